@@ -22,7 +22,6 @@
 #include "private/builtin.h"
 #include "private/cppdef.h"
 #include "private/debug.h"
-#include "didlparser.h"
 
 using namespace NSROOT;
 
@@ -491,99 +490,111 @@ void AVTransport::HandleEventMessage(EventMessagePtr msg)
       Locked<AVTProperty>::pointer prop = m_property.Get();
 
       DBG(DBG_DEBUG, "%s: %s SEQ=%s %s\n", __FUNCTION__, msg->subject[0].c_str(), msg->subject[1].c_str(), msg->subject[2].c_str());
-      std::vector<std::string>::const_iterator it = msg->subject.begin();
-      while (it != msg->subject.end())
+      std::vector<EventProperty>::const_iterator it = msg->properties.begin();
+      for (; it != msg->properties.end(); ++it)
       {
         uint32_t num;
-        if (*it == "TransportState")
-          prop->TransportState.assign(*++it);
-        else if (*it == "CurrentPlayMode")
-          prop->CurrentPlayMode.assign(*++it);
-        else if (*it == "CurrentCrossfadeMode")
-          prop->CurrentCrossfadeMode.assign(*++it);
-        else if (*it == "NumberOfTracks")
+        switch (it->id)
         {
-          string_to_uint32((*++it).c_str(), &num);
-          prop->NumberOfTracks = (unsigned)num;
+          case PROPERTY_TransportState:
+            prop->TransportState.assign(it->value);
+            break;
+          case PROPERTY_CurrentPlayMode:
+            prop->CurrentPlayMode.assign(it->value);
+            break;
+          case PROPERTY_CurrentCrossfadeMode:
+            prop->CurrentCrossfadeMode.assign(it->value);
+            break;
+          case PROPERTY_NumberOfTracks:
+            string_to_uint32(it->value.c_str(), &num);
+            prop->NumberOfTracks = (unsigned)num;
+            break;
+          case PROPERTY_CurrentTrack:
+            string_to_uint32(it->value.c_str(), &num);
+            prop->CurrentTrack = (unsigned)num;
+            break;
+          case PROPERTY_CurrentSection:
+            string_to_uint32(it->value.c_str(), &num);
+            prop->CurrentSection = (unsigned)num;
+            break;
+          case PROPERTY_CurrentTrackURI:
+            prop->CurrentTrackURI.assign(it->value);
+            break;
+          case PROPERTY_CurrentTrackDuration:
+            prop->CurrentTrackDuration.assign(it->value);
+            break;
+          case PROPERTY_CurrentTrackMetaData:
+            if (it->item)
+              prop->CurrentTrackMetaData = it->item;
+            else
+              prop->CurrentTrackMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
+            break;
+          case PROPERTY_r_NextTrackURI:
+            prop->r_NextTrackURI.assign(it->value);
+            break;
+          case PROPERTY_r_NextTrackMetaData:
+            if (it->item)
+              prop->r_NextTrackMetaData = it->item;
+            else
+              prop->r_NextTrackMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
+            break;
+          case PROPERTY_r_EnqueuedTransportURI:
+            prop->r_EnqueuedTransportURI.assign(it->value);
+            break;
+          case PROPERTY_r_EnqueuedTransportURIMetaData:
+            if (it->item)
+              prop->r_EnqueuedTransportURIMetaData = it->item;
+            else
+              prop->r_EnqueuedTransportURIMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
+            break;
+          case PROPERTY_PlaybackStorageMedium:
+            prop->PlaybackStorageMedium.assign(it->value);
+            break;
+          case PROPERTY_AVTransportURI:
+            prop->AVTransportURI.assign(it->value);
+            break;
+          case PROPERTY_AVTransportURIMetaData:
+            if (it->item)
+              prop->AVTransportURIMetaData = it->item;
+            else
+              prop->AVTransportURIMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
+            break;
+          case PROPERTY_NextAVTransportURI:
+            prop->NextAVTransportURI.assign(it->value);
+            break;
+          case PROPERTY_NextAVTransportURIMetaData:
+            prop->NextAVTransportURIMetaData.assign(it->value);
+            break;
+          case PROPERTY_CurrentTransportActions:
+            prop->CurrentTransportActions.assign(it->value);
+            break;
+          case PROPERTY_r_CurrentValidPlayModes:
+            prop->r_CurrentValidPlayModes.assign(it->value);
+            break;
+          case PROPERTY_r_MuseSessions:
+            prop->r_MuseSessions.assign(it->value);
+            break;
+          case PROPERTY_TransportStatus:
+            prop->TransportStatus.assign(it->value);
+            break;
+          case PROPERTY_r_SleepTimerGeneration:
+            prop->r_SleepTimerGeneration.assign(it->value);
+            break;
+          case PROPERTY_r_AlarmRunning:
+            prop->r_AlarmRunning.assign(it->value);
+            break;
+          case PROPERTY_r_SnoozeRunning:
+            prop->r_SnoozeRunning.assign(it->value);
+            break;
+          case PROPERTY_r_RestartPending:
+            prop->r_RestartPending.assign(it->value);
+            break;
+          case PROPERTY_PossiblePlaybackStorageMedia:
+            prop->PossiblePlaybackStorageMedia.assign(it->value);
+            break;
+          default:
+            break;
         }
-        else if (*it == "CurrentTrack")
-        {
-          string_to_uint32((*++it).c_str(), &num);
-          prop->CurrentTrack = (unsigned)num;
-        }
-        else if (*it == "CurrentSection")
-        {
-          string_to_uint32((*++it).c_str(), &num);
-          prop->CurrentSection = (unsigned)num;
-        }
-        else if (*it == "CurrentTrackURI")
-          prop->CurrentTrackURI.assign(*++it);
-        else if (*it == "CurrentTrackDuration")
-          prop->CurrentTrackDuration.assign(*++it);
-        else if (*it == "CurrentTrackMetaData")
-        {
-          DIDLParser didl((*++it).c_str());
-          if (didl.IsValid() && !didl.GetItems().empty())
-            prop->CurrentTrackMetaData = didl.GetItems()[0];
-          else
-            prop->CurrentTrackMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
-        }
-        else if (*it == "r:NextTrackURI")
-          prop->r_NextTrackURI.assign(*++it);
-        else if (*it == "r:NextTrackMetaData")
-        {
-          DIDLParser didl((*++it).c_str());
-          if (didl.IsValid() && !didl.GetItems().empty())
-            prop->r_NextTrackMetaData = didl.GetItems()[0];
-          else
-            prop->r_NextTrackMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
-        }
-        else if (*it == "r:EnqueuedTransportURI")
-          prop->r_EnqueuedTransportURI.assign(*++it);
-        else if (*it == "r:EnqueuedTransportURIMetaData")
-        {
-          DIDLParser didl((*++it).c_str());
-          if (didl.IsValid() && !didl.GetItems().empty())
-            prop->r_EnqueuedTransportURIMetaData = didl.GetItems()[0];
-          else
-            prop->r_EnqueuedTransportURIMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
-        }
-        else if (*it == "PlaybackStorageMedium")
-          prop->PlaybackStorageMedium.assign(*++it);
-        else if (*it == "AVTransportURI")
-          prop->AVTransportURI.assign(*++it);
-        else if (*it == "AVTransportURIMetaData")
-        {
-          DIDLParser didl((*++it).c_str());
-          if (didl.IsValid() && !didl.GetItems().empty())
-            prop->AVTransportURIMetaData = didl.GetItems()[0];
-          else
-            prop->AVTransportURIMetaData.reset(new DigitalItem(DigitalItem::Type_unknown));
-        }
-        else if (*it == "NextAVTransportURI")
-          prop->NextAVTransportURI.assign(*++it);
-        else if (*it == "NextAVTransportURIMetaData")
-          prop->NextAVTransportURIMetaData.assign(*++it);
-        else if (*it == "CurrentTransportActions")
-          prop->CurrentTransportActions.assign(*++it);
-        else if (*it == "r:CurrentValidPlayModes")
-          prop->r_CurrentValidPlayModes.assign(*++it);
-        else if (*it == "r:MuseSessions")
-          prop->r_MuseSessions.assign(*++it);
-        else if (*it == "TransportStatus")
-          prop->TransportStatus.assign(*++it);
-        else if (*it == "r:SleepTimerGeneration")
-          prop->r_SleepTimerGeneration.assign(*++it);
-        else if (*it == "r:AlarmRunning")
-          prop->r_AlarmRunning.assign(*++it);
-        else if (*it == "r:SnoozeRunning")
-          prop->r_SnoozeRunning.assign(*++it);
-        else if (*it == "r:RestartPending")
-          prop->r_RestartPending.assign(*++it);
-        else if (*it == "PossiblePlaybackStorageMedia")
-          prop->PossiblePlaybackStorageMedia.assign(*++it);
-
-        ++it;
       }
       // Signal
       ++m_msgCount;
@@ -22,10 +22,16 @@
 #include "private/builtin.h"
 #include "private/debug.h"
 #include "eventhandler.h"
-#include "didlparser.h"
+#include "didlpage.h"
 #include "private/cppdef.h"
+#include "private/browsecache.h"
+#include "private/soapreader.h"
+#include "private/didlpagereader.h"
+#include "private/os/threads/threadpool.h"
+#include "private/os/threads/timeout.h"
 
 #include <list>
+#include <map>
 
 using namespace NSROOT;
 
@@ -57,6 +63,7 @@ ContentDirectory::ContentDirectory(const std::string& serviceHost, unsigned serv
 , m_subscription()
 , m_CBHandle(0)
 , m_eventCB(0)
+, m_cache(NULL)
 , m_property(ContentProperty())
 {
 }
@@ -67,6 +74,7 @@ ContentDirectory::ContentDirectory(const std::string& serviceHost, unsigned serv
 , m_subscription(subscription)
 , m_CBHandle(CBHandle)
 , m_eventCB(eventCB)
+, m_cache(new BrowseCache())
 , m_property(ContentProperty())
 {
   unsigned subId = m_eventHandler.CreateSubscription(this);
@@ -76,9 +84,10 @@ ContentDirectory::ContentDirectory(const std::string& serviceHost, unsigned serv
 ContentDirectory::~ContentDirectory()
 {
   m_eventHandler.RevokeAllSubscriptions(this);
+  SAFE_DELETE(m_cache);
 }
 
-bool ContentDirectory::Browse(const std::string& objectId, unsigned index, unsigned count, ElementList &vars)
+static ElementList __browseArgs(const std::string& objectId, unsigned index, unsigned count)
 {
   char buf[11];
   ElementList args;
@@ -90,12 +99,58 @@ bool ContentDirectory::Browse(const std::string& objectId, unsigned index, unsig
   uint32_to_string((uint32_t)count, buf);
   args.push_back(ElementPtr(new Element("RequestedCount", buf)));
   args.push_back(ElementPtr(new Element("SortCriteria", "")));
-  vars = Request("Browse", args);
+  return args;
+}
+
+bool ContentDirectory::Browse(const std::string& objectId, unsigned index, unsigned count, ElementList &vars)
+{
+  vars = Request("Browse", __browseArgs(objectId, index, count));
   if (!vars.empty() && vars[0]->compare("BrowseResponse") == 0)
     return true;
   return false;
 }
 
+bool ContentDirectory::Browse(const std::string& objectId, unsigned index, unsigned count, ElementList& vars, DIDLPagePtr& page)
+{
+  unsigned generation = 0;
+  BrowseCache* cache = (m_cache && m_cache->Bind(m_subscription.GetSID()) ? m_cache : NULL);
+  if (cache)
+  {
+    if (cache->Find(objectId, index, count, vars, page))
+      return true;
+    generation = cache->Generation(objectId);
+  }
+  vars.clear();
+  page.reset();
+  // the result is decoded into the page while it is received
+  DIDLPageReader didl;
+  XMLStreamParser parser(didl);
+  SOAPReader reader(vars);
+  reader.Embed("Result", parser);
+  if (!Request("Browse", __browseArgs(objectId, index, count), reader) ||
+          vars.empty() || vars[0]->compare("BrowseResponse") != 0)
+    return false;
+  if (reader.IsEmbedded())
+    page.reset(new DIDLPage(didl));
+  if (cache && page)
+    cache->Store(objectId, index, count, vars, page, generation);
+  return true;
+}
+
+void ContentDirectory::ClearCache()
+{
+  if (m_cache)
+    m_cache->Clear();
+}
+
+bool ContentDirectory::GetGeneration(const std::string& objectId, unsigned& generation)
+{
+  if (!m_cache || !m_cache->Bind(m_subscription.GetSID()))
+    return false;
+  generation = m_cache->Generation(objectId);
+  return true;
+}
+
 bool ContentDirectory::RefreshShareIndex()
 {
   ElementList vars;
@@ -113,6 +168,8 @@ bool ContentDirectory::DestroyObject(const std::string& objectID)
   ElementList args;
   args.push_back(ElementPtr(new Element("ObjectID", objectID)));
   vars = Request("DestroyObject", args);
+  if (m_cache)
+    m_cache->Invalidate(objectID);
   if (!vars.empty() && vars[0]->compare("DestroyObjectResponse") == 0)
     return true;
   return false;
@@ -125,6 +182,8 @@ bool ContentDirectory::CreateObject(const std::string& containerID, const Digita
   args.push_back(ElementPtr(new Element("ContainerID", containerID)));
   args.push_back(ElementPtr(new Element("Elements", element->DIDL())));
   vars = Request("CreateObject", args);
+  if (m_cache)
+    m_cache->Invalidate(containerID);
   if (!vars.empty() && vars[0]->compare("CreateObjectResponse") == 0)
     return true;
   return false;
@@ -141,46 +200,69 @@ void ContentDirectory::HandleEventMessage(EventMessagePtr msg)
       Locked<ContentProperty>::pointer prop = m_property.Get();
 
       DBG(DBG_DEBUG, "%s: %s SEQ=%s %s\n", __FUNCTION__, msg->subject[0].c_str(), msg->subject[1].c_str(), msg->subject[2].c_str());
-      std::vector<std::string>::const_iterator it = msg->subject.begin();
-      while (it != msg->subject.end())
+      std::vector<EventProperty>::const_iterator it = msg->properties.begin();
+      for (; it != msg->properties.end(); ++it)
       {
-        if (*it == "SystemUpdateID")
-          prop->SystemUpdateID.assign(*++it);
-        else if (*it == "ContainerUpdateIDs")
+        switch (it->id)
         {
-          prop->ContainerUpdateIDs.clear();
-          std::vector<std::string> tokens;
-          __tokenize((*++it).c_str(), ",", tokens);
-          std::vector<std::string>::const_iterator itt = tokens.begin();
-          while (itt != tokens.end())
+          case PROPERTY_SystemUpdateID:
+            prop->SystemUpdateID.assign(it->value);
+            break;
+          case PROPERTY_ContainerUpdateIDs:
           {
-            const std::string& str = *itt;
-            if (++itt != tokens.end())
+            prop->ContainerUpdateIDs.clear();
+            std::vector<std::string> tokens;
+            __tokenize(it->value.c_str(), ",", tokens);
+            std::vector<std::string>::const_iterator itt = tokens.begin();
+            while (itt != tokens.end())
             {
-              uint32_t num;
-              if (string_to_uint32(itt->c_str(), &num) == 0)
-                prop->ContainerUpdateIDs.push_back(std::make_pair(str, num));
+              const std::string& str = *itt;
+              if (++itt != tokens.end())
+              {
+                uint32_t num;
+                if (string_to_uint32(itt->c_str(), &num) == 0)
+                {
+                  prop->ContainerUpdateIDs.push_back(std::make_pair(str, num));
+                  if (m_cache)
+                    m_cache->Update(str, num);
+                }
+              }
             }
+            break;
           }
+          case PROPERTY_UserRadioUpdateID:
+            prop->UserRadioUpdateID.assign(it->value);
+            break;
+          case PROPERTY_SavedQueuesUpdateID:
+            prop->SavedQueuesUpdateID.assign(it->value);
+            break;
+          case PROPERTY_ShareListUpdateID:
+            prop->ShareListUpdateID.assign(it->value);
+            break;
+          case PROPERTY_RecentlyPlayedUpdateID:
+            prop->RecentlyPlayedUpdateID.assign(it->value);
+            break;
+          case PROPERTY_RadioFavoritesUpdateID:
+            prop->RadioFavoritesUpdateID.assign(it->value);
+            break;
+          case PROPERTY_RadioLocationUpdateID:
+            prop->RadioLocationUpdateID.assign(it->value);
+            break;
+          case PROPERTY_FavoritesUpdateID:
+            prop->FavoritesUpdateID.assign(it->value);
+            break;
+          case PROPERTY_FavoritePresetsUpdateID:
+            prop->FavoritePresetsUpdateID.assign(it->value);
+            break;
+          case PROPERTY_ShareIndexInProgress:
+            prop->ShareIndexInProgress = (it->value == "1" || it->value == "true");
+            break;
+          case PROPERTY_ShareIndexLastError:
+            prop->ShareIndexLastError.assign(it->value);
+            break;
+          default:
+            break;
         }
-        else if (*it == "UserRadioUpdateID")
-          prop->UserRadioUpdateID.assign(*++it);
-        else if (*it == "SavedQueuesUpdateID")
-          prop->SavedQueuesUpdateID.assign(*++it);
-        else if (*it == "ShareListUpdateID")
-          prop->ShareListUpdateID.assign(*++it);
-        else if (*it == "RecentlyPlayedUpdateID")
-          prop->RecentlyPlayedUpdateID.assign(*++it);
-        else if (*it == "RadioFavoritesUpdateID")
-          prop->RadioFavoritesUpdateID.assign(*++it);
-        else if (*it == "RadioLocationUpdateID")
-          prop->RadioLocationUpdateID.assign(*++it);
-        else if (*it == "FavoritesUpdateID")
-          prop->FavoritesUpdateID.assign(*++it);
-        else if (*it == "FavoritePresetsUpdateID")
-          prop->FavoritePresetsUpdateID.assign(*++it);
-
-        ++it;
       }
       // Signal
       if (m_eventCB)
@@ -249,36 +331,269 @@ std::string ContentSearch::Root() const
 //// ContentList
 ////
 
-ContentList::ContentList(ContentDirectory& service, const ContentSearch& search, unsigned bulksize)
+#define PREFETCH_LATENCY  250   // ms, the aimed duration of a chunk request
+
+namespace NSROOT
+{
+  /**
+   * A chunk of content returned by Browse, parsed by the thread which
+   * requested it.
+   */
+  struct ContentChunk
+  {
+    unsigned index;           ///< requested starting index
+    unsigned count;           ///< requested count
+    bool succeeded;
+    bool parsed;
+    bool hasUpdateID;
+    bool hasTotal;
+    uint32_t updateID;
+    uint32_t total;
+    unsigned elapsed;         ///< duration of the request in ms
+    size_t bytes;             ///< footprint of the page
+    volatile bool ready;
+    std::vector<DigitalItemPtr> items;
+    DIDLPagePtr page;
+
+    ContentChunk(unsigned _index, unsigned _count)
+    : index(_index), count(_count), succeeded(false), parsed(false), hasUpdateID(false), hasTotal(false)
+    , updateID(0), total(0), elapsed(0), bytes(0), ready(false) { }
+
+    unsigned size() const { return (unsigned) (page ? page->Count() : items.size()); }
+  };
+
+  static void __browseChunk(ContentDirectory& service, const std::string& root, bool compact, ContentChunk& chunk)
+  {
+    DBG(DBG_PROTO, "%s: browse %u from %u\n", __FUNCTION__, chunk.count, chunk.index);
+    int64_t start = OS::gettime_ms();
+    ElementList vars;
+    DIDLPagePtr page;
+    if ((chunk.succeeded = service.Browse(root, chunk.index, chunk.count, vars, page)))
+    {
+      chunk.hasUpdateID = (string_to_uint32(vars.GetValue("UpdateID").c_str(), &chunk.updateID) == 0);
+      chunk.hasTotal = (string_to_uint32(vars.GetValue("TotalMatches").c_str(), &chunk.total) == 0);
+      if ((chunk.parsed = (page && page->IsValid())))
+      {
+        chunk.bytes = page->Footprint();
+        if (compact)
+          chunk.page = page;
+        else
+        {
+          chunk.items.reserve(page->Count());
+          for (unsigned i = 0; i < page->Count(); ++i)
+            chunk.items.push_back(page->Materialize(i));
+        }
+      }
+    }
+    chunk.elapsed = (unsigned) (OS::gettime_ms() - start);
+  }
+
+  /**
+   * Keeps chunks requested ahead of the list. A chunk is taken by the list
+   * once received, so the count of chunks held never exceeds the depth.
+   */
+  class ContentPrefetch
+  {
+  public:
+    ContentPrefetch(ContentDirectory& service, const std::string& root, bool compact,
+                    unsigned depth, unsigned size, unsigned next, unsigned total);
+    ~ContentPrefetch();
+
+    void Fill();
+    ContentChunk* Take(unsigned index);
+    unsigned Gap(unsigned index);
+    void Adjust(const ContentChunk& chunk);
+
+  private:
+    class Fetcher : public OS::CWorker
+    {
+    public:
+      Fetcher(ContentPrefetch& prefetch, ContentChunk* chunk) : m_prefetch(prefetch), m_chunk(chunk) { }
+      ~Fetcher();
+      void Process();
+    private:
+      ContentPrefetch& m_prefetch;
+      ContentChunk* m_chunk;
+    };
+
+    ContentDirectory& m_service;
+    std::string m_root;
+    bool m_compact;
+    unsigned m_depth;
+    unsigned m_minSize;
+    unsigned m_maxSize;
+    unsigned m_size;          ///< size of the next chunk to request
+    unsigned m_next;          ///< index of the next chunk to request
+    unsigned m_total;
+    OS::CMutex m_mutex;
+    OS::CCondition<volatile bool> m_condition;
+    std::map<unsigned, ContentChunk*> m_chunks; ///< requested, by starting index
+    OS::CThreadPool m_pool;   ///< destroyed first, so the running fetchers end
+  };
+}
+
+ContentPrefetch::ContentPrefetch(ContentDirectory& service, const std::string& root, bool compact,
+                                 unsigned depth, unsigned size, unsigned next, unsigned total)
+: m_service(service)
+, m_root(root)
+, m_compact(compact)
+, m_depth(depth)
+, m_minSize(size)
+, m_maxSize(BROWSE_MAX)
+, m_size(size)
+, m_next(next)
+, m_total(total)
+, m_pool(depth)
+{
+  m_pool.SetKeepAlive(1000);
+}
+
+ContentPrefetch::~ContentPrefetch()
+{
+  m_pool.Reset();
+  // wait for the running fetchers before releasing the chunks
+  OS::CLockGuard lock(m_mutex);
+  for (std::map<unsigned, ContentChunk*>::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+  {
+    m_condition.Wait(m_mutex, it->second->ready);
+    delete it->second;
+  }
+}
+
+void ContentPrefetch::Fetcher::Process()
+{
+  __browseChunk(m_prefetch.m_service, m_prefetch.m_root, m_prefetch.m_compact, *m_chunk);
+}
+
+ContentPrefetch::Fetcher::~Fetcher()
+{
+  // the chunk is ready when the worker is processed or dropped by the pool
+  OS::CLockGuard lock(m_prefetch.m_mutex);
+  m_chunk->ready = true;
+  m_prefetch.m_condition.Broadcast();
+}
+
+void ContentPrefetch::Fill()
+{
+  OS::CLockGuard lock(m_mutex);
+  while (m_chunks.size() < m_depth && m_next < m_total)
+  {
+    unsigned count = (m_total - m_next < m_size ? m_total - m_next : m_size);
+    ContentChunk* chunk = new ContentChunk(m_next, count);
+    m_chunks.insert(std::make_pair(m_next, chunk));
+    m_next += count;
+    Fetcher* worker = new Fetcher(*this, chunk);
+    if (!m_pool.Enqueue(worker))
+      delete worker; // the chunk fails
+  }
+}
+
+ContentChunk* ContentPrefetch::Take(unsigned index)
+{
+  OS::CLockGuard lock(m_mutex);
+  std::map<unsigned, ContentChunk*>::iterator it = m_chunks.find(index);
+  if (it == m_chunks.end())
+    return NULL;
+  ContentChunk* chunk = it->second;
+  m_condition.Wait(m_mutex, chunk->ready);
+  m_chunks.erase(it);
+  return chunk;
+}
+
+unsigned ContentPrefetch::Gap(unsigned index)
+{
+  OS::CLockGuard lock(m_mutex);
+  if (index >= m_total)
+    return 0;
+  // a chunk shorter than requested leaves a gap before the next one
+  std::map<unsigned, ContentChunk*>::const_iterator it = m_chunks.lower_bound(index);
+  if (it != m_chunks.end())
+    return it->first - index;
+  unsigned count = (m_total - index < m_size ? m_total - index : m_size);
+  if (m_next < index + count)
+    m_next = index + count;
+  return count;
+}
+
+void ContentPrefetch::Adjust(const ContentChunk& chunk)
+{
+  OS::CLockGuard lock(m_mutex);
+  if (chunk.hasTotal)
+    m_total = chunk.total;
+  unsigned size = chunk.size();
+  if (size < chunk.count && chunk.index + size < m_total)
+  {
+    // the server bounds the count returned
+    m_maxSize = (size > 0 ? size : 1);
+    if (m_minSize > m_maxSize)
+      m_minSize = m_maxSize;
+    m_size = m_maxSize;
+  }
+  else if (size == chunk.count)
+  {
+    // aim at the latency: large chunks amortize the round trip, small ones
+    // don't hold the list when the server is slow
+    unsigned next = (chunk.elapsed > 0 ? (unsigned) ((uint64_t)size * PREFETCH_LATENCY / chunk.elapsed) : 2 * size);
+    if (next > 2 * m_size)
+      next = 2 * m_size;
+    else if (next < m_size / 2)
+      next = m_size / 2;
+    m_size = (next > m_maxSize ? m_maxSize : next < m_minSize ? m_minSize : next);
+  }
+  DBG(DBG_PROTO, "%s: %u items in %u ms, next size %u\n", __FUNCTION__, size, chunk.elapsed, m_size);
+}
+
+ContentList::ContentList(ContentDirectory& service, const ContentSearch& search, unsigned bulksize, bool compact, unsigned prefetch)
 : m_succeeded(false)
 , m_service(service)
 , m_bulkSize(BROWSE_COUNT)
+, m_compact(compact)
 , m_root(search.Root())
 , m_baseUpdateID(0)
 , m_totalCount(0)
 , m_browsedCount(0)
 , m_lastUpdateID(0)
+, m_changed(false)
+, m_prefetch(NULL)
 {
   if (bulksize > 0 && bulksize < BROWSE_COUNT)
     m_bulkSize = bulksize;
   BrowseContent(0, m_bulkSize, m_list.begin());
   m_baseUpdateID = m_lastUpdateID; // save baseline ID for this content
+  if (prefetch > 0 && m_succeeded)
+  {
+    m_prefetch = new ContentPrefetch(m_service, m_root, m_compact, prefetch, m_bulkSize, m_browsedCount, m_totalCount);
+    m_prefetch->Fill();
+  }
 }
 
-ContentList::ContentList(ContentDirectory& service, const std::string& objectID, unsigned bulksize)
+ContentList::ContentList(ContentDirectory& service, const std::string& objectID, unsigned bulksize, bool compact, unsigned prefetch)
 : m_succeeded(false)
 , m_service(service)
 , m_bulkSize(BROWSE_COUNT)
+, m_compact(compact)
 , m_root(objectID)
 , m_baseUpdateID(0)
 , m_totalCount(0)
 , m_browsedCount(0)
 , m_lastUpdateID(0)
+, m_changed(false)
+, m_prefetch(NULL)
 {
   if (bulksize > 0 && bulksize < BROWSE_COUNT)
     m_bulkSize = bulksize;
   BrowseContent(0, m_bulkSize, m_list.begin());
   m_baseUpdateID = m_lastUpdateID; // save baseline ID for this content
+  if (prefetch > 0 && m_succeeded)
+  {
+    m_prefetch = new ContentPrefetch(m_service, m_root, m_compact, prefetch, m_bulkSize, m_browsedCount, m_totalCount);
+    m_prefetch->Fill();
+  }
+}
+
+ContentList::~ContentList()
+{
+  SAFE_DELETE(m_prefetch);
 }
 
 bool ContentList::Next(List::iterator& i)
@@ -289,7 +604,14 @@ bool ContentList::Next(List::iterator& i)
     bool r = true;
     List::iterator n = i;
     if (++n == e)
-      r = BrowseContent(m_browsedCount, m_bulkSize, n);
+    {
+      if (m_changed)
+        r = false;
+      else if (m_prefetch)
+        r = PrefetchContent(n);
+      else
+        r = BrowseContent(m_browsedCount, m_bulkSize, n);
+    }
     ++i; // On failure i becomes end
     return r;
   }
@@ -308,29 +630,60 @@ bool ContentList::Previous(List::iterator& i)
 
 bool ContentList::BrowseContent(unsigned startingIndex, unsigned count, List::iterator position)
 {
-  DBG(DBG_PROTO, "%s: browse %u from %u\n", __FUNCTION__, count, startingIndex);
-  ElementList vars;
-  ElementList::const_iterator it;
-  if ((m_succeeded = m_service.Browse(m_root, startingIndex, count, vars)) && (it = vars.FindKey("Result")) != vars.end())
-  {
-    uint32_t updateID = 0;
-    if (string_to_uint32(vars.GetValue("UpdateID").c_str(), &updateID) == 0)
-      m_lastUpdateID = updateID; // set update ID for this chunk of data
-    uint32_t totalcount = 0;
-    if (string_to_uint32(vars.GetValue("TotalMatches").c_str(), &totalcount) == 0)
-      m_totalCount = totalcount; // reset total count
-    uint32_t count = 0;
-    string_to_uint32(vars.GetValue("NumberReturned").c_str(), &count);
-    DIDLParser didl((*it)->c_str(), count);
-    if (didl.IsValid())
-    {
-      m_list.insert(position, didl.GetItems().begin(), didl.GetItems().end());
-      m_browsedCount += didl.GetItems().size();
-      DBG(DBG_PROTO, "%s: count %u\n", __FUNCTION__, didl.GetItems().size());
-      return true;
-    }
+  ContentChunk chunk(startingIndex, count);
+  __browseChunk(m_service, m_root, m_compact, chunk);
+  return AddContent(chunk, position);
+}
+
+bool ContentList::PrefetchContent(List::iterator position)
+{
+  ContentChunk* chunk = m_prefetch->Take(m_browsedCount);
+  if (!chunk)
+  {
+    unsigned count = m_prefetch->Gap(m_browsedCount);
+    if (count == 0)
+      return false;
+    chunk = new ContentChunk(m_browsedCount, count);
+    __browseChunk(m_service, m_root, m_compact, *chunk);
   }
-  return false;
+  bool r = false;
+  if (chunk->succeeded && chunk->hasUpdateID && chunk->updateID != m_baseUpdateID)
+  {
+    // the items could be moved between the chunks
+    DBG(DBG_WARN, "%s: content of %s changed (%u, %u)\n", __FUNCTION__, m_root.c_str(), m_baseUpdateID, chunk->updateID);
+    m_lastUpdateID = chunk->updateID;
+    m_changed = true;
+    m_succeeded = false;
+    SAFE_DELETE(m_prefetch);
+  }
+  else if ((r = AddContent(*chunk, position)))
+  {
+    m_prefetch->Adjust(*chunk);
+    m_prefetch->Fill();
+  }
+  delete chunk;
+  return r;
+}
+
+bool ContentList::AddContent(ContentChunk& chunk, List::iterator position)
+{
+  m_succeeded = chunk.succeeded;
+  if (chunk.hasUpdateID)
+    m_lastUpdateID = chunk.updateID; // set update ID for this chunk of data
+  if (chunk.hasTotal)
+    m_totalCount = chunk.total; // reset total count
+  if (!chunk.parsed)
+    return false;
+  if (chunk.page)
+  {
+    for (unsigned i = 0; i < chunk.page->Count(); ++i)
+      m_list.insert(position, ContentItem(DIDLItem(chunk.page, i)));
+  }
+  else
+    m_list.insert(position, chunk.items.begin(), chunk.items.end());
+  m_browsedCount += chunk.size();
+  DBG(DBG_PROTO, "%s: count %u\n", __FUNCTION__, chunk.size());
+  return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -338,90 +691,531 @@ bool ContentList::BrowseContent(unsigned startingIndex, unsigned count, List::it
 //// ContentBrowser
 ////
 
-ContentBrowser::ContentBrowser(ContentDirectory& service, const ContentSearch& search, unsigned count)
+namespace NSROOT
+{
+  /**
+   * Pages of content at fixed offsets, the most recently browsed first.
+   * The pages of the window read are pinned until the next read, and the
+   * budget is enforced on each read.
+   */
+  class ContentPageCache
+  {
+  public:
+    ContentPageCache(ContentDirectory& service, const std::string& root, bool compact,
+                     unsigned pageSize, size_t budget, unsigned prefetch);
+    ~ContentPageCache();
+
+    /**
+     * Fill the items of the window, fetching the missing pages with one
+     * request by run of pages, and waiting for the pages being prefetched.
+     */
+    bool Read(unsigned index, unsigned count, ContentBrowser::Items& items);
+
+    /**
+     * Request the pages next to the window, after it when forward.
+     */
+    void Prefetch(unsigned index, unsigned count, bool forward);
+
+    unsigned Total();
+    unsigned UpdateID();
+
+  private:
+    struct Page
+    {
+      ContentBrowser::Items items;
+      size_t bytes;
+      bool succeeded;
+      volatile bool ready;
+      bool listed;
+      bool hasUpdateID;
+      uint32_t updateID;      ///< UpdateID of the response holding the page
+      std::list<unsigned>::iterator lru;
+      Page() : bytes(0), succeeded(false), ready(false), listed(false), hasUpdateID(false), updateID(0) { }
+    };
+
+    typedef std::vector<std::pair<unsigned, unsigned> > Runs;
+
+    class Fetcher : public OS::CWorker
+    {
+    public:
+      Fetcher(ContentPageCache& cache, unsigned first, unsigned last)
+      : m_cache(cache), m_first(first), m_last(last), m_processed(false) { }
+      ~Fetcher();
+      void Process();
+    private:
+      ContentPageCache& m_cache;
+      unsigned m_first;
+      unsigned m_last;
+      bool m_processed;
+    };
+
+    ContentDirectory& m_service;
+    std::string m_root;
+    bool m_compact;
+    unsigned m_pageSize;
+    size_t m_budget;
+    unsigned m_prefetch;
+    unsigned m_total;
+    bool m_hasTotal;
+    uint32_t m_updateID;
+    bool m_hasUpdateID;
+    unsigned m_generation;    ///< Generation of the content of the pages
+    size_t m_size;            ///< bytes of the pages listed
+    unsigned m_pinFirst;
+    unsigned m_pinLast;
+    OS::CMutex m_mutex;
+    OS::CCondition<volatile bool> m_condition;
+    std::map<unsigned, Page*> m_pages;  ///< by index of page
+    std::list<unsigned> m_lru;          ///< pages received, the most recent first
+    OS::CThreadPool m_pool;   ///< destroyed first, so the running fetcher ends
+
+    void Claim(unsigned first, unsigned last, Runs& runs);
+    void Load(unsigned first, unsigned last);
+    void Abandon(unsigned first, unsigned last);
+    void Drop(std::map<unsigned, Page*>::iterator it);
+    void Flush(unsigned first, unsigned last);
+    void Expire();
+    void Renew(unsigned first, unsigned last, Runs& runs);
+    void Evict();
+    bool Pinned(unsigned page) const { return page >= m_pinFirst && page <= m_pinLast; }
+  };
+}
+
+ContentPageCache::ContentPageCache(ContentDirectory& service, const std::string& root, bool compact,
+                                   unsigned pageSize, size_t budget, unsigned prefetch)
 : m_service(service)
-, m_root(search.Root())
-, m_baseUpdateID(0)
+, m_root(root)
+, m_compact(compact)
+, m_pageSize(pageSize > 0 ? pageSize : BROWSE_COUNT)
+, m_budget(budget)
+, m_prefetch(prefetch)
+, m_total(0)
+, m_hasTotal(false)
+, m_updateID(0)
+, m_hasUpdateID(false)
+, m_generation(0)
+, m_size(0)
+, m_pinFirst(1)
+, m_pinLast(0)
+, m_pool(1)
+{
+  m_pool.SetKeepAlive(1000);
+}
+
+ContentPageCache::~ContentPageCache()
+{
+  m_pool.Reset();
+  // wait for the running fetcher before releasing the pages
+  OS::CLockGuard lock(m_mutex);
+  for (std::map<unsigned, Page*>::iterator it = m_pages.begin(); it != m_pages.end(); ++it)
+  {
+    m_condition.Wait(m_mutex, it->second->ready);
+    delete it->second;
+  }
+}
+
+void ContentPageCache::Fetcher::Process()
+{
+  m_cache.Load(m_first, m_last);
+  m_processed = true;
+}
+
+ContentPageCache::Fetcher::~Fetcher()
+{
+  // the pages fail when the worker is dropped by the pool
+  if (!m_processed)
+    m_cache.Abandon(m_first, m_last);
+}
+
+unsigned ContentPageCache::Total()
+{
+  OS::CLockGuard lock(m_mutex);
+  return m_total;
+}
+
+unsigned ContentPageCache::UpdateID()
+{
+  OS::CLockGuard lock(m_mutex);
+  return m_updateID;
+}
+
+void ContentPageCache::Claim(unsigned first, unsigned last, Runs& runs)
+{
+  if (m_hasTotal)
+  {
+    if (m_total == 0)
+      return;
+    unsigned end = (m_total - 1) / m_pageSize;
+    if (last > end)
+      last = end;
+  }
+  // a run doesn't exceed the largest chunk, unless a page does
+  unsigned maxRun = (BROWSE_MAX > m_pageSize ? BROWSE_MAX / m_pageSize : 1);
+  bool open = false;
+  for (unsigned p = first; p <= last; ++p)
+  {
+    std::map<unsigned, Page*>::iterator it = m_pages.find(p);
+    if (it != m_pages.end())
+    {
+      // a page received or being fetched is taken as is, a failed one is retried
+      if (!it->second->ready || it->second->succeeded)
+      {
+        open = false;
+        continue;
+      }
+      Drop(it);
+    }
+    Page* page = new Page();
+    m_pages.insert(std::make_pair(p, page));
+    if (open && runs.back().second - runs.back().first + 1 < maxRun)
+      runs.back().second = p;
+    else
+      runs.push_back(std::make_pair(p, p));
+    open = true;
+  }
+}
+
+void ContentPageCache::Load(unsigned first, unsigned last)
+{
+  unsigned start = first * m_pageSize;
+  unsigned end = (last + 1) * m_pageSize;
+  ContentBrowser::Items items;
+  size_t bytes = 0;
+  bool succeeded = false;
+  ContentChunk result(start, end - start);
+  while (start < end)
+  {
+    ContentChunk chunk(start, end - start);
+    __browseChunk(m_service, m_root, m_compact, chunk);
+    if (!(succeeded = (chunk.succeeded && chunk.parsed)))
+      break;
+    if (chunk.hasUpdateID)
+    {
+      if (result.hasUpdateID && chunk.updateID != result.updateID)
+      {
+        // the items could be moved between the chunks
+        succeeded = false;
+        break;
+      }
+      result.hasUpdateID = true;
+      result.updateID = chunk.updateID;
+    }
+    if (chunk.hasTotal)
+    {
+      result.hasTotal = true;
+      result.total = chunk.total;
+    }
+    if (chunk.page)
+    {
+      for (unsigned i = 0; i < chunk.page->Count(); ++i)
+        items.push_back(ContentItem(DIDLItem(chunk.page, i)));
+    }
+    else
+      items.insert(items.end(), chunk.items.begin(), chunk.items.end());
+    bytes += chunk.bytes;
+    // the server bounds the count returned
+    if (chunk.size() == 0 || (result.hasTotal && start + chunk.size() >= result.total))
+      break;
+    start += chunk.size();
+  }
+
+  OS::CLockGuard lock(m_mutex);
+  if (succeeded)
+  {
+    if (result.hasTotal)
+    {
+      m_total = result.total;
+      m_hasTotal = true;
+    }
+    if (result.hasUpdateID)
+    {
+      if (m_hasUpdateID && result.updateID != m_updateID)
+      {
+        DBG(DBG_DEBUG, "%s: content of %s changed (%u, %u)\n", __FUNCTION__, m_root.c_str(), m_updateID, result.updateID);
+        Flush(first, last);
+      }
+      m_updateID = result.updateID;
+      m_hasUpdateID = true;
+    }
+  }
+  for (unsigned p = first; p <= last; ++p)
+  {
+    std::map<unsigned, Page*>::iterator it = m_pages.find(p);
+    if (it == m_pages.end() || it->second->ready)
+      continue;
+    Page* page = it->second;
+    if ((page->succeeded = succeeded))
+    {
+      page->hasUpdateID = result.hasUpdateID;
+      page->updateID = result.updateID;
+      size_t offset = (size_t)(p - first) * m_pageSize;
+      if (offset < items.size())
+      {
+        size_t count = (items.size() - offset < m_pageSize ? items.size() - offset : m_pageSize);
+        page->items.assign(items.begin() + offset, items.begin() + offset + count);
+        // the pages of a chunk share its footprint
+        page->bytes = bytes * count / items.size();
+      }
+      m_lru.push_front(p);
+      page->lru = m_lru.begin();
+      page->listed = true;
+      m_size += page->bytes;
+    }
+    page->ready = true;
+  }
+  m_condition.Broadcast();
+  DBG(DBG_PROTO, "%s: pages %u to %u of %s, %u items\n", __FUNCTION__, first, last, m_root.c_str(), (unsigned)items.size());
+}
+
+void ContentPageCache::Abandon(unsigned first, unsigned last)
+{
+  OS::CLockGuard lock(m_mutex);
+  for (unsigned p = first; p <= last; ++p)
+  {
+    std::map<unsigned, Page*>::iterator it = m_pages.find(p);
+    if (it != m_pages.end())
+      it->second->ready = true;
+  }
+  m_condition.Broadcast();
+}
+
+void ContentPageCache::Drop(std::map<unsigned, Page*>::iterator it)
+{
+  Page* page = it->second;
+  if (page->listed)
+  {
+    m_lru.erase(page->lru);
+    m_size -= page->bytes;
+  }
+  delete page;
+  m_pages.erase(it);
+}
+
+void ContentPageCache::Flush(unsigned first, unsigned last)
+{
+  // keep the pages being fetched, the pinned ones, and the ones just received
+  std::map<unsigned, Page*>::iterator it = m_pages.begin();
+  while (it != m_pages.end())
+  {
+    std::map<unsigned, Page*>::iterator cur = it++;
+    if (cur->second->ready && !Pinned(cur->first) && (cur->first < first || cur->first > last))
+      Drop(cur);
+  }
+}
+
+void ContentPageCache::Expire()
+{
+  // the content changed, so all the pages received are stale
+  std::map<unsigned, Page*>::iterator it = m_pages.begin();
+  while (it != m_pages.end())
+  {
+    std::map<unsigned, Page*>::iterator cur = it++;
+    if (cur->second->ready)
+      Drop(cur);
+  }
+}
+
+void ContentPageCache::Renew(unsigned first, unsigned last, Runs& runs)
+{
+  // the pages of the window received before a change are claimed again
+  bool stale = false;
+  for (unsigned p = first; p <= last; ++p)
+  {
+    std::map<unsigned, Page*>::iterator it = m_pages.find(p);
+    if (it != m_pages.end() && it->second->ready && it->second->succeeded &&
+            it->second->hasUpdateID && m_hasUpdateID && it->second->updateID != m_updateID)
+    {
+      Drop(it);
+      stale = true;
+    }
+  }
+  if (stale)
+    Claim(first, last, runs);
+}
+
+void ContentPageCache::Evict()
+{
+  std::list<unsigned>::iterator it = m_lru.end();
+  while (m_size > m_budget && it != m_lru.begin())
+  {
+    --it;
+    if (Pinned(*it))
+      continue;
+    std::map<unsigned, Page*>::iterator pg = m_pages.find(*it++);
+    Drop(pg);
+  }
+}
+
+bool ContentPageCache::Read(unsigned index, unsigned count, ContentBrowser::Items& items)
+{
+  items.clear();
+  if (count == 0)
+    return true;
+  unsigned first = index / m_pageSize;
+  unsigned last = (index + count - 1) / m_pageSize;
+  unsigned generation = 0;
+  bool tracked = m_service.GetGeneration(m_root, generation);
+  Runs runs;
+  {
+    OS::CLockGuard lock(m_mutex);
+    m_pinFirst = first;
+    m_pinLast = last;
+    if (tracked && generation != m_generation)
+    {
+      if (!m_pages.empty())
+        DBG(DBG_DEBUG, "%s: content of %s changed\n", __FUNCTION__, m_root.c_str());
+      Expire();
+      m_generation = generation;
+    }
+    Claim(first, last, runs);
+  }
+  for (Runs::const_iterator it = runs.begin(); it != runs.end(); ++it)
+    Load(it->first, it->second);
+  // without events, a change is found by the UpdateID of a response: the
+  // pages of the window kept from before are then fetched again, once
+  if (!tracked && !runs.empty())
+  {
+    {
+      OS::CLockGuard lock(m_mutex);
+      runs.clear();
+      Renew(first, last, runs);
+    }
+    for (Runs::const_iterator it = runs.begin(); it != runs.end(); ++it)
+      Load(it->first, it->second);
+  }
+
+  OS::CLockGuard lock(m_mutex);
+  bool r = true;
+  for (unsigned p = first; p <= last; ++p)
+  {
+    if (m_hasTotal && p * m_pageSize >= m_total)
+      break;
+    std::map<unsigned, Page*>::iterator it = m_pages.find(p);
+    if (it == m_pages.end())
+    {
+      r = false;
+      break;
+    }
+    Page* page = it->second;
+    m_condition.Wait(m_mutex, page->ready);
+    if (!page->succeeded)
+    {
+      r = false;
+      break;
+    }
+    if (page->listed)
+      m_lru.splice(m_lru.begin(), m_lru, page->lru);
+    unsigned base = p * m_pageSize;
+    size_t from = (index > base ? index - base : 0);
+    size_t to = (index + count < base + m_pageSize ? index + count - base : m_pageSize);
+    if (to > page->items.size())
+      to = page->items.size();
+    if (from < to)
+      items.insert(items.end(), page->items.begin() + from, page->items.begin() + to);
+    // a short page ends the content
+    if (page->items.size() < m_pageSize)
+      break;
+  }
+  Evict();
+  return r;
+}
+
+void ContentPageCache::Prefetch(unsigned index, unsigned count, bool forward)
+{
+  if (m_prefetch == 0 || count == 0)
+    return;
+  unsigned first, last;
+  if (forward)
+  {
+    first = (index + count - 1) / m_pageSize + 1;
+    last = first + m_prefetch - 1;
+  }
+  else
+  {
+    last = index / m_pageSize;
+    if (last == 0)
+      return;
+    first = (last > m_prefetch ? last - m_prefetch : 0);
+    --last;
+  }
+  OS::CLockGuard lock(m_mutex);
+  Runs runs;
+  Claim(first, last, runs);
+  for (Runs::const_iterator it = runs.begin(); it != runs.end(); ++it)
+  {
+    Fetcher* worker = new Fetcher(*this, it->first, it->second);
+    if (!m_pool.Enqueue(worker))
+      delete worker; // the pages fail
+  }
+}
+
+ContentBrowser::ContentBrowser(ContentDirectory& service, const ContentSearch& search, unsigned count, bool compact,
+                               size_t budget, unsigned prefetch)
+: m_baseUpdateID(0)
 , m_totalCount(0)
 , m_startingIndex(0)
 , m_lastUpdateID(0)
+, m_cache(new ContentPageCache(service, search.Root(), compact, count, budget, prefetch))
+, m_tableValid(false)
 {
-  BrowseContent(m_startingIndex, count, m_table.begin());
+  m_cache->Read(m_startingIndex, count, m_items);
+  m_totalCount = m_cache->Total();
+  m_lastUpdateID = m_cache->UpdateID();
   m_baseUpdateID = m_lastUpdateID; // save baseline ID for this content
 }
 
-ContentBrowser::ContentBrowser(ContentDirectory& service, const std::string& objectID, unsigned count)
-: m_service(service)
-, m_root(objectID)
-, m_baseUpdateID(0)
+ContentBrowser::ContentBrowser(ContentDirectory& service, const std::string& objectID, unsigned count, bool compact,
+                               size_t budget, unsigned prefetch)
+: m_baseUpdateID(0)
 , m_totalCount(0)
 , m_startingIndex(0)
 , m_lastUpdateID(0)
+, m_cache(new ContentPageCache(service, objectID, compact, count, budget, prefetch))
+, m_tableValid(false)
 {
-  BrowseContent(m_startingIndex, count, m_table.begin());
+  m_cache->Read(m_startingIndex, count, m_items);
+  m_totalCount = m_cache->Total();
+  m_lastUpdateID = m_cache->UpdateID();
   m_baseUpdateID = m_lastUpdateID; // save baseline ID for this content
 }
 
+ContentBrowser::~ContentBrowser()
+{
+  SAFE_DELETE(m_cache);
+}
+
 bool ContentBrowser::Browse(unsigned index, unsigned count)
 {
+  m_tableValid = false;
   if (index >= m_totalCount)
   {
-    m_table.clear();
+    m_items.clear();
     m_startingIndex = m_totalCount;
     return false;
   }
 
-  unsigned size = (unsigned) m_table.size();
   if (m_totalCount < index + count)
     count = m_totalCount - index;
 
-  if (index == m_startingIndex)
-  {
-    if (count == size)
-      return true;
-    if (count < size)
-    {
-      m_table.resize(count);
-    }
-    return BrowseContent(m_startingIndex + size, count - size, m_table.end());
-  }
-
-  if (index > m_startingIndex && index + count <= m_startingIndex + size)
-  {
-    Table tmp;
-    tmp.insert(tmp.begin(), m_table.begin() + index - m_startingIndex, m_table.begin() + index - m_startingIndex + count);
-    m_table = tmp;
-    m_startingIndex = index;
-    return true;
-  }
-
-  m_table.clear();
+  bool forward = (index >= m_startingIndex);
   m_startingIndex = index;
-  return BrowseContent(m_startingIndex, count, m_table.begin());
+  bool r = m_cache->Read(index, count, m_items);
+  m_totalCount = m_cache->Total();
+  m_lastUpdateID = m_cache->UpdateID();
+  if (r)
+    m_cache->Prefetch(index, count, forward);
+  return r;
 }
 
-bool ContentBrowser::BrowseContent(unsigned startingIndex, unsigned count, Table::iterator position)
+ContentBrowser::Table& ContentBrowser::table()
 {
-  DBG(DBG_PROTO, "%s: browse %u from %u\n", __FUNCTION__, count, startingIndex);
-  ElementList vars;
-  ElementList::const_iterator it;
-  if (m_service.Browse(m_root, startingIndex, count, vars) && (it = vars.FindKey("Result")) != vars.end())
-  {
-    uint32_t updateID = 0;
-    if (string_to_uint32(vars.GetValue("UpdateID").c_str(), &updateID) == 0)
-      m_lastUpdateID = updateID; // set update ID for this chunk of data
-    uint32_t totalcount = 0;
-    if (string_to_uint32(vars.GetValue("TotalMatches").c_str(), &totalcount) == 0)
-      m_totalCount = totalcount; // reset total count
-    uint32_t count = 0;
-    string_to_uint32(vars.GetValue("NumberReturned").c_str(), &count);
-    DIDLParser didl((*it)->c_str(), count);
-    if (didl.IsValid())
-    {
-      m_table.insert(position, didl.GetItems().begin(), didl.GetItems().end());
-      DBG(DBG_PROTO, "%s: count %u\n", __FUNCTION__, didl.GetItems().size());
-      return true;
-    }
+  if (!m_tableValid)
+  {
+    m_table.clear();
+    m_table.reserve(m_items.size());
+    for (Items::iterator it = m_items.begin(); it != m_items.end(); ++it)
+      m_table.push_back(it->item());
+    m_tableValid = true;
   }
-  return false;
+  return m_table;
 }
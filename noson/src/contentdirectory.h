@@ -24,6 +24,7 @@
 #include <local_config.h>
 #include "service.h"
 #include "digitalitem.h"
+#include "didlpage.h"
 #include "eventhandler.h"
 #include "subscription.h"
 #include "locked.h"
@@ -33,10 +34,13 @@
 #include <stdint.h>
 
 #define BROWSE_COUNT  100
+#define BROWSE_MAX    1000  // largest chunk requested by a prefetch
+#define BROWSE_BUDGET 0x400000  // bytes of content kept by a browser
 
 namespace NSROOT
 {
   class Subscription;
+  class BrowseCache;
 
   class ContentDirectory : public Service, public EventSubscriber
   {
@@ -58,8 +62,30 @@ namespace NSROOT
 
     const std::string& GetSCPDURL() const { return SCPDURL; }
 
+    /**
+     * The result is the DIDL document as received.
+     */
     bool Browse(const std::string& objectId, unsigned index, unsigned count, ElementList& vars);
 
+    /**
+     * The DIDL document of the result is decoded into the page while it is
+     * received, and the other values are in vars. With events, the responses
+     * are cached until the update ID of their container changes, so browsing
+     * the same range again is local.
+     * @return false if the request failed; the page is null if the result
+     *         isn't a valid DIDL document
+     */
+    bool Browse(const std::string& objectId, unsigned index, unsigned count, ElementList& vars, DIDLPagePtr& page);
+
+    void ClearCache();
+
+    /**
+     * The generation of the content of the object, which changes with the
+     * update ID of a container in the same scope.
+     * @return false if the changes aren't tracked, as without events
+     */
+    bool GetGeneration(const std::string& objectId, unsigned& generation);
+
     bool RefreshShareIndex();
 
     bool DestroyObject(const std::string& objectID);
@@ -76,8 +102,13 @@ namespace NSROOT
     Subscription m_subscription;
     void* m_CBHandle;
     EventCB m_eventCB;
+    BrowseCache* m_cache;
 
     Locked<ContentProperty> m_property;
+
+    // prevent copy
+    ContentDirectory(const ContentDirectory&);
+    ContentDirectory& operator=(const ContentDirectory&);
   };
 
   /////////////////////////////////////////////////////////////////////////////
@@ -115,20 +146,61 @@ namespace NSROOT
     std::string m_string;
   };
 
+  /////////////////////////////////////////////////////////////////////////////
+  ////
+  //// ContentItem
+  ////
+
+  /**
+   * An item of browsed content. In compact mode the item refers to the DIDL
+   * page of its chunk, and the legacy item is built on first access.
+   */
+  class ContentItem
+  {
+  public:
+    ContentItem(const DigitalItemPtr& item) : m_item(item) {}
+    ContentItem(const DIDLItem& ref) : m_ref(ref) {}
+    virtual ~ContentItem() {}
+
+    const DIDLItem& ref() const { return m_ref; }
+
+    DigitalItemPtr& item()
+    {
+      if (!m_item && m_ref.IsValid())
+        m_item = m_ref.Materialize();
+      return m_item;
+    }
+
+  private:
+    DIDLItem m_ref;
+    DigitalItemPtr m_item;
+  };
+
   /////////////////////////////////////////////////////////////////////////////
   ////
   //// ContentList
   ////
 
+  class ContentPrefetch;
+  struct ContentChunk;
+
   class ContentList
   {
-    typedef std::list<DigitalItemPtr> List;
+    typedef std::list<ContentItem> List;
 
     friend class iterator;
   public:
-    ContentList(ContentDirectory& service, const ContentSearch& search, unsigned bulksize = BROWSE_COUNT);
-    ContentList(ContentDirectory& service, const std::string& objectID, unsigned bulksize = BROWSE_COUNT);
-    virtual ~ContentList() {}
+    /**
+     * @param compact keep each chunk in one DIDL page, instead of an item
+     * per entry. The legacy items are built on dereference, and the page
+     * is accessed by the ref() of the iterator.
+     * @param prefetch count of chunks requested ahead of the iterator. The
+     * size of the chunks then follows the latency of the responses, and the
+     * list fails when the content changed during the browse.
+     */
+    ContentList(ContentDirectory& service, const ContentSearch& search, unsigned bulksize = BROWSE_COUNT, bool compact = false, unsigned prefetch = 0);
+    ContentList(ContentDirectory& service, const std::string& objectID, unsigned bulksize = BROWSE_COUNT, bool compact = false, unsigned prefetch = 0);
+    virtual ~ContentList();
 
     class iterator
     {
@@ -143,8 +215,9 @@ namespace NSROOT
       self_type& operator--(int junk) { (void)junk; if (c) c->Previous(i); return *this; }
       bool operator==(const self_type& rhs) const { return rhs.i == i; }
       bool operator!=(const self_type& rhs) const { return rhs.i != i; }
-      List::value_type& operator*() const { return *i; }
-      List::value_type* operator->() const { return &*i; }
+      DigitalItemPtr& operator*() const { return i->item(); }
+      DigitalItemPtr* operator->() const { return &(i->item()); }
+      const DIDLItem& ref() const { return i->ref(); }
     private:
       ContentList* c;
       List::iterator i;
@@ -153,6 +226,11 @@ namespace NSROOT
 
     bool failure() const { return !m_succeeded; }
 
+    /**
+     * The update ID of a chunk differed from the first one.
+     */
+    bool changed() const { return m_changed; }
+
     iterator begin() { return iterator(this, m_list.begin()); }
 
     iterator end() { return iterator(this, m_list.end()); }
@@ -165,17 +243,26 @@ namespace NSROOT
     bool m_succeeded;
     ContentDirectory& m_service;
     unsigned m_bulkSize;
+    bool m_compact;
     std::string m_root;
     unsigned m_baseUpdateID;
     unsigned m_totalCount;
     unsigned m_browsedCount;
     unsigned m_lastUpdateID;
+    bool m_changed;
+    ContentPrefetch* m_prefetch;
 
     List m_list;
 
     bool Next(List::iterator& i);
     bool Previous(List::iterator& i);
     bool BrowseContent(unsigned startingIndex, unsigned count, List::iterator position);
+    bool PrefetchContent(List::iterator position);
+    bool AddContent(ContentChunk& chunk, List::iterator position);
+
+    // prevent copy
+    ContentList(const ContentList&);
+    ContentList& operator=(const ContentList&);
   };
 
   /////////////////////////////////////////////////////////////////////////////
@@ -183,38 +270,61 @@ namespace NSROOT
   //// ContentBrowser
   ////
 
+  class ContentPageCache;
+
   class ContentBrowser
   {
   public:
     typedef std::vector<DigitalItemPtr> Table;
-
-    ContentBrowser(ContentDirectory& service, const ContentSearch& search, unsigned count = BROWSE_COUNT);
-    ContentBrowser(ContentDirectory& service, const std::string& objectID, unsigned count = BROWSE_COUNT);
-    virtual ~ContentBrowser() {}
+    typedef std::vector<ContentItem> Items;
+
+    /**
+     * The content is fetched by pages of count items, which are kept while
+     * the budget allows, the least recently browsed dropped first. The pages
+     * missing from a window are requested together, and the pages next to it
+     * are prefetched in the direction of the browsing. The pages are dropped
+     * when the content changes, as notified by the events of the service.
+     * Without events, a change is found by the UpdateID of the responses, so
+     * the pages kept are only checked when a page is fetched.
+     * @param compact keep each chunk in one DIDL page. The items are then
+     * read through items(), and table() builds the legacy items on demand.
+     * @param budget bytes of content kept, measured on the results received
+     * @param prefetch count of pages requested ahead of the window
+     */
+    ContentBrowser(ContentDirectory& service, const ContentSearch& search, unsigned count = BROWSE_COUNT, bool compact = false,
+                   size_t budget = BROWSE_BUDGET, unsigned prefetch = 0);
+    ContentBrowser(ContentDirectory& service, const std::string& objectID, unsigned count = BROWSE_COUNT, bool compact = false,
+                   size_t budget = BROWSE_BUDGET, unsigned prefetch = 0);
+    virtual ~ContentBrowser();
 
     bool Browse(unsigned startingIndex, unsigned count);
 
     unsigned index() { return m_startingIndex; }
 
-    unsigned count() { return (unsigned) m_table.size(); }
+    unsigned count() { return (unsigned) m_items.size(); }
 
     unsigned total() { return m_totalCount; }
 
-    Table& table() { return m_table; }
+    Table& table();
+
+    Items& items() { return m_items; }
 
     unsigned GetUpdateID() { return m_baseUpdateID; }
 
   private:
-    ContentDirectory& m_service;
-    std::string m_root;
     unsigned m_baseUpdateID;
     unsigned m_totalCount;
     unsigned m_startingIndex;
     unsigned m_lastUpdateID;
+    ContentPageCache* m_cache;
 
+    Items m_items;
     Table m_table;
+    bool m_tableValid;
 
-    bool BrowseContent(unsigned startingIndex, unsigned count, Table::iterator position);
+    // prevent copy
+    ContentBrowser(const ContentBrowser&);
+    ContentBrowser& operator=(const ContentBrowser&);
   };
 
 }
@@ -0,0 +1,448 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "didlpage.h"
+#include "didlparser.h"
+#include "private/didlpagereader.h"
+#include "private/debug.h"
+#include "private/cppdef.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define KEY_LOCAL     0x80000000
+#define KEY_NONE      0xffffffff
+
+using namespace NSROOT;
+
+namespace NSROOT
+{
+  extern XMLDict DIDLDict;
+
+  /**
+   * The qualified names of the DIDL schema, and the names of their
+   * attributes. They are interned by index.
+   */
+  static const char* g_keys[] = {
+    DIDL_QNAME_DC "title",
+    DIDL_QNAME_DC "creator",
+    DIDL_QNAME_DC "date",
+    DIDL_QNAME_DC "description",
+    DIDL_QNAME_DC "contributor",
+    DIDL_QNAME_DC "publisher",
+    DIDL_QNAME_UPNP "class",
+    DIDL_QNAME_UPNP "album",
+    DIDL_QNAME_UPNP "artist",
+    DIDL_QNAME_UPNP "albumArtURI",
+    DIDL_QNAME_UPNP "genre",
+    DIDL_QNAME_UPNP "originalTrackNumber",
+    DIDL_QNAME_UPNP "author",
+    DIDL_QNAME_UPNP "playlist",
+    DIDL_QNAME_UPNP "icon",
+    DIDL_QNAME_RINC "albumArtist",
+    DIDL_QNAME_RINC "streamContent",
+    DIDL_QNAME_RINC "radioShowMd",
+    DIDL_QNAME_RINC "streamInfo",
+    DIDL_QNAME_RINC "description",
+    DIDL_QNAME_RINC "type",
+    DIDL_QNAME_RINC "resMD",
+    DIDL_QNAME_RINC "ordinal",
+    DIDL_QNAME_DIDL "res",
+    DIDL_QNAME_DIDL "desc",
+    "protocolInfo",
+    "duration",
+    "size",
+    "bitrate",
+    "sampleFrequency",
+    "nrAudioChannels",
+    "id",
+    "nameSpace",
+    "role",
+  };
+
+  static uint32_t __internedKey(const char* name)
+  {
+    for (uint32_t k = 0; k < sizeof(g_keys) / sizeof(const char*); ++k)
+      if (strcmp(g_keys[k], name) == 0)
+        return k;
+    return KEY_NONE;
+  }
+}
+
+DIDLPageReader::DIDLPageReader(size_t length, unsigned elements, unsigned attributes)
+: m_depth(0)
+, m_item(false)
+, m_var(false)
+, m_mark(0)
+{
+  // the counts are bounds found by the caller, so the parse doesn't grow
+  // the storage
+  items.reserve(elements);
+  props.reserve(elements);
+  attrs.reserve(attributes);
+  text.reserve(length + 1);
+}
+
+DIDLPage::StrRec DIDLPageReader::AddString(const char* str)
+{
+  DIDLPage::StrRec rec;
+  rec.off = (uint32_t)text.size();
+  rec.len = (uint32_t)strlen(str);
+  text.append(str, rec.len).push_back('\0');
+  return rec;
+}
+
+uint32_t DIDLPageReader::AddKey(const std::string& name)
+{
+  uint32_t key = __internedKey(name.c_str());
+  if (key == KEY_NONE)
+  {
+    key = KEY_LOCAL | (uint32_t)keys.size();
+    keys.append(name).push_back('\0');
+  }
+  return key;
+}
+
+uint32_t DIDLPageReader::ElementKey(const char* qname)
+{
+  for (KeyCache::const_iterator it = m_qnames.begin(); it != m_qnames.end(); ++it)
+    if (it->first.compare(qname) == 0)
+      return it->second;
+  uint32_t key = AddKey(DIDLDict.TranslateQName(m_names, qname));
+  m_qnames.push_back(std::make_pair(std::string(qname), key));
+  return key;
+}
+
+uint32_t DIDLPageReader::AttributeKey(const char* name)
+{
+  for (KeyCache::const_iterator it = m_anames.begin(); it != m_anames.end(); ++it)
+    if (it->first.compare(name) == 0)
+      return it->second;
+  uint32_t key = AddKey(name);
+  m_anames.push_back(std::make_pair(std::string(name), key));
+  return key;
+}
+
+bool DIDLPageReader::StartElement(const char* name, const XMLStreamAttributes& attrs)
+{
+  switch (++m_depth)
+  {
+  case 1:
+    if (!XMLNS::NameEqual(name, "DIDL-Lite"))
+      return false;
+    // learn declared namespaces in the element the DIDL-Lite for translations
+    for (unsigned i = 0; i < attrs.Count(); ++i)
+    {
+      if (XMLNS::PrefixEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS(XMLNS::LocalName(attrs.Name(i)), attrs.Value(i));
+      else if (XMLNS::NameEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS("", attrs.Value(i));
+    }
+    break;
+  case 2:
+  {
+    const char* id;
+    const char* parentID;
+    m_item = false;
+    if ((XMLNS::NameEqual(name, "item") || XMLNS::NameEqual(name, "container")) &&
+            (id = attrs.Find("id")) && (parentID = attrs.Find("parentID")))
+    {
+      m_item = true;
+      DIDLPage::ItemRec rec;
+      rec.id = AddString(id);
+      rec.parentID = AddString(parentID);
+      const char* val = attrs.Find("restricted");
+      rec.restricted = (val && strncmp(val, "true", 4) == 0) ? 1 : 0;
+      rec.firstProp = (uint32_t)props.size();
+      rec.propCount = 0;
+      items.push_back(rec);
+    }
+    break;
+  }
+  case 3:
+    if (m_item)
+    {
+      m_var = true;
+      m_mark = text.size();
+      DIDLPage::PropRec rec;
+      rec.key = ElementKey(name);
+      rec.firstAttr = (uint32_t)this->attrs.size();
+      rec.attrCount = attrs.Count();
+      for (unsigned i = 0; i < attrs.Count(); ++i)
+      {
+        DIDLPage::AttrRec attr;
+        attr.key = AttributeKey(attrs.Name(i));
+        attr.value = AddString(attrs.Value(i));
+        this->attrs.push_back(attr);
+      }
+      // the value is the last string of the variable, so the text can be
+      // appended in place
+      rec.value.off = (uint32_t)text.size();
+      rec.value.len = 0;
+      props.push_back(rec);
+    }
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool DIDLPageReader::EndElement(const char* name)
+{
+  (void)name;
+  switch (m_depth--)
+  {
+  case 2:
+    m_item = false;
+    break;
+  case 3:
+    if (m_var)
+    {
+      DIDLPage::PropRec& rec = props.back();
+      if (rec.value.len == 0)
+      {
+        // a variable without text is ignored
+        attrs.resize(rec.firstAttr);
+        text.resize(m_mark);
+        props.pop_back();
+      }
+      else
+      {
+        text.push_back('\0');
+        ++(items.back().propCount);
+      }
+    }
+    m_var = false;
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool DIDLPageReader::Characters(const char* text, size_t len)
+{
+  if (m_var && m_depth == 3)
+  {
+    this->text.append(text, len);
+    props.back().value.len += (uint32_t)len;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// DIDLPage
+////
+
+DIDLPage::DIDLPage(const char* document)
+: m_parsed(false)
+, m_block(NULL)
+, m_size(0)
+, m_itemCount(0)
+, m_items(NULL)
+, m_props(NULL)
+, m_attrs(NULL)
+, m_text(NULL)
+, m_keys(NULL)
+{
+  m_parsed = Parse(document);
+}
+
+DIDLPage::DIDLPage(const DIDLPageReader& reader)
+: m_parsed(false)
+, m_block(NULL)
+, m_size(0)
+, m_itemCount(0)
+, m_items(NULL)
+, m_props(NULL)
+, m_attrs(NULL)
+, m_text(NULL)
+, m_keys(NULL)
+{
+  Pack(reader);
+  m_parsed = true;
+}
+
+DIDLPage::~DIDLPage()
+{
+  delete[] m_block;
+}
+
+bool DIDLPage::Parse(const char* document)
+{
+  if (!document)
+    return false;
+  // skip a document without markup
+  const char* p = document;
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    ++p;
+  if (*p != '<')
+    return false;
+  // bound the counts of records: every element opens with '<' and every
+  // attribute has '='
+  size_t length = 0;
+  unsigned elements = 0, attributes = 0;
+  for (const char* c = p; *c; ++c, ++length)
+  {
+    if (*c == '<')
+      ++elements;
+    else if (*c == '=')
+      ++attributes;
+  }
+  DIDLPageReader reader(length, elements, attributes);
+  XMLStreamParser parser(reader);
+  if (!parser.Feed(p, length) || !parser.Finish())
+    return false;
+  Pack(reader);
+  return true;
+}
+
+void DIDLPage::Pack(const DIDLPageReader& reader)
+{
+  // pack the records and the strings in one block
+  size_t itemsSize = reader.items.size() * sizeof(ItemRec);
+  size_t propsSize = reader.props.size() * sizeof(PropRec);
+  size_t attrsSize = reader.attrs.size() * sizeof(AttrRec);
+  m_size = itemsSize + propsSize + attrsSize + reader.text.size() + reader.keys.size() + 1;
+  m_block = new char[m_size];
+  char* b = m_block;
+  if (itemsSize)
+    memcpy(b, &reader.items[0], itemsSize);
+  m_items = reinterpret_cast<const ItemRec*>(b);
+  b += itemsSize;
+  if (propsSize)
+    memcpy(b, &reader.props[0], propsSize);
+  m_props = reinterpret_cast<const PropRec*>(b);
+  b += propsSize;
+  if (attrsSize)
+    memcpy(b, &reader.attrs[0], attrsSize);
+  m_attrs = reinterpret_cast<const AttrRec*>(b);
+  b += attrsSize;
+  memcpy(b, reader.text.data(), reader.text.size());
+  m_text = b;
+  b += reader.text.size();
+  memcpy(b, reader.keys.data(), reader.keys.size());
+  m_keys = b;
+  b[reader.keys.size()] = '\0';
+  m_itemCount = (unsigned)reader.items.size();
+  DBG(DBG_PROTO, "%s: %u items in %u bytes\n", __FUNCTION__, m_itemCount, (unsigned)m_size);
+}
+
+const char* DIDLPage::KeyName(uint32_t key) const
+{
+  if (key & KEY_LOCAL)
+    return m_keys + (key & ~KEY_LOCAL);
+  return g_keys[key];
+}
+
+bool DIDLPage::KeyEqual(uint32_t key, uint32_t interned, const char* name) const
+{
+  if (key & KEY_LOCAL)
+    return strcmp(m_keys + (key & ~KEY_LOCAL), name) == 0;
+  return key == interned;
+}
+
+const DIDLPage::PropRec* DIDLPage::FindProperty(unsigned item, const char* key) const
+{
+  if (item >= m_itemCount)
+    return NULL;
+  uint32_t interned = __internedKey(key);
+  const ItemRec& rec = m_items[item];
+  for (uint32_t i = rec.firstProp; i < rec.firstProp + rec.propCount; ++i)
+    if (KeyEqual(m_props[i].key, interned, key))
+      return &m_props[i];
+  return NULL;
+}
+
+const char* DIDLPage::GetObjectID(unsigned item) const
+{
+  return (item < m_itemCount ? m_text + m_items[item].id.off : "");
+}
+
+const char* DIDLPage::GetParentID(unsigned item) const
+{
+  return (item < m_itemCount ? m_text + m_items[item].parentID.off : "");
+}
+
+bool DIDLPage::GetRestricted(unsigned item) const
+{
+  return (item < m_itemCount && m_items[item].restricted);
+}
+
+const char* DIDLPage::GetValue(unsigned item, const char* key) const
+{
+  const PropRec* prop = FindProperty(item, key);
+  return (prop ? m_text + prop->value.off : "");
+}
+
+const char* DIDLPage::GetAttribut(unsigned item, const char* key, const char* name) const
+{
+  const PropRec* prop = FindProperty(item, key);
+  if (prop)
+  {
+    uint32_t interned = __internedKey(name);
+    for (uint32_t i = prop->firstAttr; i < prop->firstAttr + prop->attrCount; ++i)
+      if (KeyEqual(m_attrs[i].key, interned, name))
+        return m_text + m_attrs[i].value.off;
+  }
+  return "";
+}
+
+unsigned DIDLPage::GetPropertyCount(unsigned item) const
+{
+  return (item < m_itemCount ? m_items[item].propCount : 0);
+}
+
+const char* DIDLPage::GetPropertyKey(unsigned item, unsigned prop) const
+{
+  if (prop >= GetPropertyCount(item))
+    return "";
+  return KeyName(m_props[m_items[item].firstProp + prop].key);
+}
+
+const char* DIDLPage::GetPropertyValue(unsigned item, unsigned prop) const
+{
+  if (prop >= GetPropertyCount(item))
+    return "";
+  return m_text + m_props[m_items[item].firstProp + prop].value.off;
+}
+
+DigitalItemPtr DIDLPage::Materialize(unsigned item) const
+{
+  if (item >= m_itemCount)
+    return DigitalItemPtr();
+  const ItemRec& rec = m_items[item];
+  ElementList vars;
+  vars.reserve(rec.propCount);
+  for (uint32_t i = rec.firstProp; i < rec.firstProp + rec.propCount; ++i)
+  {
+    const PropRec& prop = m_props[i];
+    ElementPtr var = MAKE_SHARED<Element>(KeyName(prop.key), std::string(m_text + prop.value.off, prop.value.len));
+    for (uint32_t a = prop.firstAttr; a < prop.firstAttr + prop.attrCount; ++a)
+      var->SetAttribut(KeyName(m_attrs[a].key), std::string(m_text + m_attrs[a].value.off, m_attrs[a].value.len));
+    vars.push_back(var);
+  }
+  return MAKE_SHARED<DigitalItem>(std::string(m_text + rec.id.off, rec.id.len),
+                                  std::string(m_text + rec.parentID.off, rec.parentID.len),
+                                  rec.restricted != 0, vars);
+}
@@ -0,0 +1,178 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DIDLPAGE_H
+#define	DIDLPAGE_H
+
+#include <local_config.h>
+#include "digitalitem.h"
+#include "sharedptr.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace NSROOT
+{
+  class DIDLPage;
+  class DIDLPageReader;
+
+  typedef SHARED_PTR<DIDLPage> DIDLPagePtr;
+
+  /**
+   * The items of a DIDL document, as returned by a page of Browse, held in
+   * one block of memory: the records of the items, their properties and
+   * attributes, then the decoded strings. The strings are NUL terminated and
+   * stay valid for the life of the page. The qualified names known from the
+   * DIDL schema are interned once for all; others are stored in the page.
+   */
+  class DIDLPage
+  {
+  public:
+    DIDLPage(const char* document);
+
+    /**
+     * Pack the records of a document decoded by the reader.
+     */
+    explicit DIDLPage(const DIDLPageReader& reader);
+    ~DIDLPage();
+
+    bool IsValid() const { return m_parsed; }
+
+    unsigned Count() const { return m_itemCount; }
+
+    /**
+     * The size of the block holding the page.
+     */
+    size_t Footprint() const { return m_size; }
+
+    const char* GetObjectID(unsigned item) const;
+    const char* GetParentID(unsigned item) const;
+    bool GetRestricted(unsigned item) const;
+
+    /**
+     * The value of the first property with the given qualified name
+     * (i.e "dc:title"), or an empty string.
+     */
+    const char* GetValue(unsigned item, const char* key) const;
+    const char* GetAttribut(unsigned item, const char* key, const char* name) const;
+
+    unsigned GetPropertyCount(unsigned item) const;
+    const char* GetPropertyKey(unsigned item, unsigned prop) const;
+    const char* GetPropertyValue(unsigned item, unsigned prop) const;
+
+    /**
+     * Build the legacy item from the records of the page.
+     */
+    DigitalItemPtr Materialize(unsigned item) const;
+
+  private:
+    struct StrRec
+    {
+      uint32_t off;       ///< offset in the text
+      uint32_t len;
+    };
+
+    struct ItemRec
+    {
+      StrRec id;
+      StrRec parentID;
+      uint32_t firstProp;
+      uint32_t propCount;
+      uint32_t restricted;
+    };
+
+    struct PropRec
+    {
+      uint32_t key;       ///< interned key, else offset in the local keys
+      StrRec value;
+      uint32_t firstAttr;
+      uint32_t attrCount;
+    };
+
+    struct AttrRec
+    {
+      uint32_t key;
+      StrRec value;
+    };
+
+    friend class DIDLPageReader;
+
+    bool m_parsed;
+    char* m_block;
+    size_t m_size;
+    unsigned m_itemCount;
+    const ItemRec* m_items;
+    const PropRec* m_props;
+    const AttrRec* m_attrs;
+    const char* m_text;
+    const char* m_keys;
+
+    bool Parse(const char* document);
+    void Pack(const DIDLPageReader& reader);
+    const char* KeyName(uint32_t key) const;
+    bool KeyEqual(uint32_t key, uint32_t interned, const char* name) const;
+    const PropRec* FindProperty(unsigned item, const char* key) const;
+
+    // prevent copy
+    DIDLPage(const DIDLPage&);
+    DIDLPage& operator=(const DIDLPage&);
+  };
+
+  /**
+   * A reference to an item of a page. It keeps the page alive.
+   */
+  class DIDLItem
+  {
+  public:
+    DIDLItem() : m_index(0) {}
+    DIDLItem(const DIDLPagePtr& page, unsigned index) : m_page(page), m_index(index) {}
+    virtual ~DIDLItem() {}
+
+    bool IsValid() const { return m_page && m_index < m_page->Count(); }
+
+    const char* GetObjectID() const { return m_page->GetObjectID(m_index); }
+
+    const char* GetParentID() const { return m_page->GetParentID(m_index); }
+
+    bool GetRestricted() const { return m_page->GetRestricted(m_index); }
+
+    const char* GetValue(const char* key) const { return m_page->GetValue(m_index, key); }
+
+    const char* GetAttribut(const char* key, const char* name) const { return m_page->GetAttribut(m_index, key, name); }
+
+    unsigned GetPropertyCount() const { return m_page->GetPropertyCount(m_index); }
+
+    const char* GetPropertyKey(unsigned prop) const { return m_page->GetPropertyKey(m_index, prop); }
+
+    const char* GetPropertyValue(unsigned prop) const { return m_page->GetPropertyValue(m_index, prop); }
+
+    DigitalItemPtr Materialize() const { return m_page->Materialize(m_index); }
+
+    const DIDLPagePtr& page() const { return m_page; }
+
+    unsigned index() const { return m_index; }
+
+  private:
+    DIDLPagePtr m_page;
+    unsigned m_index;
+  };
+}
+
+#endif	/* DIDLPAGE_H */
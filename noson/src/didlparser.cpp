@@ -19,11 +19,12 @@
  */
 
 #include "didlparser.h"
-#include "private/tinyxml2.h"
-#include "private/xmldict.h"
+#include "private/didlreader.h"
 #include "private/debug.h"
 #include "private/cppdef.h"
 
+#include <cstring>
+
 using namespace NSROOT;
 
 namespace NSROOT
@@ -59,55 +60,109 @@ const char* DIDLParser::DIDLNSString()
   return DIDLDict.ToString();
 }
 
-bool DIDLParser::Parse()
+bool DIDLReader::StartElement(const char* name, const XMLStreamAttributes& attrs)
 {
-  m_items.clear();
-  tinyxml2::XMLDocument doc;
-  if (doc.Parse(m_document) != tinyxml2::XML_SUCCESS)
-    return false;
-  const tinyxml2::XMLElement* elem;
-  if ((elem = doc.RootElement()) && XMLNS::NameEqual(elem->Name(), "DIDL-Lite"))
+  switch (++m_depth)
   {
+  case 1:
+    if (!XMLNS::NameEqual(name, "DIDL-Lite"))
+      return false;
     // learn declared namespaces in the element the DIDL-Lite for translations
-    XMLNames xmlnames;
-    xmlnames.AddXMLNS(elem);
-    // loop over elements
-    elem = elem->FirstChildElement();
-    while (elem)
+    for (unsigned i = 0; i < attrs.Count(); ++i)
     {
-      struct { const char* id; const char* parentID; bool restricted; } ref;
-      if ((XMLNS::NameEqual(elem->Name(), "item") ||
-              XMLNS::NameEqual(elem->Name(), "container")) &&
-              (ref.id = elem->Attribute("id")) &&
-              (ref.parentID = elem->Attribute("parentID")))
-      {
-        const char* val = elem->Attribute("restricted");
-        if (val && strncmp(val, "true", 4) == 0)
-          ref.restricted = true;
-        else
-          ref.restricted = false;
-        ElementList vars;
-        const tinyxml2::XMLElement* velem = elem->FirstChildElement();
-        while (velem)
-        {
-          if (velem->Name() && velem->GetText())
-          {
-            ElementPtr var(new Element(DIDLDict.TranslateQName(xmlnames, velem->Name()), velem->GetText()));
-            const tinyxml2::XMLAttribute* vattr = velem->FirstAttribute();
-            while (vattr && vattr->Name() && vattr->Value())
-            {
-              var->SetAttribut(vattr->Name(), vattr->Value());
-              vattr = vattr->Next();
-            }
-            vars.push_back(var);
-          }
-          velem = velem->NextSiblingElement();
-        }
-        m_items.push_back(DigitalItemPtr(new DigitalItem(ref.id, ref.parentID, ref.restricted, vars)));
-      }
-      elem = elem->NextSiblingElement();
+      if (XMLNS::PrefixEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS(XMLNS::LocalName(attrs.Name(i)), attrs.Value(i));
+      else if (XMLNS::NameEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS("", attrs.Value(i));
     }
-    return true;
+    break;
+  case 2:
+  {
+    const char* id;
+    const char* parentID;
+    m_item = false;
+    if ((XMLNS::NameEqual(name, "item") || XMLNS::NameEqual(name, "container")) &&
+            (id = attrs.Find("id")) && (parentID = attrs.Find("parentID")))
+    {
+      m_item = true;
+      m_id.assign(id);
+      m_parentID.assign(parentID);
+      const char* val = attrs.Find("restricted");
+      m_restricted = (val && strncmp(val, "true", 4) == 0);
+      m_vars.clear();
+    }
+    break;
   }
-  return false;
+  case 3:
+    if (m_item)
+    {
+      m_var = MAKE_SHARED<Element>(DIDLDict.TranslateQName(m_names, name));
+      for (unsigned i = 0; i < attrs.Count(); ++i)
+        m_var->SetAttribut(attrs.Name(i), attrs.Value(i));
+      m_text = false;
+    }
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool DIDLReader::EndElement(const char* name)
+{
+  (void)name;
+  switch (m_depth--)
+  {
+  case 2:
+    if (m_item)
+      m_items.push_back(MAKE_SHARED<DigitalItem>(m_id, m_parentID, m_restricted, m_vars));
+    m_item = false;
+    break;
+  case 3:
+    // a variable without text is ignored
+    if (m_var && m_text)
+      m_vars.push_back(m_var);
+    m_var.reset();
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool DIDLReader::Characters(const char* text, size_t len)
+{
+  if (m_var && m_depth == 3)
+  {
+    m_var->append(text, len);
+    m_text = true;
+  }
+  return true;
+}
+
+bool DIDLReader::Parse(const char* document, size_t len, std::vector<DigitalItemPtr>& items)
+{
+  // skip a document without markup
+  const char* end = document + len;
+  while (document < end && (*document == ' ' || *document == '\t' || *document == '\r' || *document == '\n'))
+    ++document;
+  if (document == end || *document != '<')
+    return false;
+  size_t count = items.size();
+  DIDLReader reader(items);
+  XMLStreamParser parser(reader);
+  if (!parser.Feed(document, end - document) || !parser.Finish())
+  {
+    items.resize(count);
+    return false;
+  }
+  return true;
+}
+
+bool DIDLParser::Parse()
+{
+  m_items.clear();
+  if (!m_document)
+    return false;
+  return DIDLReader::Parse(m_document, strlen(m_document), m_items);
 }
@@ -59,7 +59,7 @@ DigitalItem::DigitalItem(Type_t _type, SubType_t _subType)
 , m_objectID("")
 , m_parentID("")
 {
-  ElementPtr _class(new Element(DIDL_QNAME_UPNP "class"));
+  ElementPtr _class = MAKE_SHARED<Element>(DIDL_QNAME_UPNP "class");
   _class->assign("object");
   if (m_type != Type_unknown)
   {
@@ -99,7 +99,7 @@ namespace NSROOT
 
     const ElementPtr& SetProperty(const ElementPtr& var);
 
-    const ElementPtr& SetProperty(const Element& var) { return SetProperty(ElementPtr(new Element(var))); }
+    const ElementPtr& SetProperty(const Element& var) { return SetProperty(MAKE_SHARED<Element>(var)); }
 
     const ElementPtr& SetProperty(const std::string& key, const std::string& value) { return SetProperty(Element(key, value)); }
 
@@ -135,7 +135,7 @@ namespace NSROOT
       _clone.clear();
       _clone.reserve(size());
       for (const_iterator it = begin(); it != end(); ++it)
-        _clone.push_back(ElementPtr(new Element(**it)));
+        _clone.push_back(MAKE_SHARED<Element>(**it));
     }
 
     iterator FindKey(const std::string& key, iterator _begin)
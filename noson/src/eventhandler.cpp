@@ -25,6 +25,8 @@
 #include "private/builtin.h"
 #include "private/debug.h"
 #include "private/eventbroker.h"
+#include "private/eventreactor.h"
+#include "private/mpscqueue.h"
 #include "private/wsresponse.h"
 #include "private/wsstatus.h"
 
@@ -50,100 +52,185 @@ EventHandler::EventHandlerThread::~EventHandlerThread()
 
 ///////////////////////////////////////////////////////////////////////////////
 ////
-//// SubscriptionHandlerThread
+//// SubscriptionHandler
 ////
 
+#define DISPATCH_POOL_SIZE    4
+#define DISPATCH_BATCH_SIZE   16
+#define DISPATCH_QUEUE_SIZE   128
+
 namespace NSROOT
 {
-  class SubscriptionHandlerThread : private OS::CThread
+  /**
+   * The queue of messages for a subscriber. Queues are served by the workers
+   * of a shared pool. A queue is scheduled once at most, so the messages of
+   * a subscriber are handled in order.
+   * Messages are posted to a lock-free ring. Only the producer finding the
+   * queue idle schedules a worker, which then drains the whole burst.
+   * The producer never waits: when the ring is full, the messages are parked
+   * in a spill list until the worker catches up.
+   */
+  class SubscriptionHandler
   {
   public:
-    SubscriptionHandlerThread(EventSubscriber *handle, unsigned subid);
-    virtual ~SubscriptionHandlerThread();
+    SubscriptionHandler(EventSubscriber *handle, unsigned subid, OS::CThreadPool& pool);
+    ~SubscriptionHandler();
     EventSubscriber *GetHandle() { return m_handle; }
-    bool IsRunning() { return OS::CThread::IsRunning(); }
-    void PostMessage(const EventMessage& msg);
+    void PostMessage(const EventMessagePtr& msg);
+    void ProcessQueue();
 
   private:
     EventSubscriber *m_handle;
     unsigned m_subId;
+    OS::CThreadPool& m_pool;
+    MPSCQueue<EventMessagePtr> m_msgQueue;
+    std::list<EventMessagePtr> m_spill; ///< Overflow of the ring
+    mpsc::sequence_t m_spillSize;
+    OS::CMutex m_spillLock;
+    mpsc::sequence_t m_scheduled;   ///< A worker owns the queue
+    volatile bool m_revoked;
     mutable OS::CMutex m_mutex;
-    OS::CEvent m_queueContent;
-    std::list<EventMessagePtr> m_msgQueue;
+    OS::CCondition<volatile bool> m_condition;
+    unsigned m_workers;             ///< Count of workers in the pool
+    volatile bool m_idle;           ///< No worker is in the pool
+
+    void Schedule();
+    bool PopMessage(EventMessagePtr& msg);
+    bool Empty();
+  };
 
-    bool Start();
-    void Stop();
-    void *Process();
+  class SubscriptionWorker : public OS::CWorker
+  {
+  public:
+    SubscriptionWorker(SubscriptionHandler *handler) : m_handler(handler) { }
+    virtual void Process() { m_handler->ProcessQueue(); }
+
+  private:
+    SubscriptionHandler *m_handler;
   };
 }
 
-SubscriptionHandlerThread::SubscriptionHandlerThread(EventSubscriber *handle, unsigned subid)
-: OS::CThread()
-, m_handle(handle)
+SubscriptionHandler::SubscriptionHandler(EventSubscriber *handle, unsigned subid, OS::CThreadPool& pool)
+: m_handle(handle)
 , m_subId(subid)
+, m_pool(pool)
+, m_msgQueue(DISPATCH_QUEUE_SIZE)
+, m_spill()
+, m_spillLock()
+, m_revoked(false)
 , m_mutex()
-, m_queueContent()
-, m_msgQueue()
+, m_condition()
+, m_workers(0)
+, m_idle(true)
 {
-  if (m_handle && Start())
-    DBG(DBG_DEBUG, "%s: subscription is started (%p:%u)\n", __FUNCTION__, m_handle, m_subId);
-  else
-    DBG(DBG_ERROR, "%s: subscription failed (%p:%u)\n", __FUNCTION__, m_handle, m_subId);
+  mpsc::store(m_spillSize, 0);
+  mpsc::store(m_scheduled, 0);
+  DBG(DBG_DEBUG, "%s: subscription is started (%p:%u)\n", __FUNCTION__, m_handle, m_subId);
 }
 
-SubscriptionHandlerThread::~SubscriptionHandlerThread()
+SubscriptionHandler::~SubscriptionHandler()
 {
-  Stop();
+  m_revoked = true;
+  // Wait for the scheduled worker to leave
+  OS::CLockGuard lock(m_mutex);
+  m_condition.Wait(m_mutex, m_idle);
+  DBG(DBG_DEBUG, "%s: subscription (%p:%u) stopped\n", __FUNCTION__, m_handle, m_subId);
   m_handle = NULL;
 }
 
-bool SubscriptionHandlerThread::Start()
+void SubscriptionHandler::Schedule()
 {
-  if (OS::CThread::IsRunning())
-    return true;
-  return OS::CThread::StartThread();
+  // Critical section
+  OS::CLockGuard lock(m_mutex);
+  SubscriptionWorker *worker = new SubscriptionWorker(this);
+  if (m_pool.Enqueue(worker))
+  {
+    ++m_workers;
+    m_idle = false;
+    return;
+  }
+  delete worker;
+  mpsc::store(m_scheduled, 0);
+  DBG(DBG_ERROR, "%s: dispatching failed (%p:%u)\n", __FUNCTION__, m_handle, m_subId);
 }
 
-void SubscriptionHandlerThread::Stop()
+void SubscriptionHandler::PostMessage(const EventMessagePtr& msg)
 {
-  if (OS::CThread::IsRunning())
+  if (m_revoked)
+    return;
+  // Once spilled, the messages follow the spill list to keep the order
+  if (mpsc::load(m_spillSize) > 0 || !m_msgQueue.Push(msg))
   {
-    DBG(DBG_DEBUG, "%s: subscription thread (%p:%u)\n", __FUNCTION__, m_handle, m_subId);
-    // Set stopping. don't wait as we need to signal the thread first
-    OS::CThread::StopThread(false);
-    m_queueContent.Signal();
-    // Wait for thread to stop
-    OS::CThread::StopThread(true);
-    DBG(DBG_DEBUG, "%s: subscription thread (%p:%u) stopped\n", __FUNCTION__, m_handle, m_subId);
+    OS::CLockGuard lock(m_spillLock);
+    m_spill.push_back(msg);
+    mpsc::store(m_spillSize, (unsigned)m_spill.size());
   }
+  // Only the producer finding the queue idle wakes it up
+  if (mpsc::cas(m_scheduled, 0, 1))
+    Schedule();
 }
 
-void SubscriptionHandlerThread::PostMessage(const EventMessage& msg)
+bool SubscriptionHandler::PopMessage(EventMessagePtr& msg)
 {
-  // Critical section
-  OS::CLockGuard lock(m_mutex);
-  m_msgQueue.push_back(EventMessagePtr(new EventMessage(msg)));
-  m_queueContent.Signal();
+  // The ring holds the oldest messages
+  if (m_msgQueue.Pop(msg))
+    return true;
+  if (mpsc::load(m_spillSize) == 0)
+    return false;
+  OS::CLockGuard lock(m_spillLock);
+  if (m_spill.empty())
+    return false;
+  msg = m_spill.front();
+  m_spill.pop_front();
+  mpsc::store(m_spillSize, (unsigned)m_spill.size());
+  return true;
+}
+
+bool SubscriptionHandler::Empty()
+{
+  return m_msgQueue.Empty() && mpsc::load(m_spillSize) == 0;
 }
 
-void *SubscriptionHandlerThread::Process()
+void SubscriptionHandler::ProcessQueue()
 {
-  while (!IsStopped())
+  EventMessagePtr msg;
+  unsigned count = 0;
+  for (;;)
   {
-    while (!m_msgQueue.empty() && !IsStopped())
+    while (!m_revoked && count < DISPATCH_BATCH_SIZE && PopMessage(msg))
     {
-      // Critical section
-      OS::CLockGuard lock(m_mutex);
-      EventMessagePtr msg = m_msgQueue.front();
-      m_msgQueue.pop_front();
-      lock.Unlock();
+      ++count;
       // Do work
       m_handle->HandleEventMessage(msg);
     }
-    // The tread is woken up by m_queueContent.Signal();
-    m_queueContent.Wait();
+    msg.reset();
+    if (m_revoked)
+    {
+      // Release messages of the revoked subscription
+      while (PopMessage(msg));
+      msg.reset();
+      break;
+    }
+    // Yield to other queues: the remaining messages are processed later
+    if (count >= DISPATCH_BATCH_SIZE && !Empty())
+    {
+      Schedule();
+      break;
+    }
+    // Full barrier: the ring must be checked after the release
+    mpsc::exchange(m_scheduled, 0);
+    // A message posted before the release didn't schedule: take it back
+    if (Empty() || !mpsc::cas(m_scheduled, 0, 1))
+      break;
+    count = 0;
+  }
+  // Critical section
+  OS::CLockGuard lock(m_mutex);
+  if (--m_workers == 0)
+  {
+    m_idle = true;
+    m_condition.Broadcast();
   }
-  return NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -171,12 +258,16 @@ namespace NSROOT
   private:
     OS::CMutex m_mutex;
     OS::CThreadPool m_threadpool;
+    OS::CThreadPool m_dispatcher;
     TcpServerSocket *m_socket;
+#if HAVE_EPOLL
+    EventReactor *m_reactor;
+#endif
 
     // About subscriptions
     typedef std::map<EVENT_t, std::list<unsigned> > subscriptionsByEvent_t;
     subscriptionsByEvent_t m_subscriptionsByEvent;
-    typedef std::map<unsigned, SubscriptionHandlerThread*> subscriptions_t;
+    typedef std::map<unsigned, SubscriptionHandler*> subscriptions_t;
     subscriptions_t m_subscriptions;
 
     virtual void* Process(void);
@@ -188,10 +279,17 @@ namespace NSROOT
 BasicEventHandler::BasicEventHandler(unsigned bindingPort)
 : EventHandlerThread(bindingPort), OS::CThread()
 , m_socket(new TcpServerSocket)
+#if HAVE_EPOLL
+, m_reactor(new EventReactor(this, m_threadpool))
+#endif
 {
   m_threadpool.SetMaxSize(5);
   m_threadpool.SetKeepAlive(60000);
   m_threadpool.Start();
+  // the subscription queues share the threads of the dispatcher
+  m_dispatcher.SetMaxSize(DISPATCH_POOL_SIZE);
+  m_dispatcher.SetKeepAlive(60000);
+  m_dispatcher.Start();
 }
 
 BasicEventHandler::~BasicEventHandler()
@@ -205,6 +303,9 @@ BasicEventHandler::~BasicEventHandler()
     m_subscriptions.clear();
     m_subscriptionsByEvent.clear();
   }
+#if HAVE_EPOLL
+  SAFE_DELETE(m_reactor);
+#endif
   SAFE_DELETE(m_socket);
 }
 
@@ -221,12 +322,16 @@ void BasicEventHandler::Stop()
   {
     DBG(DBG_DEBUG, "%s: event handler thread (%p)\n", __FUNCTION__, this);
     OS::CThread::StopThread(false);
+#if HAVE_EPOLL
+    m_reactor->Interrupt();
+#else
     if (m_socket->IsValid())
     {
       WSRequest req(m_listenerAddress, m_port);
       req.RequestService("/", HRM_HEAD);
       WSResponse resp(req);
     }
+#endif
     OS::CThread::StopThread(true);
     DBG(DBG_DEBUG, "%s: event handler thread (%p) stopped\n", __FUNCTION__, this);
   }
@@ -244,15 +349,14 @@ unsigned BasicEventHandler::CreateSubscription(EventSubscriber* sub)
   subscriptions_t::const_reverse_iterator it = m_subscriptions.rbegin();
   if (it != m_subscriptions.rend())
     id = it->first;
-  SubscriptionHandlerThread *handler = new SubscriptionHandlerThread(sub, ++id);
-  if (handler->IsRunning())
+  if (!sub)
   {
-    m_subscriptions.insert(std::make_pair(id, handler));
-    return id;
+    DBG(DBG_ERROR, "%s: subscription failed (%p:%u)\n", __FUNCTION__, sub, id + 1);
+    return 0;
   }
-  // Handler didn't start
-  delete handler;
-  return 0;
+  SubscriptionHandler *handler = new SubscriptionHandler(sub, ++id, m_dispatcher);
+  m_subscriptions.insert(std::make_pair(id, handler));
+  return id;
 }
 
 bool BasicEventHandler::SubscribeForEvent(unsigned subid, EVENT_t event)
@@ -275,18 +379,23 @@ bool BasicEventHandler::SubscribeForEvent(unsigned subid, EVENT_t event)
 
 void BasicEventHandler::RevokeSubscription(unsigned subid)
 {
+  SubscriptionHandler *handler = NULL;
   OS::CLockGuard lock(m_mutex);
   subscriptions_t::iterator it;
   it = m_subscriptions.find(subid);
   if (it != m_subscriptions.end())
   {
-    delete it->second;
+    handler = it->second;
     m_subscriptions.erase(it);
   }
+  lock.Unlock();
+  // Waiting for the running worker must not hold the lock
+  delete handler;
 }
 
 void BasicEventHandler::RevokeAllSubscriptions(EventSubscriber *sub)
 {
+  std::vector<SubscriptionHandler*> handlers;
   OS::CLockGuard lock(m_mutex);
   std::vector<subscriptions_t::iterator> its;
   for (subscriptions_t::iterator it = m_subscriptions.begin(); it != m_subscriptions.end(); ++it)
@@ -296,13 +405,19 @@ void BasicEventHandler::RevokeAllSubscriptions(EventSubscriber *sub)
   }
   for (std::vector<subscriptions_t::iterator>::const_iterator it = its.begin(); it != its.end(); ++it)
   {
-    delete (*it)->second;
+    handlers.push_back((*it)->second);
     m_subscriptions.erase(*it);
   }
+  lock.Unlock();
+  // Waiting for the running workers must not hold the lock
+  for (std::vector<SubscriptionHandler*>::const_iterator it = handlers.begin(); it != handlers.end(); ++it)
+    delete *it;
 }
 
 void BasicEventHandler::DispatchEvent(const EventMessage& msg)
 {
+  // subscribers share the same copy of the message
+  EventMessagePtr ptr = MAKE_SHARED<EventMessage>(msg);
   OS::CLockGuard lock(m_mutex);
   std::vector<std::list<unsigned>::iterator> revoked;
   std::list<unsigned>::iterator it1 = m_subscriptionsByEvent[msg.event].begin();
@@ -310,7 +425,7 @@ void BasicEventHandler::DispatchEvent(const EventMessage& msg)
   {
     subscriptions_t::const_iterator it2 = m_subscriptions.find(*it1);
     if (it2 != m_subscriptions.end())
-      it2->second->PostMessage(msg);
+      it2->second->PostMessage(ptr);
     else
       revoked.push_back(it1);
     ++it1;
@@ -333,6 +448,34 @@ void *BasicEventHandler::Process()
       ++m_port;
     }
   }
+#if HAVE_EPOLL
+  if (bound)
+  {
+    // requests are received by the reactor then processed by the pool
+    if (m_reactor->Open(*m_socket))
+    {
+      m_listenerAddress = "127.0.0.1"; // IPv4 localhost
+      AnnounceStatus(EVENTHANDLER_STARTED);
+      while (!OS::CThread::IsStopped())
+      {
+        if (!m_reactor->Poll(EVENTREACTOR_POLL_TIMEOUT))
+        {
+          AnnounceStatus(EVENTHANDLER_FAILED);
+          break;
+        }
+      }
+      m_reactor->Close();
+      AnnounceStatus(EVENTHANDLER_STOPPED);
+      m_listenerAddress.clear();
+    }
+    else
+    {
+      DBG(DBG_DEBUG, "%s: creating reactor failed (%d)\n", __FUNCTION__, m_socket->GetErrNo());
+      m_reactor->Close();
+      AnnounceStatus(EVENTHANDLER_FAILED);
+    }
+  }
+#else
   if (bound)
   {
     m_listenerAddress = "127.0.0.1"; // IPv4 localhost
@@ -362,6 +505,7 @@ void *BasicEventHandler::Process()
     AnnounceStatus(EVENTHANDLER_STOPPED);
     m_listenerAddress.clear();
   }
+#endif
   else
   {
     DBG(DBG_DEBUG, "%s: creating listener failed (%d)\n", __FUNCTION__, m_socket->GetErrNo());
@@ -23,6 +23,7 @@
 
 #include <local_config.h>
 #include "sharedptr.h"
+#include "digitalitem.h"
 
 #include <string>
 #include <vector>
@@ -42,10 +43,86 @@ namespace NSROOT
     EVENT_UNKNOWN,
   } EVENT_t;
 
+  /**
+   * Properties of the notifications. Names are resolved once by the event
+   * broker, so the subscribers switch on the ID.
+   */
+  typedef enum
+  {
+    PROPERTY_UNKNOWN = 0,
+    // AVTransport
+    PROPERTY_TransportState,
+    PROPERTY_CurrentPlayMode,
+    PROPERTY_CurrentCrossfadeMode,
+    PROPERTY_NumberOfTracks,
+    PROPERTY_CurrentTrack,
+    PROPERTY_CurrentSection,
+    PROPERTY_CurrentTrackURI,
+    PROPERTY_CurrentTrackDuration,
+    PROPERTY_CurrentTrackMetaData,
+    PROPERTY_r_NextTrackURI,
+    PROPERTY_r_NextTrackMetaData,
+    PROPERTY_r_EnqueuedTransportURI,
+    PROPERTY_r_EnqueuedTransportURIMetaData,
+    PROPERTY_PlaybackStorageMedium,
+    PROPERTY_AVTransportURI,
+    PROPERTY_AVTransportURIMetaData,
+    PROPERTY_NextAVTransportURI,
+    PROPERTY_NextAVTransportURIMetaData,
+    PROPERTY_CurrentTransportActions,
+    PROPERTY_r_CurrentValidPlayModes,
+    PROPERTY_r_MuseSessions,
+    PROPERTY_TransportStatus,
+    PROPERTY_r_SleepTimerGeneration,
+    PROPERTY_r_AlarmRunning,
+    PROPERTY_r_SnoozeRunning,
+    PROPERTY_r_RestartPending,
+    PROPERTY_PossiblePlaybackStorageMedia,
+    // RenderingControl
+    PROPERTY_Volume_Master,
+    PROPERTY_Volume_LF,
+    PROPERTY_Volume_RF,
+    PROPERTY_Mute_Master,
+    PROPERTY_Mute_LF,
+    PROPERTY_Mute_RF,
+    // ZoneGroupTopology
+    PROPERTY_ZoneGroupState,
+    // ContentDirectory
+    PROPERTY_SystemUpdateID,
+    PROPERTY_ContainerUpdateIDs,
+    PROPERTY_UserRadioUpdateID,
+    PROPERTY_SavedQueuesUpdateID,
+    PROPERTY_ShareListUpdateID,
+    PROPERTY_RecentlyPlayedUpdateID,
+    PROPERTY_RadioFavoritesUpdateID,
+    PROPERTY_RadioLocationUpdateID,
+    PROPERTY_FavoritesUpdateID,
+    PROPERTY_FavoritePresetsUpdateID,
+    PROPERTY_ShareIndexInProgress,
+    PROPERTY_ShareIndexLastError,
+    PROPERTY_COUNT,
+  } PROPERTY_t;
+
+  struct EventProperty
+  {
+    PROPERTY_t                id;
+    std::string               value;
+    DigitalItemPtr            item;   ///< The decoded value of a DIDL metadata
+
+    EventProperty(PROPERTY_t _id)
+    : id(_id)
+    {}
+  };
+
   struct EventMessage
   {
     EVENT_t                   event;
+    /**
+     * For EVENT_UPNP_PROPCHANGE: SID, SEQ and the kind of notification (RCS,
+     * AVT or PROPERTY). The values are in properties.
+     */
     std::vector<std::string>  subject;
+    std::vector<EventProperty> properties;
 
     EventMessage()
     : event(EVENT_UNKNOWN)
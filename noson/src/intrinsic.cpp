@@ -22,6 +22,8 @@
 #include "intrinsic.h"
 
 #include <local_config.h>
+#include <new>
+#include <cstddef>
 #if __cplusplus >= 201103L
 #include <atomic>
 typedef std::atomic<int> counter_t;
@@ -88,13 +90,20 @@ namespace NSROOT
 }
 
 IntrinsicCounter::IntrinsicCounter(int val)
-: m_ptr(new Counter(val))
+: m_ptr(NULL)
 {
+  if (sizeof(Counter) <= sizeof(m_storage))
+    m_ptr = new (&m_storage) Counter(val);
+  else
+    m_ptr = new Counter(val);
 }
 
 IntrinsicCounter::~IntrinsicCounter()
 {
-  delete m_ptr;
+  if (static_cast<void*>(m_ptr) == static_cast<void*>(&m_storage))
+    m_ptr->~Counter();
+  else
+    delete m_ptr;
 }
 
 int IntrinsicCounter::GetValue()
@@ -43,6 +43,14 @@ namespace NSROOT
     struct Counter;
     Counter* m_ptr;
 
+    // the counter is built in place when it fits, else it is allocated
+    union Storage
+    {
+      int i;
+      long l;
+      void* p;
+    } m_storage;
+
     // Prevent copy
     IntrinsicCounter(const IntrinsicCounter& other);
     IntrinsicCounter& operator=(const IntrinsicCounter& other);
@@ -0,0 +1,383 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "libraryindex.h"
+#include "contentdirectory.h"
+#include "didlparser.h"
+#include "didlpage.h"
+#include "private/os/os.h"
+#include "private/os/threads/timeout.h"
+#include "private/debug.h"
+
+#ifndef __WINDOWS__
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#define LIBRARYINDEX_BYTEORDER  0x01020304
+#define LIBRARYINDEX_PREFETCH   4
+#define RECORD_SIZE             (LibraryIndex::Field_unknown + 1)  // the fields then the flags
+#define RECORD_RESTRICTED       0x1
+
+using namespace NSROOT;
+
+struct LibraryIndex::Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t size;              ///< size of the file
+  uint32_t recordSize;        ///< count of words by record
+  uint32_t systemUpdateID;    ///< offset in the text
+  uint32_t shareListUpdateID;
+  uint32_t textOffset;
+  uint32_t textSize;
+  uint32_t sections[Section_unknown][2]; ///< first record and count
+};
+
+static const char* g_sectionRoots[LibraryIndex::Section_unknown + 1] = {
+  "A:ALBUMARTIST", "A:ALBUM", "A:TRACKS", "A:GENRE", ""
+};
+
+static const char* g_fieldKeys[LibraryIndex::Field_unknown + 1] = {
+  0, 0,
+  DIDL_QNAME_UPNP "class",
+  DIDL_QNAME_DC   "title",
+  DIDL_QNAME_DC   "creator",
+  DIDL_QNAME_UPNP "album",
+  DIDL_QNAME_UPNP "genre",
+  DIDL_QNAME_UPNP "originalTrackNumber",
+  DIDL_QNAME_UPNP "albumArtURI",
+  DIDL_QNAME_DIDL "res",
+  0, 0
+};
+
+LibraryIndex::LibraryIndex()
+: m_base(NULL)
+, m_size(0)
+, m_header(NULL)
+, m_records(NULL)
+, m_text(NULL)
+, m_textSize(0)
+{
+}
+
+LibraryIndex::~LibraryIndex()
+{
+  Close();
+}
+
+bool LibraryIndex::Open(const std::string& path)
+{
+  Close();
+#ifdef __WINDOWS__
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  char* base = NULL;
+  long size = 0;
+  if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+  {
+    base = (char*)malloc(size);
+    if (base && fread(base, 1, size, file) != (size_t)size)
+    {
+      free(base);
+      base = NULL;
+    }
+  }
+  fclose(file);
+  if (!base)
+    return false;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  char* base = NULL;
+  off_t size = 0;
+  if (fstat(fd, &st) == 0 && (size = st.st_size) > 0 && (uint64_t)size < 0xffffffff)
+  {
+    void* addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED)
+      base = (char*)addr;
+  }
+  // the mapping holds the file
+  close(fd);
+  if (!base)
+    return false;
+#endif
+  m_base = base;
+  m_size = (size_t)size;
+  if (!Check(m_size))
+  {
+    DBG(DBG_WARN, "%s: invalid index file (%s)\n", __FUNCTION__, path.c_str());
+    Close();
+    return false;
+  }
+  m_header = (const Header*)m_base;
+  m_records = (const uint32_t*)(m_base + sizeof(Header));
+  m_text = m_base + m_header->textOffset;
+  m_textSize = m_header->textSize;
+  DBG(DBG_DEBUG, "%s: index %s loaded (%u tracks)\n", __FUNCTION__, path.c_str(), Count(Section_track));
+  return true;
+}
+
+void LibraryIndex::Close()
+{
+  if (m_base)
+  {
+#ifdef __WINDOWS__
+    free((void*)m_base);
+#else
+    munmap((void*)m_base, m_size);
+#endif
+  }
+  m_base = NULL;
+  m_size = 0;
+  m_header = NULL;
+  m_records = NULL;
+  m_text = NULL;
+  m_textSize = 0;
+}
+
+bool LibraryIndex::Check(size_t size) const
+{
+  if (size < sizeof(Header))
+    return false;
+  const Header* h = (const Header*)m_base;
+  if (memcmp(h->magic, LIBRARYINDEX_MAGIC, sizeof(h->magic)) != 0 || h->version != LIBRARYINDEX_VERSION ||
+          h->byteOrder != LIBRARYINDEX_BYTEORDER || h->size != size || h->recordSize != RECORD_SIZE)
+    return false;
+  // the records fill the space up to the text, which ends the file
+  if (h->textOffset < sizeof(Header) || h->textSize == 0 || h->textOffset + (uint64_t)h->textSize != size ||
+          (h->textOffset - sizeof(Header)) % (RECORD_SIZE * sizeof(uint32_t)) != 0 || m_base[size - 1] != '\0')
+    return false;
+  uint64_t count = (h->textOffset - sizeof(Header)) / (RECORD_SIZE * sizeof(uint32_t));
+  for (unsigned s = 0; s < Section_unknown; ++s)
+  {
+    if ((uint64_t)h->sections[s][0] + h->sections[s][1] > count)
+      return false;
+  }
+  return h->systemUpdateID < h->textSize && h->shareListUpdateID < h->textSize;
+}
+
+const char* LibraryIndex::Text(uint32_t offset) const
+{
+  // the text starts with an empty string
+  return (offset < m_textSize ? m_text + offset : m_text);
+}
+
+const char* LibraryIndex::GetSystemUpdateID() const
+{
+  return (m_header ? Text(m_header->systemUpdateID) : "");
+}
+
+const char* LibraryIndex::GetShareListUpdateID() const
+{
+  return (m_header ? Text(m_header->shareListUpdateID) : "");
+}
+
+bool LibraryIndex::IsCurrent(const std::string& shareListUpdateID) const
+{
+  return (m_header && shareListUpdateID == GetShareListUpdateID());
+}
+
+unsigned LibraryIndex::Count(Section_t section) const
+{
+  if (!m_header || section >= Section_unknown)
+    return 0;
+  return m_header->sections[section][1];
+}
+
+const uint32_t* LibraryIndex::Record(Section_t section, unsigned item) const
+{
+  if (item >= Count(section))
+    return NULL;
+  return m_records + (size_t)(m_header->sections[section][0] + item) * RECORD_SIZE;
+}
+
+const char* LibraryIndex::GetValue(Section_t section, unsigned item, Field_t field) const
+{
+  const uint32_t* rec = Record(section, item);
+  if (!rec || field >= Field_unknown)
+    return "";
+  return Text(rec[field]);
+}
+
+bool LibraryIndex::GetRestricted(Section_t section, unsigned item) const
+{
+  const uint32_t* rec = Record(section, item);
+  return (rec && (rec[Field_unknown] & RECORD_RESTRICTED));
+}
+
+DigitalItemPtr LibraryIndex::Materialize(Section_t section, unsigned item) const
+{
+  const uint32_t* rec = Record(section, item);
+  if (!rec)
+    return DigitalItemPtr();
+  ElementList vars;
+  for (unsigned f = 0; f < Field_unknown; ++f)
+  {
+    const char* value = Text(rec[f]);
+    if (!g_fieldKeys[f] || *value == '\0')
+      continue;
+    ElementPtr var = MAKE_SHARED<Element>(g_fieldKeys[f], value);
+    if (f == Field_res && rec[Field_protocolInfo])
+      var->SetAttribut("protocolInfo", Text(rec[Field_protocolInfo]));
+    vars.push_back(var);
+  }
+  return MAKE_SHARED<DigitalItem>(Text(rec[Field_objectID]), Text(rec[Field_parentID]),
+                                  (rec[Field_unknown] & RECORD_RESTRICTED) != 0, vars);
+}
+
+const char* LibraryIndex::SectionRoot(Section_t section)
+{
+  return g_sectionRoots[section < Section_unknown ? section : Section_unknown];
+}
+
+namespace NSROOT
+{
+  /**
+   * Collect the records and the strings of the index. The strings are
+   * stored once.
+   */
+  class LibraryIndexWriter
+  {
+  public:
+    LibraryIndexWriter() : m_text(1, '\0') { }
+
+    uint32_t Intern(const char* str)
+    {
+      if (*str == '\0')
+        return 0;
+      std::map<std::string, uint32_t>::iterator it = m_strings.find(str);
+      if (it != m_strings.end())
+        return it->second;
+      uint32_t off = (uint32_t)m_text.size();
+      m_text.append(str).push_back('\0');
+      m_strings.insert(std::make_pair(std::string(str), off));
+      return off;
+    }
+
+    void Add(const DIDLItem& item)
+    {
+      m_records.push_back(Intern(item.GetObjectID()));
+      m_records.push_back(Intern(item.GetParentID()));
+      for (unsigned f = LibraryIndex::Field_class; f < LibraryIndex::Field_protocolInfo; ++f)
+        m_records.push_back(Intern(item.GetValue(g_fieldKeys[f])));
+      m_records.push_back(Intern(item.GetAttribut(g_fieldKeys[LibraryIndex::Field_res], "protocolInfo")));
+      m_records.push_back(item.GetRestricted() ? RECORD_RESTRICTED : 0);
+    }
+
+    uint32_t Count() const { return (uint32_t)(m_records.size() / RECORD_SIZE); }
+
+    bool Write(const std::string& path, const LibraryIndex::Header& header) const;
+
+    std::string m_text;
+    std::map<std::string, uint32_t> m_strings;
+    std::vector<uint32_t> m_records;
+  };
+}
+
+bool LibraryIndexWriter::Write(const std::string& path, const LibraryIndex::Header& header) const
+{
+  std::string tmp(path);
+  tmp.append(".tmp");
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file)
+  {
+    DBG(DBG_ERROR, "%s: cannot write index file (%s)\n", __FUNCTION__, tmp.c_str());
+    return false;
+  }
+  bool ret = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          (m_records.empty() || fwrite(&m_records[0], sizeof(uint32_t), m_records.size(), file) == m_records.size()) &&
+          fwrite(m_text.c_str(), 1, m_text.size(), file) == m_text.size());
+  if (fclose(file) != 0)
+    ret = false;
+  if (ret)
+  {
+#ifdef __WINDOWS__
+    remove(path.c_str());
+#endif
+    ret = (rename(tmp.c_str(), path.c_str()) == 0);
+  }
+  if (!ret)
+  {
+    remove(tmp.c_str());
+    DBG(DBG_ERROR, "%s: cannot write index file (%s)\n", __FUNCTION__, path.c_str());
+  }
+  return ret;
+}
+
+bool LibraryIndex::Build(ContentDirectory& service, const std::string& path,
+                         const std::string& systemUpdateID, const std::string& shareListUpdateID,
+                         const volatile bool* abort)
+{
+  LibraryIndexWriter writer;
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LIBRARYINDEX_MAGIC, sizeof(header.magic));
+  header.version = LIBRARYINDEX_VERSION;
+  header.byteOrder = LIBRARYINDEX_BYTEORDER;
+  header.recordSize = RECORD_SIZE;
+  header.systemUpdateID = writer.Intern(systemUpdateID.c_str());
+  header.shareListUpdateID = writer.Intern(shareListUpdateID.c_str());
+
+  int64_t start = OS::gettime_ms();
+  for (unsigned s = 0; s < Section_unknown; ++s)
+  {
+    header.sections[s][0] = writer.Count();
+    ContentList list(service, g_sectionRoots[s], BROWSE_COUNT, true, LIBRARYINDEX_PREFETCH);
+    for (ContentList::iterator it = list.begin(); it != list.end(); ++it)
+    {
+      if (abort && *abort)
+        return false;
+      if (it.ref().IsValid())
+        writer.Add(it.ref());
+    }
+    if (list.failure() || list.changed())
+    {
+      DBG(DBG_WARN, "%s: browsing %s failed\n", __FUNCTION__, g_sectionRoots[s]);
+      return false;
+    }
+    header.sections[s][1] = writer.Count() - header.sections[s][0];
+  }
+
+  uint64_t textOffset = sizeof(header) + (uint64_t)writer.m_records.size() * sizeof(uint32_t);
+  if (textOffset + writer.m_text.size() >= 0xffffffff)
+  {
+    DBG(DBG_ERROR, "%s: index is too large\n", __FUNCTION__);
+    return false;
+  }
+  header.textOffset = (uint32_t)textOffset;
+  header.textSize = (uint32_t)writer.m_text.size();
+  header.size = header.textOffset + header.textSize;
+  if (!writer.Write(path, header))
+    return false;
+  DBG(DBG_INFO, "%s: index %s built in %u ms (%u tracks, %u bytes)\n", __FUNCTION__, path.c_str(),
+      (unsigned)(OS::gettime_ms() - start), header.sections[Section_track][1], header.size);
+  return true;
+}
@@ -0,0 +1,152 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBRARYINDEX_H
+#define	LIBRARYINDEX_H
+
+#include <local_config.h>
+#include "digitalitem.h"
+#include "sharedptr.h"
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+#define LIBRARYINDEX_MAGIC    "NOSONIDX"
+#define LIBRARYINDEX_VERSION  1
+
+namespace NSROOT
+{
+  class ContentDirectory;
+  class LibraryIndex;
+
+  typedef SHARED_PTR<LibraryIndex> LibraryIndexPtr;
+
+  /**
+   * Compact index of the music library of the shares, kept in a file and
+   * mapped in memory (read in memory on windows, so the file can still be
+   * replaced). The file holds a header, the records of the items,
+   * then the strings, which are stored once and NUL terminated. It is written
+   * in the byte order of the host and is only valid for the update IDs of
+   * the content directory it was built from.
+   */
+  class LibraryIndex
+  {
+  public:
+    typedef enum
+    {
+      Section_albumArtist = 0,
+      Section_album,
+      Section_track,
+      Section_genre,
+      Section_unknown,
+    } Section_t;
+
+    typedef enum
+    {
+      Field_objectID = 0,
+      Field_parentID,
+      Field_class,
+      Field_title,
+      Field_creator,
+      Field_album,
+      Field_genre,
+      Field_trackNumber,
+      Field_albumArtURI,
+      Field_res,
+      Field_protocolInfo,
+      Field_unknown,
+    } Field_t;
+
+    LibraryIndex();
+    ~LibraryIndex();
+
+    /**
+     * Map the file.
+     * @return false if the file is missing or invalid
+     */
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsValid() const { return m_base != NULL; }
+
+    const char* GetSystemUpdateID() const;
+    const char* GetShareListUpdateID() const;
+
+    /**
+     * The SystemUpdateID is bumped on any change of the content directory,
+     * i.e the queue, so only the ShareListUpdateID tracks the library.
+     * @return true if the index was built for this update ID
+     */
+    bool IsCurrent(const std::string& shareListUpdateID) const;
+
+    size_t Footprint() const { return m_size; }
+
+    unsigned Count(Section_t section) const;
+
+    /**
+     * The value of a field, or an empty string.
+     */
+    const char* GetValue(Section_t section, unsigned item, Field_t field) const;
+    bool GetRestricted(Section_t section, unsigned item) const;
+
+    /**
+     * Build the legacy item, i.e to be queued.
+     */
+    DigitalItemPtr Materialize(Section_t section, unsigned item) const;
+
+    /**
+     * The container browsed for a section, i.e "A:TRACKS".
+     */
+    static const char* SectionRoot(Section_t section);
+
+    /**
+     * Browse the sections from the content directory, then replace the file
+     * atomically.
+     * @param abort stop the traversal when set
+     * @return false if the traversal failed, was aborted, or the library
+     * changed meanwhile
+     */
+    static bool Build(ContentDirectory& service, const std::string& path,
+                      const std::string& systemUpdateID, const std::string& shareListUpdateID,
+                      const volatile bool* abort = 0);
+
+  private:
+    struct Header;
+    friend class LibraryIndexWriter;
+
+    const char* m_base;
+    size_t m_size;
+    const Header* m_header;
+    const uint32_t* m_records;
+    const char* m_text;
+    uint32_t m_textSize;
+
+    const uint32_t* Record(Section_t section, unsigned item) const;
+    const char* Text(uint32_t offset) const;
+    bool Check(size_t size) const;
+
+    // prevent copy
+    LibraryIndex(const LibraryIndex&);
+    LibraryIndex& operator=(const LibraryIndex&);
+  };
+}
+
+#endif	/* LIBRARYINDEX_H */
@@ -0,0 +1,551 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "librarysearch.h"
+#include "contentdirectory.h"
+#include "didlparser.h"
+
+#include <algorithm>
+
+#define WORD_MAXLENGTH    64
+#define WORD_SHORT        8   // one typo below, two from
+#define SCORE_EXACT       4
+#define SCORE_PREFIX      2
+#define SCORE_INNER       1
+#define SCORE_SIMILAR     1
+
+using namespace NSROOT;
+
+/*
+ * Base letters of the code points U+00C0 to U+00FF (UTF-8 C3 80 to C3 BF).
+ * A space is a separator.
+ */
+static const char g_latin1[65] =
+  "aaaaaaaceeeeiiiidnooooo ouuuuyts"
+  "aaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+void LibrarySearch::Tokenize(const char* text, std::vector<std::string>& words)
+{
+  std::string word;
+  const unsigned char* p = (const unsigned char*)text;
+  while (*p)
+  {
+    unsigned char c = *p++;
+    if (c >= 'A' && c <= 'Z')
+      word.push_back((char)(c + ('a' - 'A')));
+    else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+      word.push_back((char)c);
+    else if (c == '\'')
+      continue; // don't split contractions
+    else if (c == 0xc3 && *p >= 0x80 && *p <= 0xbf)
+    {
+      char b = g_latin1[*p++ - 0x80];
+      if (b != ' ')
+      {
+        word.push_back(b);
+        continue;
+      }
+      if (!word.empty())
+        words.push_back(word);
+      word.clear();
+    }
+    else if (c >= 0x80)
+      word.push_back((char)c); // other letters are kept as is
+    else
+    {
+      if (!word.empty())
+        words.push_back(word);
+      word.clear();
+    }
+  }
+  if (!word.empty())
+    words.push_back(word);
+}
+
+static uint32_t __trigram(const std::string& word, size_t pos)
+{
+  return ((uint32_t)(unsigned char)word[pos] << 16) | ((uint32_t)(unsigned char)word[pos + 1] << 8) | (unsigned char)word[pos + 2];
+}
+
+/*
+ * A bit by letter. An edit changes two bits at most.
+ */
+static uint32_t __letters(const std::string& word)
+{
+  uint32_t mask = 0;
+  for (std::string::const_iterator it = word.begin(); it != word.end(); ++it)
+  {
+    unsigned char c = (unsigned char)*it;
+    if (c >= 'a' && c <= 'z')
+      mask |= 1u << (c - 'a');
+    else
+      mask |= 1u << (26 + (c % 6));
+  }
+  return mask;
+}
+
+static uint32_t __hash(const char* str, size_t len, size_t skip)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (i != skip)
+      h = (h ^ (unsigned char)str[i]) * 16777619u;
+  }
+  return h;
+}
+
+static unsigned __bitcount(uint32_t v)
+{
+  unsigned n = 0;
+  for (; v; v &= v - 1)
+    ++n;
+  return n;
+}
+
+/*
+ * Optimal string alignment distance, or more than the bound.
+ */
+static unsigned __distance(const std::string& a, const std::string& b, unsigned bound)
+{
+  size_t n = a.size(), m = b.size();
+  unsigned rows[3][WORD_MAXLENGTH + 1];
+  unsigned* pp = rows[0];
+  unsigned* p = rows[1];
+  unsigned* c = rows[2];
+  for (size_t j = 0; j <= m; ++j)
+    p[j] = (unsigned)j;
+  for (size_t i = 1; i <= n; ++i)
+  {
+    c[0] = (unsigned)i;
+    unsigned low = c[0];
+    for (size_t j = 1; j <= m; ++j)
+    {
+      unsigned cost = (a[i - 1] == b[j - 1] ? 0 : 1);
+      unsigned d = std::min(std::min(p[j] + 1, c[j - 1] + 1), p[j - 1] + cost);
+      if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+        d = std::min(d, pp[j - 2] + 1);
+      c[j] = d;
+      if (d < low)
+        low = d;
+    }
+    if (low > bound)
+      return bound + 1;
+    unsigned* t = pp;
+    pp = p;
+    p = c;
+    c = t;
+  }
+  return p[m];
+}
+
+namespace NSROOT
+{
+  struct __byWord
+  {
+    const std::vector<std::string>& words;
+    __byWord(const std::vector<std::string>& _words) : words(_words) { }
+    bool operator()(uint32_t a, uint32_t b) const { return words[a] < words[b]; }
+    bool operator()(uint32_t a, const std::string& b) const { return words[a] < b; }
+  };
+}
+
+LibrarySearch::LibrarySearch()
+: m_ready(true)
+{
+}
+
+void LibrarySearch::Add(const DigitalItemPtr& item)
+{
+  if (!item)
+    return;
+  Doc doc;
+  doc.item = item;
+  doc.section = doc.position = 0;
+  AddDoc(doc, item->GetValue(DIDL_QNAME_DC "title").c_str(), item->GetValue(DIDL_QNAME_DC "creator").c_str(),
+         item->GetValue(DIDL_QNAME_UPNP "album").c_str(), item->GetValue(DIDL_QNAME_UPNP "genre").c_str());
+}
+
+void LibrarySearch::Add(const DIDLItem& item)
+{
+  if (!item.IsValid())
+    return;
+  Doc doc;
+  doc.ref = item;
+  doc.section = doc.position = 0;
+  AddDoc(doc, item.GetValue(DIDL_QNAME_DC "title"), item.GetValue(DIDL_QNAME_DC "creator"),
+         item.GetValue(DIDL_QNAME_UPNP "album"), item.GetValue(DIDL_QNAME_UPNP "genre"));
+}
+
+void LibrarySearch::Add(const LibraryIndexPtr& index, LibraryIndex::Section_t section)
+{
+  if (!index)
+    return;
+  Doc doc;
+  doc.index = index;
+  doc.section = section;
+  unsigned count = index->Count(section);
+  m_docs.reserve(m_docs.size() + count);
+  for (unsigned i = 0; i < count; ++i)
+  {
+    doc.position = i;
+    AddDoc(doc, index->GetValue(section, i, LibraryIndex::Field_title), index->GetValue(section, i, LibraryIndex::Field_creator),
+           index->GetValue(section, i, LibraryIndex::Field_album), index->GetValue(section, i, LibraryIndex::Field_genre));
+  }
+}
+
+unsigned LibrarySearch::Add(ContentList& list)
+{
+  unsigned count = 0;
+  for (ContentList::iterator it = list.begin(); it != list.end(); ++it, ++count)
+  {
+    if (it.ref().IsValid())
+      Add(it.ref());
+    else
+      Add(*it);
+  }
+  return count;
+}
+
+void LibrarySearch::Clear()
+{
+  m_docs.clear();
+  m_dict.clear();
+  m_words.clear();
+  m_postings.clear();
+  m_sorted.clear();
+  m_trigrams.clear();
+  m_byLength.clear();
+  m_masks.clear();
+  m_deletes.clear();
+  m_ready = true;
+}
+
+void LibrarySearch::AddDoc(const Doc& doc, const char* title, const char* creator, const char* album, const char* genre)
+{
+  uint32_t id = (uint32_t)m_docs.size();
+  m_docs.push_back(doc);
+  AddField(id, title, Field_title);
+  AddField(id, creator, Field_creator);
+  AddField(id, album, Field_album);
+  AddField(id, genre, Field_genre);
+}
+
+void LibrarySearch::AddField(uint32_t doc, const char* text, uint32_t field)
+{
+  if (*text == '\0')
+    return;
+  std::vector<std::string> words;
+  Tokenize(text, words);
+  for (std::vector<std::string>::const_iterator it = words.begin(); it != words.end(); ++it)
+  {
+    std::pair<std::map<std::string, uint32_t>::iterator, bool> ret = m_dict.insert(std::make_pair(*it, (uint32_t)m_words.size()));
+    if (ret.second)
+    {
+      m_words.push_back(*it);
+      m_postings.push_back(Postings());
+      m_ready = false;
+    }
+    Postings& postings = m_postings[ret.first->second];
+    if (!postings.empty() && postings.back().doc == doc)
+      postings.back().fields |= field;
+    else
+    {
+      Posting posting;
+      posting.doc = doc;
+      posting.fields = field;
+      postings.push_back(posting);
+    }
+  }
+}
+
+void LibrarySearch::Prepare()
+{
+  if (m_ready)
+    return;
+  uint32_t count = (uint32_t)m_words.size();
+  m_sorted.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+    m_sorted[i] = i;
+  std::sort(m_sorted.begin(), m_sorted.end(), __byWord(m_words));
+
+  m_trigrams.clear();
+  m_deletes.clear();
+  m_byLength.assign(WORD_MAXLENGTH + 1, std::vector<uint32_t>());
+  m_masks.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const std::string& word = m_words[i];
+    for (size_t p = 0; p + 3 <= word.size(); ++p)
+      m_trigrams.push_back(std::make_pair(__trigram(word, p), i));
+    m_masks[i] = __letters(word);
+    if (word.size() > WORD_MAXLENGTH || word.find_first_not_of("0123456789") == std::string::npos)
+      continue;
+    m_byLength[word.size()].push_back(i);
+    // the words one typo away from a short word
+    if (word.size() >= 3 && word.size() <= WORD_SHORT)
+    {
+      for (size_t p = 0; p < word.size(); ++p)
+        m_deletes.push_back(std::make_pair(__hash(word.c_str(), word.size(), p), i));
+    }
+  }
+  std::sort(m_trigrams.begin(), m_trigrams.end());
+  m_trigrams.erase(std::unique(m_trigrams.begin(), m_trigrams.end()), m_trigrams.end());
+  std::sort(m_deletes.begin(), m_deletes.end());
+  m_ready = true;
+}
+
+void LibrarySearch::Collect(uint32_t word, uint32_t score, unsigned fields, std::vector<Match>& matches) const
+{
+  const Postings& postings = m_postings[word];
+  for (Postings::const_iterator it = postings.begin(); it != postings.end(); ++it)
+  {
+    if (it->fields & fields)
+    {
+      Match match;
+      match.doc = it->doc;
+      match.score = score;
+      matches.push_back(match);
+    }
+  }
+}
+
+void LibrarySearch::Similar(const std::string& word, std::vector<uint32_t>& words) const
+{
+  // numbers aren't matched with typos
+  if (word.size() < 4 || word.size() > WORD_MAXLENGTH || word.find_first_not_of("0123456789") == std::string::npos)
+    return;
+  std::vector<uint32_t> candidates;
+  unsigned bound = (word.size() >= WORD_SHORT ? 2 : 1);
+  if (bound == 1)
+  {
+    // a word less a letter is the word less a letter (substitution or
+    // transposition), the word (insertion), or a known word (deletion)
+    typedef std::vector<std::pair<uint32_t, uint32_t> >::const_iterator iterator;
+    for (size_t skip = 0; skip <= word.size(); ++skip)
+    {
+      uint32_t h = __hash(word.c_str(), word.size(), skip);
+      iterator it = std::lower_bound(m_deletes.begin(), m_deletes.end(), std::make_pair(h, (uint32_t)0));
+      for (; it != m_deletes.end() && it->first == h; ++it)
+        candidates.push_back(it->second);
+      if (skip < word.size())
+      {
+        std::map<std::string, uint32_t>::const_iterator w = m_dict.find(std::string(word).erase(skip, 1));
+        if (w != m_dict.end())
+          candidates.push_back(w->second);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+  }
+  else
+  {
+    size_t to = std::min(word.size() + bound, (size_t)WORD_MAXLENGTH);
+    uint32_t mask = __letters(word);
+    for (size_t len = word.size() - bound; len <= to; ++len)
+    {
+      const std::vector<uint32_t>& bucket = m_byLength[len];
+      for (std::vector<uint32_t>::const_iterator it = bucket.begin(); it != bucket.end(); ++it)
+      {
+        if (__bitcount(mask ^ m_masks[*it]) <= 2 * bound)
+          candidates.push_back(*it);
+      }
+    }
+  }
+  for (std::vector<uint32_t>::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+  {
+    if (m_words[*it] != word && __distance(word, m_words[*it], bound) <= bound)
+      words.push_back(*it);
+  }
+}
+
+void LibrarySearch::Containing(const std::string& word, std::vector<uint32_t>& words) const
+{
+  if (word.size() < 3)
+  {
+    for (uint32_t i = 0; i < (uint32_t)m_words.size(); ++i)
+    {
+      if (m_words[i].find(word) != std::string::npos)
+        words.push_back(i);
+    }
+    return;
+  }
+  // the words holding the rarest trigram, then checked
+  typedef std::vector<std::pair<uint32_t, uint32_t> >::const_iterator iterator;
+  std::pair<iterator, iterator> rarest(m_trigrams.end(), m_trigrams.end());
+  for (size_t p = 0; p + 3 <= word.size(); ++p)
+  {
+    uint32_t tri = __trigram(word, p);
+    std::pair<iterator, iterator> range;
+    range.first = std::lower_bound(m_trigrams.begin(), m_trigrams.end(), std::make_pair(tri, (uint32_t)0));
+    range.second = std::lower_bound(range.first, m_trigrams.end(), std::make_pair(tri + 1, (uint32_t)0));
+    if (range.first == range.second)
+      return;
+    if (p == 0 || range.second - range.first < rarest.second - rarest.first)
+      rarest = range;
+  }
+  for (iterator it = rarest.first; it != rarest.second; ++it)
+  {
+    if (m_words[it->second].find(word) != std::string::npos)
+      words.push_back(it->second);
+  }
+}
+
+bool LibrarySearch::ByDoc(const Match& a, const Match& b)
+{
+  return a.doc < b.doc || (a.doc == b.doc && a.score > b.score);
+}
+
+bool LibrarySearch::ByScore(const Match& a, const Match& b)
+{
+  return a.score > b.score || (a.score == b.score && a.doc < b.doc);
+}
+
+bool LibrarySearch::BySize(const std::vector<Match>* a, const std::vector<Match>* b)
+{
+  return a->size() < b->size();
+}
+
+DigitalItemList LibrarySearch::Rank(std::vector<std::vector<Match> >& sets, unsigned max)
+{
+  DigitalItemList list;
+  // one match by doc, the best
+  std::vector<std::vector<Match>*> order;
+  for (std::vector<std::vector<Match> >::iterator it = sets.begin(); it != sets.end(); ++it)
+  {
+    if (it->empty())
+      return list;
+    std::sort(it->begin(), it->end(), ByDoc);
+    std::vector<Match>::iterator last = it->begin();
+    for (std::vector<Match>::iterator m = it->begin() + 1; m != it->end(); ++m)
+    {
+      if (m->doc != last->doc)
+        *(++last) = *m;
+    }
+    it->erase(++last, it->end());
+    order.push_back(&(*it));
+  }
+  if (order.empty())
+    return list;
+  // the docs matching every word, from the smallest set
+  std::sort(order.begin(), order.end(), BySize);
+  std::vector<Match> result(*order[0]);
+  for (size_t s = 1; s < order.size() && !result.empty(); ++s)
+  {
+    const std::vector<Match>& set = *order[s];
+    std::vector<Match>::iterator out = result.begin();
+    std::vector<Match>::const_iterator m = set.begin();
+    for (std::vector<Match>::iterator r = result.begin(); r != result.end(); ++r)
+    {
+      while (m != set.end() && m->doc < r->doc)
+        ++m;
+      if (m == set.end())
+        break;
+      if (m->doc == r->doc)
+      {
+        out->doc = r->doc;
+        out->score = r->score + m->score;
+        ++out;
+      }
+    }
+    result.erase(out, result.end());
+  }
+  size_t count = std::min(result.size(), (size_t)max);
+  std::partial_sort(result.begin(), result.begin() + count, result.end(), ByScore);
+  list.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    DigitalItemPtr item = Materialize(m_docs[result[i].doc]);
+    if (item)
+      list.push_back(item);
+  }
+  return list;
+}
+
+DigitalItemPtr LibrarySearch::Materialize(Doc& doc)
+{
+  if (!doc.item)
+  {
+    if (doc.ref.IsValid())
+      doc.item = doc.ref.Materialize();
+    else if (doc.index)
+      doc.item = doc.index->Materialize((LibraryIndex::Section_t)doc.section, doc.position);
+  }
+  return doc.item;
+}
+
+DigitalItemList LibrarySearch::Search(const std::string& query, unsigned max, unsigned fields)
+{
+  std::vector<std::string> words;
+  Tokenize(query.c_str(), words);
+  if (words.empty())
+    return DigitalItemList();
+  Prepare();
+  std::vector<std::vector<Match> > sets(words.size());
+  for (size_t w = 0; w < words.size(); ++w)
+  {
+    const std::string& word = words[w];
+    std::vector<Match>& set = sets[w];
+    std::map<std::string, uint32_t>::const_iterator it = m_dict.find(word);
+    if (it != m_dict.end())
+      Collect(it->second, SCORE_EXACT, fields, set);
+    // the last word could be incomplete
+    if (w + 1 == words.size())
+    {
+      std::vector<uint32_t>::const_iterator p = std::lower_bound(m_sorted.begin(), m_sorted.end(), word, __byWord(m_words));
+      for (; p != m_sorted.end() && m_words[*p].compare(0, word.size(), word) == 0; ++p)
+      {
+        if (m_words[*p].size() > word.size())
+          Collect(*p, SCORE_PREFIX, fields, set);
+      }
+    }
+    if (set.empty())
+    {
+      std::vector<uint32_t> similar;
+      Similar(word, similar);
+      for (std::vector<uint32_t>::const_iterator s = similar.begin(); s != similar.end(); ++s)
+        Collect(*s, SCORE_SIMILAR, fields, set);
+    }
+  }
+  return Rank(sets, max);
+}
+
+DigitalItemList LibrarySearch::SearchSubstring(const std::string& query, unsigned max, unsigned fields)
+{
+  std::vector<std::string> words;
+  Tokenize(query.c_str(), words);
+  if (words.empty())
+    return DigitalItemList();
+  Prepare();
+  std::vector<std::vector<Match> > sets(words.size());
+  for (size_t w = 0; w < words.size(); ++w)
+  {
+    const std::string& word = words[w];
+    std::vector<uint32_t> containing;
+    Containing(word, containing);
+    for (std::vector<uint32_t>::const_iterator it = containing.begin(); it != containing.end(); ++it)
+    {
+      const std::string& found = m_words[*it];
+      uint32_t score = (found.size() == word.size() ? SCORE_EXACT : found.compare(0, word.size(), word) == 0 ? SCORE_PREFIX : SCORE_INNER);
+      Collect(*it, score, fields, sets[w]);
+    }
+  }
+  return Rank(sets, max);
+}
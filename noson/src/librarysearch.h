@@ -0,0 +1,155 @@
+/*
+ *      Copyright (C) 2014-2016 Jean-Luc Barriere
+ *
+ *  This file is part of Noson
+ *
+ *  Noson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Noson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBRARYSEARCH_H
+#define	LIBRARYSEARCH_H
+
+#include <local_config.h>
+#include "digitalitem.h"
+#include "didlpage.h"
+#include "libraryindex.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+#define LIBRARYSEARCH_MAXRESULTS  100
+
+namespace NSROOT
+{
+  class ContentList;
+
+  /**
+   * Inverted index of the words of dc:title, dc:creator, upnp:album and
+   * upnp:genre, fed with browsed items or a library index, and searched in
+   * process. The words are folded to lower case without accents.
+   * The lookup structures are sorted on the first search after a change, and
+   * the object isn't thread safe.
+   */
+  class LibrarySearch
+  {
+  public:
+    typedef enum
+    {
+      Field_title   = 0x1,
+      Field_creator = 0x2,
+      Field_album   = 0x4,
+      Field_genre   = 0x8,
+      Field_all     = 0xf,
+    } Field_t;
+
+    LibrarySearch();
+    ~LibrarySearch() { }
+
+    void Add(const DigitalItemPtr& item);
+    void Add(const DIDLItem& item);
+
+    /**
+     * Add the items of a section. They are built from the index when found.
+     */
+    void Add(const LibraryIndexPtr& index, LibraryIndex::Section_t section);
+
+    /**
+     * Add the remaining items of the list.
+     * @return the count of items added
+     */
+    unsigned Add(ContentList& list);
+
+    void Clear();
+
+    unsigned Size() const { return (unsigned)m_docs.size(); }
+
+    unsigned WordCount() const { return (unsigned)m_words.size(); }
+
+    /**
+     * Each word of the query must match a word of the item: as is, as a
+     * prefix for the last word, else within one typo (two from eight
+     * letters). The items are ranked by the quality of the matches.
+     * @param fields mask of the fields to search
+     */
+    DigitalItemList Search(const std::string& query, unsigned max = LIBRARYSEARCH_MAXRESULTS, unsigned fields = Field_all);
+
+    /**
+     * Each word of the query must be found inside a word of the item.
+     */
+    DigitalItemList SearchSubstring(const std::string& query, unsigned max = LIBRARYSEARCH_MAXRESULTS, unsigned fields = Field_all);
+
+    /**
+     * Fold the text then split it in words.
+     */
+    static void Tokenize(const char* text, std::vector<std::string>& words);
+
+  private:
+    struct Doc
+    {
+      DigitalItemPtr item;
+      DIDLItem ref;
+      LibraryIndexPtr index;
+      uint32_t section;
+      uint32_t position;
+    };
+
+    struct Posting
+    {
+      uint32_t doc;
+      uint32_t fields;
+    };
+
+    struct Match
+    {
+      uint32_t doc;
+      uint32_t score;
+    };
+
+    typedef std::vector<Posting> Postings;
+
+    std::vector<Doc> m_docs;
+    std::map<std::string, uint32_t> m_dict;   ///< word id by word
+    std::vector<std::string> m_words;
+    std::vector<Postings> m_postings;         ///< by word id, in order of the docs
+
+    // built on search
+    bool m_ready;
+    std::vector<uint32_t> m_sorted;           ///< word ids in order of the words
+    std::vector<std::pair<uint32_t, uint32_t> > m_trigrams; ///< trigram and word id, sorted
+    std::vector<std::vector<uint32_t> > m_byLength; ///< ids of the words with letters, by length
+    std::vector<uint32_t> m_masks;            ///< letters of the words, by word id
+    std::vector<std::pair<uint32_t, uint32_t> > m_deletes; ///< hash of the short words less a letter, and word id, sorted
+
+    void AddDoc(const Doc& doc, const char* title, const char* creator, const char* album, const char* genre);
+    void AddField(uint32_t doc, const char* text, uint32_t field);
+    void Prepare();
+    void Collect(uint32_t word, uint32_t score, unsigned fields, std::vector<Match>& matches) const;
+    void Similar(const std::string& word, std::vector<uint32_t>& words) const;
+    void Containing(const std::string& word, std::vector<uint32_t>& words) const;
+    DigitalItemList Rank(std::vector<std::vector<Match> >& sets, unsigned max);
+    DigitalItemPtr Materialize(Doc& doc);
+    static bool ByDoc(const Match& a, const Match& b);
+    static bool ByScore(const Match& a, const Match& b);
+    static bool BySize(const std::vector<Match>* a, const std::vector<Match>* b);
+
+    // prevent copy
+    LibrarySearch(const LibrarySearch&);
+    LibrarySearch& operator=(const LibrarySearch&);
+  };
+}
+
+#endif	/* LIBRARYSEARCH_H */
@@ -0,0 +1,191 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "browsecache.h"
+#include "builtin.h"
+#include "debug.h"
+
+using namespace NSROOT;
+
+BrowseCache::BrowseCache(size_t maxSize)
+: m_maxSize(maxSize)
+, m_size(0)
+, m_hits(0)
+, m_misses(0)
+{
+}
+
+std::string BrowseCache::Root(const std::string& objectID)
+{
+  std::string::size_type p = objectID.find(':');
+  if (p == std::string::npos)
+    return objectID;
+  return objectID.substr(0, p + 1);
+}
+
+bool BrowseCache::Bind(const std::string& sid)
+{
+  OS::CLockGuard lock(m_mutex);
+  if (sid == m_sid)
+    return !sid.empty();
+  DBG(DBG_DEBUG, "%s: subscription changed (%s)\n", __FUNCTION__, sid.c_str());
+  m_sid = sid;
+  Clear();
+  return !sid.empty();
+}
+
+std::string BrowseCache::Key(const std::string& objectID, unsigned index, unsigned count)
+{
+  char buf[24];
+  std::string key(objectID);
+  key.push_back('\0');
+  uint32_to_string((uint32_t)index, buf);
+  key.append(buf).push_back(',');
+  uint32_to_string((uint32_t)count, buf);
+  key.append(buf);
+  return key;
+}
+
+bool BrowseCache::Find(const std::string& objectID, unsigned index, unsigned count, ElementList& vars, DIDLPagePtr& page)
+{
+  OS::CLockGuard lock(m_mutex);
+  std::map<std::string, Scope>::iterator its = m_scopes.find(Root(objectID));
+  if (its != m_scopes.end())
+  {
+    std::map<std::string, Entry>::iterator ite = its->second.entries.find(Key(objectID, index, count));
+    if (ite != its->second.entries.end())
+    {
+      vars = ite->second.vars;
+      page = ite->second.page;
+      ++m_hits;
+      return true;
+    }
+  }
+  ++m_misses;
+  return false;
+}
+
+unsigned BrowseCache::Generation(const std::string& objectID)
+{
+  OS::CLockGuard lock(m_mutex);
+  return m_scopes[Root(objectID)].generation;
+}
+
+void BrowseCache::Store(const std::string& objectID, unsigned index, unsigned count, const ElementList& vars, const DIDLPagePtr& page, unsigned generation)
+{
+  std::string root = Root(objectID);
+  std::string key = Key(objectID, index, count);
+  size_t size = key.size() + (page ? page->Footprint() : 0);
+  for (ElementList::const_iterator it = vars.begin(); it != vars.end(); ++it)
+    size += (*it)->size() + (*it)->GetKey().size();
+  if (size > m_maxSize)
+    return;
+
+  OS::CLockGuard lock(m_mutex);
+  Scope& scope = m_scopes[root];
+  if (scope.generation != generation)
+    return;
+  std::map<std::string, Entry>::iterator it = scope.entries.find(key);
+  if (it != scope.entries.end())
+    return;
+  Entry& entry = scope.entries[key];
+  entry.vars = vars;
+  entry.page = page;
+  entry.size = size;
+  m_size += size;
+  m_order.push_back(std::make_pair(root, key));
+  // drop the oldest entries
+  while (m_size > m_maxSize && !m_order.empty())
+  {
+    std::map<std::string, Scope>::iterator its = m_scopes.find(m_order.front().first);
+    if (its != m_scopes.end())
+    {
+      std::map<std::string, Entry>::iterator ite = its->second.entries.find(m_order.front().second);
+      if (ite != its->second.entries.end())
+      {
+        m_size -= ite->second.size;
+        its->second.entries.erase(ite);
+      }
+    }
+    m_order.pop_front();
+  }
+}
+
+void BrowseCache::Update(const std::string& container, uint32_t updateID)
+{
+  OS::CLockGuard lock(m_mutex);
+  std::map<std::string, uint32_t>::iterator it = m_containers.find(container);
+  if (it != m_containers.end())
+  {
+    if (it->second == updateID)
+      return;
+    it->second = updateID;
+  }
+  else
+    m_containers.insert(std::make_pair(container, updateID));
+  // the entries stored before the first notification are dropped too, as
+  // their version is unknown
+  DBG(DBG_DEBUG, "%s: container %s updated to %u\n", __FUNCTION__, container.c_str(), updateID);
+  Drop(Root(container));
+}
+
+void BrowseCache::Invalidate(const std::string& objectID)
+{
+  OS::CLockGuard lock(m_mutex);
+  Drop(Root(objectID));
+}
+
+void BrowseCache::Clear()
+{
+  OS::CLockGuard lock(m_mutex);
+  for (std::map<std::string, Scope>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+  {
+    it->second.entries.clear();
+    ++(it->second.generation);
+  }
+  m_order.clear();
+  m_size = 0;
+}
+
+size_t BrowseCache::Size()
+{
+  OS::CLockGuard lock(m_mutex);
+  return m_size;
+}
+
+void BrowseCache::Drop(const std::string& root)
+{
+  Scope& scope = m_scopes[root];
+  ++scope.generation;
+  if (scope.entries.empty())
+    return;
+  for (std::map<std::string, Entry>::const_iterator it = scope.entries.begin(); it != scope.entries.end(); ++it)
+    m_size -= it->second.size;
+  scope.entries.clear();
+  std::list<std::pair<std::string, std::string> >::iterator it = m_order.begin();
+  while (it != m_order.end())
+  {
+    if (it->first == root)
+      it = m_order.erase(it);
+    else
+      ++it;
+  }
+}
@@ -0,0 +1,119 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef BROWSECACHE_H
+#define BROWSECACHE_H
+
+#include <local_config.h>
+#include "../element.h"
+#include "../didlpage.h"
+#include "os/threads/mutex.h"
+
+#include <string>
+#include <map>
+#include <list>
+#include <stdint.h>
+
+#define BROWSECACHE_MAXSIZE  0x800000  // 8MB of results
+
+namespace NSROOT
+{
+
+  /**
+   * Responses of Browse by object ID and range, the result being kept as the
+   * decoded page and the other arguments as values. The entries are grouped by
+   * the root of their object ID ("A:", "Q:", "SQ:", ...), which is the
+   * scope of a container in the ContainerUpdateIDs of the events. A root is
+   * dropped when the update ID of one of its containers changes, and the
+   * oldest entries are dropped beyond the maximum size.
+   */
+  class BrowseCache
+  {
+  public:
+    BrowseCache(size_t maxSize = BROWSECACHE_MAXSIZE);
+    ~BrowseCache() { }
+
+    static std::string Root(const std::string& objectID);
+
+    /**
+     * The entries are valid as long as the events are received: a lost or
+     * renewed subscription (SID) clears the cache.
+     * @return false if not subscribed
+     */
+    bool Bind(const std::string& sid);
+
+    bool Find(const std::string& objectID, unsigned index, unsigned count, ElementList& vars, DIDLPagePtr& page);
+
+    /**
+     * The generation of the root must be taken before the request, so the
+     * response isn't stored when the root was dropped in the meantime.
+     */
+    unsigned Generation(const std::string& objectID);
+    void Store(const std::string& objectID, unsigned index, unsigned count, const ElementList& vars, const DIDLPagePtr& page, unsigned generation);
+
+    /**
+     * Update the ID of a container, as notified by an event.
+     */
+    void Update(const std::string& container, uint32_t updateID);
+
+    void Invalidate(const std::string& objectID);
+    void Clear();
+
+    size_t Size();
+    unsigned Hits() const { return m_hits; }
+    unsigned Misses() const { return m_misses; }
+
+  private:
+    struct Entry
+    {
+      ElementList vars;
+      DIDLPagePtr page;
+      size_t size;
+    };
+
+    struct Scope
+    {
+      unsigned generation;
+      std::map<std::string, Entry> entries;
+      Scope() : generation(0) { }
+    };
+
+    OS::CMutex m_mutex;
+    size_t m_maxSize;
+    size_t m_size;
+    unsigned m_hits;
+    unsigned m_misses;
+    std::string m_sid;
+    std::map<std::string, Scope> m_scopes;             ///< by root
+    std::map<std::string, uint32_t> m_containers;      ///< update ID by container
+    std::list<std::pair<std::string, std::string> > m_order; ///< root and key of the entries, oldest first
+
+    static std::string Key(const std::string& objectID, unsigned index, unsigned count);
+    void Drop(const std::string& root);
+
+    // prevent copy
+    BrowseCache(const BrowseCache&);
+    BrowseCache& operator=(const BrowseCache&);
+  };
+
+}
+
+#endif /* BROWSECACHE_H */
@@ -0,0 +1,80 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef DIDLPAGEREADER_H
+#define DIDLPAGEREADER_H
+
+#include <local_config.h>
+#include "xmlstream.h"
+#include "xmldict.h"
+#include "../didlpage.h"
+
+#include <string>
+#include <vector>
+
+namespace NSROOT
+{
+
+  /**
+   * Fill the records of a page while the document is parsed:
+   * DIDL-Lite/{item|container}/{variable}
+   * The reader can be fed by any parser, so the page of a document embedded
+   * in a response is built in the same pass, then packed by DIDLPage.
+   */
+  class DIDLPageReader : public XMLStreamHandler
+  {
+  public:
+    /**
+     * The bounds of the document, if known, reserve the storage.
+     */
+    DIDLPageReader(size_t length = 0, unsigned elements = 0, unsigned attributes = 0);
+
+    // Implements XMLStreamHandler
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs);
+    virtual bool EndElement(const char* name);
+    virtual bool Characters(const char* text, size_t len);
+
+    std::vector<DIDLPage::ItemRec> items;
+    std::vector<DIDLPage::PropRec> props;
+    std::vector<DIDLPage::AttrRec> attrs;
+    std::string text;
+    std::string keys;     ///< the names not interned
+
+  private:
+    typedef std::vector<std::pair<std::string, uint32_t> > KeyCache;
+
+    XMLNames m_names;
+    KeyCache m_qnames;    ///< translation of the element names seen
+    KeyCache m_anames;    ///< the attribute names seen
+    unsigned m_depth;
+    bool m_item;          ///< In a valid item or container
+    bool m_var;           ///< In a variable of the item
+    size_t m_mark;        ///< Size of the text before the current variable
+
+    DIDLPage::StrRec AddString(const char* str);
+    uint32_t AddKey(const std::string& name);
+    uint32_t ElementKey(const char* qname);
+    uint32_t AttributeKey(const char* name);
+  };
+
+}
+
+#endif /* DIDLPAGEREADER_H */
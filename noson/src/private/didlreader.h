@@ -0,0 +1,73 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef DIDLREADER_H
+#define DIDLREADER_H
+
+#include <local_config.h>
+#include "xmlstream.h"
+#include "xmldict.h"
+#include "../digitalitem.h"
+
+#include <string>
+#include <vector>
+
+namespace NSROOT
+{
+
+  /**
+   * Fill the items while the document is parsed: DIDL-Lite/{item|container}/{variable}
+   * The reader can be fed by any parser, so a DIDL document embedded in
+   * another one is decoded in the same pass.
+   */
+  class DIDLReader : public XMLStreamHandler
+  {
+  public:
+    DIDLReader(std::vector<DigitalItemPtr>& items)
+    : m_items(items), m_depth(0), m_item(false), m_restricted(false), m_text(false) { }
+
+    /**
+     * Decode a whole document.
+     * @return false if the document is not a valid DIDL document
+     */
+    static bool Parse(const char* document, size_t len, std::vector<DigitalItemPtr>& items);
+
+    // Implements XMLStreamHandler
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs);
+    virtual bool EndElement(const char* name);
+    virtual bool Characters(const char* text, size_t len);
+
+  private:
+    std::vector<DigitalItemPtr>& m_items;
+    XMLNames m_names;
+    unsigned m_depth;
+    bool m_item;          ///< In a valid item or container
+    std::string m_id;
+    std::string m_parentID;
+    bool m_restricted;
+    ElementList m_vars;
+    ElementPtr m_var;     ///< The current variable of the item
+    bool m_text;          ///< The variable has a text
+  };
+
+}
+
+#endif /* DIDLREADER_H */
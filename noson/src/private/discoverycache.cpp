@@ -0,0 +1,99 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "discoverycache.h"
+#include "os/os.h"
+#include "debug.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace NSROOT;
+
+static bool __readLine(FILE* file, std::string& line)
+{
+  char buf[1024];
+  line.clear();
+  while (fgets(buf, sizeof(buf), file))
+  {
+    size_t len = strlen(buf);
+    if (len > 0 && buf[len - 1] == '\n')
+    {
+      line.append(buf, len - 1);
+      return true;
+    }
+    line.append(buf, len);
+  }
+  return false;
+}
+
+bool DiscoveryCache::Load(const std::string& path)
+{
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  std::string line;
+  bool ret = false;
+  if (__readLine(file, line) && line == DISCOVERYCACHE_MAGIC && __readLine(file, location) && !location.empty())
+  {
+    zoneGroupState.clear();
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0 && zoneGroupState.size() < DISCOVERYCACHE_MAXSIZE)
+      zoneGroupState.append(buf, len);
+    ret = !zoneGroupState.empty() && zoneGroupState.size() < DISCOVERYCACHE_MAXSIZE;
+  }
+  fclose(file);
+  if (!ret)
+    DBG(DBG_WARN, "%s: invalid cache file (%s)\n", __FUNCTION__, path.c_str());
+  return ret;
+}
+
+bool DiscoveryCache::Save(const std::string& path) const
+{
+  if (location.empty() || zoneGroupState.empty())
+    return false;
+  std::string tmp(path);
+  tmp.append(".tmp");
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file)
+  {
+    DBG(DBG_ERROR, "%s: cannot write cache file (%s)\n", __FUNCTION__, tmp.c_str());
+    return false;
+  }
+  bool ret = (fprintf(file, "%s\n%s\n", DISCOVERYCACHE_MAGIC, location.c_str()) > 0 &&
+          fwrite(zoneGroupState.c_str(), 1, zoneGroupState.size(), file) == zoneGroupState.size());
+  if (fclose(file) != 0)
+    ret = false;
+  if (ret)
+  {
+#ifdef __WINDOWS__
+    remove(path.c_str());
+#endif
+    ret = (rename(tmp.c_str(), path.c_str()) == 0);
+  }
+  if (!ret)
+  {
+    remove(tmp.c_str());
+    DBG(DBG_ERROR, "%s: cannot write cache file (%s)\n", __FUNCTION__, path.c_str());
+  }
+  return ret;
+}
@@ -0,0 +1,58 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef DISCOVERYCACHE_H
+#define DISCOVERYCACHE_H
+
+#include <local_config.h>
+
+#include <string>
+
+#define DISCOVERYCACHE_MAGIC    "noson-discovery-1"
+#define DISCOVERYCACHE_MAXSIZE  0x400000  // 4MB
+
+namespace NSROOT
+{
+
+  /**
+   * Snapshot of the last discovery: the location of the player holding the
+   * topology subscription, and the last ZoneGroupState received.
+   * The file holds the magic line, the location line, then the state.
+   */
+  struct DiscoveryCache
+  {
+    std::string location;
+    std::string zoneGroupState;
+
+    /**
+     * @return false if the file is missing or invalid
+     */
+    bool Load(const std::string& path);
+
+    /**
+     * The file is replaced atomically.
+     */
+    bool Save(const std::string& path) const;
+  };
+
+}
+
+#endif /* DISCOVERYCACHE_H */
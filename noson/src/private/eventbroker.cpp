@@ -19,56 +19,26 @@
  */
 
 #include "eventbroker.h"
+#include "eventreader.h"
 #include "wsstatus.h"
-#include "tinyxml2.h"
-#include "xmldict.h"
 #include "cppdef.h"
 #include "debug.h"
 #include "builtin.h"
 
 #include <cstdio>
 
-#define NS_RCS "urn:schemas-upnp-org:metadata-1-0/RCS/"
-#define NS_AVT "urn:schemas-upnp-org:metadata-1-0/AVT/"
-#define NS_RIN "urn:schemas-rinconnetworks-com:metadata-1-0/"
-#define QN_RIN "r:"
-
 using namespace NSROOT;
 
-namespace NSROOT
-{
-  XMLDict __initRCSDict()
-  {
-    XMLDict dict;
-    dict.DefineNS("", NS_RCS);
-    dict.DefineNS(QN_RIN, NS_RIN);
-    return dict;
-  }
-  XMLDict RCSDict = __initRCSDict();
-
-  XMLDict __initAVTDict()
-  {
-    XMLDict dict;
-    dict.DefineNS("", NS_AVT);
-    dict.DefineNS(QN_RIN, NS_RIN);
-    return dict;
-  }
-  XMLDict AVTDict = __initAVTDict();
-}
-
 EventBroker::EventBroker(EventHandler::EventHandlerThread* handler, SHARED_PTR<TcpSocket>& sockPtr)
 : m_handler(handler)
 , m_sockPtr(sockPtr)
-, m_buffer(NULL)
 {
 }
 
 EventBroker::~EventBroker()
 {
-  SAFE_DELETE_ARRAY(m_buffer);
 }
 
-
 void EventBroker::Process()
 {
   if (!m_handler || !m_sockPtr || !m_sockPtr->IsValid())
@@ -78,13 +48,18 @@ void EventBroker::Process()
   WSRequestBroker rb(m_sockPtr.get(), socket_timeout);
   std::string resp;
 
+  HandleRequest(m_handler, rb, resp);
+  m_sockPtr->SendData(resp.c_str(), resp.size());
+  m_sockPtr->Disconnect();
+}
+
+void EventBroker::HandleRequest(EventHandler::EventHandlerThread* handler, WSRequestBroker& rb, std::string& resp)
+{
   if (!rb.IsParsed())
   {
     WSStatus status(HSC_Bad_Request);
     resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
     resp.append("\r\n\r\n");
-    m_sockPtr->SendData(resp.c_str(), resp.size());
-    m_sockPtr->Disconnect();
     return;
   }
 
@@ -94,149 +69,33 @@ void EventBroker::Process()
           rb.GetParsedNamedEntry("CONTENT-TYPE").compare(0, 8, "text/xml") == 0 &&
           rb.HasContent())
   {
-    // Receive content data
-    size_t len = 0, l = 0;
-    std::string data;
-    char buffer[4096];
-    while ((l = rb.ReadContent(buffer, sizeof(buffer))))
-    {
-      data.append(buffer, l);
-      len += l;
-    }
-
-    // Parse xml content
-    tinyxml2::XMLDocument rootdoc;
-    if (rootdoc.Parse(data.c_str(), len) != tinyxml2::XML_SUCCESS)
-    {
-      DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
-      WSStatus status(HSC_Internal_Server_Error);
-      resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
-      resp.append("\r\n\r\n");
-      m_sockPtr->SendData(resp.c_str(), resp.size());
-      m_sockPtr->Disconnect();
-      return;
-    }
-
     // Setup new event message
     EventMessage msg;
     msg.event = EVENT_UPNP_PROPCHANGE;
     msg.subject.push_back(rb.GetParsedNamedEntry("SID"));
     msg.subject.push_back(rb.GetParsedNamedEntry("SEQ"));
 
-    // Parse document
-    const tinyxml2::XMLElement* root; // root element
-    const tinyxml2::XMLElement* elem; // an element
-    const tinyxml2::XMLNode* node;    // a node
-    tinyxml2::XMLDocument doc;  // a document
-    const char* str;
-    if ((root = rootdoc.RootElement()) && XMLNS::NameEqual(root->Name(), "propertyset"))
+    // Decode content data while it is received
+    EventReader reader(msg);
+    size_t l = 0;
+    char buffer[4096];
+    while ((l = rb.ReadContent(buffer, sizeof(buffer))))
     {
-      if ((node = root->FirstChild()) && XMLNS::NameEqual(node->Value(), "property"))
-      {
-        // Check prior for embedded doc 'Event': propertyset/property/LastChange
-        if ((elem = node->FirstChildElement("LastChange")))
-        {
-          if (doc.Parse(elem->GetText()) != tinyxml2::XML_SUCCESS ||
-                !(elem = doc.RootElement()))
-          {
-            DBG(DBG_ERROR, "%s: invalid or not supported content\n", __FUNCTION__);
-            DBG(DBG_ERROR, "%s: dump => %s\n", __FUNCTION__, m_buffer);
-            WSStatus status(HSC_Internal_Server_Error);
-            resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
-            resp.append("\r\n\r\n");
-            m_sockPtr->SendData(resp.c_str(), resp.size());
-            m_sockPtr->Disconnect();
-            return;
-          }
-
-          XMLNames docns;
-          docns.AddXMLNS(elem);
-
-          /*
-           * Processing RCS notification
-           */
-          if (docns.FindName(NS_RCS) && (node = elem->FirstChildElement("InstanceID")))
-          {
-            msg.subject.push_back("RCS");
-            elem = node->FirstChildElement(NULL);
-            while (elem)
-            {
-              std::string name(RCSDict.TranslateQName(docns, elem->Name()));
-              if ((str = elem->Attribute("channel")))
-                name.append("/").append(str);
-              msg.subject.push_back(name);
-              if ((str = elem->Attribute("val")))
-                msg.subject.push_back(str);
-              else
-                msg.subject.push_back("");
-              DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, name.c_str(), str);
-              elem = elem->NextSiblingElement(NULL);
-            }
-          }
-          /*
-           * Processing AVT notification
-           */
-          else if (docns.FindName(NS_AVT) && (node = elem->FirstChildElement("InstanceID")))
-          {
-            msg.subject.push_back("AVT");
-            elem = node->FirstChildElement(NULL);
-            while (elem)
-            {
-              std::string name(AVTDict.TranslateQName(docns, elem->Name()));
-              msg.subject.push_back(name);
-              if ((str = elem->Attribute("val")))
-                msg.subject.push_back(str);
-              else
-                msg.subject.push_back("");
-              DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, name.c_str(), str);
-              elem = elem->NextSiblingElement(NULL);
-            }
-          }
-          else
-          {
-            DBG(DBG_WARN, "%s: not supported content\n", __FUNCTION__);
-            DBG(DBG_WARN, "%s: dump => %s\n", __FUNCTION__, m_buffer);
-          }
-        }
-        // Else treat propertyset/property/
-        else
-        {
-          msg.subject.push_back("PROPERTY");
-          do
-          {
-            if ((elem = node->FirstChildElement(NULL)))
-            {
-              std::string name(XMLNS::LocalName(elem->Name()));
-              msg.subject.push_back(name);
-              if ((str = elem->GetText()))
-                msg.subject.push_back(str);
-              else
-                msg.subject.push_back("");
-              DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, name.c_str(), str);
-            }
-            node = node->NextSibling();
-          } while (node && XMLNS::NameEqual(node->Value(), "property"));
-        }
-      }
+      if (!reader.Feed(buffer, l))
+        break;
     }
-    else
+    if (!reader.Finish())
     {
-      DBG(DBG_ERROR, "%s: invalid or not supported content\n", __FUNCTION__);
-      DBG(DBG_ERROR, "%s: dump => %s\n", __FUNCTION__, m_buffer);
       WSStatus status(HSC_Internal_Server_Error);
       resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
       resp.append("\r\n\r\n");
-      m_sockPtr->SendData(resp.c_str(), resp.size());
-      m_sockPtr->Disconnect();
       return;
     }
 
-    m_handler->DispatchEvent(msg);
+    handler->DispatchEvent(msg);
     WSStatus status(HSC_OK);
     resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
     resp.append("\r\n\r\n");
-    m_sockPtr->SendData(resp.c_str(), resp.size());
-    m_sockPtr->Disconnect();
     return;
   }
 
@@ -265,7 +124,7 @@ void EventBroker::Process()
         msg.event = EVENT_UNKNOWN;
         msg.subject.push_back("GET");
         msg.subject.push_back(rb.GetParsedURI());
-        m_handler->DispatchEvent(msg);
+        handler->DispatchEvent(msg);
         status.Set(HSC_OK);
         resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
         resp.append("\r\n\r\n");
@@ -277,6 +136,4 @@ void EventBroker::Process()
       resp.append(REQUEST_PROTOCOL " ").append(status.GetString()).append(" ").append(status.GetMessage());
       resp.append("\r\n\r\n");
   }
-  m_sockPtr->SendData(resp.c_str(), resp.size());
-  m_sockPtr->Disconnect();
 }
@@ -38,10 +38,14 @@ namespace NSROOT
     virtual ~EventBroker();
     virtual void Process();
 
+    /**
+     * Process the request read by the broker and build the response to send.
+     */
+    static void HandleRequest(EventHandler::EventHandlerThread* handler, WSRequestBroker& rb, std::string& resp);
+
   private:
     EventHandler::EventHandlerThread* m_handler;
     SHARED_PTR<TcpSocket> m_sockPtr;
-    char* m_buffer;
   };
 }
 
@@ -0,0 +1,155 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "eventproperty.h"
+#include "os/os.h"
+
+#include <cstring>
+
+/*
+ * The seed makes the hash collision-free for the names below, so a lookup
+ * costs one hash and one comparison. Slots are probed anyway to stay correct
+ * when a name is added without searching a new seed.
+ */
+#define PROPERTY_HASH_SEED  7717
+#define PROPERTY_HASH_SIZE  128   // power of 2, greater than PROPERTY_COUNT
+
+using namespace NSROOT;
+
+namespace NSROOT
+{
+  struct PropertyDef
+  {
+    PROPERTY_t id;
+    const char* name;
+  };
+
+  static const PropertyDef g_propertyDefs[] = {
+    { PROPERTY_TransportState,                  "TransportState" },
+    { PROPERTY_CurrentPlayMode,                 "CurrentPlayMode" },
+    { PROPERTY_CurrentCrossfadeMode,            "CurrentCrossfadeMode" },
+    { PROPERTY_NumberOfTracks,                  "NumberOfTracks" },
+    { PROPERTY_CurrentTrack,                    "CurrentTrack" },
+    { PROPERTY_CurrentSection,                  "CurrentSection" },
+    { PROPERTY_CurrentTrackURI,                 "CurrentTrackURI" },
+    { PROPERTY_CurrentTrackDuration,            "CurrentTrackDuration" },
+    { PROPERTY_CurrentTrackMetaData,            "CurrentTrackMetaData" },
+    { PROPERTY_r_NextTrackURI,                  "r:NextTrackURI" },
+    { PROPERTY_r_NextTrackMetaData,             "r:NextTrackMetaData" },
+    { PROPERTY_r_EnqueuedTransportURI,          "r:EnqueuedTransportURI" },
+    { PROPERTY_r_EnqueuedTransportURIMetaData,  "r:EnqueuedTransportURIMetaData" },
+    { PROPERTY_PlaybackStorageMedium,           "PlaybackStorageMedium" },
+    { PROPERTY_AVTransportURI,                  "AVTransportURI" },
+    { PROPERTY_AVTransportURIMetaData,          "AVTransportURIMetaData" },
+    { PROPERTY_NextAVTransportURI,              "NextAVTransportURI" },
+    { PROPERTY_NextAVTransportURIMetaData,      "NextAVTransportURIMetaData" },
+    { PROPERTY_CurrentTransportActions,         "CurrentTransportActions" },
+    { PROPERTY_r_CurrentValidPlayModes,         "r:CurrentValidPlayModes" },
+    { PROPERTY_r_MuseSessions,                  "r:MuseSessions" },
+    { PROPERTY_TransportStatus,                 "TransportStatus" },
+    { PROPERTY_r_SleepTimerGeneration,          "r:SleepTimerGeneration" },
+    { PROPERTY_r_AlarmRunning,                  "r:AlarmRunning" },
+    { PROPERTY_r_SnoozeRunning,                 "r:SnoozeRunning" },
+    { PROPERTY_r_RestartPending,                "r:RestartPending" },
+    { PROPERTY_PossiblePlaybackStorageMedia,    "PossiblePlaybackStorageMedia" },
+    { PROPERTY_Volume_Master,                   "Volume/Master" },
+    { PROPERTY_Volume_LF,                       "Volume/LF" },
+    { PROPERTY_Volume_RF,                       "Volume/RF" },
+    { PROPERTY_Mute_Master,                     "Mute/Master" },
+    { PROPERTY_Mute_LF,                         "Mute/LF" },
+    { PROPERTY_Mute_RF,                         "Mute/RF" },
+    { PROPERTY_ZoneGroupState,                  "ZoneGroupState" },
+    { PROPERTY_SystemUpdateID,                  "SystemUpdateID" },
+    { PROPERTY_ContainerUpdateIDs,              "ContainerUpdateIDs" },
+    { PROPERTY_UserRadioUpdateID,               "UserRadioUpdateID" },
+    { PROPERTY_SavedQueuesUpdateID,             "SavedQueuesUpdateID" },
+    { PROPERTY_ShareListUpdateID,               "ShareListUpdateID" },
+    { PROPERTY_RecentlyPlayedUpdateID,          "RecentlyPlayedUpdateID" },
+    { PROPERTY_RadioFavoritesUpdateID,          "RadioFavoritesUpdateID" },
+    { PROPERTY_RadioLocationUpdateID,           "RadioLocationUpdateID" },
+    { PROPERTY_FavoritesUpdateID,               "FavoritesUpdateID" },
+    { PROPERTY_FavoritePresetsUpdateID,         "FavoritePresetsUpdateID" },
+    { PROPERTY_ShareIndexInProgress,            "ShareIndexInProgress" },
+    { PROPERTY_ShareIndexLastError,             "ShareIndexLastError" },
+  };
+
+  static inline unsigned __hashName(const char* name, size_t len)
+  {
+    // FNV-1a folded to the slots
+    uint32_t h = 2166136261U ^ PROPERTY_HASH_SEED;
+    for (size_t i = 0; i < len; ++i)
+    {
+      h ^= (unsigned char)name[i];
+      h *= 16777619U;
+    }
+    return (h ^ (h >> 16)) & (PROPERTY_HASH_SIZE - 1);
+  }
+
+  struct PropertyTable
+  {
+    const char* names[PROPERTY_COUNT];
+    unsigned char slots[PROPERTY_HASH_SIZE]; ///< Index in definitions + 1
+
+    PropertyTable()
+    {
+      memset(names, 0, sizeof(names));
+      memset(slots, 0, sizeof(slots));
+      names[PROPERTY_UNKNOWN] = "";
+      for (unsigned i = 0; i < sizeof(g_propertyDefs) / sizeof(PropertyDef); ++i)
+      {
+        const PropertyDef& def = g_propertyDefs[i];
+        names[def.id] = def.name;
+        unsigned h = __hashName(def.name, strlen(def.name));
+        while (slots[h])
+          h = (h + 1) & (PROPERTY_HASH_SIZE - 1);
+        slots[h] = (unsigned char)(i + 1);
+      }
+    }
+  };
+
+  static PropertyTable g_propertyTable;
+}
+
+PROPERTY_t EventProperties::FindID(const char* name, size_t len)
+{
+  unsigned h = __hashName(name, len);
+  unsigned char s;
+  while ((s = g_propertyTable.slots[h]))
+  {
+    const PropertyDef& def = g_propertyDefs[s - 1];
+    if (strncmp(def.name, name, len) == 0 && def.name[len] == '\0')
+      return def.id;
+    h = (h + 1) & (PROPERTY_HASH_SIZE - 1);
+  }
+  return PROPERTY_UNKNOWN;
+}
+
+PROPERTY_t EventProperties::FindID(const char* name)
+{
+  return FindID(name, strlen(name));
+}
+
+const char* EventProperties::Name(PROPERTY_t id)
+{
+  if (id < PROPERTY_COUNT && g_propertyTable.names[id])
+    return g_propertyTable.names[id];
+  return "";
+}
@@ -0,0 +1,47 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef EVENTPROPERTY_H
+#define EVENTPROPERTY_H
+
+#include <local_config.h>
+#include "../eventhandler.h"
+
+#include <cstddef>
+
+namespace NSROOT
+{
+
+  struct EventProperties
+  {
+    /**
+     * Resolve the name of a notified property.
+     * @return PROPERTY_UNKNOWN when the name isn't handled
+     */
+    static PROPERTY_t FindID(const char* name, size_t len);
+    static PROPERTY_t FindID(const char* name);
+
+    static const char* Name(PROPERTY_t id);
+  };
+
+}
+
+#endif /* EVENTPROPERTY_H */
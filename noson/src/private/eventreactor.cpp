@@ -0,0 +1,501 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "eventreactor.h"
+
+#if HAVE_EPOLL
+
+#include "socket.h"
+#include "eventbroker.h"
+#include "wsrequestbroker.h"
+#include "os/threads/mutex.h"
+#include "os/threads/timeout.h"
+#include "cppdef.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cstring>
+#include <cstdlib>
+#include <list>
+#include <vector>
+
+#define REACTOR_ID_SERVER     0
+#define REACTOR_ID_COMPLETION 1
+
+using namespace NSROOT;
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Completion
+////
+
+namespace NSROOT
+{
+  /**
+   * Responses built by the workers, waiting to be sent by the loop. The loop
+   * is woken up through the event descriptor. The queue is shared with the
+   * workers, so it outlives the reactor when a worker is still running.
+   */
+  class EventReactor::Completion
+  {
+  public:
+    typedef std::list<std::pair<uint64_t, std::string> > queue_t;
+
+    Completion()
+    : m_event(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_closed(false) { }
+
+    ~Completion()
+    {
+      if (m_event >= 0)
+        close(m_event);
+    }
+
+    int GetEvent() const { return m_event; }
+
+    void Post(uint64_t id, std::string& response)
+    {
+      OS::CLockGuard lock(m_mutex);
+      if (m_closed)
+        return;
+      m_queue.push_back(std::make_pair(id, std::string()));
+      m_queue.back().second.swap(response);
+      uint64_t one = 1;
+      if (write(m_event, &one, sizeof(one)) < 0)
+        DBG(DBG_ERROR, "%s: wakeup failed (%d)\n", __FUNCTION__, errno);
+    }
+
+    void Wakeup()
+    {
+      OS::CLockGuard lock(m_mutex);
+      uint64_t one = 1;
+      if (!m_closed && write(m_event, &one, sizeof(one)) < 0)
+        DBG(DBG_ERROR, "%s: wakeup failed (%d)\n", __FUNCTION__, errno);
+    }
+
+    void Drain(queue_t& queue)
+    {
+      OS::CLockGuard lock(m_mutex);
+      uint64_t val;
+      if (read(m_event, &val, sizeof(val)) < 0 && errno != EAGAIN)
+        DBG(DBG_ERROR, "%s: read event failed (%d)\n", __FUNCTION__, errno);
+      queue.swap(m_queue);
+    }
+
+    void Shutdown()
+    {
+      OS::CLockGuard lock(m_mutex);
+      m_closed = true;
+      m_queue.clear();
+    }
+
+  private:
+    OS::CMutex m_mutex;
+    int m_event;
+    bool m_closed;
+    queue_t m_queue;
+  };
+
+  /**
+   * Read a received request from memory.
+   */
+  class RequestSocket : public NetSocket
+  {
+  public:
+    RequestSocket(const std::string& data) : m_data(data), m_pos(0) { }
+    virtual bool SendData(const char* buf, size_t size) { (void)buf; (void)size; return false; }
+    virtual size_t ReceiveData(void* buf, size_t n)
+    {
+      size_t s = m_data.size() - m_pos;
+      if (s > n)
+        s = n;
+      memcpy(buf, m_data.c_str() + m_pos, s);
+      m_pos += s;
+      return s;
+    }
+
+  private:
+    const std::string& m_data;
+    size_t m_pos;
+  };
+
+  class EventRequestWorker : public OS::CWorker
+  {
+  public:
+    EventRequestWorker(EventHandler::EventHandlerThread* handler, EventReactor::CompletionPtr& completion,
+            uint64_t id, std::string& request)
+    : m_handler(handler)
+    , m_completion(completion)
+    , m_id(id)
+    {
+      m_request.swap(request);
+    }
+
+    virtual void Process()
+    {
+      RequestSocket socket(m_request);
+      struct timeval timeout = { 0, 0 };
+      WSRequestBroker rb(&socket, timeout);
+      std::string resp;
+      EventBroker::HandleRequest(m_handler, rb, resp);
+      m_completion->Post(m_id, resp);
+    }
+
+  private:
+    EventHandler::EventHandlerThread* m_handler;
+    EventReactor::CompletionPtr m_completion;
+    uint64_t m_id;
+    std::string m_request;
+  };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// EventReactor
+////
+
+EventReactor::EventReactor(EventHandler::EventHandlerThread* handler, OS::CThreadPool& pool)
+: m_handler(handler)
+, m_pool(pool)
+, m_epoll(-1)
+, m_server(INVALID_SOCKET_VALUE)
+, m_completion(new Completion())
+, m_connections()
+, m_lastId(REACTOR_ID_COMPLETION)
+, m_lastSweep(0)
+{
+}
+
+EventReactor::~EventReactor()
+{
+  Close();
+}
+
+bool EventReactor::Open(TcpServerSocket& server)
+{
+  if (m_epoll >= 0)
+    return false;
+  // the queue of a previous run could be held by a running worker
+  m_completion.reset(new Completion());
+  server.SetMaxConnections(EVENTREACTOR_BACKLOG);
+  if (!server.ListenConnection())
+    return false;
+  m_server = server.GetSocket();
+  int flags = fcntl(m_server, F_GETFL, 0);
+  if (flags < 0 || fcntl(m_server, F_SETFL, flags | O_NONBLOCK) < 0)
+  {
+    DBG(DBG_ERROR, "%s: could not set non-blocking mode (%d)\n", __FUNCTION__, errno);
+    return false;
+  }
+  if (m_completion->GetEvent() < 0 || (m_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+  {
+    DBG(DBG_ERROR, "%s: could not create event loop (%d)\n", __FUNCTION__, errno);
+    return false;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.u64 = REACTOR_ID_SERVER;
+  if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_server, &ev) < 0)
+  {
+    DBG(DBG_ERROR, "%s: could not register listener (%d)\n", __FUNCTION__, errno);
+    return false;
+  }
+  ev.data.u64 = REACTOR_ID_COMPLETION;
+  if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_completion->GetEvent(), &ev) < 0)
+  {
+    DBG(DBG_ERROR, "%s: could not register completion (%d)\n", __FUNCTION__, errno);
+    return false;
+  }
+  m_lastSweep = OS::gettime_ms();
+  return true;
+}
+
+bool EventReactor::Poll(int timeout)
+{
+  if (m_epoll < 0)
+    return false;
+  struct epoll_event events[EVENTREACTOR_MAX_EVENTS];
+  int n = epoll_wait(m_epoll, events, EVENTREACTOR_MAX_EVENTS, timeout);
+  if (n < 0)
+  {
+    if (errno == EINTR)
+      return true;
+    DBG(DBG_ERROR, "%s: wait failed (%d)\n", __FUNCTION__, errno);
+    return false;
+  }
+  for (int i = 0; i < n; ++i)
+  {
+    uint64_t id = events[i].data.u64;
+    if (id == REACTOR_ID_SERVER)
+      AcceptConnections();
+    else if (id == REACTOR_ID_COMPLETION)
+      ProcessCompletions();
+    else
+    {
+      connections_t::iterator it = m_connections.find(id);
+      if (it == m_connections.end())
+        continue;
+      Connection* conn = it->second;
+      if (events[i].events & EPOLLERR)
+        CloseConnection(id);
+      else if (!conn->dispatched)
+        ReceiveRequest(id, conn);
+      else if (conn->responding && (events[i].events & EPOLLOUT))
+        SendResponse(id, conn);
+      else if (events[i].events & EPOLLHUP)
+        CloseConnection(id);
+    }
+  }
+  int64_t now = OS::gettime_ms();
+  if (now - m_lastSweep >= EVENTREACTOR_POLL_TIMEOUT)
+    Sweep(now);
+  return true;
+}
+
+void EventReactor::Interrupt()
+{
+  m_completion->Wakeup();
+}
+
+void EventReactor::Close()
+{
+  m_completion->Shutdown();
+  while (!m_connections.empty())
+    CloseConnection(m_connections.begin()->first);
+  if (m_epoll >= 0)
+  {
+    close(m_epoll);
+    m_epoll = -1;
+  }
+  m_server = INVALID_SOCKET_VALUE;
+}
+
+void EventReactor::AcceptConnections()
+{
+  // edge triggered: accept until the queue is empty
+  for (;;)
+  {
+    net_socket_t s = accept4(m_server, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (s == INVALID_SOCKET_VALUE)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        DBG(DBG_WARN, "%s: accept failed (%d)\n", __FUNCTION__, errno);
+      break;
+    }
+    if (m_connections.size() >= EVENTREACTOR_MAX_CONNECTIONS)
+    {
+      DBG(DBG_WARN, "%s: too many connections\n", __FUNCTION__);
+      close(s);
+      continue;
+    }
+    uint64_t id = ++m_lastId;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.u64 = id;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, s, &ev) < 0)
+    {
+      DBG(DBG_ERROR, "%s: could not register connection (%d)\n", __FUNCTION__, errno);
+      close(s);
+      continue;
+    }
+    m_connections.insert(std::make_pair(id, new Connection(s, OS::gettime_ms())));
+    DBG(DBG_DEBUG, "%s: accepting new connection (%llu)\n", __FUNCTION__, (unsigned long long)id);
+  }
+}
+
+void EventReactor::ReceiveRequest(uint64_t id, Connection* conn)
+{
+  char buf[4096];
+  // edge triggered: read until the socket is drained
+  for (;;)
+  {
+    ssize_t r = recv(conn->socket, buf, sizeof(buf), 0);
+    if (r > 0)
+    {
+      conn->data.append(buf, r);
+      if (conn->data.size() > EVENTREACTOR_REQUEST_MAXSIZE)
+      {
+        DBG(DBG_WARN, "%s: request too large (%llu)\n", __FUNCTION__, (unsigned long long)id);
+        CloseConnection(id);
+        return;
+      }
+      continue;
+    }
+    if (r == 0)
+    {
+      conn->eof = true;
+      break;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    DBG(DBG_DEBUG, "%s: receive failed (%d)\n", __FUNCTION__, errno);
+    CloseConnection(id);
+    return;
+  }
+  if (Framed(conn))
+    Dispatch(id, conn);
+  else if (conn->eof ||
+          (conn->headerLength == 0 && conn->data.size() > EVENTREACTOR_HEADER_MAXSIZE) ||
+          conn->headerLength + conn->contentLength > EVENTREACTOR_REQUEST_MAXSIZE)
+  {
+    DBG(DBG_DEBUG, "%s: invalid request (%llu)\n", __FUNCTION__, (unsigned long long)id);
+    CloseConnection(id);
+  }
+}
+
+bool EventReactor::Framed(Connection* conn)
+{
+  std::string& data = conn->data;
+  if (conn->headerLength == 0)
+  {
+    // the sequence could be truncated at end of previous data
+    size_t p = data.find("\r\n\r\n", conn->scanned > 3 ? conn->scanned - 3 : 0);
+    if (p == std::string::npos)
+    {
+      conn->scanned = data.size();
+      return false;
+    }
+    conn->headerLength = conn->scanned = p + 4;
+    // look for the fields giving the length of the content
+    size_t b = data.find("\r\n") + 2;
+    while (b < p)
+    {
+      size_t e = data.find("\r\n", b);
+      const char* line = data.c_str() + b;
+      if (e - b > 15 && strnicmp(line, "CONTENT-LENGTH:", 15) == 0)
+        conn->contentLength = strtoul(line + 15, NULL, 10);
+      else if (e - b > 18 && strnicmp(line, "TRANSFER-ENCODING:", 18) == 0)
+        conn->chunked = (data.substr(b + 18, e - b - 18).find("chunked") != std::string::npos);
+      b = e + 2;
+    }
+  }
+  if (!conn->chunked)
+    return (data.size() >= conn->headerLength + conn->contentLength);
+  // walk the chunks received
+  for (;;)
+  {
+    size_t e = data.find("\r\n", conn->scanned);
+    if (e == std::string::npos)
+      return false;
+    size_t size = strtoul(data.c_str() + conn->scanned, NULL, 16);
+    if (size == 0)
+    {
+      // the last chunk is followed by the trailer until empty line
+      for (size_t b = e + 2; (e = data.find("\r\n", b)) != std::string::npos; b = e + 2)
+      {
+        if (e == b)
+          return true;
+      }
+      return false;
+    }
+    if (size > EVENTREACTOR_REQUEST_MAXSIZE || data.size() < e + 2 + size + 2)
+      return false;
+    conn->scanned = e + 2 + size + 2;
+  }
+}
+
+void EventReactor::Dispatch(uint64_t id, Connection* conn)
+{
+  conn->dispatched = true;
+  EventRequestWorker* worker = new EventRequestWorker(m_handler, m_completion, id, conn->data);
+  conn->data.clear();
+  if (!m_pool.Enqueue(worker))
+  {
+    delete worker;
+    CloseConnection(id);
+  }
+}
+
+void EventReactor::ProcessCompletions()
+{
+  Completion::queue_t queue;
+  m_completion->Drain(queue);
+  for (Completion::queue_t::iterator it = queue.begin(); it != queue.end(); ++it)
+  {
+    connections_t::iterator itc = m_connections.find(it->first);
+    if (itc == m_connections.end())
+      continue;
+    Connection* conn = itc->second;
+    conn->data.swap(it->second);
+    conn->responding = true;
+    conn->since = OS::gettime_ms();
+    SendResponse(it->first, conn);
+  }
+}
+
+void EventReactor::SendResponse(uint64_t id, Connection* conn)
+{
+  while (conn->sent < conn->data.size())
+  {
+    ssize_t r = send(conn->socket, conn->data.c_str() + conn->sent, conn->data.size() - conn->sent, MSG_NOSIGNAL);
+    if (r >= 0)
+      conn->sent += r;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return; // wait for the socket to be writable
+    else if (errno != EINTR)
+    {
+      DBG(DBG_DEBUG, "%s: send failed (%d)\n", __FUNCTION__, errno);
+      break;
+    }
+  }
+  CloseConnection(id);
+}
+
+void EventReactor::CloseConnection(uint64_t id)
+{
+  connections_t::iterator it = m_connections.find(id);
+  if (it == m_connections.end())
+    return;
+  // closing the descriptor removes it from the interest list
+  close(it->second->socket);
+  delete it->second;
+  m_connections.erase(it);
+}
+
+void EventReactor::Sweep(int64_t now)
+{
+  std::vector<uint64_t> expired;
+  for (connections_t::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+  {
+    // a request being processed by a worker isn't expired
+    if ((!it->second->dispatched || it->second->responding) && now - it->second->since > EVENTREACTOR_IDLE_TIMEOUT)
+      expired.push_back(it->first);
+  }
+  for (std::vector<uint64_t>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+  {
+    DBG(DBG_DEBUG, "%s: connection timed out (%llu)\n", __FUNCTION__, (unsigned long long)*it);
+    CloseConnection(*it);
+  }
+  m_lastSweep = now;
+}
+
+#endif /* HAVE_EPOLL */
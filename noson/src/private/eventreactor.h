@@ -0,0 +1,134 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef EVENTREACTOR_H
+#define EVENTREACTOR_H
+
+#include <local_config.h>
+
+#if HAVE_EPOLL
+
+#include "os/os.h"
+#include "os/threads/threadpool.h"
+#include "../eventhandler.h"
+#include "../sharedptr.h"
+
+#include <string>
+#include <map>
+
+#define EVENTREACTOR_POLL_TIMEOUT     1000      // 1 sec
+#define EVENTREACTOR_IDLE_TIMEOUT     5000      // max time to receive a request
+#define EVENTREACTOR_BACKLOG          128
+#define EVENTREACTOR_MAX_EVENTS       64
+#define EVENTREACTOR_MAX_CONNECTIONS  4096
+#define EVENTREACTOR_HEADER_MAXSIZE   16384
+#define EVENTREACTOR_REQUEST_MAXSIZE  1048576
+
+namespace NSROOT
+{
+
+  class TcpServerSocket;
+
+  /**
+   * Edge-triggered epoll loop serving the event listener. Requests are
+   * received on non-blocking sockets and framed without blocking, then
+   * complete requests are processed by the workers of the pool. The
+   * responses are sent back by the loop, so a slow sender never holds a
+   * worker.
+   */
+  class EventReactor
+  {
+  public:
+    EventReactor(EventHandler::EventHandlerThread* handler, OS::CThreadPool& pool);
+    ~EventReactor();
+
+    /**
+     * Start listening on the bound server socket.
+     */
+    bool Open(TcpServerSocket& server);
+
+    /**
+     * Wait for events and process them.
+     * @param timeout in milliseconds
+     * @return false on fatal error
+     */
+    bool Poll(int timeout);
+
+    /**
+     * Wake up the loop waiting for events. It can be called from any thread.
+     */
+    void Interrupt();
+
+    void Close();
+
+    unsigned GetConnectionCount() const { return (unsigned) m_connections.size(); }
+
+    class Completion;
+    typedef SHARED_PTR<Completion> CompletionPtr;
+
+  private:
+    struct Connection
+    {
+      Connection(net_socket_t s, int64_t now)
+      : socket(s), since(now), dispatched(false), responding(false), eof(false)
+      , scanned(0), headerLength(0), contentLength(0), chunked(false), sent(0) { }
+      net_socket_t socket;
+      int64_t since;
+      bool dispatched;      ///< The request has been passed to a worker
+      bool responding;      ///< The response is being sent
+      bool eof;             ///< The peer has closed its side
+      std::string data;     ///< The received request, then the response
+      size_t scanned;       ///< Data length scanned while framing
+      size_t headerLength;
+      size_t contentLength;
+      bool chunked;
+      size_t sent;
+    };
+    typedef std::map<uint64_t, Connection*> connections_t;
+
+    EventHandler::EventHandlerThread* m_handler;
+    OS::CThreadPool& m_pool;
+    int m_epoll;
+    net_socket_t m_server;
+    CompletionPtr m_completion;
+    connections_t m_connections;
+    uint64_t m_lastId;
+    int64_t m_lastSweep;
+
+    // prevent copy
+    EventReactor(const EventReactor&);
+    EventReactor& operator=(const EventReactor&);
+
+    void AcceptConnections();
+    void ReceiveRequest(uint64_t id, Connection* conn);
+    bool Framed(Connection* conn);
+    void Dispatch(uint64_t id, Connection* conn);
+    void ProcessCompletions();
+    void SendResponse(uint64_t id, Connection* conn);
+    void CloseConnection(uint64_t id);
+    void Sweep(int64_t now);
+  };
+
+}
+
+#endif /* HAVE_EPOLL */
+
+#endif /* EVENTREACTOR_H */
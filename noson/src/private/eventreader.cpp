@@ -0,0 +1,277 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "eventreader.h"
+#include "eventproperty.h"
+#include "didlreader.h"
+#include "debug.h"
+
+#include <cstring>
+
+#define NS_RCS "urn:schemas-upnp-org:metadata-1-0/RCS/"
+#define NS_AVT "urn:schemas-upnp-org:metadata-1-0/AVT/"
+#define NS_RIN "urn:schemas-rinconnetworks-com:metadata-1-0/"
+#define QN_RIN "r:"
+
+using namespace NSROOT;
+
+namespace NSROOT
+{
+  XMLDict __initRCSDict()
+  {
+    XMLDict dict;
+    dict.DefineNS("", NS_RCS);
+    dict.DefineNS(QN_RIN, NS_RIN);
+    return dict;
+  }
+  XMLDict RCSDict = __initRCSDict();
+
+  XMLDict __initAVTDict()
+  {
+    XMLDict dict;
+    dict.DefineNS("", NS_AVT);
+    dict.DefineNS(QN_RIN, NS_RIN);
+    return dict;
+  }
+  XMLDict AVTDict = __initAVTDict();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// LastChangeReader
+////
+
+EventReader::LastChangeReader::LastChangeReader(EventMessage& msg)
+: m_msg(msg)
+, m_parser(*this)
+, m_dict(NULL)
+, m_depth(0)
+, m_instance(false)
+, m_done(false)
+{
+}
+
+bool EventReader::LastChangeReader::StartElement(const char* name, const XMLStreamAttributes& attrs)
+{
+  switch (++m_depth)
+  {
+  case 1:
+    // learn declared namespaces for translations
+    for (unsigned i = 0; i < attrs.Count(); ++i)
+    {
+      if (XMLNS::PrefixEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS(XMLNS::LocalName(attrs.Name(i)), attrs.Value(i));
+      else if (XMLNS::NameEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS("", attrs.Value(i));
+    }
+    if (m_names.FindName(NS_RCS))
+    {
+      m_dict = &RCSDict;
+      m_msg.subject.push_back("RCS");
+    }
+    else if (m_names.FindName(NS_AVT))
+    {
+      m_dict = &AVTDict;
+      m_msg.subject.push_back("AVT");
+    }
+    else
+    {
+      DBG(DBG_WARN, "%s: not supported content (%s)\n", __FUNCTION__, name);
+      m_msg.subject.push_back("");
+    }
+    break;
+  case 2:
+    // only the first instance is processed
+    m_instance = (m_dict && !m_done && XMLNS::NameEqual(name, "InstanceID"));
+    break;
+  case 3:
+    if (m_instance)
+    {
+      m_name = m_dict->TranslateQName(m_names, name);
+      const char* str;
+      if (m_dict == &RCSDict && (str = attrs.Find("channel")))
+        m_name.append("/").append(str);
+      str = attrs.Find("val");
+      PROPERTY_t id = EventProperties::FindID(m_name.c_str(), m_name.size());
+      if (id != PROPERTY_UNKNOWN)
+      {
+        m_msg.properties.push_back(EventProperty(id));
+        if (str)
+        {
+          switch (id)
+          {
+          case PROPERTY_CurrentTrackMetaData:
+          case PROPERTY_r_NextTrackMetaData:
+          case PROPERTY_r_EnqueuedTransportURIMetaData:
+          case PROPERTY_AVTransportURIMetaData:
+          {
+            // the metadata is decoded now, so it is never copied
+            std::vector<DigitalItemPtr> items;
+            if (DIDLReader::Parse(str, strlen(str), items) && !items.empty())
+              m_msg.properties.back().item = items[0];
+            break;
+          }
+          default:
+            m_msg.properties.back().value.assign(str);
+          }
+        }
+      }
+      DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, m_name.c_str(), (str ? str : ""));
+    }
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool EventReader::LastChangeReader::EndElement(const char* name)
+{
+  (void)name;
+  if (m_depth-- == 2 && m_instance)
+  {
+    m_instance = false;
+    m_done = true;
+  }
+  return true;
+}
+
+bool EventReader::LastChangeReader::Characters(const char* text, size_t len)
+{
+  (void)text;
+  (void)len;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// EventReader
+////
+
+EventReader::EventReader(EventMessage& msg)
+: m_msg(msg)
+, m_parser(*this)
+, m_lastChange(msg)
+, m_depth(0)
+, m_content(CONTENT_NONE)
+, m_first(false)
+, m_value(false)
+, m_known(false)
+{
+}
+
+bool EventReader::Finish()
+{
+  if (!m_parser.Finish())
+  {
+    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
+    return false;
+  }
+  // the subject is completed even when nothing was notified
+  if (m_content == CONTENT_NONE)
+    m_msg.subject.push_back("PROPERTY");
+  return true;
+}
+
+bool EventReader::StartElement(const char* name, const XMLStreamAttributes& attrs)
+{
+  (void)attrs;
+  switch (++m_depth)
+  {
+  case 1:
+    if (!XMLNS::NameEqual(name, "propertyset"))
+    {
+      DBG(DBG_ERROR, "%s: invalid or not supported content (%s)\n", __FUNCTION__, name);
+      return false;
+    }
+    break;
+  case 2:
+    m_first = XMLNS::NameEqual(name, "property");
+    break;
+  case 3:
+    // only the first element of a property is processed
+    if (!m_first)
+      break;
+    m_first = false;
+    if (m_content == CONTENT_NONE)
+    {
+      // check prior for embedded doc 'Event': propertyset/property/LastChange
+      if (XMLNS::NameEqual(name, "LastChange"))
+      {
+        m_content = CONTENT_LASTCHANGE;
+        m_value = true;
+        break;
+      }
+      m_content = CONTENT_PROPERTY;
+      m_msg.subject.push_back("PROPERTY");
+    }
+    if (m_content == CONTENT_PROPERTY)
+    {
+      PROPERTY_t id = EventProperties::FindID(XMLNS::LocalName(name));
+      m_value = true;
+      if ((m_known = (id != PROPERTY_UNKNOWN)))
+        m_msg.properties.push_back(EventProperty(id));
+      else
+        DBG(DBG_PROTO, "%s: %s is ignored\n", __FUNCTION__, name);
+    }
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool EventReader::EndElement(const char* name)
+{
+  (void)name;
+  if (m_depth-- == 3 && m_value)
+  {
+    m_value = false;
+    if (m_content == CONTENT_LASTCHANGE)
+    {
+      // the embedded document must be complete
+      if (!m_lastChange.Finish())
+      {
+        DBG(DBG_ERROR, "%s: invalid or not supported content\n", __FUNCTION__);
+        return false;
+      }
+    }
+    else if (m_known)
+    {
+      m_known = false;
+      DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, EventProperties::Name(m_msg.properties.back().id),
+              m_msg.properties.back().value.c_str());
+    }
+  }
+  return true;
+}
+
+bool EventReader::Characters(const char* text, size_t len)
+{
+  // values are the text of the element
+  if (!m_value || m_depth != 3)
+    return true;
+  if (m_content == CONTENT_LASTCHANGE)
+    return m_lastChange.Feed(text, len);
+  if (m_known)
+    m_msg.properties.back().value.append(text, len);
+  return true;
+}
@@ -0,0 +1,116 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef EVENTREADER_H
+#define EVENTREADER_H
+
+#include <local_config.h>
+#include "xmlstream.h"
+#include "xmldict.h"
+#include "../eventhandler.h"
+
+#include <string>
+
+namespace NSROOT
+{
+
+  /**
+   * Decode the body of an event notification while it is received.
+   * The subject of the message is completed with the kind of notification
+   * (RCS, AVT or PROPERTY), then the properties are filled.
+   * The text of LastChange is fed to a nested parser as it is unescaped, so
+   * the embedded document is decoded in the same pass without building any
+   * intermediate document.
+   */
+  class EventReader : public XMLStreamHandler
+  {
+  public:
+    EventReader(EventMessage& msg);
+    ~EventReader() { }
+
+    bool Feed(const char* data, size_t len) { return m_parser.Feed(data, len); }
+
+    /**
+     * Check the content has been fully decoded.
+     * @return false if the content is not a valid notification
+     */
+    bool Finish();
+
+    // Implements XMLStreamHandler
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs);
+    virtual bool EndElement(const char* name);
+    virtual bool Characters(const char* text, size_t len);
+
+  private:
+    /**
+     * The handler of the document embedded in LastChange: Event/InstanceID/{property}
+     */
+    class LastChangeReader : public XMLStreamHandler
+    {
+    public:
+      LastChangeReader(EventMessage& msg);
+      ~LastChangeReader() { }
+      bool Feed(const char* data, size_t len) { return m_parser.Feed(data, len); }
+      bool Finish() { return m_parser.Finish(); }
+      // Implements XMLStreamHandler
+      virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs);
+      virtual bool EndElement(const char* name);
+      virtual bool Characters(const char* text, size_t len);
+
+    private:
+      EventMessage& m_msg;
+      XMLStreamParser m_parser;
+      XMLDict* m_dict;      ///< The dictionary of the notified service
+      XMLNames m_names;
+      unsigned m_depth;
+      bool m_instance;      ///< In the first element InstanceID
+      bool m_done;          ///< The first element InstanceID has been processed
+      std::string m_name;
+
+      // prevent copy
+      LastChangeReader(const LastChangeReader&);
+      LastChangeReader& operator=(const LastChangeReader&);
+    };
+
+    typedef enum
+    {
+      CONTENT_NONE,
+      CONTENT_LASTCHANGE,
+      CONTENT_PROPERTY,
+    } CONTENT_t;
+
+    EventMessage& m_msg;
+    XMLStreamParser m_parser;
+    LastChangeReader m_lastChange;
+    unsigned m_depth;
+    CONTENT_t m_content;  ///< The kind of content, set by the first property
+    bool m_first;         ///< The current property has no value yet
+    bool m_value;         ///< In the value of a property
+    bool m_known;         ///< The current value is kept
+
+    // prevent copy
+    EventReader(const EventReader&);
+    EventReader& operator=(const EventReader&);
+  };
+
+}
+
+#endif /* EVENTREADER_H */
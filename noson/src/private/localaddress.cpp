@@ -0,0 +1,169 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "localaddress.h"
+#include "socket.h"
+#include "debug.h"
+#include "cppdef.h"
+#include "os/threads/timeout.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <cstring>
+#endif
+
+using namespace NSROOT;
+
+static OS::CMutex g_instanceLock;
+
+LocalAddressCache* LocalAddressCache::m_instance = 0;
+
+LocalAddressCache& LocalAddressCache::Instance()
+{
+  OS::CLockGuard lock(g_instanceLock);
+  if (!m_instance)
+    m_instance = new LocalAddressCache();
+  return *m_instance;
+}
+
+void LocalAddressCache::Destroy()
+{
+  OS::CLockGuard lock(g_instanceLock);
+  SAFE_DELETE(m_instance);
+}
+
+LocalAddressCache::LocalAddressCache()
+: m_mutex()
+, m_entries()
+, m_monitor(-1)
+{
+#ifdef __linux__
+  // subscribe to the changes of links, addresses and routes
+  int fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (fd >= 0)
+  {
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) == 0)
+      m_monitor = fd;
+    else
+    {
+      DBG(DBG_WARN, "%s: netlink is not available (%d)\n", __FUNCTION__, errno);
+      close(fd);
+    }
+  }
+#endif
+}
+
+LocalAddressCache::~LocalAddressCache()
+{
+#ifdef __linux__
+  if (m_monitor >= 0)
+    close(m_monitor);
+#endif
+}
+
+std::string LocalAddressCache::Lookup(const std::string& host, unsigned port)
+{
+  OS::CLockGuard lock(m_mutex);
+  int64_t now = OS::gettime_ms();
+  if (Changed())
+  {
+    DBG(DBG_DEBUG, "%s: network has changed\n", __FUNCTION__);
+    m_entries.clear();
+  }
+  entries_t::iterator it = m_entries.find(host);
+  if (it != m_entries.end())
+  {
+    // without monitor the entry expires
+    if (m_monitor >= 0 || it->second.expires > now)
+      return it->second.address;
+    m_entries.erase(it);
+  }
+  lock.Unlock();
+  std::string address = Resolve(host, port);
+  if (address.empty())
+    return address;
+  lock.Lock();
+  Entry& entry = m_entries[host];
+  entry.address = address;
+  entry.expires = now + LOCALADDRESS_TTL;
+  return address;
+}
+
+void LocalAddressCache::Invalidate(const std::string& host)
+{
+  OS::CLockGuard lock(m_mutex);
+  m_entries.erase(host);
+}
+
+void LocalAddressCache::Flush()
+{
+  OS::CLockGuard lock(m_mutex);
+  m_entries.clear();
+}
+
+bool LocalAddressCache::Changed()
+{
+  bool changed = false;
+#ifdef __linux__
+  if (m_monitor < 0)
+    return false;
+  // drain the pending notifications
+  char buf[4096];
+  for (;;)
+  {
+    ssize_t r = recv(m_monitor, buf, sizeof(buf), MSG_DONTWAIT);
+    if (r > 0)
+      changed = true;
+    else if (r < 0 && errno == ENOBUFS)
+      changed = true; // notifications were lost on overflow
+    else if (r < 0 && errno == EINTR)
+      continue;
+    else
+      break;
+  }
+#endif
+  return changed;
+}
+
+std::string LocalAddressCache::Resolve(const std::string& host, unsigned port)
+{
+  UdpSocket udp;
+  std::string address;
+  if (udp.SetAddress(SOCKET_AF_INET4, host.c_str(), port))
+    address = udp.GetLocalIP();
+  if (address.empty())
+  {
+    // the host isn't a numeric IPv4 address: make a connection
+    TcpSocket tcp;
+    if (tcp.Connect(host.c_str(), port, 0))
+      address = tcp.GetLocalIP();
+    tcp.Disconnect();
+  }
+  return address;
+}
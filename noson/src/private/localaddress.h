@@ -0,0 +1,88 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef LOCALADDRESS_H
+#define LOCALADDRESS_H
+
+#include <local_config.h>
+#include "os/os.h"
+#include "os/threads/mutex.h"
+
+#include <string>
+#include <map>
+
+#define LOCALADDRESS_TTL      60000   // 60 sec
+
+namespace NSROOT
+{
+
+  /**
+   * Process wide cache of the local address routing to a remote host. The
+   * address is resolved by a connected datagram socket, so no handshake
+   * is made with the host. On Linux the cache is flushed when a route
+   * or an interface address changes; elsewhere an entry expires after
+   * LOCALADDRESS_TTL.
+   */
+  class LocalAddressCache
+  {
+  public:
+    static LocalAddressCache& Instance();
+    static void Destroy();
+
+    /**
+     * Get the local address routing to the host.
+     * @return the numeric address, or empty on failure
+     */
+    std::string Lookup(const std::string& host, unsigned port);
+
+    /**
+     * Drop the entry of the host, i.e when it became unreachable.
+     */
+    void Invalidate(const std::string& host);
+
+    void Flush();
+
+  private:
+    LocalAddressCache();
+    ~LocalAddressCache();
+    LocalAddressCache(const LocalAddressCache&);
+    LocalAddressCache& operator=(const LocalAddressCache&);
+
+    static LocalAddressCache* m_instance;
+
+    struct Entry
+    {
+      std::string address;
+      int64_t expires;
+    };
+    typedef std::map<std::string, Entry> entries_t;
+
+    OS::CMutex m_mutex;
+    entries_t m_entries;
+    int m_monitor;            ///< Netlink socket notified of the changes
+
+    bool Changed();
+    static std::string Resolve(const std::string& host, unsigned port);
+  };
+
+}
+
+#endif /* LOCALADDRESS_H */
@@ -0,0 +1,168 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <local_config.h>
+#include "os/os.h"
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+namespace NSROOT
+{
+  namespace mpsc
+  {
+#if __cplusplus >= 201103L
+    typedef std::atomic<unsigned> sequence_t;
+    inline unsigned load(sequence_t& s) { return s.load(std::memory_order_acquire); }
+    inline void store(sequence_t& s, unsigned v) { s.store(v, std::memory_order_release); }
+    inline bool cas(sequence_t& s, unsigned e, unsigned d) { return s.compare_exchange_strong(e, d); }
+    inline unsigned exchange(sequence_t& s, unsigned v) { return s.exchange(v); }
+
+#elif defined _MSC_VER
+    typedef volatile LONG sequence_t;
+    inline unsigned load(sequence_t& s) { return (unsigned)s; }
+    inline void store(sequence_t& s, unsigned v) { InterlockedExchange(&s, (LONG)v); }
+    inline bool cas(sequence_t& s, unsigned e, unsigned d) { return InterlockedCompareExchange(&s, (LONG)d, (LONG)e) == (LONG)e; }
+    inline unsigned exchange(sequence_t& s, unsigned v) { return (unsigned)InterlockedExchange(&s, (LONG)v); }
+
+#elif defined __GNUC__
+    typedef volatile unsigned sequence_t;
+    inline unsigned load(sequence_t& s) { unsigned v = s; __sync_synchronize(); return v; }
+    inline void store(sequence_t& s, unsigned v) { __sync_synchronize(); s = v; }
+    inline bool cas(sequence_t& s, unsigned e, unsigned d) { return __sync_bool_compare_and_swap(&s, e, d); }
+    inline unsigned exchange(sequence_t& s, unsigned v) { unsigned o; do { o = s; } while (!__sync_bool_compare_and_swap(&s, o, v)); return o; }
+
+#else
+#error Atomic compare and swap is not available for the platform.
+#endif
+  }
+
+  /**
+   * Bounded ring for many producers and one consumer. A producer claims a
+   * slot with a compare and swap on the tail, then publishes the value by
+   * the sequence number of the slot. The consumer never locks.
+   */
+  template<typename T>
+  class MPSCQueue
+  {
+  public:
+    /**
+     * @param capacity rounded up to a power of 2
+     */
+    MPSCQueue(unsigned capacity)
+    : m_buffer(NULL)
+    , m_mask(1)
+    , m_head(0)
+    {
+      while (m_mask < capacity)
+        m_mask <<= 1;
+      m_buffer = new Cell[m_mask];
+      for (unsigned i = 0; i < m_mask; ++i)
+        mpsc::store(m_buffer[i].sequence, i);
+      --m_mask;
+      mpsc::store(m_tail, 0);
+    }
+
+    ~MPSCQueue()
+    {
+      delete[] m_buffer;
+    }
+
+    unsigned Capacity() const { return m_mask + 1; }
+
+    /**
+     * Push a copy of the value.
+     * @return false when the ring is full
+     */
+    bool Push(const T& val)
+    {
+      Cell* cell;
+      unsigned pos = mpsc::load(m_tail);
+      for (;;)
+      {
+        cell = &m_buffer[pos & m_mask];
+        int dif = (int)(mpsc::load(cell->sequence) - pos);
+        if (dif == 0)
+        {
+          if (mpsc::cas(m_tail, pos, pos + 1))
+            break;
+        }
+        else if (dif < 0)
+          return false;
+        pos = mpsc::load(m_tail);
+      }
+      cell->value = val;
+      mpsc::store(cell->sequence, pos + 1);
+      return true;
+    }
+
+    /**
+     * Pop the first value published. Only the consumer may call it.
+     * @return false when no value is available
+     */
+    bool Pop(T& val)
+    {
+      Cell* cell = &m_buffer[m_head & m_mask];
+      if ((int)(mpsc::load(cell->sequence) - (m_head + 1)) < 0)
+        return false;
+      val = cell->value;
+      cell->value = T();
+      mpsc::store(cell->sequence, m_head + m_mask + 1);
+      ++m_head;
+      return true;
+    }
+
+    /**
+     * Check whether a value is available. Only the consumer may call it.
+     */
+    bool Empty()
+    {
+      Cell* cell = &m_buffer[m_head & m_mask];
+      return ((int)(mpsc::load(cell->sequence) - (m_head + 1)) < 0);
+    }
+
+  private:
+    struct Cell
+    {
+      mpsc::sequence_t sequence;
+      T value;
+    };
+
+    Cell* m_buffer;
+    unsigned m_mask;
+    // keep the producers and the consumer positions on distinct cache lines
+    char m_pad0[64];
+    mpsc::sequence_t m_tail;
+    char m_pad1[64];
+    unsigned m_head;
+
+    // prevent copy
+    MPSCQueue(const MPSCQueue&);
+    MPSCQueue& operator=(const MPSCQueue&);
+  };
+
+}
+
+#endif /* MPSCQUEUE_H */
@@ -24,6 +24,8 @@
 
 #if defined(__APPLE__)
 #include <mach/mach_time.h>
+#elif !defined(__WINDOWS__)
+#include <time.h>
 #endif
 
 #ifdef NSROOT
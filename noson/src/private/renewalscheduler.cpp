@@ -0,0 +1,217 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "renewalscheduler.h"
+#include "timerwheel.h"
+#include "debug.h"
+#include "cppdef.h"
+
+#include <vector>
+
+using namespace NSROOT;
+
+namespace NSROOT
+{
+  class RenewalWorker : public OS::CWorker
+  {
+  public:
+    RenewalWorker(RenewalScheduler& scheduler, unsigned id, RenewalScheduler::Task* task)
+    : m_scheduler(scheduler), m_id(id), m_task(task) { }
+
+    virtual void Process()
+    {
+      m_scheduler.Complete(m_id, m_task->Run());
+    }
+
+  private:
+    RenewalScheduler& m_scheduler;
+    unsigned m_id;
+    RenewalScheduler::Task* m_task;
+  };
+}
+
+static OS::CMutex g_instanceLock;
+
+RenewalScheduler* RenewalScheduler::m_instance = 0;
+
+RenewalScheduler& RenewalScheduler::Instance()
+{
+  OS::CLockGuard lock(g_instanceLock);
+  if (!m_instance)
+  {
+    m_instance = new RenewalScheduler();
+    m_instance->StartThread();
+  }
+  return *m_instance;
+}
+
+void RenewalScheduler::Destroy()
+{
+  OS::CLockGuard lock(g_instanceLock);
+  SAFE_DELETE(m_instance);
+}
+
+RenewalScheduler::RenewalScheduler()
+: OS::CThread()
+, m_mutex()
+, m_condition()
+, m_event()
+, m_pool(RENEWAL_POOL_SIZE)
+, m_wheel(new TimerWheel(RENEWAL_WHEEL_SLOTS, RENEWAL_WHEEL_TICK, OS::gettime_ms()))
+, m_entries()
+, m_lastId(0)
+, m_seed((uint32_t)OS::gettime_ms())
+{
+  m_pool.SetKeepAlive(60000);
+  m_pool.Start();
+}
+
+RenewalScheduler::~RenewalScheduler()
+{
+  OS::CThread::StopThread(false);
+  m_event.Signal();
+  OS::CThread::StopThread(true);
+  m_pool.Stop();
+  // revoke the remaining tasks and wait for the running ones
+  OS::CLockGuard lock(m_mutex);
+  for (entries_t::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    it->second.revoked = true;
+    m_condition.Wait(m_mutex, it->second.idle, RENEWAL_DRAIN_TIMEOUT);
+  }
+  m_entries.clear();
+  SAFE_DELETE(m_wheel);
+}
+
+unsigned RenewalScheduler::Register(Task* task)
+{
+  OS::CLockGuard lock(m_mutex);
+  unsigned id = ++m_lastId;
+  m_entries.insert(std::make_pair(id, Entry(task)));
+  m_wheel->Schedule(id, OS::gettime_ms(), 0);
+  m_event.Signal();
+  return id;
+}
+
+void RenewalScheduler::Unregister(unsigned id)
+{
+  OS::CLockGuard lock(m_mutex);
+  entries_t::iterator it = m_entries.find(id);
+  if (it == m_entries.end())
+    return;
+  it->second.revoked = true;
+  m_wheel->Cancel(id);
+  // Wait for the running task to complete
+  m_condition.Wait(m_mutex, it->second.idle);
+  m_entries.erase(it);
+}
+
+void RenewalScheduler::Wakeup(unsigned id)
+{
+  OS::CLockGuard lock(m_mutex);
+  entries_t::iterator it = m_entries.find(id);
+  if (it == m_entries.end() || it->second.revoked)
+    return;
+  // the running task will be rescheduled on completion
+  if (!it->second.idle)
+  {
+    it->second.wakeup = true;
+    return;
+  }
+  m_wheel->Schedule(id, OS::gettime_ms(), 0);
+  m_event.Signal();
+}
+
+unsigned RenewalScheduler::TaskCount() const
+{
+  OS::CLockGuard lock(m_mutex);
+  return (unsigned) m_entries.size();
+}
+
+void* RenewalScheduler::Process()
+{
+  std::vector<unsigned> expired;
+  while (!IsStopped())
+  {
+    OS::CLockGuard lock(m_mutex);
+    bool empty = m_wheel->Empty();
+    lock.Unlock();
+    // sleep until a task is registered when nothing is scheduled
+    if (empty)
+      m_event.Wait();
+    else
+      m_event.Wait(RENEWAL_WHEEL_TICK);
+    if (IsStopped())
+      break;
+    lock.Lock();
+    m_wheel->Advance(OS::gettime_ms(), expired);
+    for (std::vector<unsigned>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+      Dispatch(*it);
+    lock.Unlock();
+    expired.clear();
+  }
+  return NULL;
+}
+
+void RenewalScheduler::Dispatch(unsigned id)
+{
+  entries_t::iterator it = m_entries.find(id);
+  if (it == m_entries.end() || it->second.revoked || !it->second.idle)
+    return;
+  RenewalWorker *worker = new RenewalWorker(*this, id, it->second.task);
+  it->second.idle = false;
+  if (m_pool.Enqueue(worker))
+    return;
+  delete worker;
+  // retry on the next tick
+  it->second.idle = true;
+  m_wheel->Schedule(id, OS::gettime_ms(), RENEWAL_WHEEL_TICK);
+  DBG(DBG_ERROR, "%s: dispatching failed (%u)\n", __FUNCTION__, id);
+}
+
+void RenewalScheduler::Complete(unsigned id, unsigned delay)
+{
+  OS::CLockGuard lock(m_mutex);
+  entries_t::iterator it = m_entries.find(id);
+  if (it == m_entries.end())
+    return;
+  it->second.idle = true;
+  if (!it->second.revoked)
+  {
+    // a wakeup asked while running must not wait for the next period
+    if (it->second.wakeup)
+      delay = 0;
+    it->second.wakeup = false;
+    m_wheel->Schedule(id, OS::gettime_ms(), Jitter(delay));
+    m_event.Signal();
+  }
+  m_condition.Broadcast();
+}
+
+unsigned RenewalScheduler::Jitter(unsigned delay)
+{
+  // spread the renewals of the subscriptions started together
+  m_seed = m_seed * 1103515245 + 12345;
+  unsigned range = delay / 100 * RENEWAL_JITTER;
+  if (range == 0)
+    return delay;
+  return delay - ((m_seed >> 16) % range);
+}
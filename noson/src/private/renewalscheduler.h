@@ -0,0 +1,123 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef RENEWALSCHEDULER_H
+#define RENEWALSCHEDULER_H
+
+#include <local_config.h>
+#include "os/threads/thread.h"
+#include "os/threads/threadpool.h"
+#include "os/threads/event.h"
+#include "os/threads/mutex.h"
+
+#include <map>
+
+#define RENEWAL_POOL_SIZE       3
+#define RENEWAL_WHEEL_SLOTS     512
+#define RENEWAL_WHEEL_TICK      100     // 100 ms
+#define RENEWAL_JITTER          10      // percent of the delay
+#define RENEWAL_DRAIN_TIMEOUT   5000    // max time to wait for the running tasks on destroy
+
+namespace NSROOT
+{
+
+  class TimerWheel;
+
+  /**
+   * Process wide scheduler of the GENA subscriptions. The deadlines of all
+   * tasks are held by one timer wheel, and the expired tasks are run by a
+   * small shared pool. A task is never run twice at the same time.
+   */
+  class RenewalScheduler : private OS::CThread
+  {
+  public:
+    static RenewalScheduler& Instance();
+    static void Destroy();
+
+    class Task
+    {
+    public:
+      virtual ~Task() { }
+      /**
+       * Run the task.
+       * @return the delay in milliseconds before the next run
+       */
+      virtual unsigned Run() = 0;
+    };
+
+    /**
+     * Register the task and run it as soon as possible.
+     * @return the id of the task
+     */
+    unsigned Register(Task* task);
+
+    /**
+     * Unregister the task, waiting for its running to complete. Thereafter
+     * the task can be destroyed.
+     */
+    void Unregister(unsigned id);
+
+    /**
+     * Run the task as soon as possible. When the task is running, it will be
+     * run again on completion.
+     */
+    void Wakeup(unsigned id);
+
+    unsigned TaskCount() const;
+
+  private:
+    RenewalScheduler();
+    ~RenewalScheduler();
+    RenewalScheduler(const RenewalScheduler&);
+    RenewalScheduler& operator=(const RenewalScheduler&);
+
+    static RenewalScheduler* m_instance;
+
+    struct Entry
+    {
+      Entry(Task* t) : task(t), idle(true), revoked(false), wakeup(false) { }
+      Task* task;
+      volatile bool idle;       ///< The task isn't running
+      bool revoked;
+      bool wakeup;              ///< Run again as soon as the running completes
+    };
+    typedef std::map<unsigned, Entry> entries_t;
+
+    mutable OS::CMutex m_mutex;
+    OS::CCondition<volatile bool> m_condition;
+    OS::CEvent m_event;
+    OS::CThreadPool m_pool;
+    TimerWheel* m_wheel;
+    entries_t m_entries;
+    unsigned m_lastId;
+    uint32_t m_seed;
+
+    virtual void* Process();
+    void Dispatch(unsigned id);
+    void Complete(unsigned id, unsigned delay);
+    unsigned Jitter(unsigned delay);
+
+    friend class RenewalWorker;
+  };
+
+}
+
+#endif /* RENEWALSCHEDULER_H */
@@ -299,6 +299,16 @@ bool SecureSocket::IsValid() const
   return m_connected;
 }
 
+bool SecureSocket::IsReusable()
+{
+#if HAVE_OPENSSL
+  // Unread data remains in the SSL layer
+  if (m_connected && SSL_pending(static_cast<SSL*>(m_ssl)) > 0)
+    return false;
+#endif
+  return TcpSocket::IsReusable();
+}
+
 bool SecureSocket::IsCertificateValid(std::string& str)
 {
 #if HAVE_OPENSSL
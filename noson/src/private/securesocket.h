@@ -59,8 +59,10 @@ namespace NSROOT
     bool Connect(const char *server, unsigned port, int rcvbuf);
     bool SendData(const char* buf, size_t size);
     size_t ReceiveData(void* buf, size_t n);
+    size_t ReceiveSome(void* buf, size_t n) { return ReceiveData(buf, n); } // SSL read returns available data
     void Disconnect();
     bool IsValid() const;
+    bool IsReusable();
 
     bool IsCertificateValid(std::string& info);
 
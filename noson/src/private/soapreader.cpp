@@ -0,0 +1,286 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "soapreader.h"
+#include "wsresponse.h"
+#include "debug.h"
+
+#include <cstring>
+
+using namespace NSROOT;
+
+static void __appendEncoded(std::string& str, const char* text, size_t len)
+{
+  const char* end = text + len;
+  for (const char* p = text; p < end; ++p)
+  {
+    switch (*p)
+    {
+    case '&': str.append("&amp;"); break;
+    case '<': str.append("&lt;"); break;
+    case '>': str.append("&gt;"); break;
+    case '"': str.append("&quot;"); break;
+    default: str.push_back(*p);
+    }
+  }
+}
+
+static bool __isBlank(const std::string& str)
+{
+  return (str.find_first_not_of(" \t\r\n") == std::string::npos);
+}
+
+SOAPReader::SOAPReader(ElementList& vars, XMLDict* dict)
+: m_vars(vars)
+, m_dict(dict)
+, m_names()
+, m_parser(*this)
+, m_depth(0)
+, m_body(false)
+, m_response(false)
+, m_found(false)
+, m_fault(false)
+, m_detail(false)
+, m_detailCount(0)
+, m_hasChild(false)
+, m_embedName()
+, m_embed(NULL)
+, m_inEmbed(false)
+, m_embedded(false)
+{
+}
+
+void SOAPReader::Embed(const char* name, XMLStreamParser& parser)
+{
+  m_embedName.assign(name);
+  m_embed = &parser;
+  m_embedded = false;
+}
+
+bool SOAPReader::Parse(WSResponse& response)
+{
+  const char* data;
+  size_t len;
+  while ((len = response.FetchContent(&data)))
+  {
+    if (!m_parser.Feed(data, len))
+      break;
+  }
+  return Finish();
+}
+
+bool SOAPReader::Finish()
+{
+  if (!m_parser.Finish())
+  {
+    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
+    m_vars.clear();
+    return false;
+  }
+  if (!m_found)
+  {
+    DBG(DBG_ERROR, "%s: invalid or not supported response\n", __FUNCTION__);
+    m_vars.clear();
+    return false;
+  }
+  return true;
+}
+
+void SOAPReader::PushValue(const std::string& key, const std::string& value)
+{
+  m_vars.push_back(MAKE_SHARED<Element>(key, value));
+  DBG(DBG_PROTO, "%s: %s%s = %s\n", __FUNCTION__, (m_fault ? "[fault] " : ""), key.c_str(), value.c_str());
+}
+
+bool SOAPReader::StartElement(const char* name, const XMLStreamAttributes& attrs)
+{
+  switch (++m_depth)
+  {
+  case 1:
+    // Check for response: Envelope/Body/{respTag}
+    if (!XMLNS::NameEqual(name, "Envelope"))
+      return false;
+    // learn declared namespaces for translations
+    for (unsigned i = 0; i < attrs.Count(); ++i)
+    {
+      if (XMLNS::PrefixEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS(XMLNS::LocalName(attrs.Name(i)), attrs.Value(i));
+      else if (XMLNS::NameEqual(attrs.Name(i), "xmlns"))
+        m_names.AddXMLNS("", attrs.Value(i));
+    }
+    break;
+  case 2:
+    m_body = XMLNS::NameEqual(name, "Body");
+    break;
+  case 3:
+    // only the first element of the body is processed
+    if (m_body && !m_found)
+    {
+      m_found = m_response = true;
+      PushValue("TAG", XMLNS::LocalName(name));
+      m_fault = (m_vars.back()->compare("Fault") == 0);
+    }
+    break;
+  case 4:
+    if (m_response)
+    {
+      m_text.clear();
+      m_hasChild = false;
+      if (m_embed && !m_fault && XMLNS::NameEqual(name, m_embedName.c_str()))
+        m_inEmbed = true;
+      else if (m_fault)
+      {
+        if (XMLNS::NameEqual(name, "detail"))
+        {
+          m_detail = true;
+          m_detailCount = 0;
+        }
+      }
+      else if (m_dict)
+      {
+        m_xml.assign("<").append(name);
+        for (unsigned i = 0; i < attrs.Count(); ++i)
+        {
+          m_xml.append(" ").append(attrs.Name(i)).append("=\"");
+          __appendEncoded(m_xml, attrs.Value(i), strlen(attrs.Value(i)));
+          m_xml.append("\"");
+        }
+        m_xml.append(">");
+      }
+    }
+    break;
+  default:
+    if (m_response)
+    {
+      if (m_depth == 5)
+      {
+        // the text received so far is part of the XML string
+        if (!m_hasChild && !m_fault && m_dict)
+          __appendEncoded(m_xml, m_text.c_str(), m_text.size());
+        m_hasChild = true;
+        if (m_detail)
+          ++m_detailCount;
+      }
+      if (m_fault)
+      {
+        // values of the fault are the children of the first detail entry
+        if (m_detail && m_depth == 6 && m_detailCount == 1)
+          m_text.clear();
+      }
+      else if (m_dict)
+      {
+        m_xml.append("<").append(name);
+        for (unsigned i = 0; i < attrs.Count(); ++i)
+        {
+          m_xml.append(" ").append(attrs.Name(i)).append("=\"");
+          __appendEncoded(m_xml, attrs.Value(i), strlen(attrs.Value(i)));
+          m_xml.append("\"");
+        }
+        m_xml.append(">");
+      }
+    }
+    break;
+  }
+  return true;
+}
+
+bool SOAPReader::EndElement(const char* name)
+{
+  switch (m_depth--)
+  {
+  case 1:
+  case 2:
+    m_body = false;
+    break;
+  case 3:
+    m_response = false;
+    break;
+  case 4:
+    if (m_inEmbed)
+    {
+      // the embedded document must be complete
+      m_inEmbed = false;
+      if (!(m_embedded = (!m_embed->HasError() && m_embed->Finish())))
+        DBG(DBG_ERROR, "%s: invalid embedded document (%s)\n", __FUNCTION__, name);
+    }
+    else if (m_response)
+    {
+      if (m_fault)
+      {
+        if (XMLNS::NameEqual(name, "faultcode") && !__isBlank(m_text))
+          PushValue("faultcode", m_text);
+        else if (XMLNS::NameEqual(name, "faultstring") && !__isBlank(m_text))
+          PushValue("faultstring", m_text);
+        m_detail = false;
+      }
+      else if (!m_hasChild)
+      {
+        if (!__isBlank(m_text))
+        {
+          // remove the namespace qualifier to handle local name as key
+          if (m_dict)
+            PushValue(m_dict->TranslateQName(m_names, name), m_text);
+          else
+            PushValue(XMLNS::LocalName(name), m_text);
+        }
+      }
+      else if (m_dict)
+      {
+        m_xml.append("</").append(name).append(">");
+        PushValue(m_dict->TranslateQName(m_names, name), m_xml);
+      }
+      m_text.clear();
+      m_xml.clear();
+    }
+    break;
+  default:
+    if (m_response)
+    {
+      if (m_fault)
+      {
+        if (m_detail && m_depth + 1 == 6 && m_detailCount == 1 && !__isBlank(m_text))
+          PushValue(XMLNS::LocalName(name), m_text);
+      }
+      else if (m_dict)
+        m_xml.append("</").append(name).append(">");
+    }
+    break;
+  }
+  return true;
+}
+
+bool SOAPReader::Characters(const char* text, size_t len)
+{
+  if (m_inEmbed)
+  {
+    // on error the rest of the document is ignored
+    if (m_depth == 4 && !m_embed->HasError())
+      m_embed->Feed(text, len);
+  }
+  else if (m_response)
+  {
+    if (m_depth == 4 || (m_detail && m_depth == 6))
+      m_text.append(text, len);
+    if (!m_fault && m_dict && (m_depth > 4 || (m_depth == 4 && m_hasChild)))
+      __appendEncoded(m_xml, text, len);
+  }
+  return true;
+}
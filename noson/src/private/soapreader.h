@@ -0,0 +1,113 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef SOAPREADER_H
+#define SOAPREADER_H
+
+#include <local_config.h>
+#include "xmlstream.h"
+#include "xmldict.h"
+#include "../element.h"
+
+#include <string>
+
+namespace NSROOT
+{
+
+  class WSResponse;
+
+  /**
+   * Decode a SOAP response while it is received.
+   * The list is filled with the tag of the response as "TAG", then with the
+   * values of the response arguments, or the fault code, string and details.
+   */
+  class SOAPReader : public XMLStreamHandler
+  {
+  public:
+    /**
+     * @param vars The list to fill
+     * @param dict The dictionary to translate the qualified name of arguments.
+     *        When set, an argument with child elements is kept as XML string,
+     *        else it is ignored and the local name is used as key.
+     */
+    SOAPReader(ElementList& vars, XMLDict* dict = NULL);
+    ~SOAPReader() { }
+
+    /**
+     * Read and decode the content of the response.
+     * @return false if the content is not a valid SOAP response
+     */
+    bool Parse(WSResponse& response);
+
+    bool Feed(const char* data, size_t len) { return m_parser.Feed(data, len); }
+    bool Finish();
+
+    /**
+     * The text of the named argument is fed to the parser as it is
+     * unescaped, so the embedded document is decoded in the same pass
+     * without building any string. The argument isn't kept in the list.
+     */
+    void Embed(const char* name, XMLStreamParser& parser);
+
+    /**
+     * Check the embedded document has been received and fully decoded.
+     */
+    bool IsEmbedded() const { return m_embedded; }
+
+    bool IsFault() const { return m_fault; }
+
+    const ElementList& GetVars() const { return m_vars; }
+
+    // Implements XMLStreamHandler
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs);
+    virtual bool EndElement(const char* name);
+    virtual bool Characters(const char* text, size_t len);
+
+  private:
+    ElementList& m_vars;
+    XMLDict* m_dict;
+    XMLNames m_names;
+    XMLStreamParser m_parser;
+    unsigned m_depth;
+    bool m_body;          ///< In the element Body
+    bool m_response;      ///< In the response element
+    bool m_found;         ///< The response element has been found
+    bool m_fault;
+    bool m_detail;        ///< In the element detail of the fault
+    unsigned m_detailCount;
+    bool m_hasChild;      ///< The current argument has child elements
+    std::string m_embedName;
+    XMLStreamParser* m_embed; ///< The parser of the embedded document
+    bool m_inEmbed;       ///< In the argument holding the embedded document
+    bool m_embedded;
+    std::string m_text;
+    std::string m_xml;
+
+    // prevent copy
+    SOAPReader(const SOAPReader&);
+    SOAPReader& operator=(const SOAPReader&);
+
+    void PushValue(const std::string& key, const std::string& value);
+  };
+
+}
+
+#endif /* SOAPREADER_H */
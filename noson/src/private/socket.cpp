@@ -337,6 +337,57 @@ size_t TcpSocket::ReceiveData(void *buf, size_t n)
   return 0;
 }
 
+size_t TcpSocket::ReceiveSome(void *buf, size_t n)
+{
+  if (IsValid())
+  {
+    m_errno = 0;
+    // Check for data remaining in buffer
+    if (m_buffer && m_bufptr < m_buffer + m_rcvlen)
+    {
+      size_t s = m_rcvlen - (m_bufptr - m_buffer);
+      if (s > n)
+        s = n;
+      memcpy(buf, m_bufptr, s);
+      m_bufptr += s;
+      return s;
+    }
+
+    struct timeval tv;
+    int r = 0, hangcount = 0;
+
+    for (;;)
+    {
+      tv = m_timeout;
+      r = Listen(&tv);
+      if (r > 0)
+      {
+        if ((r = recv(m_socket, (char*)buf, n, 0)) > 0)
+          return r;
+        if (r == 0)
+        {
+          DBG(DBG_DEBUG, "%s: socket(%p) closed by peer\n", __FUNCTION__, &m_socket);
+          m_errno = ECONNRESET;
+          break;
+        }
+        m_errno = LASTERROR;
+      }
+      if (r == 0)
+      {
+        DBG(DBG_WARN, "%s: socket(%p) timed out (%d)\n", __FUNCTION__, &m_socket, hangcount);
+        m_errno = ETIMEDOUT;
+        if (++hangcount >= m_attempt)
+          break;
+      }
+      else if (m_errno != ERRNO_INTR)
+        break;
+    }
+    return 0;
+  }
+  m_errno = ENOTCONN;
+  return 0;
+}
+
 void TcpSocket::Disconnect()
 {
   if (IsValid())
@@ -388,6 +439,20 @@ int TcpSocket::Listen(timeval *timeout)
   return -1;
 }
 
+bool TcpSocket::IsReusable()
+{
+  if (!IsValid())
+    return false;
+  // Unread data remains in buffer
+  if (m_buffer && m_bufptr < m_buffer + m_rcvlen)
+    return false;
+  // The socket must not be readable: else the peer sent FIN or garbage
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 0;
+  return (Listen(&tv) == 0);
+}
+
 net_socket_t TcpSocket::GetSocket() const
 {
   return m_socket;
@@ -704,6 +769,93 @@ bool UdpSocket::SetMulticastTTL(int multicastTTL)
   return true;
 }
 
+bool UdpSocket::SetMulticastInterface(const char* address)
+{
+  if (!IsValid())
+    return false;
+
+  if (m_addr->sa.sa_family != AF_INET)
+  {
+    m_errno = EINVAL;
+    DBG(DBG_ERROR, "%s: address familly not supported (%d)\n", __FUNCTION__, m_addr->sa.sa_family);
+    return false;
+  }
+  struct in_addr _addr;
+  if (inet_pton(AF_INET, address, &_addr) != 1)
+  {
+    m_errno = EINVAL;
+    DBG(DBG_ERROR, "%s: invalid address (%s)\n", __FUNCTION__, address);
+    return false;
+  }
+  if (setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_IF, (char*)&_addr, sizeof(_addr)))
+  {
+    m_errno = LASTERROR;
+    DBG(DBG_ERROR, "%s: could not set IP_MULTICAST_IF from socket (%d)\n", __FUNCTION__, m_errno);
+    return false;
+  }
+  m_errno = 0;
+  return true;
+}
+
+bool UdpSocket::Bind(unsigned port)
+{
+  if (!IsValid())
+    return false;
+
+  if (m_addr->sa.sa_family != AF_INET)
+  {
+    m_errno = EINVAL;
+    DBG(DBG_ERROR, "%s: address familly not supported (%d)\n", __FUNCTION__, m_addr->sa.sa_family);
+    return false;
+  }
+  int opt_reuseaddr = 1;
+  if (setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, (char*)&opt_reuseaddr, sizeof(opt_reuseaddr)))
+  {
+    m_errno = LASTERROR;
+    DBG(DBG_ERROR, "%s: could not set reuseaddr from socket (%d)\n", __FUNCTION__, m_errno);
+    return false;
+  }
+  sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(port);
+  if (bind(m_socket, (struct sockaddr*)&sa, sizeof(sa)) != 0)
+  {
+    m_errno = LASTERROR;
+    DBG(DBG_ERROR, "%s: failed to bind socket (%d)\n", __FUNCTION__, m_errno);
+    return false;
+  }
+  m_errno = 0;
+  return true;
+}
+
+bool UdpSocket::JoinMulticastGroup(const char* group, const char* address)
+{
+  if (!IsValid())
+    return false;
+
+  struct ip_mreq mreq;
+  memset(&mreq, 0, sizeof(mreq));
+  if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 ||
+          (address && inet_pton(AF_INET, address, &mreq.imr_interface) != 1))
+  {
+    m_errno = EINVAL;
+    DBG(DBG_ERROR, "%s: invalid address\n", __FUNCTION__);
+    return false;
+  }
+  if (!address)
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq)))
+  {
+    m_errno = LASTERROR;
+    DBG(DBG_ERROR, "%s: could not set IP_ADD_MEMBERSHIP from socket (%d)\n", __FUNCTION__, m_errno);
+    return false;
+  }
+  m_errno = 0;
+  return true;
+}
+
 bool UdpSocket::SendData(const char* data, size_t size)
 {
   if (IsValid())
@@ -820,3 +972,55 @@ std::string UdpSocket::GetRemoteIP() const
   }
   return host;
 }
+
+unsigned UdpSocket::GetRemotePort() const
+{
+  switch(m_from->sa.sa_family)
+  {
+    case AF_INET:
+      return ntohs(((struct sockaddr_in*)&m_from->sa)->sin_port);
+    default:
+      break;
+  }
+  return 0;
+}
+
+std::string UdpSocket::GetLocalIP()
+{
+  char host[INET6_ADDRSTRLEN];
+  memset(host, 0, INET6_ADDRSTRLEN);
+
+  if (!IsValid())
+    return host;
+
+  // the target is held in a struct sockaddr: only IPv4 fits
+  if (m_addr->sa.sa_family != AF_INET)
+    return host;
+  if (connect(m_socket, &m_addr->sa, sizeof(struct sockaddr_in)) != 0)
+  {
+    m_errno = LASTERROR;
+    DBG(DBG_ERROR, "%s: connect failed (%d)\n", __FUNCTION__, m_errno);
+    return host;
+  }
+
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(struct sockaddr_storage);
+  if (getsockname(m_socket, (struct sockaddr*)&addr, &addr_len) == 0)
+  {
+    switch(addr.ss_family)
+    {
+      case AF_INET:
+        getnameinfo((struct sockaddr*)&addr, addr_len, host, INET_ADDRSTRLEN, NULL, 0, NI_NUMERICHOST);
+        break;
+      case AF_INET6:
+        getnameinfo((struct sockaddr*)&addr, addr_len, host, INET6_ADDRSTRLEN, NULL, 0, NI_NUMERICHOST);
+        break;
+      default:
+        break;
+    }
+  }
+  else
+    m_errno = LASTERROR;
+
+  return host;
+}
@@ -56,6 +56,11 @@ namespace NSROOT
     virtual ~NetSocket() { }
     virtual bool SendData(const char* buf, size_t size) = 0;
     virtual size_t ReceiveData(void* buf, size_t n) = 0;
+    /**
+     * Receive available data, without waiting the requested size is filled.
+     * @return count of bytes received, or 0 on timeout or error
+     */
+    virtual size_t ReceiveSome(void* buf, size_t n) { return ReceiveData(buf, n); }
     void SetTimeout(timeval timeout)
     {
       m_timeout = timeout;
@@ -83,9 +88,15 @@ namespace NSROOT
     virtual bool Connect(const char *server, unsigned port, int rcvbuf);
     virtual bool SendData(const char* buf, size_t size);
     virtual size_t ReceiveData(void* buf, size_t n);
+    virtual size_t ReceiveSome(void* buf, size_t n);
     virtual void Disconnect();
     virtual bool IsValid() const;
     int Listen(timeval *timeout);
+    /**
+     * Check the connection could carry a new request: nothing remains to
+     * read and the peer has not closed its side.
+     */
+    virtual bool IsReusable();
     net_socket_t GetSocket() const;
     std::string GetLocalIP();
 
@@ -121,9 +132,17 @@ namespace NSROOT
     bool Create(SOCKET_AF_t af);
     bool IsValid() const;
     bool Bind(unsigned port);
+    void SetMaxConnections(unsigned n)
+    {
+      m_maxconnections = n;
+    }
     bool ListenConnection();
     bool AcceptConnection(TcpSocket& socket);
     void Close();
+    net_socket_t GetSocket() const
+    {
+      return m_socket;
+    }
 
   private:
     SocketAddress* m_addr;
@@ -153,6 +172,26 @@ namespace NSROOT
 
     bool SetAddress(SOCKET_AF_t af, const char *target, unsigned port);
     bool SetMulticastTTL(int multicastTTL);
+    /**
+     * Select the interface sending the IPv4 multicast datagrams.
+     * @param address the numeric address of the local interface
+     */
+    bool SetMulticastInterface(const char* address);
+    /**
+     * Bind the socket on the given port of all interfaces, sharing the port
+     * with the other listeners.
+     */
+    bool Bind(unsigned port);
+    /**
+     * Join the IPv4 multicast group on the given interface.
+     * @param address the numeric address of the local interface, or NULL
+     * for the default one
+     */
+    bool JoinMulticastGroup(const char* group, const char* address);
+    net_socket_t GetSocket() const
+    {
+      return m_socket;
+    }
     size_t GetPayloadLength() const
     {
       return m_rcvlen;
@@ -162,6 +201,13 @@ namespace NSROOT
       m_rcvlen = 0;
     }
     std::string GetRemoteIP() const;
+    unsigned GetRemotePort() const;
+    /**
+     * Get the local address routing to the target address. The datagram
+     * socket is connected, which selects the route without sending any
+     * packet.
+     */
+    std::string GetLocalIP();
 
   private:
     SocketAddress* m_addr;
@@ -0,0 +1,123 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "socketreader.h"
+#include "socket.h"
+
+#include <cstring>
+
+using namespace NSROOT;
+
+SocketReader::SocketReader(NetSocket* socket, size_t bufferSize)
+: m_socket(socket)
+, m_buffer(new char[bufferSize])
+, m_ptr(m_buffer)
+, m_end(m_buffer)
+, m_size(bufferSize)
+, m_received(0)
+{
+}
+
+SocketReader::~SocketReader()
+{
+  delete[] m_buffer;
+}
+
+bool SocketReader::Fill()
+{
+  // move pending data at front
+  size_t pending = m_end - m_ptr;
+  if (pending && m_ptr != m_buffer)
+    memmove(m_buffer, m_ptr, pending);
+  m_ptr = m_buffer;
+  m_end = m_buffer + pending;
+  if (pending >= m_size)
+    return false;
+  size_t r = m_socket->ReceiveSome(m_end, m_size - pending);
+  m_end += r;
+  m_received += r;
+  return (r > 0);
+}
+
+bool SocketReader::ReadLine(const char* eol, std::string& line, size_t* len)
+{
+  const char* s_eol = (eol != NULL ? eol : "\n");
+  size_t l_eol = strlen(s_eol);
+  size_t l = 0;
+
+  line.clear();
+  for (;;)
+  {
+    const char* p = m_ptr;
+    while ((p = static_cast<const char*>(memchr(p, s_eol[0], m_end - p))))
+    {
+      // the sequence could be truncated at end of buffer
+      if ((size_t)(m_end - p) < l_eol)
+        break;
+      if (memcmp(p, s_eol, l_eol) == 0)
+      {
+        line.append(m_ptr, p - m_ptr);
+        l += p - m_ptr;
+        m_ptr = const_cast<char*>(p) + l_eol;
+        *len = l;
+        return true;
+      }
+      ++p;
+    }
+    // flush the scanned data but a truncated sequence
+    size_t s = (p ? p : m_end) - m_ptr;
+    line.append(m_ptr, s);
+    l += s;
+    m_ptr += s;
+    if (l >= SOCKETREADER_LINE_MAXSIZE)
+      break;
+    if (!Fill())
+    {
+      /* No EOL found until end of data */
+      *len = l;
+      return false;
+    }
+  }
+  *len = l;
+  return true;
+}
+
+size_t SocketReader::ReadData(void* buf, size_t n)
+{
+  size_t s = m_end - m_ptr;
+  if (s == 0)
+  {
+    s = m_socket->ReceiveData(buf, n);
+    m_received += s;
+    return s;
+  }
+  if (s > n)
+    s = n;
+  memcpy(buf, m_ptr, s);
+  m_ptr += s;
+  if (s < n)
+  {
+    size_t r = m_socket->ReceiveData(static_cast<char*>(buf) + s, n - s);
+    m_received += r;
+    s += r;
+  }
+  return s;
+}
@@ -0,0 +1,94 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef SOCKETREADER_H
+#define SOCKETREADER_H
+
+#include <local_config.h>
+
+#include <cstddef>  // for size_t
+#include <string>
+
+#define SOCKETREADER_BUFFER_SIZE  4096
+#define SOCKETREADER_LINE_MAXSIZE 4000
+
+namespace NSROOT
+{
+
+  class NetSocket;
+
+  /**
+   * Buffered reader on a socket stream.
+   * Lines are scanned in the buffer filled by large socket reads. Data
+   * remaining in the buffer after the last line is served first to the next
+   * data read, so the message body following a header is not lost.
+   */
+  class SocketReader
+  {
+  public:
+    SocketReader(NetSocket* socket, size_t bufferSize = SOCKETREADER_BUFFER_SIZE);
+    ~SocketReader();
+
+    /**
+     * Read a line terminated by the given sequence. The sequence is removed.
+     * @param eol The end of line sequence, or NULL for LF
+     * @param line The line read
+     * @param len The length of the line
+     * @return false if no end of line was found until the end of data
+     */
+    bool ReadLine(const char* eol, std::string& line, size_t* len);
+
+    /**
+     * Read data, pending bytes in buffer first, then from the socket.
+     * It behaves as NetSocket::ReceiveData.
+     */
+    size_t ReadData(void* buf, size_t n);
+
+    /**
+     * Returns the count of bytes pending in buffer.
+     */
+    size_t Pending() const { return m_end - m_ptr; }
+
+    /**
+     * Returns the count of bytes received from the socket.
+     */
+    size_t Received() const { return m_received; }
+
+    NetSocket* GetSocket() const { return m_socket; }
+
+  private:
+    NetSocket* m_socket;
+    char* m_buffer;
+    char* m_ptr;              ///< The next position to read data from the buffer
+    char* m_end;              ///< The end of received data in the buffer
+    size_t m_size;
+    size_t m_received;
+
+    // prevent copy
+    SocketReader(const SocketReader&);
+    SocketReader& operator=(const SocketReader&);
+
+    bool Fill();
+  };
+
+}
+
+#endif /* SOCKETREADER_H */
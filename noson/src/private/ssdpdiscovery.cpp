@@ -0,0 +1,284 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "ssdpdiscovery.h"
+#include "socket.h"
+#include "debug.h"
+#include "os/threads/timeout.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#endif
+
+using namespace NSROOT;
+
+namespace
+{
+  struct FasterResponder
+  {
+    bool operator()(const SSDPDiscovery::Responder& a, const SSDPDiscovery::Responder& b) const
+    {
+      return a.latency < b.latency;
+    }
+  };
+
+  bool headerIs(const char* name, size_t len, const char* token)
+  {
+    size_t n = strlen(token);
+    if (len != n)
+      return false;
+#ifdef __WINDOWS__
+    return (_strnicmp(name, token, n) == 0);
+#else
+    return (strncasecmp(name, token, n) == 0);
+#endif
+  }
+}
+
+SSDPDiscovery::SSDPDiscovery(const std::string& searchTarget, const char* serverMatch)
+: m_searchTarget(searchTarget)
+, m_serverMatch(serverMatch ? serverMatch : "")
+, m_responders()
+{
+}
+
+bool SSDPDiscovery::Search(unsigned mx)
+{
+  char buf[SOCKET_BUFFER_SIZE];
+  snprintf(buf, sizeof(buf),
+          "M-SEARCH * HTTP/1.1\r\n"
+          "HOST: %s:%u\r\n"
+          "MAN: \"ssdp:discover\"\r\n"
+          "MX: %u\r\n"
+          "ST: %s\r\n"
+          "\r\n", SSDP_MULTICAST_ADDR, (unsigned)SSDP_MULTICAST_PORT, mx, m_searchTarget.c_str());
+  std::string msearch(buf);
+
+  m_responders.clear();
+
+  // open one socket by interface, else use the default one
+  std::vector<std::string> interfaces = GetInterfaces();
+  if (interfaces.empty())
+    interfaces.push_back("");
+  std::vector<UdpSocket*> sockets;
+  std::vector<std::string> bound;
+  struct timeval notimeout = { 0, 0 };
+  for (std::vector<std::string>::const_iterator it = interfaces.begin(); it != interfaces.end(); ++it)
+  {
+    UdpSocket* sock = new UdpSocket();
+    if (!sock->SetAddress(SOCKET_AF_INET4, SSDP_MULTICAST_ADDR, SSDP_MULTICAST_PORT) ||
+            !sock->SetMulticastTTL(SSDP_MULTICAST_TTL) ||
+            (!it->empty() && !sock->SetMulticastInterface(it->c_str())))
+    {
+      delete sock;
+      continue;
+    }
+    sock->SetTimeout(notimeout);
+    sockets.push_back(sock);
+    bound.push_back(*it);
+    DBG(DBG_DEBUG, "%s: probing interface (%s)\n", __FUNCTION__, it->c_str());
+  }
+  if (sockets.empty())
+    return false;
+
+  std::map<std::string, size_t> index;
+  int64_t start = OS::gettime_ms();
+  int64_t window = (int64_t)mx * 1000 + SSDP_GRACE_TIME;
+  int64_t elapsed = 0;
+  unsigned sent = 0;
+  while (elapsed < window)
+  {
+    // repeat the search early in the window against the loss of datagrams
+    int64_t wait = window - elapsed;
+    if (sent < SSDP_SEARCH_COUNT)
+    {
+      int64_t next = (int64_t)sent * 100;
+      if (elapsed >= next)
+      {
+        for (std::vector<UdpSocket*>::iterator it = sockets.begin(); it != sockets.end(); ++it)
+          (*it)->SendData(msearch.c_str(), msearch.size());
+        ++sent;
+        next += 100;
+      }
+      if (sent < SSDP_SEARCH_COUNT && next - elapsed < wait)
+        wait = next - elapsed;
+    }
+
+    // wait on all interfaces at once
+    fd_set fds;
+    FD_ZERO(&fds);
+    net_socket_t maxfd = 0;
+    for (std::vector<UdpSocket*>::iterator it = sockets.begin(); it != sockets.end(); ++it)
+    {
+      FD_SET((*it)->GetSocket(), &fds);
+      if ((*it)->GetSocket() > maxfd)
+        maxfd = (*it)->GetSocket();
+    }
+    struct timeval tv;
+    tv.tv_sec = (long)(wait / 1000);
+    tv.tv_usec = (long)((wait % 1000) * 1000);
+    int r = select((int)maxfd + 1, &fds, NULL, NULL, &tv);
+    elapsed = OS::gettime_ms() - start;
+    if (r <= 0)
+      continue;
+
+    for (size_t i = 0; i < sockets.size(); ++i)
+    {
+      if (!FD_ISSET(sockets[i]->GetSocket(), &fds))
+        continue;
+      size_t len = sockets[i]->ReceiveData(buf, sizeof(buf));
+      SSDPMessage msg;
+      if (len == 0 || !SSDPMessage::Parse(buf, len, msg) || msg.type != SSDPMessage::RESPONSE || msg.location.empty())
+        continue;
+      if (!m_serverMatch.empty() && msg.server.find(m_serverMatch) == std::string::npos)
+        continue;
+      if (msg.usn.empty())
+        msg.usn = msg.location;
+      if (index.find(msg.usn) != index.end())
+        continue;
+      Responder responder;
+      responder.usn = msg.usn;
+      responder.location = msg.location;
+      responder.server = msg.server;
+      responder.address = sockets[i]->GetRemoteIP();
+      responder.interface = bound[i];
+      responder.latency = (unsigned)elapsed;
+      DBG(DBG_DEBUG, "%s: %s responds in %u ms (%s)\n", __FUNCTION__, responder.address.c_str(),
+              responder.latency, responder.location.c_str());
+      index.insert(std::make_pair(responder.usn, m_responders.size()));
+      m_responders.push_back(responder);
+    }
+  }
+
+  for (std::vector<UdpSocket*>::iterator it = sockets.begin(); it != sockets.end(); ++it)
+    delete *it;
+
+  std::stable_sort(m_responders.begin(), m_responders.end(), FasterResponder());
+  DBG(DBG_INFO, "%s: %u responders found\n", __FUNCTION__, (unsigned)m_responders.size());
+  return !m_responders.empty();
+}
+
+bool SSDPMessage::Parse(const char* data, size_t len, SSDPMessage& msg)
+{
+  const char* end = data + len;
+  const char* line = data;
+  bool status = false;
+  while (line < end)
+  {
+    const char* eol = line;
+    while (eol < end && *eol != '\r' && *eol != '\n')
+      ++eol;
+    size_t n = eol - line;
+    if (!status)
+    {
+      // HTTP/1.1 200 OK, or NOTIFY * HTTP/1.1
+      if (n >= 12 && memcmp(line, "HTTP/", 5) == 0)
+      {
+        const char* code = (const char*)memchr(line, ' ', n);
+        if (!code || atoi(code + 1) != 200)
+          return false;
+        msg.type = RESPONSE;
+      }
+      else if (n >= 15 && memcmp(line, "NOTIFY ", 7) == 0)
+        msg.type = NOTIFY;
+      else
+        return false;
+      status = true;
+    }
+    else if (n == 0)
+      break; // end of header
+    else
+    {
+      // the value may be preceded by any amount of LWS
+      const char* colon = (const char*)memchr(line, ':', n);
+      if (colon)
+      {
+        const char* val = colon + 1;
+        while (val < eol && (*val == ' ' || *val == '\t'))
+          ++val;
+        size_t tl = colon - line;
+        if (headerIs(line, tl, "LOCATION"))
+          msg.location.assign(val, eol - val);
+        else if (headerIs(line, tl, "SERVER"))
+          msg.server.assign(val, eol - val);
+        else if (headerIs(line, tl, "USN"))
+          msg.usn.assign(val, eol - val);
+        else if (headerIs(line, tl, "NTS"))
+          msg.nts.assign(val, eol - val);
+        else if (headerIs(line, tl, "NT") || headerIs(line, tl, "ST"))
+          msg.nt.assign(val, eol - val);
+        else if (headerIs(line, tl, "BOOTID.UPNP.ORG") || headerIs(line, tl, "X-RINCON-BOOTSEQ"))
+          msg.bootId.assign(val, eol - val);
+        else if (headerIs(line, tl, "CACHE-CONTROL"))
+        {
+          // max-age = 1800
+          std::string cc(val, eol - val);
+          size_t p = cc.find("max-age");
+          if (p != std::string::npos && (p = cc.find('=', p)) != std::string::npos)
+            msg.maxAge = (unsigned)atoi(cc.c_str() + p + 1);
+        }
+      }
+    }
+    // skip the end of line
+    if (eol < end && *eol == '\r')
+      ++eol;
+    if (eol < end && *eol == '\n')
+      ++eol;
+    line = eol;
+  }
+  return status;
+}
+
+std::vector<std::string> SSDPDiscovery::GetInterfaces()
+{
+  std::vector<std::string> list;
+#ifndef __WINDOWS__
+  struct ifaddrs* ifap;
+  if (getifaddrs(&ifap) != 0)
+    return list;
+  for (struct ifaddrs* ifa = ifap; ifa; ifa = ifa->ifa_next)
+  {
+    if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+      continue;
+    if (!(ifa->ifa_flags & IFF_UP) || !(ifa->ifa_flags & IFF_MULTICAST) || (ifa->ifa_flags & IFF_LOOPBACK))
+      continue;
+    char host[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &((struct sockaddr_in*)ifa->ifa_addr)->sin_addr, host, sizeof(host)))
+      list.push_back(host);
+  }
+  freeifaddrs(ifap);
+#endif
+  return list;
+}
@@ -0,0 +1,120 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef SSDPDISCOVERY_H
+#define SSDPDISCOVERY_H
+
+#include <local_config.h>
+
+#include <string>
+#include <vector>
+
+#define SSDP_MULTICAST_ADDR   "239.255.255.250"
+#define SSDP_MULTICAST_PORT   1900
+#define SSDP_MULTICAST_TTL    4
+#define SSDP_MX               1       // seconds
+#define SSDP_SEARCH_COUNT     2       // M-SEARCH sent by window against the loss
+#define SSDP_GRACE_TIME       250     // ms waited after the MX window
+
+namespace NSROOT
+{
+
+  /**
+   * The fields of a SSDP datagram: a response to M-SEARCH, or a NOTIFY.
+   */
+  struct SSDPMessage
+  {
+    enum { RESPONSE, NOTIFY } type;
+    std::string nt;           ///< NT of a notify, ST of a response
+    std::string nts;          ///< ssdp:alive, ssdp:byebye
+    std::string usn;
+    std::string location;
+    std::string server;
+    std::string bootId;       ///< Changes when the device restarts
+    unsigned maxAge;          ///< The validity in seconds, or 0
+
+    SSDPMessage() : type(RESPONSE), maxAge(0) { }
+
+    /**
+     * Parse the datagram in one pass.
+     * @return false if the datagram is neither a successful response nor a
+     * notify
+     */
+    static bool Parse(const char* data, size_t len, SSDPMessage& msg);
+  };
+
+  /**
+   * SSDP search. The M-SEARCH is sent on every IPv4 interface supporting
+   * multicast, then the responses of all of them are collected until the
+   * end of the MX window. The responders are deduplicated by USN and ranked
+   * by response latency.
+   */
+  class SSDPDiscovery
+  {
+  public:
+    struct Responder
+    {
+      std::string usn;
+      std::string location;
+      std::string server;
+      std::string address;    ///< The address of the responder
+      std::string interface;  ///< The local interface receiving the response
+      unsigned latency;       ///< The time of response in milliseconds
+    };
+
+    /**
+     * @param searchTarget the ST of the search
+     * @param serverMatch the substring the SERVER header must contain, or NULL
+     */
+    SSDPDiscovery(const std::string& searchTarget, const char* serverMatch = NULL);
+    ~SSDPDiscovery() { }
+
+    /**
+     * Run one search window.
+     * @param mx the MX of the search in seconds
+     * @return false if no responder was found
+     */
+    bool Search(unsigned mx = SSDP_MX);
+
+    /**
+     * The responders of the last search, the fastest first.
+     */
+    const std::vector<Responder>& GetResponders() const { return m_responders; }
+
+    /**
+     * Get the address of the local IPv4 interfaces supporting multicast,
+     * excluding the loopback.
+     */
+    static std::vector<std::string> GetInterfaces();
+
+  private:
+    std::string m_searchTarget;
+    std::string m_serverMatch;
+    std::vector<Responder> m_responders;
+
+    // prevent copy
+    SSDPDiscovery(const SSDPDiscovery&);
+    SSDPDiscovery& operator=(const SSDPDiscovery&);
+  };
+
+}
+
+#endif /* SSDPDISCOVERY_H */
@@ -0,0 +1,224 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "ssdplistener.h"
+#include "ssdpdiscovery.h"
+#include "socket.h"
+#include "debug.h"
+#include "cppdef.h"
+#include "os/threads/timeout.h"
+
+#include <algorithm>
+
+using namespace NSROOT;
+
+namespace
+{
+  struct LatestDevice
+  {
+    bool operator()(const SSDPListener::Device& a, const SSDPListener::Device& b) const
+    {
+      return a.seen > b.seen;
+    }
+  };
+}
+
+SSDPListener::SSDPListener(const std::string& notificationType, const char* serverMatch)
+: OS::CThread()
+, m_notificationType(notificationType)
+, m_serverMatch(serverMatch ? serverMatch : "")
+, m_mutex()
+, m_devices()
+, m_gone()
+, m_CBHandle(NULL)
+, m_CB(NULL)
+, m_socket(NULL)
+{
+}
+
+SSDPListener::~SSDPListener()
+{
+  Stop();
+}
+
+void SSDPListener::SetCallback(void* handle, DeviceCB cb)
+{
+  OS::CLockGuard lock(m_mutex);
+  m_CBHandle = handle;
+  m_CB = cb;
+}
+
+bool SSDPListener::Start()
+{
+  if (OS::CThread::IsRunning())
+    return true;
+  SAFE_DELETE(m_socket);
+  m_socket = new UdpSocket();
+  if (!m_socket->SetAddress(SOCKET_AF_INET4, SSDP_MULTICAST_ADDR, SSDP_MULTICAST_PORT) ||
+          !m_socket->Bind(SSDP_MULTICAST_PORT))
+  {
+    DBG(DBG_WARN, "%s: cannot listen on the group\n", __FUNCTION__);
+    SAFE_DELETE(m_socket);
+    return false;
+  }
+  // join the group on every interface
+  std::vector<std::string> interfaces = SSDPDiscovery::GetInterfaces();
+  unsigned joined = 0;
+  for (std::vector<std::string>::const_iterator it = interfaces.begin(); it != interfaces.end(); ++it)
+    if (m_socket->JoinMulticastGroup(SSDP_MULTICAST_ADDR, it->c_str()))
+      ++joined;
+  if (joined == 0 && !m_socket->JoinMulticastGroup(SSDP_MULTICAST_ADDR, NULL))
+  {
+    SAFE_DELETE(m_socket);
+    return false;
+  }
+  struct timeval timeout = { 1, 0 };
+  m_socket->SetTimeout(timeout);
+  return OS::CThread::StartThread();
+}
+
+void SSDPListener::Stop()
+{
+  // the receive times out every second
+  OS::CThread::StopThread(true);
+  SAFE_DELETE(m_socket);
+}
+
+std::vector<SSDPListener::Device> SSDPListener::GetDevices() const
+{
+  std::vector<Device> list;
+  OS::CLockGuard lock(m_mutex);
+  int64_t now = OS::gettime_ms();
+  for (std::map<std::string, Device>::const_iterator it = m_devices.begin(); it != m_devices.end(); ++it)
+    if (it->second.expires > now)
+      list.push_back(it->second);
+  lock.Unlock();
+  std::sort(list.begin(), list.end(), LatestDevice());
+  return list;
+}
+
+bool SSDPListener::Empty() const
+{
+  OS::CLockGuard lock(m_mutex);
+  return m_devices.empty();
+}
+
+void SSDPListener::HandleDatagram(const char* data, size_t len)
+{
+  SSDPMessage msg;
+  if (!SSDPMessage::Parse(data, len, msg) || msg.type != SSDPMessage::NOTIFY || msg.nt != m_notificationType)
+    return;
+  // uuid:RINCON_000E58000001400::urn:schemas-upnp-org:device:ZonePlayer:1
+  std::string uuid = msg.usn.substr(0, msg.usn.find("::"));
+  if (uuid.empty())
+    return;
+  int64_t now = OS::gettime_ms();
+  OS::CLockGuard lock(m_mutex);
+  std::map<std::string, Device>::iterator it = m_devices.find(uuid);
+  if (msg.nts == "ssdp:byebye")
+  {
+    if (it == m_devices.end())
+      return;
+    std::string location = it->second.location;
+    m_gone[uuid] = it->second;
+    m_devices.erase(it);
+    lock.Unlock();
+    DBG(DBG_DEBUG, "%s: device is gone (%s)\n", __FUNCTION__, uuid.c_str());
+    Notify(uuid, location, false);
+  }
+  else if (msg.nts == "ssdp:alive")
+  {
+    if (msg.location.empty() || (!m_serverMatch.empty() && msg.server.find(m_serverMatch) == std::string::npos))
+      return;
+    bool restarted = false;
+    if (it == m_devices.end())
+    {
+      // the first announce of a device restarts it only when it was known
+      // with another boot ID or location
+      std::map<std::string, Device>::iterator git = m_gone.find(uuid);
+      if (git != m_gone.end())
+      {
+        restarted = (git->second.location != msg.location || git->second.bootId != msg.bootId);
+        m_gone.erase(git);
+      }
+      it = m_devices.insert(std::make_pair(uuid, Device())).first;
+    }
+    else
+      restarted = (it->second.location != msg.location || it->second.bootId != msg.bootId);
+    Device& device = it->second;
+    device.uuid = uuid;
+    device.location = msg.location;
+    device.server = msg.server;
+    device.bootId = msg.bootId;
+    device.seen = now;
+    device.expires = now + (int64_t)(msg.maxAge ? msg.maxAge : SSDP_DEFAULT_MAXAGE) * 1000;
+    lock.Unlock();
+    if (restarted)
+    {
+      DBG(DBG_DEBUG, "%s: device is restarted (%s)\n", __FUNCTION__, uuid.c_str());
+      Notify(uuid, msg.location, true);
+    }
+  }
+}
+
+void* SSDPListener::Process()
+{
+  char buf[SOCKET_BUFFER_SIZE];
+  while (!IsStopped())
+  {
+    size_t len = m_socket->ReceiveData(buf, sizeof(buf));
+    if (len > 0)
+      HandleDatagram(buf, len);
+    Purge(OS::gettime_ms());
+  }
+  return NULL;
+}
+
+void SSDPListener::Purge(int64_t now)
+{
+  std::vector<Device> expired;
+  OS::CLockGuard lock(m_mutex);
+  std::map<std::string, Device>::iterator it = m_devices.begin();
+  while (it != m_devices.end())
+  {
+    if (it->second.expires > now)
+      ++it;
+    else
+    {
+      expired.push_back(it->second);
+      m_gone[it->first] = it->second;
+      m_devices.erase(it++);
+    }
+  }
+  lock.Unlock();
+  for (std::vector<Device>::const_iterator dit = expired.begin(); dit != expired.end(); ++dit)
+    Notify(dit->uuid, dit->location, false);
+}
+
+void SSDPListener::Notify(const std::string& uuid, const std::string& location, bool alive)
+{
+  OS::CLockGuard lock(m_mutex);
+  void* handle = m_CBHandle;
+  DeviceCB cb = m_CB;
+  lock.Unlock();
+  if (cb)
+    cb(handle, uuid, location, alive);
+}
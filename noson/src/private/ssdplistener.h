@@ -0,0 +1,113 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef SSDPLISTENER_H
+#define SSDPLISTENER_H
+
+#include <local_config.h>
+#include "os/os.h"
+#include "os/threads/thread.h"
+#include "os/threads/mutex.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define SSDP_DEFAULT_MAXAGE   1800    // seconds
+
+namespace NSROOT
+{
+
+  class UdpSocket;
+
+  /**
+   * Passive SSDP listener. It consumes the ssdp:alive and ssdp:byebye of
+   * the multicast group to keep a live table of the devices, without any
+   * search. A device expires after the max-age of its last announce.
+   */
+  class SSDPListener : private OS::CThread
+  {
+  public:
+    struct Device
+    {
+      std::string uuid;
+      std::string location;
+      std::string server;
+      std::string bootId;
+      int64_t seen;           ///< The time of the last announce
+      int64_t expires;
+    };
+
+    /**
+     * Callback on a known device restarted or moved (alive), or on a device
+     * gone or expired. A new device isn't signaled. A device gone is
+     * remembered, so its return is signaled only when it has rebooted or
+     * moved.
+     */
+    typedef void (*DeviceCB)(void* handle, const std::string& uuid, const std::string& location, bool alive);
+
+    /**
+     * @param notificationType the NT of the devices to track
+     * @param serverMatch the substring the SERVER header must contain, or NULL
+     */
+    SSDPListener(const std::string& notificationType, const char* serverMatch = NULL);
+    ~SSDPListener();
+
+    void SetCallback(void* handle, DeviceCB cb);
+
+    bool Start();
+    void Stop();
+    bool IsRunning() { return OS::CThread::IsRunning(); }
+
+    /**
+     * Get the live devices, the latest announced first.
+     */
+    std::vector<Device> GetDevices() const;
+
+    bool Empty() const;
+
+    /**
+     * Process a datagram received on the group.
+     */
+    void HandleDatagram(const char* data, size_t len);
+
+  private:
+    std::string m_notificationType;
+    std::string m_serverMatch;
+    mutable OS::CMutex m_mutex;
+    std::map<std::string, Device> m_devices;
+    std::map<std::string, Device> m_gone;   ///< The last state of the devices gone
+    void* m_CBHandle;
+    DeviceCB m_CB;
+    UdpSocket* m_socket;
+
+    virtual void* Process();
+    void Purge(int64_t now);
+    void Notify(const std::string& uuid, const std::string& location, bool alive);
+
+    // prevent copy
+    SSDPListener(const SSDPListener&);
+    SSDPListener& operator=(const SSDPListener&);
+  };
+
+}
+
+#endif /* SSDPLISTENER_H */
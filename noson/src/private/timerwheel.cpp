@@ -0,0 +1,94 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "timerwheel.h"
+
+using namespace NSROOT;
+
+TimerWheel::TimerWheel(unsigned slotCount, unsigned resolution, int64_t now)
+: m_slots(slotCount > 0 ? slotCount : 1)
+, m_resolution(resolution > 0 ? resolution : 1)
+, m_cursor(0)
+, m_time(now)
+{
+}
+
+void TimerWheel::Schedule(unsigned id, int64_t now, unsigned delay)
+{
+  Cancel(id);
+  // an empty wheel is moved to the current time
+  if (m_index.empty() && now > m_time)
+    m_time = now;
+  int64_t deadline = now + delay - m_time;
+  // the timer expires on the next tick at the earliest
+  uint64_t ticks = (deadline > 0 ? (uint64_t)(deadline + m_resolution - 1) / m_resolution : 1);
+  if (ticks == 0)
+    ticks = 1;
+  unsigned slot = (unsigned)((m_cursor + ticks) % m_slots.size());
+  unsigned rounds = (unsigned)((ticks - 1) / m_slots.size());
+  slot_t& list = m_slots[slot];
+  slot_t::iterator it = list.insert(list.end(), Timer(id, rounds));
+  m_index.insert(std::make_pair(id, std::make_pair(slot, it)));
+}
+
+bool TimerWheel::Cancel(unsigned id)
+{
+  index_t::iterator it = m_index.find(id);
+  if (it == m_index.end())
+    return false;
+  m_slots[it->second.first].erase(it->second.second);
+  m_index.erase(it);
+  return true;
+}
+
+void TimerWheel::Advance(int64_t now, std::vector<unsigned>& expired)
+{
+  if (m_index.empty())
+  {
+    if (now > m_time)
+      m_time = now;
+    return;
+  }
+  while (m_time + m_resolution <= now)
+  {
+    m_time += m_resolution;
+    m_cursor = (m_cursor + 1) % m_slots.size();
+    slot_t& list = m_slots[m_cursor];
+    slot_t::iterator it = list.begin();
+    while (it != list.end())
+    {
+      if (it->rounds > 0)
+      {
+        --(it->rounds);
+        ++it;
+        continue;
+      }
+      expired.push_back(it->id);
+      m_index.erase(it->id);
+      it = list.erase(it);
+    }
+    if (m_index.empty())
+    {
+      m_time = now;
+      break;
+    }
+  }
+}
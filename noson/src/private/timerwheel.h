@@ -0,0 +1,96 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <local_config.h>
+#include "os/os.h"
+
+#include <vector>
+#include <list>
+#include <map>
+
+namespace NSROOT
+{
+
+  /**
+   * Hashed timer wheel. A timer is hashed to the slot of its deadline, and
+   * counts the rounds of the wheel remaining before it expires. Scheduling
+   * and advancing cost the same whatever the count of timers.
+   * The wheel isn't thread-safe.
+   */
+  class TimerWheel
+  {
+  public:
+    /**
+     * @param slotCount the count of slots of the wheel
+     * @param resolution the time of a slot in milliseconds
+     * @param now the current time in milliseconds
+     */
+    TimerWheel(unsigned slotCount, unsigned resolution, int64_t now);
+    ~TimerWheel() { }
+
+    /**
+     * Schedule the timer, replacing any previous deadline of the same id.
+     * @param delay in milliseconds from now
+     */
+    void Schedule(unsigned id, int64_t now, unsigned delay);
+
+    /**
+     * @return false if the timer isn't scheduled
+     */
+    bool Cancel(unsigned id);
+
+    /**
+     * Advance the wheel up to now.
+     * @param expired filled with the id of the expired timers
+     */
+    void Advance(int64_t now, std::vector<unsigned>& expired);
+
+    bool Empty() const { return m_index.empty(); }
+    unsigned Size() const { return (unsigned) m_index.size(); }
+    unsigned Resolution() const { return m_resolution; }
+
+  private:
+    struct Timer
+    {
+      Timer(unsigned _id, unsigned _rounds) : id(_id), rounds(_rounds) { }
+      unsigned id;
+      unsigned rounds;
+    };
+    typedef std::list<Timer> slot_t;
+    typedef std::map<unsigned, std::pair<unsigned, slot_t::iterator> > index_t;
+
+    std::vector<slot_t> m_slots;
+    index_t m_index;
+    unsigned m_resolution;
+    unsigned m_cursor;        ///< The last slot processed
+    int64_t m_time;           ///< The time of the cursor
+
+    // prevent copy
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+  };
+
+}
+
+#endif /* TIMERWHEEL_H */
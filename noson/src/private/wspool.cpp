@@ -0,0 +1,158 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "wspool.h"
+#include "socket.h"
+#include "builtin.h"
+#include "debug.h"
+#include "cppdef.h"
+#include "os/threads/mutex.h"
+#include "os/threads/timeout.h"
+
+#include <cstring>
+
+using namespace NSROOT;
+
+WSConnectionPool* WSConnectionPool::m_instance = 0;
+
+WSConnectionPool& WSConnectionPool::Instance()
+{
+  if (!m_instance)
+    m_instance = new WSConnectionPool();
+  return *m_instance;
+}
+
+void WSConnectionPool::Destroy()
+{
+  SAFE_DELETE(m_instance);
+}
+
+WSConnectionPool::WSConnectionPool()
+: m_mutex(new OS::CMutex)
+, m_idle()
+, m_idleCount(0)
+{
+  memset(&m_stats, 0, sizeof(Stats));
+}
+
+WSConnectionPool::~WSConnectionPool()
+{
+  Purge(0);
+  SAFE_DELETE(m_mutex);
+}
+
+std::string WSConnectionPool::MakeKey(const std::string& server, unsigned port, bool secure)
+{
+  char buf[12];
+  uint32_to_string(port, buf);
+  std::string key(secure ? "https://" : "http://");
+  key.append(server).append(":").append(buf);
+  return key;
+}
+
+TcpSocket* WSConnectionPool::Checkout(const std::string& server, unsigned port, bool secure)
+{
+  OS::CLockGuard lock(*m_mutex);
+  __purge(OS::gettime_ms(), WSPOOL_IDLE_TIMEOUT);
+  ConnectionMap::iterator it = m_idle.find(MakeKey(server, port, secure));
+  if (it != m_idle.end())
+  {
+    // take the most recently used first
+    while (!it->second.empty())
+    {
+      TcpSocket* socket = it->second.back().socket;
+      it->second.pop_back();
+      --m_idleCount;
+      if (socket->IsReusable())
+      {
+        ++m_stats.hits;
+        DBG(DBG_PROTO, "%s: reuse connection to %s\n", __FUNCTION__, it->first.c_str());
+        return socket;
+      }
+      ++m_stats.stale;
+      DBG(DBG_PROTO, "%s: connection to %s was closed by peer\n", __FUNCTION__, it->first.c_str());
+      delete socket;
+    }
+    m_idle.erase(it);
+  }
+  ++m_stats.misses;
+  return NULL;
+}
+
+void WSConnectionPool::Checkin(const std::string& server, unsigned port, bool secure, TcpSocket* socket)
+{
+  if (!socket)
+    return;
+  if (!socket->IsReusable())
+  {
+    delete socket;
+    return;
+  }
+  OS::CLockGuard lock(*m_mutex);
+  int64_t now = OS::gettime_ms();
+  __purge(now, WSPOOL_IDLE_TIMEOUT);
+  ConnectionList& list = m_idle[MakeKey(server, port, secure)];
+  if (list.size() >= WSPOOL_MAX_IDLE_PER_KEY || m_idleCount >= WSPOOL_MAX_IDLE)
+  {
+    ++m_stats.evictions;
+    delete socket;
+    return;
+  }
+  Connection conn;
+  conn.socket = socket;
+  conn.since = now;
+  list.push_back(conn);
+  ++m_idleCount;
+}
+
+void WSConnectionPool::Purge(unsigned idleTimeout)
+{
+  OS::CLockGuard lock(*m_mutex);
+  __purge(OS::gettime_ms(), idleTimeout);
+}
+
+WSConnectionPool::Stats WSConnectionPool::GetStats() const
+{
+  OS::CLockGuard lock(*m_mutex);
+  Stats stats = m_stats;
+  stats.idle = m_idleCount;
+  return stats;
+}
+
+void WSConnectionPool::__purge(int64_t now, unsigned idleTimeout)
+{
+  ConnectionMap::iterator it = m_idle.begin();
+  while (it != m_idle.end())
+  {
+    // the oldest is at front
+    while (!it->second.empty() && now - it->second.front().since >= (int64_t)idleTimeout)
+    {
+      delete it->second.front().socket;
+      it->second.pop_front();
+      --m_idleCount;
+      ++m_stats.evictions;
+    }
+    if (it->second.empty())
+      m_idle.erase(it++);
+    else
+      ++it;
+  }
+}
@@ -0,0 +1,120 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef WSPOOL_H
+#define WSPOOL_H
+
+#include <local_config.h>
+#include "os/os.h"
+
+#include <string>
+#include <list>
+#include <map>
+
+#define WSPOOL_IDLE_TIMEOUT     10000 // 10 sec
+#define WSPOOL_MAX_IDLE_PER_KEY 4
+#define WSPOOL_MAX_IDLE         32
+
+namespace NSROOT
+{
+  namespace OS
+  {
+    class CMutex;
+  }
+
+  class TcpSocket;
+
+  /**
+   * Process wide pool of persistent HTTP connections.
+   * Connections are indexed by the tuple (host, port, secure). A connection
+   * is checked out for the time of one request/response, then checked in
+   * when the response has been fully consumed and the peer allows keep-alive.
+   */
+  class WSConnectionPool
+  {
+  public:
+    static WSConnectionPool& Instance();
+    static void Destroy();
+
+    struct Stats
+    {
+      unsigned hits;      ///< count of connections reused from the pool
+      unsigned misses;    ///< count of checkouts without any idle connection
+      unsigned stale;     ///< count of idle connections closed by the peer
+      unsigned evictions; ///< count of idle connections expired or over limit
+      unsigned idle;      ///< count of connections currently idle in the pool
+    };
+
+    /**
+     * Take an idle connection for the given end-point.
+     * @param server The host name or address
+     * @param port The port number
+     * @param secure The connection is secured with SSL
+     * @return the connected socket, else NULL when none is available
+     */
+    TcpSocket* Checkout(const std::string& server, unsigned port, bool secure);
+
+    /**
+     * Give back a connection for later use. The pool takes ownership of the
+     * socket and could release it immediately.
+     * @param server The host name or address
+     * @param port The port number
+     * @param secure The connection is secured with SSL
+     * @param socket The socket to keep alive
+     */
+    void Checkin(const std::string& server, unsigned port, bool secure, TcpSocket* socket);
+
+    /**
+     * Close all idle connections expired since the given delay.
+     * @param idleTimeout The max idle time in milliseconds, 0 closes all
+     */
+    void Purge(unsigned idleTimeout = WSPOOL_IDLE_TIMEOUT);
+
+    Stats GetStats() const;
+
+  private:
+    WSConnectionPool();
+    ~WSConnectionPool();
+    WSConnectionPool(const WSConnectionPool&);
+    WSConnectionPool& operator=(const WSConnectionPool&);
+
+    static WSConnectionPool* m_instance;
+
+    struct Connection
+    {
+      TcpSocket* socket;
+      int64_t since;
+    };
+    typedef std::list<Connection> ConnectionList;
+    typedef std::map<std::string, ConnectionList> ConnectionMap;
+
+    OS::CMutex* m_mutex;
+    ConnectionMap m_idle;
+    unsigned m_idleCount;
+    Stats m_stats;
+
+    static std::string MakeKey(const std::string& server, unsigned port, bool secure);
+    void __purge(int64_t now, unsigned idleTimeout);
+  };
+
+}
+
+#endif /* WSPOOL_H */
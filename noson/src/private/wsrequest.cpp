@@ -54,6 +54,7 @@ WSRequest::WSRequest(const std::string& server, unsigned port)
 , m_accept(CT_NONE)
 , m_contentType(CT_FORM)
 , m_contentData()
+, m_keepAlive(false)
 {
   if (port == 443)
     m_secure_uri = true;
@@ -71,6 +72,7 @@ WSRequest::WSRequest(const std::string& server, unsigned port, bool secureURI)
 , m_accept(CT_NONE)
 , m_contentType(CT_FORM)
 , m_contentData()
+, m_keepAlive(false)
 {
   // by default allow content encoding if possible
   RequestAcceptEncoding(true);
@@ -84,6 +86,7 @@ WSRequest::WSRequest(const URIParser& uri, HRM_t method)
 , m_accept(CT_NONE)
 , m_contentType(CT_FORM)
 , m_contentData()
+, m_keepAlive(false)
 {
   if (uri.Host())
     m_server.assign(uri.Host());
@@ -131,6 +134,11 @@ void WSRequest::RequestAcceptEncoding(bool yesno)
 #endif
 }
 
+void WSRequest::SetKeepAlive(bool yesno)
+{
+  m_keepAlive = yesno;
+}
+
 void WSRequest::SetUserAgent(const std::string& value)
 {
   m_userAgent = value;
@@ -207,7 +215,7 @@ void WSRequest::MakeMessageGET(std::string& msg, const char* method) const
     msg.append("User-Agent: " REQUEST_USER_AGENT "\r\n");
   else
     msg.append("User-Agent: ").append(m_userAgent).append("\r\n");
-  msg.append("Connection: " REQUEST_CONNECTION "\r\n");
+  msg.append("Connection: ").append(m_keepAlive ? REQUEST_KEEPALIVE : REQUEST_CONNECTION).append("\r\n");
   if (m_accept != CT_NONE)
     msg.append("Accept: ").append(MimeFromContentType(m_accept)).append("\r\n");
   msg.append("Accept-Charset: ").append(m_charset).append("\r\n");
@@ -230,7 +238,7 @@ void WSRequest::MakeMessagePOST(std::string& msg, const char* method) const
     msg.append("User-Agent: " REQUEST_USER_AGENT "\r\n");
   else
     msg.append("User-Agent: ").append(m_userAgent).append("\r\n");
-  msg.append("Connection: " REQUEST_CONNECTION "\r\n");
+  msg.append("Connection: ").append(m_keepAlive ? REQUEST_KEEPALIVE : REQUEST_CONNECTION).append("\r\n");
   if (m_accept != CT_NONE)
     msg.append("Accept: ").append(MimeFromContentType(m_accept)).append("\r\n");
   msg.append("Accept-Charset: ").append(m_charset).append("\r\n");
@@ -264,7 +272,7 @@ void WSRequest::MakeMessageHEAD(std::string& msg, const char* method) const
     msg.append("User-Agent: " REQUEST_USER_AGENT "\r\n");
   else
     msg.append("User-Agent: ").append(m_userAgent).append("\r\n");
-  msg.append("Connection: " REQUEST_CONNECTION "\r\n");
+  msg.append("Connection: ").append(m_keepAlive ? REQUEST_KEEPALIVE : REQUEST_CONNECTION).append("\r\n");
   if (m_accept != CT_NONE)
     msg.append("Accept: ").append(MimeFromContentType(m_accept)).append("\r\n");
   msg.append("Accept-Charset: ").append(m_charset).append("\r\n");
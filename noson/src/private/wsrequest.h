@@ -32,7 +32,8 @@
 
 #define REQUEST_PROTOCOL      "HTTP/1.1"
 #define REQUEST_USER_AGENT    "libnoson/1.0"
-#define REQUEST_CONNECTION    "close" // "keep-alive"
+#define REQUEST_CONNECTION    "close"
+#define REQUEST_KEEPALIVE     "keep-alive"
 #define REQUEST_STD_CHARSET   "utf-8"
 
 namespace NSROOT
@@ -59,6 +60,7 @@ namespace NSROOT
     void RequestService(const std::string& url, HRM_t method = HRM_GET);
     void RequestAccept(CT_t contentType);
     void RequestAcceptEncoding(bool yesno);
+    void SetKeepAlive(bool yesno);
     void SetUserAgent(const std::string& value);
     void SetContentParam(const std::string& param, const std::string& value);
     void SetContentCustom(CT_t contentType, const char *content);
@@ -71,6 +73,7 @@ namespace NSROOT
     const std::string& GetServer() const { return m_server; }
     unsigned GetPort() const { return m_port; }
     bool IsSecureURI() const { return m_secure_uri; }
+    bool IsKeepAlive() const { return m_keepAlive; }
 
   private:
     std::string m_server;
@@ -84,6 +87,7 @@ namespace NSROOT
     std::string m_contentData;
     std::map<std::string, std::string> m_headers;
     std::string m_userAgent;
+    bool m_keepAlive;
 
     void MakeMessageGET(std::string& msg, const char* method = "GET") const;
     void MakeMessagePOST(std::string& msg, const char* method = "POST") const;
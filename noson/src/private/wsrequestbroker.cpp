@@ -21,69 +21,15 @@
 
 #include "wsrequestbroker.h"
 #include "socket.h"
+#include "socketreader.h"
 #include "debug.h"
 #include "builtin.h"
 #include "cppdef.h"
 
 #define HTTP_TOKEN_MAXSIZE    20
-#define HTTP_HEADER_MAXSIZE   4000
-#define QUERY_BUFFER_SIZE     4000
 
 using namespace NSROOT;
 
-bool WSRequestBroker::ReadHeaderLine(NetSocket *socket, const char *eol, std::string& line, size_t *len)
-{
-  char buf[QUERY_BUFFER_SIZE];
-  const char *s_eol;
-  int p = 0, p_eol = 0, l_eol;
-  size_t l = 0;
-
-  if (eol != NULL)
-    s_eol = eol;
-  else
-    s_eol = "\n";
-  l_eol = strlen(s_eol);
-
-  line.clear();
-  do
-  {
-    if (socket->ReceiveData(&buf[p], 1) > 0)
-    {
-      if (buf[p++] == s_eol[p_eol])
-      {
-        if (++p_eol >= l_eol)
-        {
-          buf[p - l_eol] = '\0';
-          line.append(buf);
-          l += p - l_eol;
-          break;
-        }
-      }
-      else
-      {
-        p_eol = 0;
-        if (p > (QUERY_BUFFER_SIZE - 2 - l_eol))
-        {
-          buf[p] = '\0';
-          line.append(buf);
-          l += p;
-          p = 0;
-        }
-      }
-    }
-    else
-    {
-      /* No EOL found until end of data */
-      *len = l;
-      return false;
-    }
-  }
-  while (l < HTTP_HEADER_MAXSIZE);
-
-  *len = l;
-  return true;
-}
-
 void WSRequestBroker::Tokenize(const std::string& str, const char *delimiters, std::vector<std::string>& tokens, bool trimnull)
 {
   std::string::size_type pa = 0, pb = 0;
@@ -103,6 +49,7 @@ void WSRequestBroker::Tokenize(const std::string& str, const char *delimiters, s
 
 WSRequestBroker::WSRequestBroker(NetSocket* socket, timeval timeout)
 : m_socket(socket)
+, m_reader(new SocketReader(socket))
 , m_parsed(false)
 , m_parsedMethod(HRM_HEAD)
 , m_contentChunked(false)
@@ -119,6 +66,7 @@ WSRequestBroker::WSRequestBroker(NetSocket* socket, timeval timeout)
 WSRequestBroker::~WSRequestBroker()
 {
   SAFE_DELETE_ARRAY(m_chunkBuffer);
+  SAFE_DELETE(m_reader);
 }
 
 void WSRequestBroker::SetTimeout(timeval timeout)
@@ -144,7 +92,7 @@ bool WSRequestBroker::ParseQuery()
   bool ret = false;
   
   token[0] = 0;
-  while (ReadHeaderLine(m_socket, "\r\n", strread, &len))
+  while (m_reader->ReadLine("\r\n", strread, &len))
   {
     const char *line = strread.c_str(), *val = NULL;
     int value_len = 0;
@@ -250,7 +198,7 @@ size_t WSRequestBroker::ReadChunk(void *buf, size_t buflen)
       m_chunkBuffer = m_chunkPtr = m_chunkEnd = NULL;
       std::string strread;
       size_t len = 0;
-      while (ReadHeaderLine(m_socket, "\r\n", strread, &len) && len == 0);
+      while (m_reader->ReadLine("\r\n", strread, &len) && len == 0);
       DBG(DBG_PROTO, "%s: chunked data (%s)\n", __FUNCTION__, strread.c_str());
       std::string chunkStr("0x0");
       uint32_t chunkSize = 0;
@@ -260,7 +208,7 @@ size_t WSRequestBroker::ReadChunk(void *buf, size_t buflen)
           return 0;
         m_chunkPtr = m_chunkBuffer;
         m_chunkEnd = m_chunkBuffer + chunkSize;
-        if (m_socket->ReceiveData(m_chunkBuffer, chunkSize) != chunkSize)
+        if (m_reader->ReadData(m_chunkBuffer, chunkSize) != chunkSize)
           return 0;
       }
       else
@@ -282,11 +230,11 @@ size_t WSRequestBroker::ReadContent(char* buf, size_t buflen)
   {
     // let read on unknown length
     if (!m_contentLength)
-      s = m_socket->ReceiveData(buf, buflen);
+      s = m_reader->ReadData(buf, buflen);
     else if (m_contentLength > m_consumed)
     {
       size_t len = m_contentLength - m_consumed;
-      s = m_socket->ReceiveData(buf, len > buflen ? buflen : len);
+      s = m_reader->ReadData(buf, len > buflen ? buflen : len);
     }
   }
   else
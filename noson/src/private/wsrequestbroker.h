@@ -34,6 +34,7 @@ namespace NSROOT
 {
 
   class NetSocket;
+  class SocketReader;
 
   class WSRequestBroker
   {
@@ -55,11 +56,11 @@ namespace NSROOT
     size_t ReadContent(char *buf, size_t buflen);
     size_t GetConsumed() const { return m_consumed; }
 
-    static bool ReadHeaderLine(NetSocket *socket, const char *eol, std::string& line, size_t *len);
     static void Tokenize(const std::string& str, const char *delimiters, std::vector<std::string>& tokens, bool trimnull = false);
 
   private:
     NetSocket* m_socket;
+    SocketReader* m_reader;
     bool m_parsed;
     HRM_t m_parsedMethod;
     std::string m_parsedURI;
@@ -24,72 +24,25 @@
 #include "debug.h"
 #include "cppdef.h"
 #include "compressor.h"
+#include "wspool.h"
+#include "socketreader.h"
 
 #include <cstdlib>  // for atol
 #include <cstdio>
 #include <cstring>
 
 #define HTTP_TOKEN_MAXSIZE    20
-#define HTTP_HEADER_MAXSIZE   4000
-#define RESPONSE_BUFFER_SIZE  4000
+#define RESPONSE_BUFFER_SIZE  4096
 
 using namespace NSROOT;
 
-bool WSResponse::ReadHeaderLine(NetSocket *socket, const char *eol, std::string& line, size_t *len)
-{
-  char buf[RESPONSE_BUFFER_SIZE];
-  const char *s_eol;
-  int p = 0, p_eol = 0, l_eol;
-  size_t l = 0;
-
-  if (eol != NULL)
-    s_eol = eol;
-  else
-    s_eol = "\n";
-  l_eol = strlen(s_eol);
-
-  line.clear();
-  do
-  {
-    if (socket->ReceiveData(&buf[p], 1) > 0)
-    {
-      if (buf[p++] == s_eol[p_eol])
-      {
-        if (++p_eol >= l_eol)
-        {
-          buf[p - l_eol] = '\0';
-          line.append(buf);
-          l += p - l_eol;
-          break;
-        }
-      }
-      else
-      {
-        p_eol = 0;
-        if (p > (RESPONSE_BUFFER_SIZE - 2 - l_eol))
-        {
-          buf[p] = '\0';
-          line.append(buf);
-          l += p;
-          p = 0;
-        }
-      }
-    }
-    else
-    {
-      /* No EOL found until end of data */
-      *len = l;
-      return false;
-    }
-  }
-  while (l < HTTP_HEADER_MAXSIZE);
-
-  *len = l;
-  return true;
-}
-
 WSResponse::WSResponse(const WSRequest &request)
 : m_socket(NULL)
+, m_reader(NULL)
+, m_server(request.GetServer())
+, m_port(request.GetPort())
+, m_secure(request.IsSecureURI())
+, m_keepAlive(request.IsKeepAlive())
 , m_successful(false)
 , m_statusCode(0)
 , m_serverInfo()
@@ -99,23 +52,40 @@ WSResponse::WSResponse(const WSRequest &request)
 , m_contentEncoding(CE_NONE)
 , m_contentChunked(false)
 , m_contentLength(0)
+, m_contentLengthSet(false)
 , m_consumed(0)
 , m_chunkBuffer(NULL)
+, m_chunkBufferSize(0)
 , m_chunkPtr(NULL)
 , m_chunkEOR(NULL)
 , m_chunkEnd(NULL)
+, m_chunkEnded(false)
 , m_decoder(NULL)
 {
-  if (request.IsSecureURI())
-    m_socket = SSLSessionFactory::Instance().NewSocket();
-  else
-    m_socket = new TcpSocket();
-  if (!m_socket)
-    DBG(DBG_ERROR, "%s: create socket failed\n", __FUNCTION__);
-  else if (m_socket->Connect(request.GetServer().c_str(), request.GetPort(), SOCKET_RCVBUF_MINSIZE))
+  for (;;)
   {
+    // try to reuse a persistent connection, else open a new one
+    bool reused = false;
+    if (m_keepAlive && (m_socket = WSConnectionPool::Instance().Checkout(m_server, m_port, m_secure)))
+      reused = true;
+    else
+    {
+      if (m_secure)
+        m_socket = SSLSessionFactory::Instance().NewSocket();
+      else
+        m_socket = new TcpSocket();
+      if (!m_socket)
+      {
+        DBG(DBG_ERROR, "%s: create socket failed\n", __FUNCTION__);
+        break;
+      }
+      if (!m_socket->Connect(m_server.c_str(), m_port, SOCKET_RCVBUF_MINSIZE))
+        break;
+    }
     m_socket->SetReadAttempt(6); // 60 sec to hang up
-    if (SendRequest(request) && GetResponse())
+    m_reader = new SocketReader(m_socket);
+    bool sent = SendRequest(request);
+    if (sent && GetResponse())
     {
       if (m_statusCode < 200)
         DBG(DBG_WARN, "%s: status %d\n", __FUNCTION__, m_statusCode);
@@ -127,9 +97,21 @@ WSResponse::WSResponse(const WSRequest &request)
         DBG(DBG_ERROR, "%s: bad request (%d)\n", __FUNCTION__, m_statusCode);
       else
         DBG(DBG_ERROR, "%s: server error (%d)\n", __FUNCTION__, m_statusCode);
+      break;
     }
-    else
-      DBG(DBG_ERROR, "%s: invalid response\n", __FUNCTION__);
+    // the peer could close an idle connection at any time: retry once with
+    // a fresh connection when nothing has been received on the reused one.
+    // Once the peer answered, the request could have been processed, and a
+    // non-idempotent action must not run twice.
+    if (reused && (!sent || m_reader->Received() == 0))
+    {
+      DBG(DBG_DEBUG, "%s: persistent connection lost, retrying\n", __FUNCTION__);
+      SAFE_DELETE(m_reader);
+      SAFE_DELETE(m_socket);
+      continue;
+    }
+    DBG(DBG_ERROR, "%s: invalid response\n", __FUNCTION__);
+    break;
   }
 }
 
@@ -137,9 +119,26 @@ WSResponse::~WSResponse()
 {
   SAFE_DELETE(m_decoder);
   SAFE_DELETE_ARRAY(m_chunkBuffer);
+  // give back the connection when the message has been fully consumed
+  if (m_reader && m_keepAlive && IsCompleted() && m_reader->Pending() == 0)
+  {
+    WSConnectionPool::Instance().Checkin(m_server, m_port, m_secure, m_socket);
+    m_socket = NULL;
+  }
+  SAFE_DELETE(m_reader);
   SAFE_DELETE(m_socket);
 }
 
+bool WSResponse::IsCompleted() const
+{
+  // these responses never include a message body
+  if (m_statusCode == 204 || m_statusCode == 304)
+    return true;
+  if (m_contentChunked)
+    return m_chunkEnded;
+  return (m_contentLengthSet && m_consumed >= m_contentLength);
+}
+
 bool WSResponse::SendRequest(const WSRequest &request)
 {
   std::string msg;
@@ -163,7 +162,7 @@ bool WSResponse::GetResponse()
   bool ret = false;
 
   token[0] = 0;
-  while (ReadHeaderLine(m_socket, "\r\n", strread, &len))
+  while (m_reader->ReadLine("\r\n", strread, &len))
   {
     const char *line = strread.c_str(), *val = NULL;
     int value_len = 0;
@@ -181,6 +180,9 @@ bool WSResponse::GetResponse()
       {
         /* We have received a valid feedback */
         m_statusCode = status;
+        /* Persistent connection is the default since HTTP/1.1 */
+        if (len < 8 || memcmp(line, "HTTP/1.1", 8) != 0)
+          m_keepAlive = false;
         ret = true;
       }
       else
@@ -246,13 +248,23 @@ bool WSResponse::GetResponse()
           if (memcmp(token, "LOCATION", token_len) == 0)
             m_location.append(val);
           break;
+        case 10:
+          if (memcmp(token, "CONNECTION", token_len) == 0)
+          {
+            if (value_len > 4 && strnicmp(val, "close", 5) == 0)
+              m_keepAlive = false;
+          }
+          break;
         case 12:
           if (memcmp(token, "CONTENT-TYPE", token_len) == 0)
             m_contentType = ContentTypeFromMime(val);
           break;
         case 14:
           if (memcmp(token, "CONTENT-LENGTH", token_len) == 0)
+          {
             m_contentLength = atol(val);
+            m_contentLengthSet = true;
+          }
           break;
         case 16:
           if (memcmp(token, "CONTENT-ENCODING", token_len) == 0)
@@ -284,49 +296,102 @@ bool WSResponse::GetResponse()
   return ret;
 }
 
-size_t WSResponse::ReadChunk(void *buf, size_t buflen)
+/**
+ * Parse the chunk size: hexadecimal digits, possibly followed by extensions.
+ * Returns false if no digit was found or the value overflows.
+ */
+static bool __chunkSize(const char *str, uint32_t *num)
+{
+  uint32_t val = 0;
+  int n = 0;
+  for (;; ++str, ++n)
+  {
+    unsigned d;
+    if (*str >= '0' && *str <= '9')
+      d = *str - '0';
+    else if (*str >= 'a' && *str <= 'f')
+      d = *str - 'a' + 10;
+    else if (*str >= 'A' && *str <= 'F')
+      d = *str - 'A' + 10;
+    else
+      break;
+    if (val & 0xf0000000)
+      return false;
+    val = (val << 4) | d;
+  }
+  *num = val;
+  return (n > 0);
+}
+
+size_t WSResponse::FetchChunk(const char **data, size_t maxlen)
 {
   size_t s = 0;
-  if (m_contentChunked)
+  *data = NULL;
+  if (m_contentChunked && !m_chunkEnded)
   {
     // no more pending byte in chunk buffer
     if (m_chunkPtr >= m_chunkEnd)
     {
       // process next chunk
-      SAFE_DELETE_ARRAY(m_chunkBuffer);
-      m_chunkBuffer = m_chunkPtr = m_chunkEOR = m_chunkEnd = NULL;
+      m_chunkPtr = m_chunkEOR = m_chunkEnd = m_chunkBuffer;
       std::string strread;
       size_t len = 0;
-      while (ReadHeaderLine(m_socket, "\r\n", strread, &len) && len == 0);
+      while (m_reader->ReadLine("\r\n", strread, &len) && len == 0);
       DBG(DBG_PROTO, "%s: chunked data (%s)\n", __FUNCTION__, strread.c_str());
-      std::string chunkStr("0x0");
       uint32_t chunkSize;
-      if (!strread.empty() && sscanf(chunkStr.append(strread).c_str(), "%x", &chunkSize) == 1 && chunkSize > 0)
+      if (!__chunkSize(strread.c_str(), &chunkSize))
       {
-        if (!(m_chunkBuffer = new char[chunkSize]))
-          return 0;
+        // a framing error: the connection must not carry another request
+        DBG(DBG_ERROR, "%s: invalid chunk size (%s)\n", __FUNCTION__, strread.c_str());
+        m_keepAlive = false;
+        return 0;
+      }
+      if (chunkSize > 0)
+      {
+        // the buffer is kept for next chunks and grows as needed
+        if (chunkSize > m_chunkBufferSize)
+        {
+          SAFE_DELETE_ARRAY(m_chunkBuffer);
+          m_chunkBufferSize = (chunkSize + RESPONSE_BUFFER_SIZE - 1) & ~(size_t)(RESPONSE_BUFFER_SIZE - 1);
+          m_chunkBuffer = new char[m_chunkBufferSize];
+        }
         m_chunkPtr = m_chunkEOR = m_chunkBuffer;
         m_chunkEnd = m_chunkBuffer + chunkSize;
       }
       else
-        return 0; // that's the end of chunks
+      {
+        // that's the end of chunks: skip the trailer until the empty line
+        bool eol;
+        while ((eol = m_reader->ReadLine("\r\n", strread, &len)) && len > 0);
+        m_chunkEnded = eol;
+        return 0;
+      }
     }
     // fill chunk buffer
     if (m_chunkPtr >= m_chunkEOR)
     {
       // ask for new data to fill in the chunk buffer
       // fill at last read position and until to the end
-      m_chunkEOR += m_socket->ReceiveData(m_chunkEOR, m_chunkEnd - m_chunkEOR);
+      m_chunkEOR += m_reader->ReadData(m_chunkEOR, m_chunkEnd - m_chunkEOR);
     }
-    if ((s = m_chunkEOR - m_chunkPtr) > buflen)
-      s = buflen;
-    memcpy(buf, m_chunkPtr, s);
+    if ((s = m_chunkEOR - m_chunkPtr) > maxlen)
+      s = maxlen;
+    *data = m_chunkPtr;
     m_chunkPtr += s;
     m_consumed += s;
   }
   return s;
 }
 
+size_t WSResponse::ReadChunk(void *buf, size_t buflen)
+{
+  const char *data;
+  size_t s = FetchChunk(&data, buflen);
+  if (s)
+    memcpy(buf, data, s);
+  return s;
+}
+
 int WSResponse::SocketStreamReader(void *hdl, void *buf, int sz)
 {
   WSResponse *resp = static_cast<WSResponse*>(hdl);
@@ -334,12 +399,12 @@ int WSResponse::SocketStreamReader(void *hdl, void *buf, int sz)
     return 0;
   size_t s = 0;
   // let read on unknown length
-  if (!resp->m_contentLength)
-    s = resp->m_socket->ReceiveData(buf, sz);
+  if (!resp->m_contentLengthSet)
+    s = resp->m_reader->ReadData(buf, sz);
   else if (resp->m_contentLength > resp->m_consumed)
   {
     size_t len = resp->m_contentLength - resp->m_consumed;
-    s = resp->m_socket->ReceiveData(buf, len > (size_t)sz ? (size_t)sz : len);
+    s = resp->m_reader->ReadData(buf, len > (size_t)sz ? (size_t)sz : len);
   }
   resp->m_consumed += s;
   return s;
@@ -354,17 +419,19 @@ int WSResponse::ChunkStreamReader(void *hdl, void *buf, int sz)
 size_t WSResponse::ReadContent(char* buf, size_t buflen)
 {
   size_t s = 0;
+  if (m_reader == NULL)
+    return s;
   if (!m_contentChunked)
   {
     if (m_contentEncoding == CE_NONE)
     {
       // let read on unknown length
-      if (!m_contentLength)
-        s = m_socket->ReceiveData(buf, buflen);
+      if (!m_contentLengthSet)
+        s = m_reader->ReadData(buf, buflen);
       else if (m_contentLength > m_consumed)
       {
         size_t len = m_contentLength - m_consumed;
-        s = m_socket->ReceiveData(buf, len > buflen ? buflen : len);
+        s = m_reader->ReadData(buf, len > buflen ? buflen : len);
       }
       m_consumed += s;
     }
@@ -411,6 +478,40 @@ size_t WSResponse::ReadContent(char* buf, size_t buflen)
   return s;
 }
 
+size_t WSResponse::FetchContent(const char **data)
+{
+  *data = NULL;
+  if (m_reader == NULL)
+    return 0;
+  if (m_contentEncoding == CE_NONE)
+  {
+    if (m_contentChunked)
+      return FetchChunk(data, (size_t)(-1));
+    // use the chunk buffer to receive the data
+    if (m_chunkBuffer == NULL)
+    {
+      m_chunkBufferSize = RESPONSE_BUFFER_SIZE;
+      m_chunkBuffer = new char[m_chunkBufferSize];
+    }
+    size_t s = ReadContent(m_chunkBuffer, m_chunkBufferSize);
+    if (s)
+      *data = m_chunkBuffer;
+    return s;
+  }
+  else if (m_contentEncoding == CE_GZIP || m_contentEncoding == CE_DEFLATE)
+  {
+    if (m_decoder == NULL)
+      m_decoder = new Decompressor(m_contentChunked ? &ChunkStreamReader : &SocketStreamReader, this);
+    size_t s = 0;
+    if (m_decoder->HasOutputData())
+      s = m_decoder->FetchOutput(data);
+    if (s == 0 && !m_decoder->IsCompleted())
+      DBG(DBG_ERROR, "%s: decoding failed\n", __FUNCTION__);
+    return s;
+  }
+  return 0;
+}
+
 bool WSResponse::GetHeaderValue(const std::string& header, std::string& value)
 {
   for (HeaderList::const_iterator it = m_headers.begin(); it != m_headers.end(); ++it)
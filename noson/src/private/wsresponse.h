@@ -33,8 +33,8 @@
 namespace NSROOT
 {
 
-  class NetSocket;
   class TcpSocket;
+  class SocketReader;
   class Decompressor;
 
   class WSResponse
@@ -47,16 +47,26 @@ namespace NSROOT
     bool IsChunkedTransfer() const { return m_contentChunked; }
     size_t GetContentLength() const { return m_contentLength; }
     size_t ReadContent(char *buf, size_t buflen);
+    /**
+     * Get the next block of content data without copy into a user buffer.
+     * The data is owned by the response and is valid until the next read.
+     * @param data The pointer to the data block
+     * @return the size of the block, or 0 at end of content
+     */
+    size_t FetchContent(const char **data);
     size_t GetConsumed() const { return m_consumed; }
     int GetStatusCode() const { return m_statusCode; }
     const std::string& Redirection() const { return m_location; }
 
     bool GetHeaderValue(const std::string& header, std::string& value);
 
-    static bool ReadHeaderLine(NetSocket *socket, const char *eol, std::string& line, size_t *len);
-
   private:
     TcpSocket *m_socket;
+    SocketReader *m_reader;
+    std::string m_server;
+    unsigned m_port;
+    bool m_secure;
+    bool m_keepAlive;         ///< The connection could be reused
     bool m_successful;
     int m_statusCode;
     std::string m_serverInfo;
@@ -66,11 +76,14 @@ namespace NSROOT
     CE_t m_contentEncoding;
     bool m_contentChunked;
     size_t m_contentLength;
+    bool m_contentLengthSet;
     size_t m_consumed;
-    char* m_chunkBuffer;      ///< The chunk data buffer
+    char* m_chunkBuffer;      ///< The chunk data buffer, reused for next chunks
+    size_t m_chunkBufferSize; ///< The allocated size of the chunk buffer
     char* m_chunkPtr;         ///< The next position to read data from the chunk
     char* m_chunkEOR;         ///< The end of received data in the chunk
     char* m_chunkEnd;         ///< The end of the chunk buffer
+    bool m_chunkEnded;        ///< The last chunk and trailer have been read
     Decompressor *m_decoder;
 
     typedef std::list<std::pair<std::string, std::string> > HeaderList;
@@ -82,6 +95,8 @@ namespace NSROOT
 
     bool SendRequest(const WSRequest& request);
     bool GetResponse();
+    bool IsCompleted() const;
+    size_t FetchChunk(const char **data, size_t maxlen);
     size_t ReadChunk(void *buf, size_t buflen);
     static int SocketStreamReader(void *hdl, void *buf, int sz);
     static int ChunkStreamReader(void *hdl, void *buf, int sz);
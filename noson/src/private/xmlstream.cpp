@@ -0,0 +1,515 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "xmlstream.h"
+#include "debug.h"
+
+#include <cstring>
+#include <cstdlib>
+
+#define XMLSTREAM_ENTITY_MAXSIZE  10
+#define XMLSTREAM_TEXT_CHUNK      4096  // character data are passed in pieces of this size
+#define XMLSTREAM_DEPTH_RESERVE   16
+#define XMLSTREAM_ATTRS_RESERVE   8
+
+using namespace NSROOT;
+
+static inline bool __isspace(char c)
+{
+  return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+/**
+ * Returns true when the string is a prefix of the literal
+ */
+static inline bool __isprefix(const std::string& str, const char* lit)
+{
+  size_t len = strlen(lit);
+  return (str.size() <= len && memcmp(str.c_str(), lit, str.size()) == 0);
+}
+
+/**
+ * Decode the entity reference without delimiters, i.e "amp" or "#x20".
+ * Returns the count of UTF-8 bytes written in out, else 0 if unknown.
+ */
+static size_t __decodeEntity(const char* ent, size_t len, char* out)
+{
+  switch (len)
+  {
+  case 2:
+    if (memcmp(ent, "lt", 2) == 0) { *out = '<'; return 1; }
+    if (memcmp(ent, "gt", 2) == 0) { *out = '>'; return 1; }
+    break;
+  case 3:
+    if (memcmp(ent, "amp", 3) == 0) { *out = '&'; return 1; }
+    break;
+  case 4:
+    if (memcmp(ent, "quot", 4) == 0) { *out = '"'; return 1; }
+    if (memcmp(ent, "apos", 4) == 0) { *out = '\''; return 1; }
+    break;
+  default:
+    break;
+  }
+  if (len < 2 || ent[0] != '#')
+    return 0;
+  // character reference
+  char num[XMLSTREAM_ENTITY_MAXSIZE + 1];
+  char* end = NULL;
+  unsigned long cp;
+  if (ent[1] == 'x' || ent[1] == 'X')
+  {
+    if (len < 3 || len - 2 > XMLSTREAM_ENTITY_MAXSIZE)
+      return 0;
+    memcpy(num, ent + 2, len - 2);
+    num[len - 2] = '\0';
+    cp = strtoul(num, &end, 16);
+  }
+  else
+  {
+    if (len - 1 > XMLSTREAM_ENTITY_MAXSIZE)
+      return 0;
+    memcpy(num, ent + 1, len - 1);
+    num[len - 1] = '\0';
+    cp = strtoul(num, &end, 10);
+  }
+  if (!end || *end != '\0' || cp == 0)
+    return 0;
+  // encode UTF-8
+  if (cp < 0x80)
+  {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  if (cp < 0x110000)
+  {
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+  }
+  return 0;
+}
+
+/**
+ * Decode entities of the null terminated string in place.
+ * Unknown entities are kept as is.
+ */
+static void __decodeString(char* str)
+{
+  char* w = str;
+  const char* r = str;
+  while (*r)
+  {
+    if (*r == '&')
+    {
+      const char* e = r + 1;
+      while (*e && *e != ';' && e - r <= XMLSTREAM_ENTITY_MAXSIZE)
+        ++e;
+      if (*e == ';')
+      {
+        char out[4];
+        size_t n = __decodeEntity(r + 1, e - r - 1, out);
+        if (n)
+        {
+          memcpy(w, out, n);
+          w += n;
+          r = e + 1;
+          continue;
+        }
+      }
+    }
+    *w++ = *r++;
+  }
+  *w = '\0';
+}
+
+const char* XMLStreamAttributes::Find(const char* name) const
+{
+  for (unsigned i = 0; i < m_names.size(); ++i)
+    if (strcmp(m_names[i], name) == 0)
+      return m_values[i];
+  return NULL;
+}
+
+XMLStreamParser::XMLStreamParser(XMLStreamHandler& handler)
+: m_handler(handler)
+, m_state(STATE_TEXT)
+, m_error(false)
+, m_completed(false)
+, m_quote(0)
+, m_mark(0)
+, m_depth(0)
+{
+  m_stack.reserve(XMLSTREAM_DEPTH_RESERVE);
+  m_attrs.m_names.reserve(XMLSTREAM_ATTRS_RESERVE);
+  m_attrs.m_values.reserve(XMLSTREAM_ATTRS_RESERVE);
+}
+
+bool XMLStreamParser::SetError(const char* msg)
+{
+  DBG(DBG_ERROR, "%s: %s\n", __FUNCTION__, msg);
+  m_error = true;
+  return false;
+}
+
+bool XMLStreamParser::FlushText()
+{
+  if (m_text.empty())
+    return true;
+  // character data out of the root element are ignored
+  bool ret = m_depth == 0 || m_handler.Characters(m_text.data(), m_text.size());
+  m_text.clear();
+  if (!ret)
+    return SetError("aborted by handler");
+  return true;
+}
+
+bool XMLStreamParser::Feed(const char* data, size_t len)
+{
+  if (m_error)
+    return false;
+  const char* p = data;
+  const char* end = data + len;
+  while (p < end)
+  {
+    switch (m_state)
+    {
+    case STATE_TEXT:
+    {
+      while (p < end)
+      {
+        const char* s = p;
+        while (p < end && *p != '<' && *p != '&')
+          ++p;
+        m_text.append(s, p - s);
+        if (p == end)
+          break;
+        if (*p == '&')
+        {
+          // decode at once the entity terminated in this piece
+          const char* e = p + 1;
+          while (e < end && e - p - 1 < XMLSTREAM_ENTITY_MAXSIZE && *e != ';' && *e != '<' && *e != '&')
+            ++e;
+          if (e < end && *e == ';')
+          {
+            char out[4];
+            size_t n = __decodeEntity(p + 1, e - p - 1, out);
+            if (n)
+              m_text.append(out, n);
+            else
+              m_text.append(p, e - p + 1);
+            p = e + 1;
+            continue;
+          }
+          m_state = STATE_ENTITY;
+        }
+        else
+        {
+          if (!FlushText())
+            return false;
+          m_state = STATE_MARKUP;
+        }
+        m_buf.clear();
+        ++p;
+        break;
+      }
+      // do not retain long character data
+      if (m_text.size() >= XMLSTREAM_TEXT_CHUNK && !FlushText())
+        return false;
+      break;
+    }
+    case STATE_ENTITY:
+    {
+      char c = *p;
+      if (c == ';')
+      {
+        char out[4];
+        size_t n = __decodeEntity(m_buf.c_str(), m_buf.size(), out);
+        if (n)
+          m_text.append(out, n);
+        else
+          m_text.append("&").append(m_buf).append(";");
+        m_state = STATE_TEXT;
+        ++p;
+      }
+      else if (c == '<' || c == '&' || m_buf.size() >= XMLSTREAM_ENTITY_MAXSIZE)
+      {
+        // not an entity: keep it as is and process the char as text
+        m_text.append("&").append(m_buf);
+        m_state = STATE_TEXT;
+      }
+      else
+      {
+        m_buf.push_back(c);
+        ++p;
+      }
+      break;
+    }
+    case STATE_MARKUP:
+    {
+      if (*p == '!')
+      {
+        m_state = STATE_BANG;
+        m_buf.assign("!");
+        ++p;
+      }
+      else if (*p == '?')
+      {
+        m_state = STATE_PI;
+        m_mark = 0;
+        ++p;
+      }
+      else
+      {
+        m_state = STATE_TAG;
+        m_quote = 0;
+      }
+      break;
+    }
+    case STATE_BANG:
+    {
+      m_buf.push_back(*p++);
+      if (m_buf.compare("!--") == 0)
+      {
+        m_state = STATE_COMMENT;
+        m_mark = 0;
+      }
+      else if (m_buf.compare("![CDATA[") == 0)
+      {
+        m_state = STATE_CDATA;
+        m_mark = 0;
+      }
+      else if (!__isprefix(m_buf, "!--") && !__isprefix(m_buf, "![CDATA["))
+      {
+        // a declaration, i.e DOCTYPE
+        char c = m_buf[m_buf.size() - 1];
+        m_mark = (c == '[' ? 1 : 0);
+        m_state = (c == '>' ? STATE_TEXT : STATE_DECL);
+      }
+      break;
+    }
+    case STATE_COMMENT:
+    {
+      char c = *p++;
+      if (c == '-')
+        ++m_mark;
+      else
+      {
+        if (c == '>' && m_mark >= 2)
+          m_state = STATE_TEXT;
+        m_mark = 0;
+      }
+      break;
+    }
+    case STATE_CDATA:
+    {
+      while (p < end)
+      {
+        if (m_mark == 0)
+        {
+          const char* q = static_cast<const char*>(memchr(p, ']', end - p));
+          if (q == NULL)
+          {
+            m_text.append(p, end - p);
+            p = end;
+            break;
+          }
+          m_text.append(p, q - p);
+          p = q;
+        }
+        char c = *p++;
+        if (c == ']')
+          ++m_mark;
+        else if (c == '>' && m_mark >= 2)
+        {
+          m_text.append(m_mark - 2, ']');
+          m_mark = 0;
+          m_state = STATE_TEXT;
+          break;
+        }
+        else
+        {
+          m_text.append(m_mark, ']').push_back(c);
+          m_mark = 0;
+        }
+      }
+      break;
+    }
+    case STATE_PI:
+    {
+      char c = *p++;
+      if (c == '>' && m_mark)
+        m_state = STATE_TEXT;
+      m_mark = (c == '?' ? 1 : 0);
+      break;
+    }
+    case STATE_DECL:
+    {
+      char c = *p++;
+      if (c == '[')
+        ++m_mark;
+      else if (c == ']' && m_mark)
+        --m_mark;
+      else if (c == '>' && !m_mark)
+        m_state = STATE_TEXT;
+      break;
+    }
+    case STATE_TAG:
+    {
+      const char* s = p;
+      while (p < end)
+      {
+        char c = *p++;
+        if (m_quote)
+        {
+          if (c == m_quote)
+            m_quote = 0;
+        }
+        else if (c == '"' || c == '\'')
+          m_quote = c;
+        else if (c == '>')
+        {
+          m_buf.append(s, p - s - 1);
+          m_state = STATE_TEXT;
+          if (!ProcessTag())
+            return false;
+          s = p;
+          break;
+        }
+      }
+      if (m_state == STATE_TAG)
+        m_buf.append(s, p - s);
+      break;
+    }
+    }
+  }
+  // do not retain character data
+  return FlushText();
+}
+
+bool XMLStreamParser::Finish()
+{
+  if (m_error)
+    return false;
+  if (!m_completed || m_state != STATE_TEXT)
+    return SetError("unexpected end of document");
+  return true;
+}
+
+bool XMLStreamParser::ProcessTag()
+{
+  size_t e = m_buf.size();
+  // end tag
+  if (e && m_buf[0] == '/')
+  {
+    while (e > 1 && __isspace(m_buf[e - 1]))
+      --e;
+    if (m_depth == 0 || m_stack[m_depth - 1].compare(0, std::string::npos, m_buf, 1, e - 1) != 0)
+      return SetError("mismatched end tag");
+    if (--m_depth == 0)
+      m_completed = true;
+    if (!m_handler.EndElement(m_stack[m_depth].c_str()))
+      return SetError("aborted by handler");
+    return true;
+  }
+  // empty element tag
+  bool empty = false;
+  while (e > 0 && __isspace(m_buf[e - 1]))
+    --e;
+  if (e > 0 && m_buf[e - 1] == '/')
+  {
+    empty = true;
+    --e;
+  }
+  m_buf.push_back('\0');
+  char* b = &m_buf[0];
+  b[e] = '\0';
+  size_t i = 0;
+  while (i < e && !__isspace(b[i]))
+    ++i;
+  if (i == 0)
+    return SetError("invalid tag");
+  b[i++] = '\0';
+
+  // attributes: the buffer is tokenized in place
+  m_attrs.m_names.clear();
+  m_attrs.m_values.clear();
+  for (;;)
+  {
+    while (i < e && __isspace(b[i]))
+      ++i;
+    if (i >= e)
+      break;
+    size_t an = i;
+    while (i < e && b[i] != '=' && !__isspace(b[i]))
+      ++i;
+    size_t ane = i;
+    while (i < e && __isspace(b[i]))
+      ++i;
+    if (i >= e || b[i] != '=')
+      return SetError("invalid attribute");
+    ++i;
+    while (i < e && __isspace(b[i]))
+      ++i;
+    if (i >= e || (b[i] != '"' && b[i] != '\''))
+      return SetError("invalid attribute value");
+    char q = b[i++];
+    size_t vs = i;
+    while (i < e && b[i] != q)
+      ++i;
+    if (i >= e)
+      return SetError("unterminated attribute value");
+    b[ane] = '\0';
+    b[i++] = '\0';
+    __decodeString(b + vs);
+    m_attrs.m_names.push_back(b + an);
+    m_attrs.m_values.push_back(b + vs);
+  }
+
+  // the strings of the stack are reused to save allocations
+  if (m_depth == m_stack.size())
+    m_stack.push_back(std::string());
+  m_stack[m_depth++].assign(b);
+  if (!m_handler.StartElement(b, m_attrs))
+    return SetError("aborted by handler");
+  if (empty)
+  {
+    if (--m_depth == 0)
+      m_completed = true;
+    if (!m_handler.EndElement(m_stack[m_depth].c_str()))
+      return SetError("aborted by handler");
+  }
+  return true;
+}
@@ -0,0 +1,131 @@
+/*
+ *      Copyright (C) 2016 Jean-Luc Barriere
+ *
+ *  This library is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation; either version 3, or (at your option)
+ *  any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 51 Franklin Street, Fifth Floor, Boston,
+ *  MA 02110-1301 USA
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef XMLSTREAM_H
+#define XMLSTREAM_H
+
+#include <local_config.h>
+
+#include <cstddef>  // for size_t
+#include <string>
+#include <vector>
+
+namespace NSROOT
+{
+
+  class XMLStreamAttributes
+  {
+    friend class XMLStreamParser;
+  public:
+    unsigned Count() const { return (unsigned) m_names.size(); }
+    const char* Name(unsigned i) const { return m_names[i]; }
+    const char* Value(unsigned i) const { return m_values[i]; }
+    /**
+     * Returns the value of the named attribute, else NULL.
+     */
+    const char* Find(const char* name) const;
+
+  private:
+    std::vector<const char*> m_names;
+    std::vector<const char*> m_values;
+  };
+
+  /**
+   * Callbacks of the stream parser. Any callback returning false stops the
+   * parsing with an error.
+   */
+  class XMLStreamHandler
+  {
+  public:
+    virtual ~XMLStreamHandler() { }
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs) = 0;
+    virtual bool EndElement(const char* name) = 0;
+    /**
+     * Receive decoded character data of the current element. The content of
+     * one element could be received in many pieces.
+     */
+    virtual bool Characters(const char* text, size_t len) = 0;
+  };
+
+  /**
+   * Incremental SAX parser: the document is fed in pieces as they arrive,
+   * so only the markup being parsed is held in memory.
+   * It handles elements, attributes, character and entity references, CDATA
+   * sections. Comments, processing instructions and declarations are skipped.
+   */
+  class XMLStreamParser
+  {
+  public:
+    XMLStreamParser(XMLStreamHandler& handler);
+    ~XMLStreamParser() { }
+
+    /**
+     * Parse the next piece of the document.
+     * @return false on error
+     */
+    bool Feed(const char* data, size_t len);
+
+    /**
+     * Check the document has been fully parsed without error.
+     */
+    bool Finish();
+
+    bool HasError() const { return m_error; }
+    unsigned Depth() const { return m_depth; }
+
+  private:
+    typedef enum
+    {
+      STATE_TEXT,
+      STATE_ENTITY,
+      STATE_MARKUP,
+      STATE_BANG,
+      STATE_TAG,
+      STATE_COMMENT,
+      STATE_CDATA,
+      STATE_PI,
+      STATE_DECL,
+    } STATE_t;
+
+    XMLStreamHandler& m_handler;
+    STATE_t m_state;
+    bool m_error;
+    bool m_completed;         ///< The root element has been closed
+    char m_quote;             ///< The opening quote of attribute value in tag
+    unsigned m_mark;          ///< Count of terminal chars matched or bracket level
+    std::string m_buf;        ///< The pending markup or entity
+    std::string m_text;       ///< The pending character data
+    std::vector<std::string> m_stack;  ///< Names of open elements, kept for reuse
+    unsigned m_depth;         ///< Count of open elements
+    XMLStreamAttributes m_attrs;
+
+    // prevent copy
+    XMLStreamParser(const XMLStreamParser&);
+    XMLStreamParser& operator=(const XMLStreamParser&);
+
+    bool FlushText();
+    bool ProcessTag();
+    bool SetError(const char* msg);
+  };
+
+}
+
+#endif /* XMLSTREAM_H */
@@ -132,42 +132,35 @@ void RenderingControl::HandleEventMessage(EventMessagePtr msg)
       Locked<RCSProperty>::pointer prop = m_property.Get();
 
       DBG(DBG_DEBUG, "%s: %s SEQ=%s %s\n", __FUNCTION__, msg->subject[0].c_str(), msg->subject[1].c_str(), msg->subject[2].c_str());
-      std::vector<std::string>::const_iterator it = msg->subject.begin();
-      while (it != msg->subject.end())
+      std::vector<EventProperty>::const_iterator it = msg->properties.begin();
+      for (; it != msg->properties.end(); ++it)
       {
         int32_t num;
-        if (*it == "Volume/Master")
+        if (string_to_int32(it->value.c_str(), &num) != 0)
+          continue;
+        switch (it->id)
         {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+          case PROPERTY_Volume_Master:
             prop->VolumeMaster = num;
-        }
-        else if (*it == "Volume/LF")
-        {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+            break;
+          case PROPERTY_Volume_LF:
             prop->VolumeLF = num;
-        }
-        else if (*it == "Volume/RF")
-        {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+            break;
+          case PROPERTY_Volume_RF:
             prop->VolumeRF = num;
-        }
-        else if (*it == "Mute/Master")
-        {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+            break;
+          case PROPERTY_Mute_Master:
             prop->MuteMaster = num;
-        }
-        else if (*it == "Mute/LF")
-        {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+            break;
+          case PROPERTY_Mute_LF:
             prop->MuteLF = num;
-        }
-        else if (*it == "Mute/RF")
-        {
-          if (string_to_int32((*++it).c_str(), &num) == 0)
+            break;
+          case PROPERTY_Mute_RF:
             prop->MuteRF = num;
+            break;
+          default:
+            break;
         }
-
-        ++it;
       }
       // Signal
       ++m_msgCount;
@@ -21,9 +21,9 @@
 #include "service.h"
 #include "private/wsrequest.h"
 #include "private/wsresponse.h"
+#include "private/soapreader.h"
 #include "private/debug.h"
 #include "private/cppdef.h"
-#include "private/tinyxml2.h"
 #include "private/xmldict.h"
 #include "private/os/threads/mutex.h"
 #include "sonosplayer.h"
@@ -57,7 +57,13 @@ ElementList Service::GetLastFault()
 ElementList Service::Request(const std::string& action, const ElementList& args)
 {
   ElementList vars;
+  SOAPReader reader(vars);
+  Request(action, args, reader);
+  return vars;
+}
 
+bool Service::Request(const std::string& action, const ElementList& args, SOAPReader& reader)
+{
   std::string soapaction;
   soapaction.append("\"" NS_PREFIX).append(GetName()).append(NS_SUFFIX "#").append(action).append("\"");
 
@@ -78,6 +84,7 @@ ElementList Service::Request(const std::string& action, const ElementList& args)
 
   WSRequest request(m_host, m_port);
   request.RequestService(GetControlURL(), HRM_POST);
+  request.SetKeepAlive(true);
   request.SetHeader("SOAPAction", soapaction);
   request.SetContentCustom(CT_XML, content.c_str());
   WSResponse response(request);
@@ -85,84 +92,15 @@ ElementList Service::Request(const std::string& action, const ElementList& args)
   if (!response.IsSuccessful())
   {
     DBG(DBG_ERROR, "%s: invalid response\n", __FUNCTION__);
-    return vars;
-  }
-
-  // Receive content data
-  size_t len = 0, l = 0;
-  std::string data;
-  char buffer[4096];
-  while ((l = response.ReadContent(buffer, sizeof(buffer))))
-  {
-    data.append(buffer, l);
-    len += l;
+    return false;
   }
 
-  // Parse xml content
-  tinyxml2::XMLDocument rootdoc;
-  if (rootdoc.Parse(data.c_str(), len) != tinyxml2::XML_SUCCESS)
-  {
-    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
-    return vars;
-  }
-  const tinyxml2::XMLElement* elem; // an element
-  // Check for response: Envelope/Body/{respTag}
-  if (!(elem = rootdoc.RootElement()) || !XMLNS::NameEqual(elem->Name(), "Envelope") ||
-          !(elem = elem->FirstChildElement()) || !XMLNS::NameEqual(elem->Name(), "Body") ||
-          !(elem = elem->FirstChildElement()))
-  {
-    DBG(DBG_ERROR, "%s: invalid or not supported response\n", __FUNCTION__);
-    tinyxml2::XMLPrinter out;
-    rootdoc.Accept(&out);
-    DBG(DBG_ERROR, "%s\n", out.CStr());
-    return vars;
-  }
-  vars.push_back(ElementPtr(new Element("TAG", XMLNS::LocalName(elem->Name()))));
-  if (vars.back()->compare("Fault") == 0)
-  {
-    const tinyxml2::XMLElement* felem = elem->FirstChildElement(NULL);
-    while (felem)
-    {
-      if (XMLNS::NameEqual(felem->Name(), "faultcode") && felem->GetText())
-        vars.push_back(ElementPtr(new Element("faultcode", felem->GetText())));
-      else if (XMLNS::NameEqual(felem->Name(), "faultstring") && felem->GetText())
-        vars.push_back(ElementPtr(new Element("faultstring", felem->GetText())));
-      else if (XMLNS::NameEqual(felem->Name(), "detail"))
-      {
-        const tinyxml2::XMLElement* delem = felem->FirstChildElement(NULL);
-        if (delem && (delem = delem->FirstChildElement(NULL)))
-        {
-          do
-          {
-            if (delem->GetText())
-            {
-              // remove the namespace qualifier to handle local name as key
-              vars.push_back(ElementPtr(new Element(XMLNS::LocalName(delem->Name()), delem->GetText())));
-              DBG(DBG_PROTO, "%s: [fault] %s = %s\n", __FUNCTION__, vars.back()->GetKey().c_str(), vars.back()->c_str());
-            }
-            delem = delem->NextSiblingElement(NULL);
-          } while (delem);
-        }
-      }
-      felem = felem->NextSiblingElement(NULL);
-    }
-    SetFault(vars);
-  }
-  else
-  {
-    elem = elem->FirstChildElement(NULL);
-    while (elem)
-    {
-      if (elem->GetText())
-      {
-        // remove the namespace qualifier to handle local name as key
-        vars.push_back(ElementPtr(new Element(XMLNS::LocalName(elem->Name()), elem->GetText())));
-        DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, vars.back()->GetKey().c_str(), vars.back()->c_str());
-      }
-      elem = elem->NextSiblingElement(NULL);
-    }
-  }
-  return vars;
+  // Parse the content while it is received
+  if (!reader.Parse(response))
+    return false;
+  if (reader.IsFault())
+    SetFault(reader.GetVars());
+  return true;
 }
 
 void Service::SetFault(const ElementList& vars)
@@ -34,6 +34,8 @@ namespace NSROOT
     class CMutex;
   }
 
+  class SOAPReader;
+
   class Service
   {
   public:
@@ -60,6 +62,12 @@ namespace NSROOT
 
     ElementList Request(const std::string& action, const ElementList& args);
 
+    /**
+     * Send the request, then decode the response with the given reader.
+     * @return false if no response has been decoded; a fault is decoded too
+     */
+    bool Request(const std::string& action, const ElementList& args, SOAPReader& reader);
+
   private:
     OS::CMutex* m_mutex;
     ElementList m_fault;
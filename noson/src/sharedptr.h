@@ -26,15 +26,103 @@
 #include "intrinsic.h"
 
 #include <cstddef>  // for NULL
+#if __cplusplus >= 201103L
+#include <utility>  // for std::forward
+#endif
 
 #define SHARED_PTR NSROOT::shared_ptr
+#define MAKE_SHARED NSROOT::make_shared
 
 namespace NSROOT
 {
 
+  /**
+   * The control block of a shared object: the counter of references, and
+   * the disposal of the object and the block when the last is released.
+   */
+  class shared_count
+  {
+  public:
+    shared_count() : m_counter(1) { }
+    virtual ~shared_count() { }
+
+    int GetValue() { return m_counter.GetValue(); }
+
+    int Increment() { return m_counter.Increment(); }
+
+    int Decrement() { return m_counter.Decrement(); }
+
+    virtual void dispose() = 0;
+
+  private:
+    IntrinsicCounter m_counter;
+
+    // prevent copy
+    shared_count(const shared_count&);
+    shared_count& operator=(const shared_count&);
+  };
+
+  /**
+   * The block of an object allocated apart.
+   */
+  template<class T>
+  class shared_count_ptr : public shared_count
+  {
+  public:
+    explicit shared_count_ptr(T* p) : m_p(p) { }
+
+    void dispose()
+    {
+      delete m_p;
+      delete this;
+    }
+
+  private:
+    T* m_p;
+  };
+
+  template<class T> class shared_ptr;
+
+  /**
+   * The block holding the object itself, so both are allocated once.
+   */
+  template<class T>
+  class shared_count_inplace : public shared_count
+  {
+  public:
+#if __cplusplus >= 201103L
+    template<class... A>
+    explicit shared_count_inplace(A&&... a) : m_obj(std::forward<A>(a)...) { }
+#else
+    shared_count_inplace() : m_obj() { }
+    template<class A1>
+    explicit shared_count_inplace(const A1& a1) : m_obj(a1) { }
+    template<class A1, class A2>
+    shared_count_inplace(const A1& a1, const A2& a2) : m_obj(a1, a2) { }
+    template<class A1, class A2, class A3>
+    shared_count_inplace(const A1& a1, const A2& a2, const A3& a3) : m_obj(a1, a2, a3) { }
+    template<class A1, class A2, class A3, class A4>
+    shared_count_inplace(const A1& a1, const A2& a2, const A3& a3, const A4& a4) : m_obj(a1, a2, a3, a4) { }
+    template<class A1, class A2, class A3, class A4, class A5>
+    shared_count_inplace(const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5) : m_obj(a1, a2, a3, a4, a5) { }
+#endif
+
+    void dispose()
+    {
+      delete this;
+    }
+
+    shared_ptr<T> share();
+
+  private:
+    T m_obj;
+  };
+
   template<class T>
   class shared_ptr
   {
+    template<class U> friend class shared_count_inplace;
+
   public:
 
     shared_ptr() : p(NULL), c(NULL) { }
@@ -43,7 +131,7 @@ namespace NSROOT
     {
       if (p != NULL)
       {
-        c = new IntrinsicCounter(1);
+        c = new shared_count_ptr<T>(p);
       }
     }
 
@@ -57,6 +145,14 @@ namespace NSROOT
         }
     }
 
+#if __cplusplus >= 201103L
+    shared_ptr(shared_ptr&& s) : p(s.p), c(s.c)
+    {
+      s.p = NULL;
+      s.c = NULL;
+    }
+#endif
+
     shared_ptr& operator=(const shared_ptr& s)
     {
       if (this != &s)
@@ -92,10 +188,7 @@ namespace NSROOT
     {
       if (c != NULL)
         if (c->Decrement() == 0)
-        {
-            delete p;
-            delete c;
-        }
+          c->dispose();
       c = NULL;
       p = NULL;
     }
@@ -108,7 +201,7 @@ namespace NSROOT
         if (s != NULL)
         {
           p = s;
-          c = new IntrinsicCounter(1);
+          c = new shared_count_ptr<T>(s);
         }
       }
     }
@@ -121,7 +214,7 @@ namespace NSROOT
     void swap(shared_ptr<T>& s)
     {
       T *tmp_p = p;
-      IntrinsicCounter *tmp_c = c;
+      shared_count *tmp_c = c;
       p = s.p;
       c = s.c;
       s.p = tmp_p;
@@ -155,9 +248,66 @@ namespace NSROOT
 
   protected:
     T *p;
-    IntrinsicCounter *c;
+    shared_count *c;
+
+  private:
+    // take the first reference of a block
+    shared_ptr(T* s, shared_count* sc) : p(s), c(sc) { }
   };
 
+  template<class T>
+  shared_ptr<T> shared_count_inplace<T>::share()
+  {
+    return shared_ptr<T>(&m_obj, this);
+  }
+
+  /**
+   * Create a shared object, allocated with its control block.
+   */
+#if __cplusplus >= 201103L
+  template<class T, class... A>
+  shared_ptr<T> make_shared(A&&... a)
+  {
+    return (new shared_count_inplace<T>(std::forward<A>(a)...))->share();
+  }
+#else
+  template<class T>
+  shared_ptr<T> make_shared()
+  {
+    return (new shared_count_inplace<T>())->share();
+  }
+
+  template<class T, class A1>
+  shared_ptr<T> make_shared(const A1& a1)
+  {
+    return (new shared_count_inplace<T>(a1))->share();
+  }
+
+  template<class T, class A1, class A2>
+  shared_ptr<T> make_shared(const A1& a1, const A2& a2)
+  {
+    return (new shared_count_inplace<T>(a1, a2))->share();
+  }
+
+  template<class T, class A1, class A2, class A3>
+  shared_ptr<T> make_shared(const A1& a1, const A2& a2, const A3& a3)
+  {
+    return (new shared_count_inplace<T>(a1, a2, a3))->share();
+  }
+
+  template<class T, class A1, class A2, class A3, class A4>
+  shared_ptr<T> make_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+  {
+    return (new shared_count_inplace<T>(a1, a2, a3, a4))->share();
+  }
+
+  template<class T, class A1, class A2, class A3, class A4, class A5>
+  shared_ptr<T> make_shared(const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5)
+  {
+    return (new shared_count_inplace<T>(a1, a2, a3, a4, a5))->share();
+  }
+#endif
+
 }
 
 #endif	/* SHAREDPTR_H */
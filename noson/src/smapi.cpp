@@ -25,6 +25,8 @@
 #include "private/tinyxml2.h"
 #include "private/xmldict.h"
 #include "private/wsresponse.h"
+#include "private/soapreader.h"
+#include "private/xmlstream.h"
 #include "private/builtin.h"
 #include "private/cppdef.h"
 #include "private/urlencoder.h"
@@ -54,6 +56,139 @@ namespace NSROOT
     doc.Accept(&out);
     DBG(DBG_ERROR, "%s\n", out.CStr());
   }
+
+  /**
+   * Streaming handler filling the presentation map:
+   * Presentation/PresentationMap[type]/Match/{SearchCategories|browseIconSizeMap}/{entry}
+   */
+  class PresentationMapReader : public XMLStreamHandler
+  {
+  public:
+    typedef std::list<std::pair<ElementPtr, ElementList> > PresentationList;
+
+    PresentationMapReader(PresentationList& presentation, ElementList& searchCategories)
+    : m_presentation(presentation), m_searchCategories(searchCategories)
+    , m_depth(0), m_valid(false), m_type(TypeNone), m_match(0), m_active(false), m_sizeMap(false), m_uid(0) { }
+
+    bool IsValid() const { return m_valid; }
+
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs)
+    {
+      switch (++m_depth)
+      {
+      case 1:
+        // Check for response: Presentation
+        return (m_valid = XMLNS::NameEqual(name, "Presentation"));
+      case 2:
+        m_type = TypeNone;
+        m_match = 0;
+        m_uid = 0; // the item ids are unique by map
+        if (strcmp(name, "PresentationMap") == 0)
+        {
+          const char* type = attrs.Find("type");
+          if (type && strncmp(type, "Search", 6) == 0)
+            m_type = TypeSearch;
+          else if (type && strncmp(type, "BrowseIconSizeMap", 17) == 0)
+            m_type = TypeBrowseIconSizeMap;
+        }
+        break;
+      case 3:
+        // only the first match is processed
+        if (strcmp(name, "Match") == 0)
+          ++m_match;
+        m_sizeMap = false;
+        break;
+      case 4:
+        m_active = false;
+        if (m_match != 1)
+          break;
+        if (m_type == TypeSearch && strcmp(name, "SearchCategories") == 0)
+        {
+          ElementPtr search(new Element("Search"));
+          // set attribute StringId if any
+          const char* stringId = attrs.Find("stringId");
+          if (stringId)
+            search->SetAttribut("stringId", stringId);
+          m_presentation.push_back(std::make_pair(search, ElementList()));
+          m_active = true;
+        }
+        else if (m_type == TypeBrowseIconSizeMap && strcmp(name, "browseIconSizeMap") == 0 && !m_sizeMap)
+        {
+          m_presentation.push_back(std::make_pair(ElementPtr(new Element(name)), ElementList()));
+          m_active = m_sizeMap = true;
+        }
+        break;
+      case 5:
+        if (m_active)
+        {
+          char sid[10];
+          if (m_type == TypeSearch)
+          {
+            // could be Category or CustomCategory
+            const char* id = attrs.Find("id");
+            const char* mappedId = attrs.Find("mappedId");
+            if (!id || !mappedId)
+            {
+              m_active = false;
+              break;
+            }
+            uint32_to_string(++m_uid, sid);
+            ElementPtr item(new Element(name, sid));
+            item->SetAttribut("id", id);
+            item->SetAttribut("mappedId", mappedId);
+            m_presentation.back().second.push_back(item);
+            // also fill list of search categories
+            m_searchCategories.push_back(ElementPtr(new Element(id, mappedId)));
+          }
+          else if (strcmp(name, "sizeEntry") == 0)
+          {
+            const char* size = attrs.Find("size");
+            const char* substitution = attrs.Find("substitution");
+            if (!size || !substitution)
+            {
+              m_active = false;
+              break;
+            }
+            uint32_to_string(++m_uid, sid);
+            ElementPtr item(new Element(name, sid));
+            item->SetAttribut("size", size);
+            item->SetAttribut("substitution", substitution);
+            m_presentation.back().second.push_back(item);
+          }
+        }
+        break;
+      default:
+        break;
+      }
+      return true;
+    }
+
+    virtual bool EndElement(const char* name)
+    {
+      (void)name;
+      --m_depth;
+      return true;
+    }
+
+    virtual bool Characters(const char* text, size_t len)
+    {
+      (void)text;
+      (void)len;
+      return true;
+    }
+
+  private:
+    enum { TypeNone, TypeSearch, TypeBrowseIconSizeMap };
+    PresentationList& m_presentation;
+    ElementList& m_searchCategories;
+    unsigned m_depth;
+    bool m_valid;
+    int m_type;
+    unsigned m_match;
+    bool m_active;
+    bool m_sizeMap;
+    unsigned m_uid;
+  };
 }
 
 SMAPI::SMAPI(const PlayerPtr& player)
@@ -120,16 +255,7 @@ bool SMAPI::Init(const SMServicePtr& smsvc, const std::string& locale)
       DBG(DBG_ERROR, "%s: invalid response\n", __FUNCTION__);
       return false;
     }
-    // receive content data
-    size_t len = 0, l = 0;
-    std::string data;
-    char buffer[4096];
-    while ((l = response.ReadContent(buffer, sizeof(buffer))))
-    {
-      data.append(buffer, l);
-      len += l;
-    }
-    if (!parsePresentationMap(data))
+    if (!parsePresentationMap(response))
       return false;
   }
 
@@ -426,95 +552,25 @@ bool SMAPI::GetDeviceAuthToken(SMOAKeyring::Data& auth)
   return false;
 }
 
-bool SMAPI::parsePresentationMap(const std::string& xml)
+bool SMAPI::parsePresentationMap(WSResponse& response)
 {
-  tinyxml2::XMLDocument rootdoc;
-  // Parse xml content
-  if (rootdoc.Parse(xml.c_str(), xml.size()) != tinyxml2::XML_SUCCESS)
-  {
-    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
-    return false;
-  }
-  tinyxml2::XMLElement* elem; // an element
-  // Check for response: Presentation
-  if (!(elem = rootdoc.RootElement()) || !XMLNS::NameEqual(elem->Name(), "Presentation"))
+  m_presentation.clear();
+  m_searchCategories.clear();
+  // Parse xml content while it is received
+  PresentationMapReader handler(m_presentation, m_searchCategories);
+  XMLStreamParser parser(handler);
+  const char* data;
+  size_t len;
+  while ((len = response.FetchContent(&data)) && parser.Feed(data, len));
+  if (!handler.IsValid())
   {
     DBG(DBG_ERROR, "%s: invalid or not supported content\n", __FUNCTION__);
-    tinyxml2::XMLPrinter out;
-    rootdoc.Accept(&out);
-    DBG(DBG_ERROR, "%s\n", out.CStr());
     return false;
   }
-  m_presentation.clear();
-  m_searchCategories.clear();
-  elem = elem->FirstChildElement("PresentationMap");
-  while (elem)
+  if (!parser.Finish())
   {
-    unsigned uid = 0; // unique item id
-    char sid[10];
-    memset(sid, '\0', sizeof(sid));
-    tinyxml2::XMLElement* child; // a child of elem
-    const char* type = elem->Attribute("type");
-    if (type)
-    {
-      if (strncmp(type, "DisplayType", 11) == 0)
-      {
-      }
-      else if (strncmp(type, "Search", 6) == 0 && (child = elem->FirstChildElement("Match")))
-      {
-        child = child->FirstChildElement("SearchCategories");
-        while (child)
-        {
-          ElementPtr search(new Element("Search"));
-          // set attribute StringId if any
-          const char* stringId = child->Attribute("stringId");
-          if (stringId)
-            search->SetAttribut("stringId", stringId);
-          // build the list of category for this search categories
-          ElementList list;
-          tinyxml2::XMLElement* categ = child->FirstChildElement();
-          while (categ && categ->Attribute("id") && categ->Attribute("mappedId"))
-          {
-            // could be Category or CustomCategory
-            uint32_to_string(++uid, sid);
-            ElementPtr item(new Element(categ->Name(), sid));
-            item->SetAttribut("id", categ->Attribute("id"));
-            item->SetAttribut("mappedId", categ->Attribute("mappedId"));
-            list.push_back(item);
-            // also fill list of search categories
-            m_searchCategories.push_back(ElementPtr(new Element(categ->Attribute("id"), categ->Attribute("mappedId"))));
-            categ = categ->NextSiblingElement(NULL);
-          }
-          m_presentation.push_back(std::make_pair(search, list));
-          child = child->NextSiblingElement(NULL);
-        }
-      }
-      else if (strncmp(type, "BrowseIconSizeMap", 17) == 0 && (child = elem->FirstChildElement("Match")))
-      {
-        child = child->FirstChildElement("browseIconSizeMap");
-        if (child)
-        {
-          ElementPtr name(new Element(child->Name()));
-          // build the list of size entry
-          ElementList list;
-          tinyxml2::XMLElement* entry = child->FirstChildElement("sizeEntry");
-          while (entry && entry->Attribute("size") && entry->Attribute("substitution"))
-          {
-            uint32_to_string(++uid, sid);
-            ElementPtr item(new Element(entry->Name(), sid));
-            item->SetAttribut("size", entry->Attribute("size"));
-            item->SetAttribut("substitution", entry->Attribute("substitution"));
-            list.push_back(item);
-            entry = entry->NextSiblingElement(NULL);
-          }
-          m_presentation.push_back(std::make_pair(name, list));
-        }
-      }
-      else if (strncmp(type, "NowPlayingRatings", 17) == 0)
-      {
-      }
-    }
-    elem = elem->NextSiblingElement(NULL);
+    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
+    return false;
   }
   // Storage for presentation:
   // Element: key=Search, attr={stringId}
@@ -590,6 +646,7 @@ ElementList SMAPI::DoCall(const std::string& action, const ElementList& args)
   content.append("</s:Envelope>");
 
   WSRequest request(*m_uri, HRM_POST);
+  request.SetKeepAlive(true);
   request.SetUserAgent(m_service->GetAgent());
   if (!m_locale.empty())
     request.SetHeader("Accept-Language", std::string(m_locale).append(", en-US;q=0.9"));
@@ -600,92 +657,10 @@ ElementList SMAPI::DoCall(const std::string& action, const ElementList& args)
   // don't check response status code
   // service will return 500 on soap fault
 
-  // Receive content data
-  size_t len = 0, l = 0;
-  std::string data;
-  char buffer[4096];
-  while ((l = response.ReadContent(buffer, sizeof(buffer))))
-  {
-    data.append(buffer, l);
-    len += l;
-  }
-
-  // Parse xml content
-  tinyxml2::XMLDocument rootdoc;
-  if (rootdoc.Parse(data.c_str(), len) != tinyxml2::XML_SUCCESS)
-  {
-    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
-    return vars;
-  }
-  const tinyxml2::XMLElement* elem; // an element
-  // Check for response: Envelope/Body/{respTag}
-
-  if (!(elem = rootdoc.RootElement()) || !XMLNS::NameEqual(elem->Name(), "Envelope"))
-  {
-    __dumpInvalidResponse(rootdoc);
-    return vars;
-  }
-  // learn declared namespaces in the element Envelope for translations
-  XMLNames xmlnames;
-  xmlnames.AddXMLNS(elem);
-
-  if (!(elem = elem->FirstChildElement()) || !XMLNS::NameEqual(elem->Name(), "Body") ||
-          !(elem = elem->FirstChildElement()))
-  {
-    __dumpInvalidResponse(rootdoc);
-    return vars;
-  }
-  vars.push_back(ElementPtr(new Element("TAG", XMLNS::LocalName(elem->Name()))));
-  if (vars.back()->compare("Fault") == 0)
-  {
-    const tinyxml2::XMLElement* felem = elem->FirstChildElement(NULL);
-    while (felem)
-    {
-      if (XMLNS::NameEqual(felem->Name(), "faultcode") && felem->GetText())
-        vars.push_back(ElementPtr(new Element("faultcode", felem->GetText())));
-      else if (XMLNS::NameEqual(felem->Name(), "faultstring") && felem->GetText())
-        vars.push_back(ElementPtr(new Element("faultstring", felem->GetText())));
-      else if (XMLNS::NameEqual(felem->Name(), "detail"))
-      {
-        const tinyxml2::XMLElement* delem = felem->FirstChildElement(NULL);
-        if (delem && (delem = delem->FirstChildElement(NULL)))
-        {
-          do
-          {
-            if (delem->GetText())
-            {
-              // remove the namespace qualifier to handle local name as key
-              vars.push_back(ElementPtr(new Element(XMLNS::LocalName(delem->Name()), delem->GetText())));
-              DBG(DBG_PROTO, "%s: [fault] %s = %s\n", __FUNCTION__, vars.back()->GetKey().c_str(), vars.back()->c_str());
-            }
-            delem = delem->NextSiblingElement(NULL);
-          } while (delem);
-        }
-      }
-      felem = felem->NextSiblingElement(NULL);
-    }
+  // Parse the content while it is received
+  SOAPReader reader(vars, &SMAPIDict);
+  if (reader.Parse(response) && reader.IsFault())
     SetFault(vars);
-  }
-  else
-  {
-    elem = elem->FirstChildElement(NULL);
-    while (elem)
-    {
-      if (elem->GetText())
-      {
-        vars.push_back(ElementPtr(new Element(SMAPIDict.TranslateQName(xmlnames, elem->Name()), elem->GetText())));
-        DBG(DBG_PROTO, "%s: %s = %s\n", __FUNCTION__, vars.back()->GetKey().c_str(), vars.back()->c_str());
-      }
-      else if (!elem->NoChildren())
-      {
-        tinyxml2::XMLPrinter out;
-        elem->Accept(&out);
-        vars.push_back(ElementPtr(new Element(SMAPIDict.TranslateQName(xmlnames, elem->Name()), out.CStr())));
-        DBG(DBG_PROTO, "%s: dump (%s)\n%s\n", __FUNCTION__, vars.back()->GetKey().c_str(), vars.back()->c_str());
-      }
-      elem = elem->NextSiblingElement(NULL);
-    }
-  }
   return vars;
 }
 
@@ -40,6 +40,7 @@ namespace NSROOT
   };
 
   class URIParser;
+  class WSResponse;
   
   class SMAPI
   {
@@ -141,7 +142,7 @@ namespace NSROOT
     std::string m_authLinkCode;
     std::string m_authLinkDeviceId;
 
-    bool parsePresentationMap(const std::string& xml);
+    bool parsePresentationMap(WSResponse& response);
 
     bool makeSoapHeader();
 
@@ -81,93 +81,93 @@ SMAPIItemList SMAPIMetadata::GetItems()
     if (mediaType == "track")
     {
       itemType = track;
-      data.item.reset(new DigitalItem(DigitalItem::Type_item, DigitalItem::SubType_audioItem));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_item, DigitalItem::SubType_audioItem);
     }
     else if (mediaType == "stream")
     {
       itemType = stream;
-      data.item.reset(new DigitalItem(DigitalItem::Type_item, DigitalItem::SubType_audioItem));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_item, DigitalItem::SubType_audioItem);
     }
     else if (mediaType == "program")
     {
       itemType = program;
-      data.item.reset(new DigitalItem(DigitalItem::Type_item, DigitalItem::SubType_audioItem));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_item, DigitalItem::SubType_audioItem);
     }
     else if (mediaType == "show")
     {
       itemType = show;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "album")
     {
       itemType = album;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_album));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_album);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "albumList")
     {
       itemType = albumList;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_storageFolder));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_storageFolder);
       data.displayType = SMAPIItem::Grid;
     }
     else if (mediaType == "artist")
     {
       itemType = artist;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_person));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_person);
     }
     else if (mediaType == "artistTrackList")
     {
       itemType = artistTrackList;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "genre")
     {
       itemType = genre;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_genre));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_genre);
     }
     else if (mediaType == "playlist")
     {
       itemType = playlist;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "streamList")
     {
       itemType = streamList;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "trackList")
     {
       itemType = trackList;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_playlistContainer);
       data.displayType = SMAPIItem::List;
     }
     else if (mediaType == "container")
     {
       itemType = container;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_storageFolder));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_storageFolder);
     }
     else if (mediaType == "collection")
     {
       itemType = collection;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_storageFolder));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_storageFolder);
     }
     else if (mediaType == "favorites")
     {
       itemType = favorites;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_storageFolder));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_storageFolder);
     }
     else if (mediaType == "search")
     {
       itemType = search;
-      data.item.reset(new DigitalItem(DigitalItem::Type_container, DigitalItem::SubType_storageFolder));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_container, DigitalItem::SubType_storageFolder);
     }
     else
       // no browsable
-      data.item.reset(new DigitalItem(DigitalItem::Type_item, DigitalItem::SubType_unknown));
+      data.item = MAKE_SHARED<DigitalItem>(DigitalItem::Type_item, DigitalItem::SubType_unknown);
 
     switch (data.item->subType())
     {
@@ -443,7 +443,7 @@ ElementPtr SMAPIMetadata::ParseMediaCollection(const void* _elem)
   const tinyxml2::XMLElement* elem = static_cast<const tinyxml2::XMLElement*>(_elem);
   if (!elem)
     return ptr;
-  ptr.reset(new Element("mediaCollection"));
+  ptr = MAKE_SHARED<Element>("mediaCollection");
   const tinyxml2::XMLElement* felem = elem->FirstChildElement(NULL);
   while (felem)
   {
@@ -492,7 +492,7 @@ ElementPtr SMAPIMetadata::ParseMediaMetadata(const void* _elem)
   const tinyxml2::XMLElement* elem = static_cast<const tinyxml2::XMLElement*>(_elem);
   if (!elem)
     return ptr;
-  ptr.reset(new Element("mediaMetadata"));
+  ptr = MAKE_SHARED<Element>("mediaMetadata");
   const tinyxml2::XMLElement* felem = elem->FirstChildElement(NULL);
   while (felem)
   {
@@ -28,6 +28,7 @@
 #include "private/debug.h"
 #include "private/uriparser.h"
 #include "private/tokenizer.h"
+#include "private/os/threads/threadpool.h"
 #include "didlparser.h"
 #include "sonossystem.h"
 #include "smapimetadata.h"
@@ -48,28 +49,32 @@ Player::Player(const ZonePtr& zone, EventHandler& eventHandler, void* CBHandle,
 , m_deviceProperties(0)
 , m_contentDirectory(0)
 , m_musicServices(0)
+, m_indexState(IndexState())
+, m_indexer(0)
+, m_indexAbort(false)
 {
-  if (!zone)
-    DBG(DBG_ERROR, "%s: invalid zone\n", __FUNCTION__);
-  else
-  {
-    ZonePlayerPtr cinfo = zone->GetCoordinator();
-    if (cinfo)
-    {
-      if (cinfo->IsValid())
-      {
-        DBG(DBG_DEBUG, "%s: initialize player '%s' as coordinator (%s:%u)\n", __FUNCTION__, cinfo->c_str(), cinfo->GetHost().c_str(), cinfo->GetPort());
-        m_uuid = cinfo->GetUUID();
-        m_host = cinfo->GetHost();
-        m_port = cinfo->GetPort();
-        Init(*zone);
-      }
-      else
-        DBG(DBG_ERROR, "%s: invalid coordinator for zone '%s' (%s)\n", __FUNCTION__, zone->GetZoneName().c_str(), cinfo->GetLocation().c_str());
-    }
-    else
-      DBG(DBG_ERROR, "%s: zone '%s' hasn't any coordinator\n", __FUNCTION__, zone->GetZoneName().c_str());
-  }
+  Init(zone, 0);
+}
+
+Player::Player(const ZonePtr& zone, EventHandler& eventHandler, const SMServiceList& services, void* CBHandle, EventCB eventCB)
+: m_valid(false)
+, m_uuid()
+, m_host()
+, m_port(0)
+, m_eventHandler(eventHandler)
+, m_CBHandle(CBHandle)
+, m_eventCB(eventCB)
+, m_eventSignaled(false)
+, m_eventMask(0)
+, m_AVTransport(0)
+, m_deviceProperties(0)
+, m_contentDirectory(0)
+, m_musicServices(0)
+, m_indexState(IndexState())
+, m_indexer(0)
+, m_indexAbort(false)
+{
+  Init(zone, &services);
 }
 
 Player::Player(const ZonePlayerPtr& zonePlayer, EventHandler& eventHandler, void* CBHandle, EventCB eventCB)
@@ -86,6 +91,9 @@ Player::Player(const ZonePlayerPtr& zonePlayer, EventHandler& eventHandler, void
 , m_deviceProperties(0)
 , m_contentDirectory(0)
 , m_musicServices(0)
+, m_indexState(IndexState())
+, m_indexer(0)
+, m_indexAbort(false)
 {
   if (zonePlayer && zonePlayer->IsValid())
   {
@@ -115,6 +123,9 @@ Player::Player(const ZonePlayerPtr& zonePlayer)
 , m_deviceProperties(0)
 , m_contentDirectory(0)
 , m_musicServices(0)
+, m_indexState(IndexState())
+, m_indexer(0)
+, m_indexAbort(false)
 {
   if (zonePlayer && zonePlayer->IsValid())
   {
@@ -147,6 +158,9 @@ Player::Player(const ZonePlayerPtr& zonePlayer)
 Player::~Player()
 {
   m_eventHandler.RevokeAllSubscriptions(this);
+  // stop the indexing before the services
+  m_indexAbort = true;
+  SAFE_DELETE(m_indexer);
   SAFE_DELETE(m_musicServices);
   SAFE_DELETE(m_contentDirectory);
   SAFE_DELETE(m_deviceProperties);
@@ -163,7 +177,32 @@ void Player::SubordinateRC::FillSRProperty(SRProperty& srp) const
     srp.property = *(renderingControl->GetRenderingProperty().Get());
 }
 
-void Player::Init(const Zone& zone)
+void Player::Init(const ZonePtr& zone, const SMServiceList* services)
+{
+  if (!zone)
+    DBG(DBG_ERROR, "%s: invalid zone\n", __FUNCTION__);
+  else
+  {
+    ZonePlayerPtr cinfo = zone->GetCoordinator();
+    if (cinfo)
+    {
+      if (cinfo->IsValid())
+      {
+        DBG(DBG_DEBUG, "%s: initialize player '%s' as coordinator (%s:%u)\n", __FUNCTION__, cinfo->c_str(), cinfo->GetHost().c_str(), cinfo->GetPort());
+        m_uuid = cinfo->GetUUID();
+        m_host = cinfo->GetHost();
+        m_port = cinfo->GetPort();
+        Init(*zone, services);
+      }
+      else
+        DBG(DBG_ERROR, "%s: invalid coordinator for zone '%s' (%s)\n", __FUNCTION__, zone->GetZoneName().c_str(), cinfo->GetLocation().c_str());
+    }
+    else
+      DBG(DBG_ERROR, "%s: zone '%s' hasn't any coordinator\n", __FUNCTION__, zone->GetZoneName().c_str());
+  }
+}
+
+void Player::Init(const Zone& zone, const SMServiceList* services)
 {
   unsigned subId = m_eventHandler.CreateSubscription(this);
   m_eventHandler.SubscribeForEvent(subId, EVENT_HANDLER_STATUS);
@@ -192,7 +231,10 @@ void Player::Init(const Zone& zone)
   m_musicServices = new MusicServices(m_host, m_port);
 
   // fill available music services
-  m_smservices = m_musicServices->GetAvailableServices();
+  if (services)
+    m_smservices = *services;
+  else
+    m_smservices = m_musicServices->GetAvailableServices();
 
   for (RCTable::iterator it = m_RCTable.begin(); it != m_RCTable.end(); ++it)
     it->subscription.Start();
@@ -224,6 +266,7 @@ void Player::CB_RenderingControl(void* handle)
 void Player::CB_ContentDirectory(void* handle)
 {
   Player* _handle = static_cast<Player*>(handle);
+  _handle->CheckLibraryIndex();
   Locked<unsigned char>::pointer _mask = _handle->m_eventMask.Get();
   *_mask |= SVCEvent_ContentDirectoryChanged;
   if (_handle->m_eventCB && !_handle->m_eventSignaled.Load())
@@ -292,6 +335,117 @@ bool Player::RefreshShareIndex()
   return m_contentDirectory->RefreshShareIndex();
 }
 
+namespace NSROOT
+{
+  class LibraryIndexer : public OS::CWorker
+  {
+  public:
+    LibraryIndexer(Player& player) : m_player(player) { }
+    virtual void Process() { m_player.UpdateLibraryIndex(); }
+  private:
+    Player& m_player;
+  };
+}
+
+bool Player::SetLibraryIndex(const std::string& path)
+{
+  LibraryIndexPtr index = MAKE_SHARED<LibraryIndex>();
+  bool loaded = index->Open(path);
+  {
+    Locked<IndexState>::pointer state = m_indexState.Get();
+    state->path = path;
+    state->index = loaded ? index : LibraryIndexPtr();
+    if (!m_indexer)
+      m_indexer = new OS::CThreadPool(1);
+  }
+  // the content directory could be notified already
+  CheckLibraryIndex();
+  return loaded;
+}
+
+LibraryIndexPtr Player::GetLibraryIndex()
+{
+  return m_indexState.Get()->index;
+}
+
+void Player::CheckLibraryIndex()
+{
+  if (!m_contentDirectory)
+    return;
+  ContentProperty prop = GetContentProperty();
+  Locked<IndexState>::pointer state = m_indexState.Get();
+  // the index isn't built while the share is indexed, but it is rebuilt
+  // once the indexing is completed
+  if (prop.ShareIndexInProgress)
+  {
+    state->indexing = true;
+    return;
+  }
+  if (state->indexing)
+  {
+    state->indexing = false;
+    ++state->refresh;
+  }
+  if (prop.ShareListUpdateID.empty() || state->path.empty() || !m_indexer ||
+          (state->index && state->built == state->refresh && state->index->IsCurrent(prop.ShareListUpdateID)))
+    return;
+  // one run at a time: it checks again for the requests received meanwhile
+  if (state->requests++ == 0)
+  {
+    LibraryIndexer* worker = new LibraryIndexer(*this);
+    if (!m_indexer->Enqueue(worker))
+    {
+      delete worker;
+      state->requests = 0;
+    }
+  }
+}
+
+void Player::UpdateLibraryIndex()
+{
+  for (;;)
+  {
+    unsigned requests;
+    std::string path;
+    LibraryIndexPtr index;
+    unsigned refresh;
+    bool stale;
+    {
+      Locked<IndexState>::pointer state = m_indexState.Get();
+      requests = state->requests;
+      path = state->path;
+      index = state->index;
+      refresh = state->refresh;
+      stale = (state->built != refresh);
+    }
+    ContentProperty prop = GetContentProperty();
+    if (!m_indexAbort && !prop.ShareListUpdateID.empty() && !prop.ShareIndexInProgress &&
+            !(index && !stale && index->IsCurrent(prop.ShareListUpdateID)))
+    {
+      DBG(DBG_INFO, "%s: update library index (%s)\n", __FUNCTION__, prop.ShareListUpdateID.c_str());
+      ContentDirectory service(m_host, m_port);
+      index = MAKE_SHARED<LibraryIndex>();
+      if (LibraryIndex::Build(service, path, prop.SystemUpdateID, prop.ShareListUpdateID, &m_indexAbort) && index->Open(path))
+      {
+        {
+          Locked<IndexState>::pointer state = m_indexState.Get();
+          state->index = index;
+          // an indexing of the share completed meanwhile asks another run
+          state->built = refresh;
+        }
+        Locked<unsigned char>::pointer _mask = m_eventMask.Get();
+        *_mask |= SVCEvent_LibraryIndexChanged;
+        if (m_eventCB && !m_eventSignaled.Load())
+          m_eventCB(m_CBHandle);
+      }
+    }
+    Locked<IndexState>::pointer state = m_indexState.Get();
+    state->requests -= requests;
+    if (state->requests == 0)
+      return;
+  }
+}
+
 bool Player::GetZoneInfo(ElementList& vars)
 {
   return m_deviceProperties->GetZoneInfo(vars);
@@ -30,6 +30,7 @@
 #include "element.h"
 #include "locked.h"
 #include "musicservices.h"
+#include "libraryindex.h"
 
 #include <string>
 #include <vector>
@@ -43,6 +44,12 @@ namespace NSROOT
   class ContentDirectory;
   class MusicServices;
   class Subscription;
+  class LibraryIndexer;
+
+  namespace OS
+  {
+    class CThreadPool;
+  }
 
   class Player;
 
@@ -63,6 +70,17 @@ namespace NSROOT
      */
     Player(const ZonePtr& zone, EventHandler& eventHandler, void* CBHandle = 0, EventCB eventCB = 0);
 
+    /**
+     * Initialize a zone player with the music services already known for the
+     * household, so they aren't requested again.
+     * @param zone
+     * @param eventHandler
+     * @param services
+     * @param CBHandle
+     * @param eventCB
+     */
+    Player(const ZonePtr& zone, EventHandler& eventHandler, const SMServiceList& services, void* CBHandle = 0, EventCB eventCB = 0);
+
     /**
      * Initialize a standalone player.
      * @param zonePlayer
@@ -94,6 +112,17 @@ namespace NSROOT
     ContentProperty GetContentProperty();
 
     bool RefreshShareIndex();
+
+    /**
+     * Keep an index of the music library in the file. The index is loaded
+     * from the file, then rebuilt in the background when the content
+     * directory notifies a new ShareListUpdateID or the completion of the
+     * share indexing, and the event SVCEvent_LibraryIndexChanged is signaled.
+     * @return true if the file was loaded
+     */
+    bool SetLibraryIndex(const std::string& path);
+    LibraryIndexPtr GetLibraryIndex();
+
     bool GetZoneInfo(ElementList& vars);
     bool GetZoneAttributes(ElementList& vars);
     bool GetHouseholdID(ElementList& vars);
@@ -193,7 +222,8 @@ namespace NSROOT
     MusicServices*      m_musicServices;
 
     // cold startup
-    void Init(const Zone& zone);
+    void Init(const ZonePtr& zone, const SMServiceList* services);
+    void Init(const Zone& zone, const SMServiceList* services = 0);
 
     // event callback
     static void CB_AVTransport(void* handle);
@@ -203,6 +233,24 @@ namespace NSROOT
     // music services
     SMServiceList m_smservices;
 
+    // library index
+    struct IndexState
+    {
+      std::string path;
+      LibraryIndexPtr index;
+      unsigned requests;        ///< updates asked since the last run
+      bool indexing;            ///< The share is being indexed
+      unsigned refresh;         ///< count of indexings of the share completed
+      unsigned built;           ///< the count when the index was built
+      IndexState() : requests(0), indexing(false), refresh(0), built(0) { }
+    };
+    friend class LibraryIndexer;
+    Locked<IndexState> m_indexState;
+    OS::CThreadPool* m_indexer;
+    volatile bool m_indexAbort;
+    void CheckLibraryIndex();
+    void UpdateLibraryIndex();
+
     // prevent copy
     Player(const Player&);
     Player& operator=(const Player&);
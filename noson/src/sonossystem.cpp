@@ -23,8 +23,10 @@
 #include "digitalitem.h"
 #include "didlparser.h"
 #include "musicservices.h"
-#include "private/socket.h"
 #include "private/wsresponse.h"
+#include "private/ssdpdiscovery.h"
+#include "private/ssdplistener.h"
+#include "private/discoverycache.h"
 #include "private/os/threads/timeout.h"
 #include "private/debug.h"
 #include "private/builtin.h"
@@ -34,12 +36,14 @@
 #include "private/os/threads/event.h"
 #include "private/cppdef.h"
 #include "private/xmldict.h"
+#include "private/xmlstream.h"
 
 #include <cstdio> // for sscanf
 
 #define CB_TIMEOUT    5000
 #define PATH_TOPOLOGY "/status/topology"
 #define URI_MSLOGO    "http://update-services.sonos.com/services/mslogo.xml"
+#define DISCOVER_ST   "urn:schemas-upnp-org:device:ZonePlayer:1"
 
 using namespace SONOS;
 
@@ -49,8 +53,17 @@ System::System(void* CBHandle, EventCB eventCB)
 , m_eventHandler(SONOS_LISTENER_PORT)
 , m_subId(0)
 , m_groupTopology(0)
+, m_ssdp(new SSDPListener(DISCOVER_ST, "Sonos/"))
+, m_cachePath()
+, m_location()
 , m_CBHandle(CBHandle)
 , m_eventCB(eventCB)
+, m_players()
+, m_zoneContexts()
+, m_zoneCBHandle(0)
+, m_zoneEventCB(0)
+, m_smservices()
+, m_smservicesLoaded(false)
 {
   m_connectedZone.player.reset();
   m_connectedZone.zone.reset();
@@ -60,36 +73,103 @@ System::System(void* CBHandle, EventCB eventCB)
   m_eventHandler.SubscribeForEvent(m_subId, EVENT_UNKNOWN);
   if (!m_eventHandler.Start())
     DBG(DBG_ERROR, "%s: starting event handler failed\n", __FUNCTION__);
+
+  // track the players announcing on the network
+  m_ssdp->SetCallback(this, CBSSDPDevice);
+  if (!m_ssdp->Start())
+    DBG(DBG_WARN, "%s: starting SSDP listener failed\n", __FUNCTION__);
 }
 
 System::~System()
 {
+  SAFE_DELETE(m_ssdp);
+  m_mutex->Lock();
+  // the callback of the topology could wait for the lock
+  ZoneGroupTopology* topology = m_groupTopology;
+  m_groupTopology = 0;
+  m_mutex->Unlock();
+  SAFE_DELETE(topology);
   m_mutex->Lock();
-  SAFE_DELETE(m_groupTopology);
+  ConnectedPlayerList players;
+  players.swap(m_players);
+  PlayerPtr player = m_connectedZone.player;
+  m_connectedZone.player.reset();
+  m_mutex->Unlock();
+  // the callback of the player could wait for the lock
+  players.clear();
+  player.reset();
+  m_mutex->Lock();
+  for (std::map<std::string, ZoneContext*>::iterator it = m_zoneContexts.begin(); it != m_zoneContexts.end(); ++it)
+    delete it->second;
+  m_zoneContexts.clear();
   SAFE_DELETE(m_cbzgt);
   SAFE_DELETE(m_mutex);
 }
 
+void System::SetDiscoveryCache(const std::string& path)
+{
+  OS::CLockGuard lock(*m_mutex);
+  m_cachePath = path;
+}
+
 bool System::Discover()
 {
   std::string url;
-  if (!FindDeviceDescription(url))
-    return false;
+  DiscoveryCache cache;
+  bool warm = false;
+  OS::CLockGuard lock(*m_mutex);
+  std::string cachePath = m_cachePath;
+  lock.Unlock();
+  // a single request checks the player of the snapshot is still there
+  if (!cachePath.empty() && cache.Load(cachePath))
+  {
+    URIParser cached(cache.location);
+    WSRequest request(cached, HRM_HEAD);
+    WSResponse response(request);
+    if (response.IsSuccessful())
+    {
+      DBG(DBG_INFO, "%s: warm start from %s\n", __FUNCTION__, cache.location.c_str());
+      url = cache.location;
+      warm = true;
+    }
+  }
+  if (!warm)
+  {
+    // a player announced lately: no need to search
+    std::vector<SSDPListener::Device> devices = m_ssdp->GetDevices();
+    if (!devices.empty())
+      url = devices.front().location;
+    else if (!FindDeviceDescription(url))
+      return false;
+  }
   URIParser uri(url);
   if (!uri.Scheme() || !uri.Host() || !uri.Port())
     return false;
 
-  OS::CLockGuard lock(*m_mutex);
+  lock.Lock();
+  // the callback of the previous topology could wait for the lock
+  ZoneGroupTopology* topology = m_groupTopology;
+  m_groupTopology = 0;
+  lock.Unlock();
+  SAFE_DELETE(topology);
+  lock.Lock();
   // subscribe to ZoneGroupTopology events
-  SAFE_DELETE(m_groupTopology);
+  m_location = url;
   m_ZGTSubscription = Subscription(uri.Host(), uri.Port(), ZoneGroupTopology::EventURL, m_eventHandler.GetPort(), SUBSCRIPTION_TIMEOUT);
   m_groupTopology = new ZoneGroupTopology(uri.Host(), uri.Port(), m_eventHandler, m_ZGTSubscription, this, CBZGTopology);
+  // the first event will refresh the state from the snapshot
+  bool loaded = (warm && m_groupTopology->SetZoneGroupState(cache.zoneGroupState));
   m_ZGTSubscription.Start();
+  if (loaded)
+    return true;
   // Wait event notification
   if (m_cbzgt->Wait(CB_TIMEOUT))
     return true;
   DBG(DBG_WARN, "%s: notification wasn't received after timeout: fall back on manual call\n", __FUNCTION__);
-  return m_groupTopology->GetZoneGroupState();
+  if (!m_groupTopology->GetZoneGroupState())
+    return false;
+  SaveDiscoveryCache();
+  return true;
 }
 
 void System::RenewSubscriptions()
@@ -119,6 +199,22 @@ ZonePlayerList System::GetZonePlayerList() const
   return ZonePlayerList();
 }
 
+unsigned System::GetTopologyVersion() const
+{
+  OS::CLockGuard lock(*m_mutex);
+  if (m_groupTopology)
+    return m_groupTopology->GetVersion();
+  return 0;
+}
+
+TopologyChangeList System::GetTopologyChanges() const
+{
+  OS::CLockGuard lock(*m_mutex);
+  if (m_groupTopology)
+    return m_groupTopology->GetLastChanges();
+  return TopologyChangeList();
+}
+
 bool System::ConnectZone(const ZonePtr& zone, void* CBHandle, EventCB eventCB)
 {
   OS::CLockGuard lock(*m_mutex);
@@ -128,17 +224,138 @@ bool System::ConnectZone(const ZonePtr& zone, void* CBHandle, EventCB eventCB)
   // Check requirements
   if (!zone)
     return false;
+  lock.Unlock();
   DBG(DBG_DEBUG, "%s: connect zone '%s'\n", __FUNCTION__, zone->GetZoneName().c_str());
-  PlayerPtr player(new Player(zone, m_eventHandler, CBHandle, eventCB));
-  if (player->IsValid())
+  PlayerPtr player = MakePlayer(zone, CBHandle, eventCB);
+  if (player)
   {
-    m_connectedZone.player = player;
+    lock.Lock();
+    player.swap(m_connectedZone.player);
     m_connectedZone.zone = zone;
+    lock.Unlock();
+    // the callback of the previous player could wait for the lock
+    player.reset();
     return true;
   }
   return false;
 }
 
+PlayerPtr System::MakePlayer(const ZonePtr& zone, void* CBHandle, EventCB eventCB)
+{
+  ZonePlayerPtr coordinator = zone->GetCoordinator();
+  if (!coordinator || !coordinator->IsValid())
+    return PlayerPtr();
+  // the music services are requested once for all players. The lock isn't
+  // held across the request nor the connection of the player
+  OS::CLockGuard lock(*m_mutex);
+  bool loaded = m_smservicesLoaded;
+  SMServiceList services = m_smservices;
+  lock.Unlock();
+  if (!loaded)
+  {
+    MusicServices musicServices(coordinator->GetHost(), coordinator->GetPort());
+    services = musicServices.GetAvailableServices();
+    // a failed request is done again for the next player
+    if (!services.empty())
+    {
+      lock.Lock();
+      m_smservices = services;
+      m_smservicesLoaded = true;
+      lock.Unlock();
+    }
+  }
+  PlayerPtr player(new Player(zone, m_eventHandler, services, CBHandle, eventCB));
+  if (player->IsValid())
+    return player;
+  return PlayerPtr();
+}
+
+void System::SetZoneEventCB(void* handle, ZoneEventCB eventCB)
+{
+  OS::CLockGuard lock(*m_mutex);
+  m_zoneCBHandle = handle;
+  m_zoneEventCB = eventCB;
+}
+
+PlayerPtr System::AddZone(const ZonePtr& zone)
+{
+  OS::CLockGuard lock(*m_mutex);
+  // Check listener
+  if (!m_eventHandler.IsRunning() && !m_eventHandler.Start())
+    return PlayerPtr();
+  // Check requirements
+  if (!zone)
+    return PlayerPtr();
+  ConnectedPlayerList::const_iterator it = m_players.find(zone->GetGroup());
+  if (it != m_players.end())
+    return it->second;
+  DBG(DBG_DEBUG, "%s: add zone '%s'\n", __FUNCTION__, zone->GetZoneName().c_str());
+  // the events of the zones are funneled to one callback
+  ZoneContext*& ctx = m_zoneContexts[zone->GetGroup()];
+  if (!ctx)
+  {
+    ctx = new ZoneContext;
+    ctx->system = this;
+    ctx->group = zone->GetGroup();
+  }
+  lock.Unlock();
+  PlayerPtr player = MakePlayer(zone, ctx, CBZoneEvent);
+  if (!player)
+    return player;
+  lock.Lock();
+  // the zone could be added in the meantime
+  std::pair<ConnectedPlayerList::iterator, bool> ret = m_players.insert(std::make_pair(zone->GetGroup(), player));
+  if (ret.second)
+    return player;
+  PlayerPtr other = ret.first->second;
+  lock.Unlock();
+  // the callback of the player could wait for the lock
+  player.reset();
+  return other;
+}
+
+bool System::RemoveZone(const std::string& group)
+{
+  OS::CLockGuard lock(*m_mutex);
+  ConnectedPlayerList::iterator it = m_players.find(group);
+  if (it == m_players.end())
+    return false;
+  PlayerPtr player = it->second;
+  m_players.erase(it);
+  lock.Unlock();
+  // the callback of the player could wait for the lock
+  player.reset();
+  return true;
+}
+
+ConnectedPlayerList System::GetConnectedPlayers() const
+{
+  OS::CLockGuard lock(*m_mutex);
+  return m_players;
+}
+
+PlayerPtr System::GetConnectedPlayer(const std::string& group) const
+{
+  OS::CLockGuard lock(*m_mutex);
+  ConnectedPlayerList::const_iterator it = m_players.find(group);
+  if (it != m_players.end())
+    return it->second;
+  return PlayerPtr();
+}
+
+void System::CBZoneEvent(void* handle)
+{
+  ZoneContext* ctx = static_cast<ZoneContext*>(handle);
+  if (!ctx)
+    return;
+  OS::CLockGuard lock(*ctx->system->m_mutex);
+  void* cbHandle = ctx->system->m_zoneCBHandle;
+  ZoneEventCB cb = ctx->system->m_zoneEventCB;
+  lock.Unlock();
+  if (cb)
+    cb(cbHandle, ctx->group);
+}
+
 bool System::ConnectZone(const ZonePlayerPtr& zonePlayer, void* CBHandle, EventCB eventCB)
 {
   OS::CLockGuard lock(*m_mutex);
@@ -148,11 +365,16 @@ bool System::ConnectZone(const ZonePlayerPtr& zonePlayer, void* CBHandle, EventC
   // Check requirements
   if (!m_groupTopology || !zonePlayer)
     return false;
-  Locked<ZoneList>::pointer zones = m_groupTopology->GetZoneList().Get();
-  ZoneList::const_iterator zit = zones->find(zonePlayer->GetAttribut("group"));
-  if (zit == zones->end())
-    return false;
-  return ConnectZone(zit->second, CBHandle, eventCB);
+  ZonePtr zone;
+  {
+    Locked<ZoneList>::pointer zones = m_groupTopology->GetZoneList().Get();
+    ZoneList::const_iterator zit = zones->find(zonePlayer->GetAttribut("group"));
+    if (zit == zones->end())
+      return false;
+    zone = zit->second;
+  }
+  lock.Unlock();
+  return ConnectZone(zone, CBHandle, eventCB);
 }
 
 bool System::IsConnected() const
@@ -274,116 +496,43 @@ void System::DeleteServiceOAuth(const std::string& type, const std::string& sn)
 
 bool System::FindDeviceDescription(std::string& url)
 {
-#define MULTICAST_ADDR      "239.255.255.250"
-#define MULTICAST_STRP      "1900"
-#define MULTICAST_NUMP      1900
 #define DISCOVER_TIMEOUT    5000
-#define DISCOVER_ST         "urn:schemas-upnp-org:device:ZonePlayer:1"
-#define HTTP_TOKEN_MAXSIZE  20
-
-  static const char* msearch =
-  "M-SEARCH * HTTP/1.1\r\n"
-  "HOST: " MULTICAST_ADDR ":" MULTICAST_STRP "\r\n"
-  "MAN: \"ssdp:discover\"\r\n"
-  "MX: 1\r\n"
-  "ST: " DISCOVER_ST "\r\n"
-  "\r\n";
-
-  static struct timeval socket_timeout = { 0, 500000 };
-
-  bool ret = false;
-  UdpSocket sock;
-  sock.SetAddress(SOCKET_AF_INET4, MULTICAST_ADDR, MULTICAST_NUMP);
-  sock.SetMulticastTTL(4);
 
+  SSDPDiscovery discovery(DISCOVER_ST, "Sonos/");
   OS::CTimeout timeout(DISCOVER_TIMEOUT);
-  while (!ret && timeout.TimeLeft() > 0)
+  while (timeout.TimeLeft() > 0)
   {
-    sock.SendData(msearch, strlen(msearch));
-    sock.SetTimeout(socket_timeout);
-    std::string strread;
-    size_t len = 0;
-    unsigned _context = 0;
-    while (!ret && WSResponse::ReadHeaderLine(&sock, "\r\n", strread, &len))
+    if (discovery.Search())
     {
-      const char* line = strread.c_str();
-      if (len == 15 && memcmp(line, "HTTP", 4) == 0)
-      {
-        int status = 0;
-        if (1 == sscanf(line, "%*s %d", &status) && status == 200)
-        {
-          DBG(DBG_INFO, "%s: starting new context\n", __FUNCTION__);
-          _context = 1; // new valid context
-        }
-        else
-          _context = 0; // reset context
-      }
-      else if (_context)
-      {
-        /*
-         * Each header field consists of a name followed by a colon (":") and the
-         * field value. Field names are case-insensitive. The field value MAY be
-         * preceded by any amount of LWS, though a single SP is preferred.
-         */
-        const char* val = NULL;
-        char token[21];
-        int token_len = 0;
-        int value_len = 0;
-        if ((val = strchr(line, ':')))
-        {
-          int p;
-          if ((token_len = val - line) > HTTP_TOKEN_MAXSIZE)
-            token_len = HTTP_TOKEN_MAXSIZE;
-          for (p = 0; p < token_len; ++p)
-            token[p] = toupper(line[p]);
-          token[token_len] = 0;
-          while ((value_len = len - (val - line)) && *(++val) == ' ');
-        }
-
-        if (token_len)
-        {
-          switch (token_len)
-          {
-            case 6:
-              if (val && memcmp(token, "SERVER", token_len) == 0)
-              {
-                DBG(DBG_INFO, "%s: server string found (%s)\n", __FUNCTION__, val);
-                _context |= 0x2;
-                if (strstr(val, "Sonos/"))
-                {
-                  DBG(DBG_INFO, "%s: search target matches\n", __FUNCTION__);
-                  _context |= 0x4;
-                }
-                else
-                {
-                  DBG(DBG_INFO, "%s: search target not matches\n", __FUNCTION__);
-                  _context = 0; // reset context
-                }
-              }
-              break;
-            case 8:
-              if (val && memcmp(token, "LOCATION", token_len) == 0)
-              {
-                DBG(DBG_INFO, "%s: location url found (%s)\n", __FUNCTION__, val);
-                _context |= 0x8;
-                url.assign(val);
-              }
-              break;
-            default:
-              break;
-          }
-        }
-        else if (len == 0)
-        {
-          DBG(DBG_INFO, "%s: reseting context\n", __FUNCTION__);
-          _context = 0; // reset context
-        }
-      }
-      if (_context == 0xF)
-        ret = true;
+      // the fastest player to answer is the best one to subscribe
+      const SSDPDiscovery::Responder& best = discovery.GetResponders().front();
+      DBG(DBG_INFO, "%s: %u players found, selecting %s (%u ms)\n", __FUNCTION__,
+              (unsigned)discovery.GetResponders().size(), best.address.c_str(), best.latency);
+      url.assign(best.location);
+      return true;
     }
   }
-  return ret;
+  return false;
+}
+
+void System::CBSSDPDevice(void* handle, const std::string& uuid, const std::string& location, bool alive)
+{
+  if (!handle || !alive)
+    return;
+  System* _handle = static_cast<System*>(handle);
+  URIParser uri(location);
+  if (!uri.Host())
+    return;
+  DBG(DBG_DEBUG, "%s: player %s is restarted (%s)\n", __FUNCTION__, uuid.c_str(), uri.Host());
+  // the subscriptions were lost by the restarted player
+  OS::CLockGuard lock(*_handle->m_mutex);
+  if (_handle->m_groupTopology && _handle->m_groupTopology->GetHost() == uri.Host())
+    _handle->m_ZGTSubscription.AskRenewal();
+  if (_handle->m_connectedZone.player && _handle->m_connectedZone.player->GetHost() == uri.Host())
+    _handle->m_connectedZone.player->RenewSubscriptions();
+  for (ConnectedPlayerList::iterator it = _handle->m_players.begin(); it != _handle->m_players.end(); ++it)
+    if (it->second->GetHost() == uri.Host())
+      it->second->RenewSubscriptions();
 }
 
 void System::CBZGTopology(void* handle)
@@ -392,11 +541,100 @@ void System::CBZGTopology(void* handle)
   {
     System* _handle = static_cast<System*>(handle);
     _handle->m_cbzgt->Broadcast();
+    // keep the snapshot of the topology
+    OS::CLockGuard lock(*_handle->m_mutex);
+    _handle->SaveDiscoveryCache();
+    lock.Unlock();
     if (_handle->m_eventCB)
       (_handle->m_eventCB)(_handle->m_CBHandle);
   }
 }
 
+void System::SaveDiscoveryCache()
+{
+  if (m_cachePath.empty() || !m_groupTopology)
+    return;
+  DiscoveryCache cache;
+  cache.location = m_location;
+  cache.zoneGroupState = m_groupTopology->GetLastZoneGroupState();
+  cache.Save(m_cachePath);
+}
+
+namespace NSROOT
+{
+  /**
+   * Streaming handler filling the list of logos:
+   * images/sized/service[id]/image[placement]
+   */
+  class MSLogoReader : public XMLStreamHandler
+  {
+  public:
+    MSLogoReader(ElementList& logos) : m_logos(logos), m_depth(0), m_valid(false), m_sized(0), m_image(false) { }
+
+    bool IsValid() const { return m_valid; }
+
+    virtual bool StartElement(const char* name, const XMLStreamAttributes& attrs)
+    {
+      switch (++m_depth)
+      {
+      case 1:
+        return (m_valid = XMLNS::NameEqual(name, "images"));
+      case 2:
+        // only the first element sized is processed
+        if (strcmp(name, "sized") == 0)
+          ++m_sized;
+        break;
+      case 3:
+        m_typeId.clear();
+        if (m_sized == 1 && strcmp(name, "service") == 0 && attrs.Find("id"))
+          m_typeId.assign(attrs.Find("id"));
+        break;
+      case 4:
+        m_image = false;
+        if (!m_typeId.empty() && strcmp(name, "image") == 0 && attrs.Find("placement"))
+        {
+          m_placement.assign(attrs.Find("placement"));
+          m_text.clear();
+          m_image = true;
+        }
+        break;
+      default:
+        break;
+      }
+      return true;
+    }
+
+    virtual bool EndElement(const char* name)
+    {
+      (void)name;
+      if (m_depth-- == 4 && m_image && !m_text.empty())
+      {
+        ElementPtr logo(new Element(m_typeId, m_text));
+        logo->SetAttribut("placement", m_placement);
+        m_logos.push_back(logo);
+      }
+      return true;
+    }
+
+    virtual bool Characters(const char* text, size_t len)
+    {
+      if (m_depth == 4 && m_image)
+        m_text.append(text, len);
+      return true;
+    }
+
+  private:
+    ElementList& m_logos;
+    unsigned m_depth;
+    bool m_valid;
+    unsigned m_sized;
+    bool m_image;
+    std::string m_typeId;
+    std::string m_placement;
+    std::string m_text;
+  };
+}
+
 bool System::LoadMSLogo(ElementList& logos)
 {
   WSRequest request(URIParser(URI_MSLOGO));
@@ -404,55 +642,22 @@ bool System::LoadMSLogo(ElementList& logos)
   if (!response.IsSuccessful())
     return false;
 
-  size_t len = 0, l = 0;
-  std::string data;
-  char buffer[4000];
-  while ((l = response.ReadContent(buffer, sizeof(buffer))))
-  {
-    data.append(buffer, l);
-    len += l;
-  }
-
-  tinyxml2::XMLDocument rootdoc;
-  // Parse xml content
-  if (rootdoc.Parse(data.c_str(), len) != tinyxml2::XML_SUCCESS)
-  {
-    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
-    return false;
-  }
-  const tinyxml2::XMLElement* elem; // an element
-  // Check for response: Services
-  if (!(elem = rootdoc.RootElement()) || !XMLNS::NameEqual(elem->Name(), "images")
-          || !(elem = elem->FirstChildElement("sized")))
+  // Parse xml content while it is received
+  logos.clear();
+  MSLogoReader handler(logos);
+  XMLStreamParser parser(handler);
+  const char* data;
+  size_t len;
+  while ((len = response.FetchContent(&data)) && parser.Feed(data, len));
+  if (!handler.IsValid())
   {
     DBG(DBG_ERROR, "%s: invalid or not supported content\n", __FUNCTION__);
-    tinyxml2::XMLPrinter out;
-    rootdoc.Accept(&out);
-    DBG(DBG_ERROR, "%s\n", out.CStr());
     return false;
   }
-  logos.clear();
-  elem = elem->FirstChildElement("service");
-  while (elem)
+  if (!parser.Finish())
   {
-    const tinyxml2::XMLElement* felem;
-    const char* typeId = elem->Attribute("id");
-    if (typeId)
-    {
-      felem = elem->FirstChildElement("image");
-      while (felem)
-      {
-        const char* p = felem->Attribute("placement");
-        if (p && felem->GetText())
-        {
-          ElementPtr logo(new Element(typeId, felem->GetText()));
-          logo->SetAttribut("placement", p);
-          logos.push_back(logo);
-        }
-        felem = felem->NextSiblingElement("image");
-      }
-    }
-    elem = elem->NextSiblingElement("service");
+    DBG(DBG_ERROR, "%s: parse xml failed\n", __FUNCTION__);
+    return false;
   }
   return true;
 }
@@ -28,6 +28,7 @@
 #include "subscription.h"
 
 #include <string>
+#include <map>
 
 #define SONOS_LISTENER_PORT 1400
 
@@ -40,6 +41,16 @@ namespace NSROOT
   }
 
   class ZoneGroupTopology;
+  class SSDPListener;
+
+  typedef std::map<std::string, PlayerPtr> ConnectedPlayerList;
+
+  /**
+   * Callback of the events of a connected zone.
+   * @param handle The handle given on setup
+   * @param group The group of the zone signaling events
+   */
+  typedef void (*ZoneEventCB)(void* handle, const std::string& group);
 
   class System : private EventSubscriber
   {
@@ -49,6 +60,14 @@ namespace NSROOT
 
     bool IsListening() { return m_eventHandler.IsRunning(); }
 
+    /**
+     * Keep a snapshot of the discovery in the given file. At startup the
+     * snapshot is checked by a single request, then the topology is loaded
+     * from it without waiting for the first event.
+     * @param path the file of the snapshot, or empty to disable
+     */
+    void SetDiscoveryCache(const std::string& path);
+
     bool Discover();
 
     void RenewSubscriptions();
@@ -57,6 +76,17 @@ namespace NSROOT
 
     ZonePlayerList GetZonePlayerList() const;
 
+    /**
+     * The version of the topology is bumped by each change. The zones and
+     * players unchanged keep the same objects from a version to the next.
+     */
+    unsigned GetTopologyVersion() const;
+
+    /**
+     * @return the changes made by the current version of the topology
+     */
+    TopologyChangeList GetTopologyChanges() const;
+
     bool ConnectZone(const ZonePtr& zone, void* CBHandle = 0, EventCB eventCB = 0);
 
     bool ConnectZone(const ZonePlayerPtr& zonePlayer, void* CBHandle = 0, EventCB eventCB = 0);
@@ -67,6 +97,29 @@ namespace NSROOT
 
     const PlayerPtr& GetPlayer() const { return m_connectedZone.player; }
 
+    /**
+     * Set the callback receiving the events of all the zones added. It must
+     * be set before adding any zone.
+     */
+    void SetZoneEventCB(void* handle, ZoneEventCB eventCB);
+
+    /**
+     * Connect a zone beside the others. All the players share the event
+     * listener of the system, and the music services of the household.
+     * @return the player of the zone, or null on failure
+     */
+    PlayerPtr AddZone(const ZonePtr& zone);
+
+    /**
+     * Disconnect the zone of the given group.
+     * @return false if the zone isn't connected
+     */
+    bool RemoveZone(const std::string& group);
+
+    ConnectedPlayerList GetConnectedPlayers() const;
+
+    PlayerPtr GetConnectedPlayer(const std::string& group) const;
+
     // Implements EventSubscriber
     virtual void HandleEventMessage(EventMessagePtr msg);
 
@@ -100,6 +153,9 @@ namespace NSROOT
     unsigned m_subId;
     Subscription m_ZGTSubscription;
     ZoneGroupTopology* m_groupTopology;
+    SSDPListener* m_ssdp;
+    std::string m_cachePath;
+    std::string m_location;       ///< The player holding the subscription
     void* m_CBHandle;
     EventCB m_eventCB;
 
@@ -109,10 +165,31 @@ namespace NSROOT
       PlayerPtr player;
     } m_connectedZone;
 
+    // the zones added
+    struct ZoneContext
+    {
+      System* system;
+      std::string group;
+    };
+    ConnectedPlayerList m_players;
+    std::map<std::string, ZoneContext*> m_zoneContexts; ///< Kept until destroy
+    void* m_zoneCBHandle;
+    ZoneEventCB m_zoneEventCB;
+    SMServiceList m_smservices;   ///< The music services of the household
+    bool m_smservicesLoaded;
+
+    PlayerPtr MakePlayer(const ZonePtr& zone, void* CBHandle, EventCB eventCB);
+
+    static void CBZoneEvent(void* handle);
+
     static bool FindDeviceDescription(std::string& url);
 
     static void CBZGTopology(void* handle);
 
+    void SaveDiscoveryCache();
+
+    static void CBSSDPDevice(void* handle, const std::string& uuid, const std::string& location, bool alive);
+
     static bool LoadMSLogo(ElementList& logos);
   };
 }
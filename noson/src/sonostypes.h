@@ -36,6 +36,7 @@ namespace NSROOT
     SVCEvent_TransportChanged        = 0x01,
     SVCEvent_RenderingControlChanged = 0x02,
     SVCEvent_ContentDirectoryChanged = 0x04,
+    SVCEvent_LibraryIndexChanged     = 0x08,
   } SVCEventMask_t;
 
   typedef enum
@@ -100,6 +100,33 @@ namespace NSROOT
       return first->compare(*last) < 0 ? true : false;
     }
   };
+
+  /**
+   * A change between two states of the topology.
+   */
+  struct TopologyChange
+  {
+    typedef enum
+    {
+      GroupAdded,
+      GroupRemoved,
+      GroupCoordinator,     ///< The coordinator of the group has changed
+      MemberAdded,          ///< The player joined the household
+      MemberRemoved,        ///< The player left the household
+      MemberMoved,          ///< The player moved from a group to another
+      MemberChanged,        ///< An attribute of the player has changed
+    } Type;
+
+    Type type;
+    std::string group;      ///< The group of the change
+    std::string uuid;       ///< The player, if any
+    std::string from;       ///< The previous group of a moved player
+
+    TopologyChange(Type _type, const std::string& _group, const std::string& _uuid = "", const std::string& _from = "")
+    : type(_type), group(_group), uuid(_uuid), from(_from) { }
+  };
+
+  typedef std::vector<TopologyChange> TopologyChangeList;
 }
 
 #endif	/* SONOSZONE_H */
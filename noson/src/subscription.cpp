@@ -20,11 +20,11 @@
 
 #include "subscription.h"
 #include "private/cppdef.h"
-#include "private/os/threads/thread.h"
-#include "private/os/threads/event.h"
+#include "private/os/threads/mutex.h"
+#include "private/renewalscheduler.h"
 #include "private/wsresponse.h"
 #include "private/uriparser.h"
-#include "private/socket.h"
+#include "private/localaddress.h"
 #include "private/builtin.h"
 #include "private/debug.h"
 #include "sonossystem.h" // for definitions
@@ -44,18 +44,24 @@ Subscription::SubscriptionThread::~SubscriptionThread()
 namespace NSROOT
 {
 
-  class SubscriptionThreadImpl : public Subscription::SubscriptionThread, private OS::CThread
+  /**
+   * The subscription is a task of the renewal scheduler: it doesn't own a
+   * thread, and its renewal is run by the shared pool of the scheduler.
+   */
+  class SubscriptionThreadImpl : public Subscription::SubscriptionThread, private RenewalScheduler::Task
   {
   public:
     SubscriptionThreadImpl(const std::string& host, unsigned port, const std::string& url, unsigned bindingPort, unsigned timeout)
-    : CThread()
-    , m_host(host)
+    : m_host(host)
     , m_port(port)
     , m_url(url)
     , m_bindingPort(bindingPort)
     , m_timeout(timeout)
     , m_configured(false)
     , m_renewable(false)
+    , m_success(false)
+    , m_resubscribe(false)
+    , m_taskId(0)
     {
       // Try to configure
       Configure();
@@ -73,27 +79,37 @@ namespace NSROOT
 
     virtual bool Start()
     {
-      return OS::CThread::StartThread();
+      OS::CLockGuard lock(m_mutex);
+      if (m_taskId)
+        return true;
+      m_taskId = RenewalScheduler::Instance().Register(this);
+      return true;
     }
 
-    virtual void Stop()
+    virtual void Stop();
+
+    virtual bool IsRunning()
     {
-      OS::CThread::StopThread(false);
-      m_event.Signal();
-      OS::CThread::StopThread(true);
+      OS::CLockGuard lock(m_mutex);
+      return (m_taskId != 0);
     }
 
-    virtual bool IsRunning() { return OS::CThread::IsRunning(); }
-
     virtual void AskRenewal()
     {
-      if (IsRunning())
+      OS::CLockGuard lock(m_mutex);
+      if (m_taskId)
       {
-        UnSubscribeForEvent();
-        m_event.Signal();
+        m_resubscribe = true;
+        RenewalScheduler::Instance().Wakeup(m_taskId);
       }
     }
 
+    virtual std::string GetSID()
+    {
+      OS::CLockGuard lock(m_mutex);
+      return m_SID;
+    }
+
   private:
     std::string m_host;
     unsigned m_port;
@@ -102,41 +118,62 @@ namespace NSROOT
     unsigned m_timeout;
     bool m_configured;
     bool m_renewable;
+    bool m_success;
+    bool m_resubscribe;       ///< Cancel the subscription before the next run
     std::string m_myIP;
-    OS::CEvent m_event;
+    std::string m_SID;
+    unsigned m_taskId;
+    OS::CMutex m_mutex;
 
-    virtual void* Process();
+    virtual unsigned Run();
     bool Configure();
     bool SubscribeForEvent(bool renew = false);
     bool UnSubscribeForEvent();
   };
 }
 
-void* SubscriptionThreadImpl::Process()
+void SubscriptionThreadImpl::Stop()
+{
+  OS::CLockGuard lock(m_mutex);
+  unsigned id = m_taskId;
+  m_taskId = 0;
+  lock.Unlock();
+  if (!id)
+    return;
+  // Wait for the running renewal to complete
+  RenewalScheduler::Instance().Unregister(id);
+  // Cancel the subscription synchronously: a job queued to the pool would be
+  // lost at exit, and the player would keep notifying a dead callback
+  if (m_success)
+    UnSubscribeForEvent();
+  lock.Lock();
+  m_SID.clear();
+  m_success = false;
+}
+
+unsigned SubscriptionThreadImpl::Run()
 {
-  bool success = false;
-  while (!IsStopped())
+  OS::CLockGuard lock(m_mutex);
+  bool resubscribe = m_resubscribe;
+  m_resubscribe = false;
+  lock.Unlock();
+  if (resubscribe && m_success)
   {
-    // Reconfigure: IP may be leased for a time
-    if (Configure() && (success = SubscribeForEvent(success)))
-      m_event.Wait(m_timeout * 900);
-    else
-    {
-      // wait before retry
-      m_event.Wait(TIMEOUT_RETRY * 1000);
-    }
-  }
-  if (success)
     UnSubscribeForEvent();
-  return NULL;
+    m_success = false;
+  }
+  // Reconfigure: IP may be leased for a time
+  if (Configure() && (m_success = SubscribeForEvent(m_success)))
+    return m_timeout * 900;
+  // the route could be stale
+  LocalAddressCache::Instance().Invalidate(m_host);
+  // wait before retry
+  return TIMEOUT_RETRY * 1000;
 }
 
 bool SubscriptionThreadImpl::Configure()
 {
-  TcpSocket sock;
-  sock.Connect(m_host.c_str(), m_port, 0);
-  std::string myIP = sock.GetLocalIP();
-  sock.Disconnect();
+  std::string myIP = LocalAddressCache::Instance().Lookup(m_host, m_port);
   if (!myIP.empty())
   {
     if (myIP == m_myIP)
@@ -152,13 +189,14 @@ bool SubscriptionThreadImpl::Configure()
 
 bool SubscriptionThreadImpl::SubscribeForEvent(bool renew)
 {
+  std::string sid = GetSID();
   WSRequest request(m_host, m_port);
   request.RequestService(m_url, HRM_SUBSCRIBE);
   // is renewable ?
-  if (renew && m_renewable && !m_SID.empty())
+  if (renew && m_renewable && !sid.empty())
   {
-    DBG(DBG_DEBUG, "%s: renew subscription (%s)\n", __FUNCTION__, m_SID.c_str());
-    request.SetHeader("SID", m_SID);
+    DBG(DBG_DEBUG, "%s: renew subscription (%s)\n", __FUNCTION__, sid.c_str());
+    request.SetHeader("SID", sid);
   }
   else
   {
@@ -175,21 +213,27 @@ bool SubscriptionThreadImpl::SubscribeForEvent(bool renew)
   uint32_to_string(secs, buf + 7);
   request.SetHeader("TIMEOUT", buf);
   WSResponse response(request);
-  if (response.IsSuccessful() && response.GetHeaderValue("SID", m_SID))
+  if (response.IsSuccessful() && response.GetHeaderValue("SID", sid))
+  {
+    OS::CLockGuard lock(m_mutex);
+    m_SID = sid;
     return true;
+  }
   return false;
 }
 
 bool SubscriptionThreadImpl::UnSubscribeForEvent()
 {
-  if (!m_SID.empty())
+  std::string sid = GetSID();
+  if (!sid.empty())
   {
     WSRequest request(m_host, m_port);
     request.RequestService(m_url, HRM_UNSUBSCRIBE);
-    request.SetHeader("SID", m_SID);
+    request.SetHeader("SID", sid);
     WSResponse response(request);
     if (!response.IsSuccessful())
       return false;
+    OS::CLockGuard lock(m_mutex);
     m_SID.clear();
   }
   return true;
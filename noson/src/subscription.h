@@ -42,7 +42,7 @@ namespace NSROOT
     
     bool Start();
 
-    const std::string GetSID() { return m_imp ? m_imp->m_SID : ""; }
+    const std::string GetSID() { return m_imp ? m_imp->GetSID() : ""; }
 
     void AskRenewal();
 
@@ -57,9 +57,7 @@ namespace NSROOT
       virtual void Stop() = 0;
       virtual bool IsRunning() = 0;
       virtual void AskRenewal() = 0;
-
-    protected:
-      std::string m_SID;
+      virtual std::string GetSID() = 0;
     };
 
     typedef SHARED_PTR<SubscriptionThread> SubscriptionThreadPtr;
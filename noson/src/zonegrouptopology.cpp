@@ -24,6 +24,8 @@
 #include "private/tinyxml2.h"
 #include "private/xmldict.h"
 
+#include <map>
+
 using namespace NSROOT;
 
 const std::string ZoneGroupTopology::Name("ZoneGroupTopology");
@@ -56,8 +58,11 @@ ZoneGroupTopology::ZoneGroupTopology(const std::string& serviceHost, unsigned se
 , m_eventCB(0)
 , m_msgCount(0)
 , m_topologyKey(0)
+, m_version(0)
 , m_zones(ZoneList())
 , m_zonePlayers(ZonePlayerList())
+, m_state()
+, m_changes()
 {
 }
 
@@ -69,8 +74,11 @@ ZoneGroupTopology::ZoneGroupTopology(const std::string& serviceHost, unsigned se
 , m_eventCB(eventCB)
 , m_msgCount(0)
 , m_topologyKey(0)
+, m_version(0)
 , m_zones(ZoneList())
 , m_zonePlayers(ZonePlayerList())
+, m_state()
+, m_changes()
 {
   unsigned subId = m_eventHandler.CreateSubscription(this);
   m_eventHandler.SubscribeForEvent(subId, EVENT_UPNP_PROPCHANGE);
@@ -99,19 +107,18 @@ void ZoneGroupTopology::HandleEventMessage(EventMessagePtr msg)
     if (m_subscription.GetSID() == msg->subject[0] && msg->subject[2] == "PROPERTY")
     {
       DBG(DBG_DEBUG, "%s: %s SEQ=%s %s\n", __FUNCTION__, msg->subject[0].c_str(), msg->subject[1].c_str(), msg->subject[2].c_str());
-      std::vector<std::string>::const_iterator it = msg->subject.begin();
-      unsigned _key = m_topologyKey;
-      while (it != msg->subject.end())
+      std::vector<EventProperty>::const_iterator it = msg->properties.begin();
+      unsigned _version = m_version;
+      for (; it != msg->properties.end(); ++it)
       {
-        if (*it == "ZoneGroupState")
+        if (it->id == PROPERTY_ZoneGroupState)
         {
-          ParseZoneGroupState(*++it);
+          ParseZoneGroupState(it->value);
           break;
         }
-        ++it;
       }
       // Event is signaled only on first or any change
-      if (m_msgCount && _key == m_topologyKey)
+      if (m_msgCount && _version == m_version)
         return;
       // Signal
       ++m_msgCount;
@@ -143,8 +150,21 @@ bool ZoneGroupTopology::ParseZoneGroupState(const std::string& xml)
 
   Locked<ZoneList>::pointer zones = m_zones.Get();
   Locked<ZonePlayerList>::pointer zonePlayers = m_zonePlayers.Get();
-  zones->clear();
-  zonePlayers->clear();
+
+  // index the previous state: the unchanged objects are kept
+  std::map<std::string, ZonePlayerPtr> oldPlayers;
+  std::map<std::string, std::string> oldGroupOf;
+  for (ZoneList::const_iterator it = zones->begin(); it != zones->end(); ++it)
+    for (Zone::const_iterator pit = it->second->begin(); pit != it->second->end(); ++pit)
+    {
+      oldPlayers.insert(std::make_pair((*pit)->GetUUID(), *pit));
+      oldGroupOf.insert(std::make_pair((*pit)->GetUUID(), it->first));
+    }
+
+  ZoneList newZones;
+  ZonePlayerList newPlayers;
+  std::map<std::string, std::string> newGroupOf;
+  TopologyChangeList changes;
   elem = elem->FirstChildElement();
   while (elem)
   {
@@ -157,7 +177,6 @@ bool ZoneGroupTopology::ParseZoneGroupState(const std::string& xml)
     }
     ZonePtr zone(new Zone(zoneGroup.GetAttribut("ID")));
     const std::string& cuuid = zoneGroup.GetAttribut("Coordinator");
-    DBG(DBG_INFO, "%s: new group '%s' with coordinator '%s'\n", __FUNCTION__, zone->GetGroup().c_str(), cuuid.c_str());
     // browse childs
     const tinyxml2::XMLElement* child = elem->FirstChildElement();
     while (child)
@@ -183,22 +202,114 @@ bool ZoneGroupTopology::ParseZoneGroupState(const std::string& xml)
         zp->SetAttribut(ZP_VERSION, zoneGroupMember.GetAttribut("SoftwareVersion"));
         zp->SetAttribut(ZP_MCVERSION, zoneGroupMember.GetAttribut("MinCompatibleVersion"));
         zp->SetAttribut(ZP_LCVERSION, zoneGroupMember.GetAttribut("LegacyCompatibleVersion"));
-        DBG(DBG_INFO, "%s: new group member '%s' (%s)\n", __FUNCTION__, muuid.c_str(), zp->c_str());
-        zonePlayers->insert(std::make_pair(*zp, zp));
-        zone->push_back(zp);
+        // a player isn't shared between groups: a duplicate is ignored
+        if (newGroupOf.insert(std::make_pair(muuid, zone->GetGroup())).second)
+        {
+          std::map<std::string, ZonePlayerPtr>::const_iterator old = oldPlayers.find(muuid);
+          if (old != oldPlayers.end())
+          {
+            if (SamePlayer(*old->second, *zp, true))
+              zp = old->second;
+            else if (!SamePlayer(*old->second, *zp, false))
+              changes.push_back(TopologyChange(TopologyChange::MemberChanged, zone->GetGroup(), muuid));
+          }
+          newPlayers.insert(std::make_pair(*zp, zp));
+          zone->push_back(zp);
+        }
       }
       child = child->NextSiblingElement(NULL);
     }
     zone->Revamp();
-    zones->insert(std::make_pair(zone->GetGroup(), zone));
+    ZoneList::const_iterator old = zones->find(zone->GetGroup());
+    if (old == zones->end())
+    {
+      DBG(DBG_INFO, "%s: new group '%s' with coordinator '%s'\n", __FUNCTION__, zone->GetGroup().c_str(), cuuid.c_str());
+      changes.push_back(TopologyChange(TopologyChange::GroupAdded, zone->GetGroup(), cuuid));
+    }
+    else
+    {
+      ZonePlayerPtr oldCoordinator = old->second->GetCoordinator();
+      if (!oldCoordinator || oldCoordinator->GetUUID() != cuuid)
+      {
+        DBG(DBG_INFO, "%s: group '%s' has new coordinator '%s'\n", __FUNCTION__, zone->GetGroup().c_str(), cuuid.c_str());
+        changes.push_back(TopologyChange(TopologyChange::GroupCoordinator, zone->GetGroup(), cuuid));
+      }
+      // the same players in the same order: keep the zone
+      if (SameMembers(*old->second, *zone))
+        zone = old->second;
+    }
+    newZones.insert(std::make_pair(zone->GetGroup(), zone));
     elem = elem->NextSiblingElement(NULL);
   }
+
+  // report the removed groups, then the moves of the players
+  for (ZoneList::const_iterator it = zones->begin(); it != zones->end(); ++it)
+    if (newZones.find(it->first) == newZones.end())
+    {
+      DBG(DBG_INFO, "%s: group '%s' is removed\n", __FUNCTION__, it->first.c_str());
+      changes.push_back(TopologyChange(TopologyChange::GroupRemoved, it->first));
+    }
+  for (std::map<std::string, std::string>::const_iterator it = newGroupOf.begin(); it != newGroupOf.end(); ++it)
+  {
+    std::map<std::string, std::string>::const_iterator old = oldGroupOf.find(it->first);
+    if (old == oldGroupOf.end())
+      changes.push_back(TopologyChange(TopologyChange::MemberAdded, it->second, it->first));
+    else if (old->second != it->second)
+    {
+      DBG(DBG_INFO, "%s: member '%s' moved from '%s' to '%s'\n", __FUNCTION__, it->first.c_str(), old->second.c_str(), it->second.c_str());
+      changes.push_back(TopologyChange(TopologyChange::MemberMoved, it->second, it->first, old->second));
+    }
+  }
+  for (std::map<std::string, std::string>::const_iterator it = oldGroupOf.begin(); it != oldGroupOf.end(); ++it)
+    if (newGroupOf.find(it->first) == newGroupOf.end())
+      changes.push_back(TopologyChange(TopologyChange::MemberRemoved, it->second, it->first));
+
+  zones->swap(newZones);
+  zonePlayers->swap(newPlayers);
+  m_state.assign(xml);
+  if (changes.empty())
+    return true;
+  m_changes.swap(changes);
+  ++m_version;
   // compute a key for this state
   std::string keyStr;
   keyStr.reserve(zones->size() << 5);
   for (ZoneList::const_iterator it = zones->begin(); it != zones->end(); ++it)
     keyStr.append(it->first);
   m_topologyKey = __hashvalue(0xFFFFFFFF, keyStr.c_str());
-  DBG(DBG_INFO, "%s: topology key %u\n", __FUNCTION__, m_topologyKey);
+  DBG(DBG_INFO, "%s: topology version %u key %u, %u changes\n", __FUNCTION__, m_version, m_topologyKey, (unsigned)m_changes.size());
+  return true;
+}
+
+bool ZoneGroupTopology::SamePlayer(const ZonePlayer& a, const ZonePlayer& b, bool withRole)
+{
+  static const char* attrs[] = { ZP_UUID, ZP_LOCATION, ZP_ICON, ZP_VERSION, ZP_MCVERSION, ZP_LCVERSION };
+  if (a.compare(b) != 0)
+    return false;
+  for (unsigned i = 0; i < sizeof(attrs) / sizeof(attrs[0]); ++i)
+    if (a.GetAttribut(attrs[i]) != b.GetAttribut(attrs[i]))
+      return false;
+  return (!withRole || a.GetAttribut(ZP_COORDINATOR) == b.GetAttribut(ZP_COORDINATOR));
+}
+
+bool ZoneGroupTopology::SameMembers(const Zone& a, const Zone& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (a[i].get() != b[i].get())
+      return false;
   return true;
 }
+
+TopologyChangeList ZoneGroupTopology::GetLastChanges()
+{
+  Locked<ZoneList>::pointer zones = m_zones.Get();
+  return m_changes;
+}
+
+std::string ZoneGroupTopology::GetLastZoneGroupState()
+{
+  Locked<ZoneList>::pointer zones = m_zones.Get();
+  return m_state;
+}
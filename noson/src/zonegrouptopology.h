@@ -53,8 +53,28 @@ namespace NSROOT
 
     bool GetZoneGroupState();
 
+    /**
+     * Load a state known before, i.e from a snapshot.
+     */
+    bool SetZoneGroupState(const std::string& xml) { return ParseZoneGroupState(xml); }
+
+    /**
+     * @return the last state parsed successfully
+     */
+    std::string GetLastZoneGroupState();
+
     unsigned GetTopologyKey() const { return m_topologyKey; }
 
+    /**
+     * The version is bumped by each state changing the topology.
+     */
+    unsigned GetVersion() const { return m_version; }
+
+    /**
+     * @return the changes made by the last version
+     */
+    TopologyChangeList GetLastChanges();
+
     Locked<ZoneList>& GetZoneList() { return m_zones; }
 
     Locked<ZonePlayerList>& GetZonePlayerList() { return m_zonePlayers; }
@@ -69,11 +89,16 @@ namespace NSROOT
     EventCB m_eventCB;
     unsigned m_msgCount;
     unsigned m_topologyKey;
+    unsigned m_version;
 
     Locked<ZoneList> m_zones;
     Locked<ZonePlayerList> m_zonePlayers;
+    std::string m_state;        ///< Guarded by the zone list
+    TopologyChangeList m_changes; ///< Guarded by the zone list
 
     bool ParseZoneGroupState(const std::string& xml);
+    static bool SamePlayer(const ZonePlayer& a, const ZonePlayer& b, bool withRole);
+    static bool SameMembers(const Zone& a, const Zone& b);
 
   };
 }
@@ -0,0 +1,163 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#endif
+
+#include "../../noson/src/private/socket.h"
+#include "../../noson/src/private/socketreader.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <cstdio>
+#include <string>
+
+/*
+ * Compares header parse throughput of the buffered socket reader with the
+ * former byte-at-a-time path. Messages are streamed through a socket pair.
+ */
+
+static const char* g_header =
+  "HTTP/1.1 200 OK\r\n"
+  "CONTENT-LENGTH: 0\r\n"
+  "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+  "EXT:\r\n"
+  "Server: Linux UPnP/1.0 Sonos/34.16-37101 (ZPS1)\r\n"
+  "Connection: close\r\n"
+  "X-Sonos-Reserved: 0123456789abcdef0123456789abcdef0123456789abcdef\r\n"
+  "SID: uuid:RINCON_000E58000000001400_sub0000001234\r\n"
+  "TIMEOUT: Second-300\r\n"
+  "\r\n";
+
+class PairSocket : public SONOS::TcpSocket
+{
+public:
+  PairSocket(net_socket_t s) { m_socket = s; }
+};
+
+/* the former implementation */
+static bool ReadHeaderLine(SONOS::NetSocket *socket, const char *eol, std::string& line, size_t *len)
+{
+  char buf[4000];
+  const char *s_eol;
+  int p = 0, p_eol = 0, l_eol;
+  size_t l = 0;
+
+  if (eol != NULL)
+    s_eol = eol;
+  else
+    s_eol = "\n";
+  l_eol = strlen(s_eol);
+
+  line.clear();
+  do
+  {
+    if (socket->ReceiveData(&buf[p], 1) > 0)
+    {
+      if (buf[p++] == s_eol[p_eol])
+      {
+        if (++p_eol >= l_eol)
+        {
+          buf[p - l_eol] = '\0';
+          line.append(buf);
+          l += p - l_eol;
+          break;
+        }
+      }
+      else
+      {
+        p_eol = 0;
+        if (p > (4000 - 2 - l_eol))
+        {
+          buf[p] = '\0';
+          line.append(buf);
+          l += p;
+          p = 0;
+        }
+      }
+    }
+    else
+    {
+      *len = l;
+      return false;
+    }
+  }
+  while (l < 4000);
+
+  *len = l;
+  return true;
+}
+
+static unsigned ParseLegacy(PairSocket& sock)
+{
+  std::string line;
+  size_t len;
+  unsigned n = 0;
+  while (ReadHeaderLine(&sock, "\r\n", line, &len) && len > 0)
+    ++n;
+  return n;
+}
+
+static unsigned ParseBuffered(SONOS::SocketReader& reader)
+{
+  std::string line;
+  size_t len;
+  unsigned n = 0;
+  while (reader.ReadLine("\r\n", line, &len) && len > 0)
+    ++n;
+  return n;
+}
+
+int main(int argc, char** argv)
+{
+  int count = 20000;
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+  {
+    perror("socketpair");
+    return 1;
+  }
+  PairSocket sock(sv[0]);
+  SONOS::SocketReader reader(&sock);
+  size_t hlen = strlen(g_header);
+  unsigned lines = 0;
+  int64_t start, legacy, buffered;
+
+  start = SONOS::OS::gettime_ms();
+  for (int i = 0; i < count; ++i)
+  {
+    if (write(sv[1], g_header, hlen) != (ssize_t)hlen)
+      return 1;
+    lines += ParseLegacy(sock);
+  }
+  legacy = SONOS::OS::gettime_ms() - start;
+
+  start = SONOS::OS::gettime_ms();
+  for (int i = 0; i < count; ++i)
+  {
+    if (write(sv[1], g_header, hlen) != (ssize_t)hlen)
+      return 1;
+    lines += ParseBuffered(reader);
+  }
+  buffered = SONOS::OS::gettime_ms() - start;
+
+  fprintf(stdout, "headers: %d x %u bytes, %u lines parsed\n", count, (unsigned)hlen, lines);
+  fprintf(stdout, "byte-at-a-time: %lld ms (%.1f MB/s)\n", (long long)legacy,
+          legacy ? (double)hlen * count / 1000.0 / legacy : 0.0);
+  fprintf(stdout, "buffered:       %lld ms (%.1f MB/s)\n", (long long)buffered,
+          buffered ? (double)hlen * count / 1000.0 / buffered : 0.0);
+  close(sv[1]);
+  return 0;
+}
@@ -0,0 +1,259 @@
+#include "../../noson/src/eventhandler.h"
+#include "../../noson/src/didlparser.h"
+#include "../../noson/src/private/eventreader.h"
+#include "../../noson/src/private/tinyxml2.h"
+#include "../../noson/src/private/xmldict.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Decodes a recorded AVT notification of a track change, as the event broker
+ * then AVTransport do, to compare the former DOM decoding with the streaming
+ * decoder. The LastChange document embeds the metadata of the current, next
+ * and enqueued tracks.
+ */
+
+#define DIDL_TRACK(id, title, album, uri) \
+  "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" " \
+  "xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\" xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">" \
+  "<item id=\"" id "\" parentID=\"A:TRACKS\" restricted=\"true\">" \
+  "<res protocolInfo=\"x-file-cifs:*:audio/flac:*\" duration=\"0:04:12\">" uri "</res>" \
+  "<r:streamContent></r:streamContent><upnp:albumArtURI>/getaa?s=1&amp;u=" uri "</upnp:albumArtURI>" \
+  "<dc:title>" title "</dc:title><upnp:class>object.item.audioItem.musicTrack</upnp:class>" \
+  "<dc:creator>The Band</dc:creator><upnp:album>" album "</upnp:album><r:albumArtist>The Band</r:albumArtist>" \
+  "<upnp:originalTrackNumber>3</upnp:originalTrackNumber></item></DIDL-Lite>"
+
+#define DIDL_QUEUE \
+  "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" " \
+  "xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\" xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">" \
+  "<item id=\"Q:0\" parentID=\"Q:\" restricted=\"true\"><dc:title>Queue</dc:title>" \
+  "<upnp:class>object.container.playlistContainer</upnp:class></item></DIDL-Lite>"
+
+static std::string Escape(const std::string& str)
+{
+  std::string ret;
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+  {
+    switch (*it)
+    {
+      case '&': ret.append("&amp;"); break;
+      case '<': ret.append("&lt;"); break;
+      case '>': ret.append("&gt;"); break;
+      case '"': ret.append("&quot;"); break;
+      default: ret.push_back(*it);
+    }
+  }
+  return ret;
+}
+
+static std::string MakeBody()
+{
+  std::string doc;
+  doc.append("<Event xmlns=\"urn:schemas-upnp-org:metadata-1-0/AVT/\" xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\">");
+  doc.append("<InstanceID val=\"0\">");
+  doc.append("<TransportState val=\"PLAYING\"/><CurrentPlayMode val=\"NORMAL\"/><CurrentCrossfadeMode val=\"0\"/>");
+  doc.append("<NumberOfTracks val=\"12\"/><CurrentTrack val=\"3\"/><CurrentSection val=\"0\"/>");
+  doc.append("<CurrentTrackURI val=\"x-file-cifs://nas/music/The%20Band/track03.flac\"/>");
+  doc.append("<CurrentTrackDuration val=\"0:04:12\"/>");
+  doc.append("<CurrentTrackMetaData val=\"").append(Escape(DIDL_TRACK("-1", "Third Song", "The Album", "x-file-cifs://nas/music/The%20Band/track03.flac"))).append("\"/>");
+  doc.append("<r:NextTrackURI val=\"x-file-cifs://nas/music/The%20Band/track04.flac\"/>");
+  doc.append("<r:NextTrackMetaData val=\"").append(Escape(DIDL_TRACK("-1", "Fourth Song", "The Album", "x-file-cifs://nas/music/The%20Band/track04.flac"))).append("\"/>");
+  doc.append("<r:EnqueuedTransportURI val=\"x-rincon-playlist:RINCON_000E58000001400#A:ALBUM/The%20Album\"/>");
+  doc.append("<r:EnqueuedTransportURIMetaData val=\"").append(Escape(DIDL_TRACK("A:ALBUM/The%20Album", "The Album", "The Album", "x-rincon-playlist:RINCON_000E58000001400#A:ALBUM/The%20Album"))).append("\"/>");
+  doc.append("<PlaybackStorageMedium val=\"NETWORK\"/>");
+  doc.append("<AVTransportURI val=\"x-rincon-queue:RINCON_000E58000001400#0\"/>");
+  doc.append("<AVTransportURIMetaData val=\"").append(Escape(DIDL_QUEUE)).append("\"/>");
+  doc.append("<NextAVTransportURI val=\"\"/><NextAVTransportURIMetaData val=\"\"/>");
+  doc.append("<CurrentTransportActions val=\"Set, Stop, Pause, Play, X_DLNA_SeekTime, Next, Previous, X_DLNA_SeekTrackNr\"/>");
+  doc.append("<r:CurrentValidPlayModes val=\"SHUFFLE,REPEAT,REPEATONE,CROSSFADE\"/>");
+  doc.append("<r:MuseSessions val=\"\"/><TransportStatus val=\"OK\"/><r:SleepTimerGeneration val=\"0\"/>");
+  doc.append("<r:AlarmRunning val=\"0\"/><r:SnoozeRunning val=\"0\"/><r:RestartPending val=\"0\"/>");
+  doc.append("<PossiblePlaybackStorageMedia val=\"NONE, NETWORK\"/>");
+  doc.append("</InstanceID></Event>");
+  std::string body("<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>");
+  body.append(Escape(doc)).append("</LastChange></e:property></e:propertyset>");
+  return body;
+}
+
+static SONOS::XMLDict InitAVTDict()
+{
+  SONOS::XMLDict dict;
+  dict.DefineNS("", "urn:schemas-upnp-org:metadata-1-0/AVT/");
+  dict.DefineNS("r:", "urn:schemas-rinconnetworks-com:metadata-1-0/");
+  return dict;
+}
+
+static SONOS::XMLDict InitDIDLDict()
+{
+  SONOS::XMLDict dict;
+  dict.DefineNS(DIDL_QNAME_DIDL, DIDL_XMLNS_DIDL);
+  dict.DefineNS(DIDL_QNAME_RINC, DIDL_XMLNS_RINC);
+  dict.DefineNS(DIDL_QNAME_DC, DIDL_XMLNS_DC);
+  dict.DefineNS(DIDL_QNAME_UPNP, DIDL_XMLNS_UPNP);
+  return dict;
+}
+
+static SONOS::XMLDict g_avtDict = InitAVTDict();
+static SONOS::XMLDict g_didlDict = InitDIDLDict();
+
+static bool IsMetaData(const std::string& name)
+{
+  return name.size() > 8 && name.compare(name.size() - 8, 8, "MetaData") == 0;
+}
+
+/* the former DIDL parser: the document is loaded in a DOM */
+static unsigned DOMParseDIDL(const char* document, std::vector<SONOS::DigitalItemPtr>& items)
+{
+  tinyxml2::XMLDocument doc;
+  if (doc.Parse(document) != tinyxml2::XML_SUCCESS)
+    return 0;
+  const tinyxml2::XMLElement* elem;
+  if (!(elem = doc.RootElement()) || !SONOS::XMLNS::NameEqual(elem->Name(), "DIDL-Lite"))
+    return 0;
+  SONOS::XMLNames xmlnames;
+  xmlnames.AddXMLNS(elem);
+  elem = elem->FirstChildElement();
+  while (elem)
+  {
+    const char* id = elem->Attribute("id");
+    const char* parentID = elem->Attribute("parentID");
+    if (id && parentID)
+    {
+      SONOS::ElementList vars;
+      const tinyxml2::XMLElement* velem = elem->FirstChildElement();
+      while (velem)
+      {
+        if (velem->Name() && velem->GetText())
+        {
+          SONOS::ElementPtr var(new SONOS::Element(g_didlDict.TranslateQName(xmlnames, velem->Name()), velem->GetText()));
+          const tinyxml2::XMLAttribute* vattr = velem->FirstAttribute();
+          while (vattr && vattr->Name() && vattr->Value())
+          {
+            var->SetAttribut(vattr->Name(), vattr->Value());
+            vattr = vattr->Next();
+          }
+          vars.push_back(var);
+        }
+        velem = velem->NextSiblingElement();
+      }
+      items.push_back(SONOS::DigitalItemPtr(new SONOS::DigitalItem(id, parentID, true, vars)));
+    }
+    elem = elem->NextSiblingElement();
+  }
+  return (unsigned)items.size();
+}
+
+/* the former decoding: outer DOM, inner DOM, then a DOM per metadata */
+static unsigned DecodeDOM(const std::string& body, std::vector<SONOS::DigitalItemPtr>& items)
+{
+  tinyxml2::XMLDocument rootdoc;
+  if (rootdoc.Parse(body.c_str(), body.size()) != tinyxml2::XML_SUCCESS)
+    return 0;
+  const tinyxml2::XMLElement* elem;
+  const tinyxml2::XMLNode* node;
+  if (!(elem = rootdoc.RootElement()) || !(node = elem->FirstChild()) ||
+          !(elem = node->FirstChildElement("LastChange")))
+    return 0;
+  tinyxml2::XMLDocument doc;
+  if (doc.Parse(elem->GetText()) != tinyxml2::XML_SUCCESS || !(elem = doc.RootElement()))
+    return 0;
+  SONOS::XMLNames docns;
+  docns.AddXMLNS(elem);
+  if (!(node = elem->FirstChildElement("InstanceID")))
+    return 0;
+  std::vector<std::string> subject;
+  elem = node->FirstChildElement(NULL);
+  while (elem)
+  {
+    subject.push_back(g_avtDict.TranslateQName(docns, elem->Name()));
+    const char* str = elem->Attribute("val");
+    subject.push_back(str ? str : "");
+    elem = elem->NextSiblingElement(NULL);
+  }
+  for (std::vector<std::string>::const_iterator it = subject.begin(); it != subject.end(); ++it)
+  {
+    if (IsMetaData(*it))
+      DOMParseDIDL((++it)->c_str(), items);
+    else
+      ++it;
+  }
+  return (unsigned)subject.size() / 2;
+}
+
+/* the streaming decoding */
+static unsigned DecodeStream(const std::string& body, std::vector<SONOS::DigitalItemPtr>& items)
+{
+  SONOS::EventMessage msg;
+  SONOS::EventReader reader(msg);
+  // fed as received by the event broker
+  for (size_t p = 0; p < body.size(); p += 4096)
+  {
+    if (!reader.Feed(body.c_str() + p, (body.size() - p < 4096 ? body.size() - p : 4096)))
+      return 0;
+  }
+  if (!reader.Finish())
+    return 0;
+  std::vector<SONOS::EventProperty>::const_iterator it;
+  for (it = msg.properties.begin(); it != msg.properties.end(); ++it)
+  {
+    switch (it->id)
+    {
+      case SONOS::PROPERTY_CurrentTrackMetaData:
+      case SONOS::PROPERTY_r_NextTrackMetaData:
+      case SONOS::PROPERTY_r_EnqueuedTransportURIMetaData:
+      case SONOS::PROPERTY_AVTransportURIMetaData:
+        // decoded by the reader in the same pass
+        if (it->item)
+          items.push_back(it->item);
+        break;
+      default:
+        break;
+    }
+  }
+  return (unsigned)msg.properties.size();
+}
+
+static void Run(const char* label, unsigned (*decode)(const std::string&, std::vector<SONOS::DigitalItemPtr>&),
+        const std::string& body, unsigned count)
+{
+  unsigned props = 0;
+  std::vector<SONOS::DigitalItemPtr> items;
+  int64_t elapsed = 0;
+  // keep the best of the rounds
+  for (unsigned r = 0; r < 5; ++r)
+  {
+    int64_t start = SONOS::OS::gettime_ms();
+    for (unsigned i = 0; i < count; ++i)
+    {
+      items.clear();
+      props = decode(body, items);
+    }
+    int64_t e = SONOS::OS::gettime_ms() - start;
+    if (r == 0 || e < elapsed)
+      elapsed = e;
+  }
+  std::string title;
+  if (!items.empty())
+    title = items[0]->GetValue("dc:title");
+  fprintf(stdout, "%-8s %u events in %lld ms (%.0f events/s), %u properties, %u items, title '%s'\n",
+          label, count, (long long)elapsed, elapsed ? 1000.0 * count / elapsed : 0.0,
+          props, (unsigned)items.size(), title.c_str());
+}
+
+int main(int argc, char** argv)
+{
+  unsigned count = 10000;
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  std::string body = MakeBody();
+  fprintf(stdout, "payload: %u bytes\n", (unsigned)body.size());
+  Run("dom", DecodeDOM, body, count);
+  Run("stream", DecodeStream, body, count);
+  return 0;
+}
@@ -0,0 +1,1089 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#endif
+
+#include "mockplayer.h"
+#include "../../noson/src/private/ssdpdiscovery.h"
+#include "../../noson/src/private/os/threads/event.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <cstdio>
+#include <list>
+
+#define SSDP_ADDR       "239.255.255.250"
+#define SSDP_PORT       1900
+#define SSDP_ST         "urn:schemas-upnp-org:device:ZonePlayer:1"
+#define SERVER_STRING   "Linux UPnP/1.0 Sonos/57.3-77280 (ZPS1)"
+#define SOFTWARE_VERSION "57.3-77280"
+#define HOUSEHOLD_ID    "Sonos_MockHousehold"
+
+#define URL_DESCRIPTION "/xml/device_description.xml"
+#define URL_AVT_CTRL    "/MediaRenderer/AVTransport/Control"
+#define URL_AVT_EVENT   "/MediaRenderer/AVTransport/Event"
+#define URL_RC_CTRL     "/MediaRenderer/RenderingControl/Control"
+#define URL_RC_EVENT    "/MediaRenderer/RenderingControl/Event"
+#define URL_CD_CTRL     "/MediaServer/ContentDirectory/Control"
+#define URL_CD_EVENT    "/MediaServer/ContentDirectory/Event"
+#define URL_ZGT_CTRL    "/ZoneGroupTopology/Control"
+#define URL_ZGT_EVENT   "/ZoneGroupTopology/Event"
+#define URL_MS_CTRL     "/MusicServices/Control"
+#define URL_DP_CTRL     "/DeviceProperties/Control"
+
+#define DIDL_HEADER     "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\" xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">"
+#define DIDL_FOOTER     "</DIDL-Lite>"
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Helpers
+////
+
+static std::string Escape(const std::string& str)
+{
+  std::string out;
+  out.reserve(str.size() + str.size() / 4);
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+  {
+    switch (*it)
+    {
+      case '&': out.append("&amp;"); break;
+      case '<': out.append("&lt;"); break;
+      case '>': out.append("&gt;"); break;
+      case '"': out.append("&quot;"); break;
+      default: out.push_back(*it);
+    }
+  }
+  return out;
+}
+
+static std::string Num(unsigned n)
+{
+  char buf[12];
+  snprintf(buf, sizeof(buf), "%u", n);
+  return buf;
+}
+
+/* the value of a header field, or empty */
+static std::string GetHeader(const std::string& msg, const char* name)
+{
+  size_t len = strlen(name);
+  size_t b = msg.find("\r\n");
+  size_t end = msg.find("\r\n\r\n");
+  while (b != std::string::npos && b < end)
+  {
+    b += 2;
+    if (msg.size() > b + len && msg[b + len] == ':' && strncasecmp(msg.c_str() + b, name, len) == 0)
+    {
+      size_t v = b + len + 1;
+      while (v < msg.size() && msg[v] == ' ')
+        ++v;
+      return msg.substr(v, msg.find("\r\n", v) - v);
+    }
+    b = msg.find("\r\n", b);
+  }
+  return std::string();
+}
+
+/* the text of an argument in a SOAP body, or empty */
+static std::string GetArg(const std::string& body, const char* name)
+{
+  std::string tag("<");
+  tag.append(name).append(">");
+  size_t b = body.find(tag);
+  if (b == std::string::npos)
+    return std::string();
+  b += tag.size();
+  return body.substr(b, body.find("</", b) - b);
+}
+
+static std::string Property(const char* name, const std::string& value)
+{
+  return std::string("<e:property><").append(name).append(">").append(value).append("</").append(name).append("></e:property>");
+}
+
+static std::string Envelope(const char* service, const std::string& action, const std::string& args)
+{
+  std::string xml("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+          "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\"><s:Body>");
+  xml.append("<u:").append(action).append("Response xmlns:u=\"urn:schemas-upnp-org:service:").append(service).append(":1\">");
+  xml.append(args);
+  xml.append("</u:").append(action).append("Response></s:Body></s:Envelope>");
+  return xml;
+}
+
+static std::string Arg(const char* name, const std::string& value)
+{
+  return std::string("<").append(name).append(">").append(value).append("</").append(name).append(">");
+}
+
+static void Reply(std::string& response, const char* status, const std::string& body, bool keepAlive)
+{
+  response.assign("HTTP/1.1 ").append(status).append("\r\n");
+  if (!body.empty())
+    response.append("CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n");
+  response.append("CONTENT-LENGTH: ").append(Num((unsigned)body.size())).append("\r\n");
+  response.append("SERVER: " SERVER_STRING "\r\n");
+  response.append(keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+  response.append("\r\n").append(body);
+}
+
+static void Fault(std::string& response, unsigned code, bool keepAlive)
+{
+  std::string xml("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+          "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\"><s:Body>"
+          "<s:Fault><faultcode>s:Client</faultcode><faultstring>UPnPError</faultstring><detail>"
+          "<UPnPError xmlns=\"urn:schemas-upnp-org:control-1-0\"><errorCode>");
+  xml.append(Num(code)).append("</errorCode></UPnPError></detail></s:Fault></s:Body></s:Envelope>");
+  Reply(response, "500 Internal Server Error", xml, keepAlive);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Connection: serves the requests of a client until it closes
+////
+
+class MockHousehold::Connection : public SONOS::OS::CWorker
+{
+public:
+  Connection(MockHousehold& household, unsigned zone, SONOS::TcpSocket* socket)
+  : m_household(household), m_zone(zone), m_socket(socket) { }
+  ~Connection() { delete m_socket; }
+
+  void Process()
+  {
+    struct timeval timeout = { 1, 0 };
+    m_socket->SetTimeout(timeout);
+    m_socket->SetReadAttempt(1);
+    std::string data;
+    char buf[4096];
+    int64_t idle = SONOS::OS::gettime_ms();
+    while (!m_household.m_stopping)
+    {
+      size_t e = data.find("\r\n\r\n");
+      if (e != std::string::npos)
+      {
+        size_t size = e + 4 + (size_t)atoi(GetHeader(data, "CONTENT-LENGTH").c_str());
+        if (data.size() >= size)
+        {
+          std::string request = data.substr(0, size);
+          data.erase(0, size);
+          unsigned delay = m_household.Delay();
+          if (delay)
+            usleep(delay * 1000);
+          std::string response, subscribed;
+          bool keepAlive = m_household.HandleRequest(m_zone, request, response, subscribed);
+          if (!m_socket->SendData(response.c_str(), response.size()))
+            break;
+          // the state is notified once the subscriber knows the SID
+          if (!subscribed.empty())
+            m_household.Notify(subscribed);
+          if (!keepAlive)
+            break;
+          idle = SONOS::OS::gettime_ms();
+          continue;
+        }
+      }
+      size_t r = m_socket->ReceiveSome(buf, sizeof(buf));
+      if (r > 0)
+        data.append(buf, r);
+      else if (m_socket->GetErrNo() != ETIMEDOUT || SONOS::OS::gettime_ms() - idle > MOCK_IDLE_TIMEOUT)
+        break;
+    }
+    m_socket->Disconnect();
+  }
+
+private:
+  MockHousehold& m_household;
+  unsigned m_zone;
+  SONOS::TcpSocket* m_socket;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Notifier: sends the event messages to the subscribers
+////
+
+class MockHousehold::Notifier : private SONOS::OS::CThread
+{
+public:
+  Notifier(MockHousehold& household) : m_household(household) { }
+  ~Notifier() { Stop(); }
+
+  bool Start() { return StartThread(); }
+  void Stop()
+  {
+    StopThread(false);
+    m_event.Signal();
+    StopThread(true);
+  }
+
+  void Post(const std::string& sid)
+  {
+    SONOS::OS::CLockGuard lock(m_mutex);
+    m_queue.push_back(sid);
+    m_event.Signal();
+  }
+
+private:
+  MockHousehold& m_household;
+  SONOS::OS::CMutex m_mutex;
+  SONOS::OS::CEvent m_event;
+  std::list<std::string> m_queue;
+
+  void* Process()
+  {
+    while (!IsStopped())
+    {
+      SONOS::OS::CLockGuard lock(m_mutex);
+      if (m_queue.empty())
+      {
+        lock.Unlock();
+        m_event.Wait(100);
+        continue;
+      }
+      std::string sid = m_queue.front();
+      m_queue.pop_front();
+      lock.Unlock();
+      Send(sid);
+    }
+    return NULL;
+  }
+
+  void Send(const std::string& sid)
+  {
+    SONOS::OS::CLockGuard lock(m_household.m_mutex);
+    std::map<std::string, Subscription>::iterator it = m_household.m_subscriptions.find(sid);
+    if (it == m_household.m_subscriptions.end())
+      return;
+    Subscription sub = it->second;
+    it->second.seq++;
+    std::string body = m_household.EventBody(sub.zone, sub.url);
+    lock.Unlock();
+    if (body.empty())
+      return;
+    std::string msg("NOTIFY ");
+    msg.append(sub.path).append(" HTTP/1.1\r\n");
+    msg.append("HOST: ").append(sub.host).append(":").append(Num(sub.port)).append("\r\n");
+    msg.append("CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n");
+    msg.append("CONTENT-LENGTH: ").append(Num((unsigned)body.size())).append("\r\n");
+    msg.append("NT: upnp:event\r\nNTS: upnp:propchange\r\n");
+    msg.append("SID: ").append(sid).append("\r\n");
+    msg.append("SEQ: ").append(Num(sub.seq)).append("\r\n\r\n");
+    msg.append(body);
+    SONOS::TcpSocket socket;
+    struct timeval timeout = { 2, 0 };
+    socket.SetTimeout(timeout);
+    socket.SetReadAttempt(1);
+    char buf[256];
+    bool done = (socket.Connect(sub.host.c_str(), sub.port, 0) &&
+            socket.SendData(msg.c_str(), msg.size()) &&
+            socket.ReceiveSome(buf, sizeof(buf)) > 0);
+    socket.Disconnect();
+    lock.Lock();
+    if (done)
+      m_household.m_stats.notifies++;
+    else
+      m_household.m_stats.failures++;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// Announcer: answers the discovery
+////
+
+class MockHousehold::Announcer : private SONOS::OS::CThread
+{
+public:
+  Announcer(MockHousehold& household) : m_household(household), m_socket(NULL) { }
+  ~Announcer()
+  {
+    Stop();
+  }
+
+  bool Start()
+  {
+    m_socket = new SONOS::UdpSocket();
+    if (!m_socket->SetAddress(SONOS::SOCKET_AF_INET4, SSDP_ADDR, SSDP_PORT) || !m_socket->Bind(SSDP_PORT))
+    {
+      delete m_socket;
+      m_socket = NULL;
+      return false;
+    }
+    std::vector<std::string> interfaces = SONOS::SSDPDiscovery::GetInterfaces();
+    for (std::vector<std::string>::const_iterator it = interfaces.begin(); it != interfaces.end(); ++it)
+      m_socket->JoinMulticastGroup(SSDP_ADDR, it->c_str());
+    m_socket->JoinMulticastGroup(SSDP_ADDR, NULL);
+    struct timeval timeout = { 0, 200000 };
+    m_socket->SetTimeout(timeout);
+    Announce("ssdp:alive");
+    return StartThread();
+  }
+
+  void Stop()
+  {
+    if (!m_socket)
+      return;
+    StopThread(true);
+    Announce("ssdp:byebye");
+    delete m_socket;
+    m_socket = NULL;
+  }
+
+private:
+  MockHousehold& m_household;
+  SONOS::UdpSocket* m_socket;
+
+  std::string Message(const char* firstLine, const char* nts, unsigned zone) const
+  {
+    std::string msg(firstLine);
+    msg.append("\r\nCACHE-CONTROL: max-age = 1800\r\nEXT:\r\n");
+    msg.append("LOCATION: ").append(m_household.GetLocation(zone)).append("\r\n");
+    msg.append("SERVER: " SERVER_STRING "\r\n");
+    if (nts)
+      msg.append("HOST: " SSDP_ADDR ":1900\r\nNT: " SSDP_ST "\r\nNTS: ").append(nts).append("\r\n");
+    else
+      msg.append("ST: " SSDP_ST "\r\n");
+    msg.append("USN: uuid:").append(m_household.GetUUID(zone)).append("::" SSDP_ST "\r\n");
+    msg.append("X-RINCON-HOUSEHOLD: " HOUSEHOLD_ID "\r\nX-RINCON-BOOTSEQ: 1\r\n\r\n");
+    return msg;
+  }
+
+  void Announce(const char* nts)
+  {
+    SONOS::UdpSocket sock;
+    if (!sock.SetAddress(SONOS::SOCKET_AF_INET4, SSDP_ADDR, SSDP_PORT))
+      return;
+    sock.SetMulticastTTL(1);
+    for (unsigned i = 0; i < m_household.GetZoneCount(); ++i)
+    {
+      std::string msg = Message("NOTIFY * HTTP/1.1", nts, i);
+      sock.SendData(msg.c_str(), msg.size());
+    }
+  }
+
+  void* Process()
+  {
+    char buf[2048];
+    while (!IsStopped())
+    {
+      size_t len = m_socket->ReceiveData(buf, sizeof(buf) - 1);
+      if (len == 0)
+        continue;
+      std::string msg(buf, len);
+      if (msg.compare(0, 8, "M-SEARCH") != 0)
+        continue;
+      std::string st = GetHeader(msg, "ST");
+      if (st != SSDP_ST && st != "ssdp:all")
+        continue;
+      SONOS::UdpSocket sock;
+      if (!sock.SetAddress(SONOS::SOCKET_AF_INET4, m_socket->GetRemoteIP().c_str(), m_socket->GetRemotePort()))
+        continue;
+      for (unsigned i = 0; i < m_household.GetZoneCount(); ++i)
+      {
+        std::string resp = Message("HTTP/1.1 200 OK", NULL, i);
+        sock.SendData(resp.c_str(), resp.size());
+      }
+      SONOS::OS::CLockGuard lock(m_household.m_mutex);
+      m_household.m_stats.searches++;
+    }
+    return NULL;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+////
+//// MockHousehold
+////
+
+MockHousehold::MockHousehold(const Options& options)
+: m_options(options)
+, m_zones()
+, m_systemUpdateID(1)
+, m_lastSID(0)
+, m_seed(1)
+, m_stopping(false)
+, m_subscriptions()
+, m_pool(256)
+, m_notifier(NULL)
+, m_announcer(NULL)
+{
+  memset(&m_stats, 0, sizeof(m_stats));
+  for (unsigned i = 0; i < options.zones; ++i)
+  {
+    char buf[64];
+    Zone zone;
+    zone.port = options.port + i;
+    snprintf(buf, sizeof(buf), "RINCON_000E5800%04X01400", zone.port);
+    zone.uuid.assign(buf);
+    snprintf(buf, sizeof(buf), "Room %u", i + 1);
+    zone.name.assign(buf);
+    zone.server = NULL;
+    zone.transportState.assign("STOPPED");
+    zone.track = 1;
+    zone.volume = 20;
+    zone.mute = false;
+    m_zones.push_back(zone);
+  }
+  m_pool.SetKeepAlive(1000);
+}
+
+MockHousehold::~MockHousehold()
+{
+  Stop();
+}
+
+bool MockHousehold::Start()
+{
+  m_stopping = false;
+  for (std::vector<Zone>::iterator it = m_zones.begin(); it != m_zones.end(); ++it)
+  {
+    it->server = new SONOS::TcpServerSocket();
+    if (!it->server->Create(SONOS::SOCKET_AF_INET4) || !it->server->Bind(it->port) || !it->server->ListenConnection())
+    {
+      fprintf(stderr, "%s: cannot listen on port %u\n", __FUNCTION__, it->port);
+      Stop();
+      return false;
+    }
+  }
+  m_notifier = new Notifier(*this);
+  if (!m_notifier->Start() || !StartThread())
+  {
+    Stop();
+    return false;
+  }
+  if (m_options.ssdp)
+  {
+    m_announcer = new Announcer(*this);
+    if (!m_announcer->Start())
+      fprintf(stderr, "%s: cannot answer the discovery\n", __FUNCTION__);
+  }
+  return true;
+}
+
+void MockHousehold::Stop()
+{
+  m_stopping = true;
+  delete m_announcer;
+  m_announcer = NULL;
+  StopThread(true);
+  // the connections give up within a second
+  int64_t start = SONOS::OS::gettime_ms();
+  while (m_pool.Size() > 0 && SONOS::OS::gettime_ms() - start < 5000)
+    usleep(10000);
+  delete m_notifier;
+  m_notifier = NULL;
+  for (std::vector<Zone>::iterator it = m_zones.begin(); it != m_zones.end(); ++it)
+  {
+    delete it->server;
+    it->server = NULL;
+  }
+}
+
+std::string MockHousehold::GetLocation(unsigned zone) const
+{
+  return std::string("http://" MOCK_ADDRESS ":").append(Num(m_zones[zone].port)).append(URL_DESCRIPTION);
+}
+
+std::string MockHousehold::GetUUID(unsigned zone) const
+{
+  return m_zones[zone].uuid;
+}
+
+std::string MockHousehold::GetGroup(unsigned zone) const
+{
+  return m_zones[zone].uuid + ":1";
+}
+
+MockHousehold::Stats MockHousehold::GetStats()
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  return m_stats;
+}
+
+void MockHousehold::SetLatency(unsigned latency, unsigned jitter)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  m_options.latency = latency;
+  m_options.jitter = jitter;
+}
+
+void MockHousehold::SetLibrarySize(unsigned tracks)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  m_options.tracks = tracks;
+  ++m_systemUpdateID;
+  lock.Unlock();
+  NotifyAll(m_zones.size(), URL_CD_EVENT);
+}
+
+void MockHousehold::SetTransportState(unsigned zone, const std::string& state)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  m_zones[zone].transportState = state;
+  lock.Unlock();
+  NotifyAll(zone, URL_AVT_EVENT);
+}
+
+void MockHousehold::SetTrack(unsigned zone, unsigned track)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  m_zones[zone].track = track;
+  lock.Unlock();
+  NotifyAll(zone, URL_AVT_EVENT);
+}
+
+void MockHousehold::SetVolume(unsigned zone, unsigned volume)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  m_zones[zone].volume = volume;
+  lock.Unlock();
+  NotifyAll(zone, URL_RC_EVENT);
+}
+
+bool MockHousehold::Execute(const std::string& line)
+{
+  char cmd[16];
+  unsigned a = 0, b = 0;
+  int n = sscanf(line.c_str(), "%15s %u %u", cmd, &a, &b);
+  if (n < 1 || cmd[0] == '#')
+    return true;
+  // the zone of the command, or all
+  unsigned first = 0, last = (unsigned)m_zones.size();
+  bool zoned = (strcmp(cmd, "play") == 0 || strcmp(cmd, "pause") == 0 || strcmp(cmd, "stop") == 0 ||
+          strcmp(cmd, "track") == 0 || strcmp(cmd, "volume") == 0);
+  if (zoned && n > 1 && a > 0)
+  {
+    if (a > last)
+      return false;
+    first = a - 1;
+    last = a;
+  }
+  if (strcmp(cmd, "latency") == 0 && n > 1)
+    SetLatency(a, n > 2 ? b : 0);
+  else if (strcmp(cmd, "tracks") == 0 && n > 1)
+    SetLibrarySize(a);
+  else if (strcmp(cmd, "play") == 0 || strcmp(cmd, "pause") == 0 || strcmp(cmd, "stop") == 0)
+  {
+    const char* state = (cmd[1] == 'l' ? "PLAYING" : cmd[1] == 'a' ? "PAUSED_PLAYBACK" : "STOPPED");
+    for (unsigned i = first; i < last; ++i)
+      SetTransportState(i, state);
+  }
+  else if (strcmp(cmd, "track") == 0 && n > 2)
+  {
+    for (unsigned i = first; i < last; ++i)
+      SetTrack(i, b);
+  }
+  else if (strcmp(cmd, "volume") == 0 && n > 2)
+  {
+    for (unsigned i = first; i < last; ++i)
+      SetVolume(i, b);
+  }
+  else if (strcmp(cmd, "sleep") == 0 && n > 1)
+    usleep(a * 1000);
+  else if (strcmp(cmd, "stats") == 0)
+  {
+    Stats stats = GetStats();
+    fprintf(stdout, "requests %u, subscribes %u, renewals %u, unsubscribes %u, notifies %u, failures %u, searches %u\n",
+            stats.requests, stats.subscribes, stats.renewals, stats.unsubscribes, stats.notifies, stats.failures, stats.searches);
+  }
+  else
+    return false;
+  return true;
+}
+
+void* MockHousehold::Process()
+{
+  while (!IsStopped())
+  {
+    fd_set fds;
+    FD_ZERO(&fds);
+    net_socket_t maxfd = 0;
+    for (std::vector<Zone>::const_iterator it = m_zones.begin(); it != m_zones.end(); ++it)
+    {
+      FD_SET(it->server->GetSocket(), &fds);
+      if (it->server->GetSocket() > maxfd)
+        maxfd = it->server->GetSocket();
+    }
+    struct timeval tv = { 0, 100000 };
+    if (select(maxfd + 1, &fds, NULL, NULL, &tv) <= 0)
+      continue;
+    for (unsigned i = 0; i < m_zones.size(); ++i)
+    {
+      if (!FD_ISSET(m_zones[i].server->GetSocket(), &fds))
+        continue;
+      SONOS::TcpSocket* socket = new SONOS::TcpSocket();
+      if (!m_zones[i].server->AcceptConnection(*socket))
+      {
+        delete socket;
+        continue;
+      }
+      Connection* worker = new Connection(*this, i, socket);
+      if (!m_pool.Enqueue(worker))
+        delete worker;
+    }
+  }
+  return NULL;
+}
+
+unsigned MockHousehold::Delay()
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  if (m_options.jitter == 0)
+    return m_options.latency;
+  m_seed = m_seed * 1103515245 + 12345;
+  return m_options.latency + (m_seed >> 16) % (m_options.jitter + 1);
+}
+
+bool MockHousehold::HandleRequest(unsigned zone, const std::string& request, std::string& response, std::string& subscribed)
+{
+  size_t e = request.find(' ');
+  std::string method = request.substr(0, e);
+  std::string url = request.substr(e + 1, request.find(' ', e + 1) - e - 1);
+  std::string connection = GetHeader(request, "Connection");
+  bool keepAlive = (strncasecmp(connection.c_str(), "close", 5) != 0);
+
+  if (method == "GET" || method == "HEAD")
+  {
+    if (url != URL_DESCRIPTION)
+    {
+      Reply(response, "404 Not Found", std::string(), keepAlive);
+      return keepAlive;
+    }
+    const Zone& z = m_zones[zone];
+    std::string xml("<?xml version=\"1.0\" encoding=\"utf-8\" ?>"
+            "<root xmlns=\"urn:schemas-upnp-org:device-1-0\"><specVersion><major>1</major><minor>0</minor></specVersion><device>"
+            "<deviceType>" SSDP_ST "</deviceType>");
+    xml.append("<friendlyName>" MOCK_ADDRESS " - Mock - ").append(z.uuid).append("</friendlyName>");
+    xml.append("<manufacturer>Sonos, Inc.</manufacturer><modelNumber>S1</modelNumber><modelName>Mock</modelName>");
+    xml.append("<softwareVersion>" SOFTWARE_VERSION "</softwareVersion>");
+    xml.append("<roomName>").append(Escape(z.name)).append("</roomName>");
+    xml.append("<UDN>uuid:").append(z.uuid).append("</UDN></device></root>");
+    Reply(response, "200 OK", xml, keepAlive);
+    if (method == "HEAD")
+      response.erase(response.size() - xml.size());
+    return keepAlive;
+  }
+  if (method == "SUBSCRIBE")
+  {
+    HandleSubscribe(zone, url, request, keepAlive, response);
+    if (!GetHeader(request, "Callback").empty())
+      subscribed = GetHeader(response, "SID");
+    return keepAlive;
+  }
+  if (method == "UNSUBSCRIBE")
+  {
+    HandleUnsubscribe(request, keepAlive, response);
+    return keepAlive;
+  }
+  if (method == "POST")
+  {
+    std::string action = GetHeader(request, "SOAPAction");
+    size_t p = action.find('#');
+    action = (p == std::string::npos ? std::string() : action.substr(p + 1));
+    if (!action.empty() && action[action.size() - 1] == '"')
+      action.erase(action.size() - 1);
+    std::string body = request.substr(request.find("\r\n\r\n") + 4);
+    SONOS::OS::CLockGuard lock(m_mutex);
+    m_stats.requests++;
+    lock.Unlock();
+    if (!HandleControl(zone, url, action, body, keepAlive, response))
+      Fault(response, 401, keepAlive);
+    return keepAlive;
+  }
+  Reply(response, "405 Method Not Allowed", std::string(), false);
+  return false;
+}
+
+bool MockHousehold::HandleControl(unsigned zone, const std::string& url, const std::string& action, const std::string& body, bool keepAlive, std::string& response)
+{
+  std::string args;
+  const char* service;
+  std::string notify;
+  SONOS::OS::CLockGuard lock(m_mutex);
+  Zone& z = m_zones[zone];
+
+  if (url == URL_AVT_CTRL)
+  {
+    service = "AVTransport";
+    if (action == "GetTransportInfo")
+      args.append(Arg("CurrentTransportState", z.transportState)).append(Arg("CurrentTransportStatus", "OK")).append(Arg("CurrentSpeed", "1"));
+    else if (action == "GetPositionInfo")
+    {
+      std::string id = std::string("Q:0/").append(Num(z.track));
+      args.append(Arg("Track", Num(z.track))).append(Arg("TrackDuration", "0:04:00"));
+      args.append(Arg("TrackMetaData", Escape(DIDL_HEADER + TrackDIDL(z.track - 1, id, "Q:0") + DIDL_FOOTER)));
+      args.append(Arg("TrackURI", std::string("x-file-cifs://mock/music/track").append(Num(z.track)).append(".flac")));
+      args.append(Arg("RelTime", "0:01:00")).append(Arg("AbsTime", "NOT_IMPLEMENTED"));
+      args.append(Arg("RelCount", "2147483647")).append(Arg("AbsCount", "2147483647"));
+    }
+    else if (action == "GetMediaInfo")
+    {
+      unsigned queue = m_options.tracks < MOCK_QUEUE_SIZE ? m_options.tracks : MOCK_QUEUE_SIZE;
+      args.append(Arg("NrTracks", Num(queue))).append(Arg("MediaDuration", "NOT_IMPLEMENTED"));
+      args.append(Arg("CurrentURI", std::string("x-rincon-queue:").append(z.uuid).append("#0")));
+      args.append(Arg("CurrentURIMetaData", "")).append(Arg("NextURI", "")).append(Arg("NextURIMetaData", ""));
+      args.append(Arg("PlayMedium", "NETWORK")).append(Arg("RecordMedium", "NOT_IMPLEMENTED")).append(Arg("WriteStatus", "NOT_IMPLEMENTED"));
+    }
+    else if (action == "GetRemainingSleepTimerDuration")
+      args.append(Arg("RemainingSleepTimerDuration", "")).append(Arg("CurrentSleepTimerGeneration", "0"));
+    else if (action == "Play")
+      z.transportState.assign("PLAYING");
+    else if (action == "Pause")
+      z.transportState.assign("PAUSED_PLAYBACK");
+    else if (action == "Stop")
+      z.transportState.assign("STOPPED");
+    else if (action == "Next")
+      ++z.track;
+    else if (action == "Previous")
+      z.track = (z.track > 1 ? z.track - 1 : 1);
+    else if (action == "Seek" && GetArg(body, "Unit") == "TRACK_NR")
+      z.track = (unsigned)atoi(GetArg(body, "Target").c_str());
+    if (action == "Play" || action == "Pause" || action == "Stop" || action == "Next" || action == "Previous" || action == "Seek")
+      notify = URL_AVT_EVENT;
+  }
+  else if (url == URL_RC_CTRL)
+  {
+    service = "RenderingControl";
+    if (action == "GetVolume")
+      args.append(Arg("CurrentVolume", Num(z.volume)));
+    else if (action == "GetMute")
+      args.append(Arg("CurrentMute", z.mute ? "1" : "0"));
+    else if (action == "SetVolume")
+    {
+      z.volume = (unsigned)atoi(GetArg(body, "DesiredVolume").c_str());
+      notify = URL_RC_EVENT;
+    }
+    else if (action == "SetMute")
+    {
+      z.mute = (GetArg(body, "DesiredMute") == "1");
+      notify = URL_RC_EVENT;
+    }
+  }
+  else if (url == URL_CD_CTRL)
+  {
+    service = "ContentDirectory";
+    if (action == "Browse")
+    {
+      unsigned returned = 0, total = 0;
+      std::string didl = Browse(GetArg(body, "ObjectID"), (unsigned)atoi(GetArg(body, "StartingIndex").c_str()),
+              (unsigned)atoi(GetArg(body, "RequestedCount").c_str()), returned, total);
+      args.append(Arg("Result", Escape(didl))).append(Arg("NumberReturned", Num(returned)));
+      args.append(Arg("TotalMatches", Num(total))).append(Arg("UpdateID", Num(m_systemUpdateID)));
+    }
+  }
+  else if (url == URL_ZGT_CTRL)
+  {
+    service = "ZoneGroupTopology";
+    if (action == "GetZoneGroupState")
+      args.append(Arg("ZoneGroupState", Escape(ZoneGroupState())));
+  }
+  else if (url == URL_MS_CTRL)
+  {
+    service = "MusicServices";
+    if (action == "ListAvailableServices")
+    {
+      args.append(Arg("AvailableServiceDescriptorList", Escape("<Services></Services>")));
+      args.append(Arg("AvailableServiceTypeList", "")).append(Arg("AvailableServiceListVersion", "RINCON_MOCK:1"));
+    }
+  }
+  else if (url == URL_DP_CTRL)
+  {
+    service = "DeviceProperties";
+    if (action == "GetZoneAttributes")
+      args.append(Arg("CurrentZoneName", Escape(z.name))).append(Arg("CurrentIcon", "x-rincon-roomicon:living")).append(Arg("CurrentConfiguration", "1"));
+    else if (action == "GetZoneInfo")
+      args.append(Arg("SerialNumber", "00-0E-58-00-00-00:0")).append(Arg("SoftwareVersion", SOFTWARE_VERSION)).append(Arg("IPAddress", MOCK_ADDRESS));
+    else if (action == "GetHouseholdID")
+      args.append(Arg("CurrentHouseholdID", HOUSEHOLD_ID));
+  }
+  else
+    return false;
+  lock.Unlock();
+  if (action.empty())
+    return false;
+  // any other action succeeds without effect
+  Reply(response, "200 OK", Envelope(service, action, args), keepAlive);
+  if (!notify.empty())
+    NotifyAll(zone, notify);
+  return true;
+}
+
+bool MockHousehold::HandleSubscribe(unsigned zone, const std::string& url, const std::string& request, bool keepAlive, std::string& response)
+{
+  std::string sid = GetHeader(request, "SID");
+  SONOS::OS::CLockGuard lock(m_mutex);
+  if (!sid.empty())
+  {
+    // renewal
+    if (m_subscriptions.find(sid) == m_subscriptions.end())
+    {
+      Reply(response, "412 Precondition Failed", std::string(), keepAlive);
+      return false;
+    }
+    m_stats.renewals++;
+  }
+  else
+  {
+    // Callback: <http://host:port/path>
+    std::string callback = GetHeader(request, "Callback");
+    size_t b = callback.find("://");
+    if (url.find("/Event") == std::string::npos)
+    {
+      Reply(response, "404 Not Found", std::string(), keepAlive);
+      return false;
+    }
+    if (b == std::string::npos)
+    {
+      Reply(response, "412 Precondition Failed", std::string(), keepAlive);
+      return false;
+    }
+    b += 3;
+    size_t c = callback.find(':', b);
+    size_t p = callback.find_first_of("/>", b);
+    Subscription sub;
+    sub.zone = zone;
+    sub.url = url;
+    sub.host = callback.substr(b, (c < p ? c : p) - b);
+    sub.port = (c < p ? (unsigned)atoi(callback.c_str() + c + 1) : 80);
+    sub.path = (p != std::string::npos && callback[p] == '/' ? callback.substr(p, callback.find('>', p) - p) : "/");
+    sub.seq = 0;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "uuid:%s_sub%010u", m_zones[zone].uuid.c_str(), ++m_lastSID);
+    sid.assign(buf);
+    m_subscriptions.insert(std::make_pair(sid, sub));
+    m_stats.subscribes++;
+  }
+  lock.Unlock();
+  Reply(response, "200 OK", std::string(), keepAlive);
+  // insert the fields of the subscription before the empty line
+  response.insert(response.size() - 2, std::string("SID: ").append(sid).append("\r\nTIMEOUT: Second-3600\r\n"));
+  return true;
+}
+
+bool MockHousehold::HandleUnsubscribe(const std::string& request, bool keepAlive, std::string& response)
+{
+  SONOS::OS::CLockGuard lock(m_mutex);
+  if (m_subscriptions.erase(GetHeader(request, "SID")) == 0)
+  {
+    Reply(response, "412 Precondition Failed", std::string(), keepAlive);
+    return false;
+  }
+  m_stats.unsubscribes++;
+  lock.Unlock();
+  Reply(response, "200 OK", std::string(), keepAlive);
+  return true;
+}
+
+void MockHousehold::Notify(const std::string& sid)
+{
+  if (m_notifier)
+    m_notifier->Post(sid);
+}
+
+void MockHousehold::NotifyAll(unsigned zone, const std::string& url)
+{
+  std::vector<std::string> sids;
+  SONOS::OS::CLockGuard lock(m_mutex);
+  for (std::map<std::string, Subscription>::const_iterator it = m_subscriptions.begin(); it != m_subscriptions.end(); ++it)
+  {
+    // the zone is out of range for all
+    if (it->second.url == url && (zone >= m_zones.size() || it->second.zone == zone))
+      sids.push_back(it->first);
+  }
+  lock.Unlock();
+  for (std::vector<std::string>::const_iterator it = sids.begin(); it != sids.end(); ++it)
+    Notify(*it);
+}
+
+std::string MockHousehold::ZoneGroupState() const
+{
+  std::string xml("<ZoneGroups>");
+  for (unsigned i = 0; i < m_zones.size(); ++i)
+  {
+    const Zone& z = m_zones[i];
+    xml.append("<ZoneGroup Coordinator=\"").append(z.uuid).append("\" ID=\"").append(GetGroup(i)).append("\">");
+    xml.append("<ZoneGroupMember UUID=\"").append(z.uuid).append("\" Location=\"").append(GetLocation(i));
+    xml.append("\" ZoneName=\"").append(Escape(z.name)).append("\" Icon=\"x-rincon-roomicon:living\"");
+    xml.append(" SoftwareVersion=\"" SOFTWARE_VERSION "\" MinCompatibleVersion=\"56.0-00000\" LegacyCompatibleVersion=\"36.0-00000\" BootSeq=\"1\"/>");
+    xml.append("</ZoneGroup>");
+  }
+  xml.append("</ZoneGroups>");
+  return xml;
+}
+
+std::string MockHousehold::TrackDIDL(unsigned index, const std::string& id, const std::string& parentID) const
+{
+  unsigned album = index / MOCK_ALBUM_TRACKS + 1;
+  unsigned artist = (album - 1) / MOCK_ARTIST_ALBUMS + 1;
+  unsigned number = index % MOCK_ALBUM_TRACKS + 1;
+  std::string path = std::string("Artist%20").append(Num(artist)).append("/Album%20").append(Num(album))
+          .append("/Track%20").append(Num(index + 1)).append(".flac");
+  std::string xml("<item id=\"");
+  xml.append(Escape(id)).append("\" parentID=\"").append(Escape(parentID)).append("\" restricted=\"true\">");
+  xml.append("<res protocolInfo=\"x-file-cifs:*:audio/flac:*\" duration=\"0:04:00\">x-file-cifs://mock/music/").append(path).append("</res>");
+  xml.append("<upnp:albumArtURI>/getaa?u=x-file-cifs%3a%2f%2fmock%2fmusic%2f").append(Num(index + 1)).append("&amp;v=1</upnp:albumArtURI>");
+  xml.append("<dc:title>Track ").append(Num(index + 1)).append("</dc:title>");
+  xml.append("<upnp:class>object.item.audioItem.musicTrack</upnp:class>");
+  xml.append("<dc:creator>Artist ").append(Num(artist)).append("</dc:creator>");
+  xml.append("<upnp:album>Album ").append(Num(album)).append("</upnp:album>");
+  xml.append("<upnp:genre>Genre ").append(Num((artist - 1) % MOCK_GENRES + 1)).append("</upnp:genre>");
+  xml.append("<upnp:originalTrackNumber>").append(Num(number)).append("</upnp:originalTrackNumber>");
+  xml.append("</item>");
+  return xml;
+}
+
+std::string MockHousehold::Browse(const std::string& objectId, unsigned index, unsigned count, unsigned& returned, unsigned& total) const
+{
+  // the library: tracks are grouped by albums, albums by artists
+  unsigned tracks = m_options.tracks;
+  unsigned albums = (tracks + MOCK_ALBUM_TRACKS - 1) / MOCK_ALBUM_TRACKS;
+  unsigned artists = (albums + MOCK_ARTIST_ALBUMS - 1) / MOCK_ARTIST_ALBUMS;
+  enum { ROOT, TRACKS, ALBUMS, ARTISTS, GENRES, QUEUE, NONE } kind = NONE;
+  unsigned first = 0;
+  if (objectId == "A:")
+  {
+    kind = ROOT;
+    total = 3;
+  }
+  else if (objectId == "A:TRACKS")
+  {
+    kind = TRACKS;
+    total = tracks;
+  }
+  else if (objectId == "A:ALBUM")
+  {
+    kind = ALBUMS;
+    total = albums;
+  }
+  else if (objectId == "A:ARTIST" || objectId == "A:ALBUMARTIST")
+  {
+    kind = ARTISTS;
+    total = artists;
+  }
+  else if (objectId == "A:GENRE")
+  {
+    kind = GENRES;
+    total = artists < MOCK_GENRES ? artists : MOCK_GENRES;
+  }
+  else if (objectId == "Q:0")
+  {
+    kind = QUEUE;
+    total = tracks < MOCK_QUEUE_SIZE ? tracks : MOCK_QUEUE_SIZE;
+  }
+  else if (objectId.compare(0, 14, "A:ALBUM/Album%") == 0)
+  {
+    // tracks of the album
+    unsigned album = (unsigned)atoi(objectId.c_str() + 16);
+    kind = TRACKS;
+    first = (album > 0 ? album - 1 : albums) * MOCK_ALBUM_TRACKS;
+    total = (first < tracks ? (tracks - first < MOCK_ALBUM_TRACKS ? tracks - first : MOCK_ALBUM_TRACKS) : 0);
+  }
+  else if (objectId.compare(0, 16, "A:ARTIST/Artist%") == 0)
+  {
+    // albums of the artist
+    unsigned artist = (unsigned)atoi(objectId.c_str() + 18);
+    kind = ALBUMS;
+    first = (artist > 0 ? artist - 1 : artists) * MOCK_ARTIST_ALBUMS;
+    total = (first < albums ? (albums - first < MOCK_ARTIST_ALBUMS ? albums - first : MOCK_ARTIST_ALBUMS) : 0);
+  }
+  else
+    total = 0;
+
+  static const char* root[] = { "A:ARTIST", "Artists", "A:ALBUM", "Albums", "A:TRACKS", "Tracks" };
+  std::string xml(DIDL_HEADER);
+  returned = 0;
+  if (m_options.limit && (count == 0 || count > m_options.limit))
+    count = m_options.limit;
+  for (unsigned i = index; i < total && (count == 0 || returned < count); ++i, ++returned)
+  {
+    unsigned n = first + i;
+    switch (kind)
+    {
+      case ROOT:
+        xml.append("<container id=\"").append(root[2 * i]).append("\" parentID=\"A:\" restricted=\"true\">");
+        xml.append("<dc:title>").append(root[2 * i + 1]).append("</dc:title><upnp:class>object.container</upnp:class></container>");
+        break;
+      case TRACKS:
+        xml.append(TrackDIDL(n, std::string("S://mock/music/track").append(Num(n + 1)).append(".flac"), objectId));
+        break;
+      case QUEUE:
+        xml.append(TrackDIDL(n, std::string("Q:0/").append(Num(n + 1)), objectId));
+        break;
+      case ALBUMS:
+        xml.append("<container id=\"A:ALBUM/Album%20").append(Num(n + 1)).append("\" parentID=\"").append(Escape(objectId)).append("\" restricted=\"true\">");
+        xml.append("<dc:title>Album ").append(Num(n + 1)).append("</dc:title><upnp:class>object.container.album.musicAlbum</upnp:class>");
+        xml.append("<dc:creator>Artist ").append(Num(n / MOCK_ARTIST_ALBUMS + 1)).append("</dc:creator></container>");
+        break;
+      case ARTISTS:
+        xml.append("<container id=\"").append(objectId).append("/Artist%20").append(Num(n + 1)).append("\" parentID=\"").append(objectId).append("\" restricted=\"true\">");
+        xml.append("<dc:title>Artist ").append(Num(n + 1)).append("</dc:title><upnp:class>object.container.person.musicArtist</upnp:class></container>");
+        break;
+      case GENRES:
+        xml.append("<container id=\"A:GENRE/Genre%20").append(Num(n + 1)).append("\" parentID=\"A:GENRE\" restricted=\"true\">");
+        xml.append("<dc:title>Genre ").append(Num(n + 1)).append("</dc:title><upnp:class>object.container.genre.musicGenre</upnp:class></container>");
+        break;
+      default:
+        break;
+    }
+  }
+  xml.append(DIDL_FOOTER);
+  return xml;
+}
+
+std::string MockHousehold::EventBody(unsigned zone, const std::string& url) const
+{
+  const Zone& z = m_zones[zone];
+  std::string lastChange;
+  std::string xml("<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\">");
+  if (url == URL_AVT_EVENT)
+  {
+    unsigned queue = m_options.tracks < MOCK_QUEUE_SIZE ? m_options.tracks : MOCK_QUEUE_SIZE;
+    lastChange.append("<Event xmlns=\"urn:schemas-upnp-org:metadata-1-0/AVT/\" xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\"><InstanceID val=\"0\">");
+    lastChange.append("<TransportState val=\"").append(z.transportState).append("\"/>");
+    lastChange.append("<CurrentPlayMode val=\"NORMAL\"/><CurrentCrossfadeMode val=\"0\"/>");
+    lastChange.append("<NumberOfTracks val=\"").append(Num(queue)).append("\"/>");
+    lastChange.append("<CurrentTrack val=\"").append(Num(z.track)).append("\"/><CurrentSection val=\"0\"/>");
+    lastChange.append("<CurrentTrackURI val=\"x-file-cifs://mock/music/track").append(Num(z.track)).append(".flac\"/>");
+    lastChange.append("<CurrentTrackDuration val=\"0:04:00\"/>");
+    lastChange.append("<AVTransportURI val=\"x-rincon-queue:").append(z.uuid).append("#0\"/>");
+    lastChange.append("</InstanceID></Event>");
+    xml.append(Property("LastChange", Escape(lastChange)));
+  }
+  else if (url == URL_RC_EVENT)
+  {
+    lastChange.append("<Event xmlns=\"urn:schemas-upnp-org:metadata-1-0/RCS/\"><InstanceID val=\"0\">");
+    lastChange.append("<Volume channel=\"Master\" val=\"").append(Num(z.volume)).append("\"/>");
+    lastChange.append("<Volume channel=\"LF\" val=\"100\"/><Volume channel=\"RF\" val=\"100\"/>");
+    lastChange.append("<Mute channel=\"Master\" val=\"").append(z.mute ? "1" : "0").append("\"/>");
+    lastChange.append("<Bass val=\"0\"/><Treble val=\"0\"/><Loudness channel=\"Master\" val=\"1\"/><OutputFixed val=\"0\"/>");
+    lastChange.append("</InstanceID></Event>");
+    xml.append(Property("LastChange", Escape(lastChange)));
+  }
+  else if (url == URL_CD_EVENT)
+  {
+    xml.append(Property("SystemUpdateID", Num(m_systemUpdateID)));
+    xml.append(Property("ContainerUpdateIDs", std::string("A:,").append(Num(m_systemUpdateID))));
+  }
+  else if (url == URL_ZGT_EVENT)
+  {
+    xml.append(Property("ZoneGroupState", Escape(ZoneGroupState())));
+    xml.append(Property("ThirdPartyMediaServersX", "0"));
+  }
+  else
+    return std::string();
+  xml.append("</e:propertyset>");
+  return xml;
+}
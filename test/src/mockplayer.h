@@ -0,0 +1,165 @@
+#ifndef MOCKPLAYER_H
+#define MOCKPLAYER_H
+
+#include "../../noson/src/private/socket.h"
+#include "../../noson/src/private/os/threads/thread.h"
+#include "../../noson/src/private/os/threads/threadpool.h"
+#include "../../noson/src/private/os/threads/mutex.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * Simulates a household of zone players on localhost, so the whole stack can
+ * be driven without hardware.
+ * - SSDP: the players answer M-SEARCH, and announce themselves on start.
+ * - HTTP: device description, and the control URLs of AVTransport,
+ *   RenderingControl, ContentDirectory, ZoneGroupTopology, MusicServices and
+ *   DeviceProperties.
+ * - GENA: subscriptions are accepted, then the state is notified to the
+ *   subscriber once, and on each change.
+ * Each player listens on its own port, starting from the base port. The
+ * latency of the responses and the size of the music library can be changed
+ * at any time, from the code or by script (see Execute).
+ */
+
+#define MOCK_ADDRESS        "127.0.0.1"
+#define MOCK_BASE_PORT      14400
+#define MOCK_IDLE_TIMEOUT   5000
+#define MOCK_QUEUE_SIZE     100
+#define MOCK_ALBUM_TRACKS   10
+#define MOCK_ARTIST_ALBUMS  4
+#define MOCK_GENRES         8
+
+class MockHousehold : private SONOS::OS::CThread
+{
+public:
+  struct Options
+  {
+    unsigned zones;         ///< count of players, one per group
+    unsigned port;          ///< port of the first player
+    unsigned latency;       ///< delay of a response in ms
+    unsigned jitter;        ///< random delay added in ms
+    unsigned tracks;        ///< size of the music library
+    unsigned limit;         ///< most items returned by a browse, 0 for all
+    bool ssdp;              ///< answer the discovery
+    Options() : zones(1), port(MOCK_BASE_PORT), latency(0), jitter(0), tracks(1000), limit(0), ssdp(true) { }
+  };
+
+  struct Stats
+  {
+    unsigned requests;      ///< control requests served
+    unsigned subscribes;    ///< new subscriptions
+    unsigned renewals;
+    unsigned unsubscribes;
+    unsigned notifies;      ///< event messages sent
+    unsigned failures;      ///< event messages not delivered
+    unsigned searches;      ///< M-SEARCH answered
+  };
+
+  MockHousehold(const Options& options);
+  ~MockHousehold();
+
+  bool Start();
+  void Stop();
+
+  /**
+   * The location of the device description of a player.
+   */
+  std::string GetLocation(unsigned zone) const;
+  std::string GetUUID(unsigned zone) const;
+  std::string GetGroup(unsigned zone) const;
+  unsigned GetZoneCount() const { return (unsigned)m_zones.size(); }
+  Stats GetStats();
+
+  void SetLatency(unsigned latency, unsigned jitter);
+  /**
+   * Change the size of the library. The content directory subscribers are
+   * notified of the new update id.
+   */
+  void SetLibrarySize(unsigned tracks);
+  void SetTransportState(unsigned zone, const std::string& state);
+  void SetTrack(unsigned zone, unsigned track);
+  void SetVolume(unsigned zone, unsigned volume);
+
+  /**
+   * Execute a line of script. The commands are:
+   *   latency <ms> [<jitter ms>]
+   *   tracks <count>
+   *   play|pause|stop <zone>
+   *   track <zone> <number>
+   *   volume <zone> <value>
+   *   sleep <ms>
+   *   stats
+   * A zone is numbered from 1, or 0 for all.
+   * @return false if the command is unknown
+   */
+  bool Execute(const std::string& line);
+
+private:
+  struct Zone
+  {
+    std::string uuid;
+    std::string name;
+    unsigned port;
+    SONOS::TcpServerSocket* server;
+    std::string transportState;
+    unsigned track;
+    unsigned volume;
+    bool mute;
+  };
+
+  struct Subscription
+  {
+    unsigned zone;
+    std::string url;
+    std::string host;
+    unsigned port;
+    std::string path;
+    unsigned seq;
+  };
+
+  class Connection;
+  class Notifier;
+  class Announcer;
+  friend class Connection;
+  friend class Notifier;
+  friend class Announcer;
+
+  Options m_options;
+  std::vector<Zone> m_zones;
+  mutable SONOS::OS::CMutex m_mutex;
+  unsigned m_systemUpdateID;
+  unsigned m_lastSID;
+  unsigned m_seed;
+  volatile bool m_stopping;
+  Stats m_stats;
+  std::map<std::string, Subscription> m_subscriptions;
+  SONOS::OS::CThreadPool m_pool;
+  Notifier* m_notifier;
+  Announcer* m_announcer;
+
+  void* Process();
+
+  // connection handling
+  unsigned Delay();
+  bool HandleRequest(unsigned zone, const std::string& request, std::string& response, std::string& subscribed);
+  bool HandleControl(unsigned zone, const std::string& url, const std::string& action, const std::string& body, bool keepAlive, std::string& response);
+  bool HandleSubscribe(unsigned zone, const std::string& url, const std::string& request, bool keepAlive, std::string& response);
+  bool HandleUnsubscribe(const std::string& request, bool keepAlive, std::string& response);
+
+  // content
+  std::string ZoneGroupState() const;
+  std::string TrackDIDL(unsigned index, const std::string& id, const std::string& parentID) const;
+  std::string Browse(const std::string& objectId, unsigned index, unsigned count, unsigned& returned, unsigned& total) const;
+  std::string EventBody(unsigned zone, const std::string& url) const;
+  void Notify(const std::string& sid);
+  void NotifyAll(unsigned zone, const std::string& url);
+
+  // prevent copy
+  MockHousehold(const MockHousehold&);
+  MockHousehold& operator=(const MockHousehold&);
+};
+
+#endif /* MOCKPLAYER_H */
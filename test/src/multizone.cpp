@@ -0,0 +1,343 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#endif
+
+#include "../../noson/src/sonossystem.h"
+#include "../../noson/src/private/socket.h"
+#include "../../noson/src/private/os/threads/thread.h"
+#include "../../noson/src/private/os/threads/mutex.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * Drives many simulated zones from one system.
+ * 1. Connect: each zone is served by its own player on localhost. All the
+ *    players subscribe through the event listener of the system, and the
+ *    music services are requested once for all.
+ * 2. Delivery: transport events are sent concurrently to the listener, then
+ *    funneled to the zone event callback with the group of the zone.
+ */
+
+#define ZONE_COUNT    64
+#define BASE_PORT     14001
+
+#define BODY_SERVICES "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\"><s:Body><u:ListAvailableServicesResponse xmlns:u=\"urn:schemas-upnp-org:service:MusicServices:1\"><AvailableServiceDescriptorList>&lt;Services&gt;&lt;/Services&gt;</AvailableServiceDescriptorList><AvailableServiceTypeList></AvailableServiceTypeList><AvailableServiceListVersion>RINCON_000E58000001400:1</AvailableServiceListVersion></u:ListAvailableServicesResponse></s:Body></s:Envelope>"
+#define BODY_AVT      "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/AVT/&quot; xmlns:r=&quot;urn:schemas-rinconnetworks-com:metadata-1-0/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;&lt;TransportState val=&quot;PLAYING&quot;/&gt;&lt;CurrentPlayMode val=&quot;NORMAL&quot;/&gt;&lt;NumberOfTracks val=&quot;12&quot;/&gt;&lt;CurrentTrack val=&quot;3&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;</LastChange></e:property></e:propertyset>"
+
+/* the players of the household, served by one thread */
+class PlayerFarm : public SONOS::OS::CThread
+{
+public:
+  PlayerFarm() : subscribes(0), unsubscribes(0), posts(0), m_callbackPort(0) { }
+  ~PlayerFarm()
+  {
+    for (std::vector<SONOS::TcpServerSocket*>::iterator it = m_servers.begin(); it != m_servers.end(); ++it)
+      delete *it;
+  }
+
+  bool Open(unsigned count)
+  {
+    for (unsigned i = 0; i < count; ++i)
+    {
+      SONOS::TcpServerSocket* server = new SONOS::TcpServerSocket();
+      m_servers.push_back(server);
+      if (!server->Create(SONOS::SOCKET_AF_INET4) || !server->Bind(BASE_PORT + i) || !server->ListenConnection())
+        return false;
+    }
+    return StartThread();
+  }
+
+  void Close() { StopThread(true); }
+
+  unsigned GetCallbackPort()
+  {
+    SONOS::OS::CLockGuard lock(m_mutex);
+    return m_callbackPort;
+  }
+
+  std::string GetSID(unsigned port)
+  {
+    SONOS::OS::CLockGuard lock(m_mutex);
+    return m_sids[port];
+  }
+
+  volatile unsigned subscribes;
+  volatile unsigned unsubscribes;
+  volatile unsigned posts;
+
+private:
+  std::vector<SONOS::TcpServerSocket*> m_servers;
+  SONOS::OS::CMutex m_mutex;
+  unsigned m_callbackPort;
+  std::map<unsigned, std::string> m_sids; ///< transport subscription by player port
+
+  void* Process()
+  {
+    while (!IsStopped())
+    {
+      fd_set fds;
+      FD_ZERO(&fds);
+      net_socket_t maxfd = 0;
+      for (std::vector<SONOS::TcpServerSocket*>::const_iterator it = m_servers.begin(); it != m_servers.end(); ++it)
+      {
+        FD_SET((*it)->GetSocket(), &fds);
+        if ((*it)->GetSocket() > maxfd)
+          maxfd = (*it)->GetSocket();
+      }
+      struct timeval tv = { 0, 100000 };
+      if (select(maxfd + 1, &fds, NULL, NULL, &tv) <= 0)
+        continue;
+      for (unsigned i = 0; i < m_servers.size(); ++i)
+      {
+        if (!FD_ISSET(m_servers[i]->GetSocket(), &fds))
+          continue;
+        SONOS::TcpSocket sock;
+        if (m_servers[i]->AcceptConnection(sock))
+          Serve(sock, BASE_PORT + i);
+        sock.Disconnect();
+      }
+    }
+    return NULL;
+  }
+
+  static std::string GetHeader(const std::string& req, const char* name)
+  {
+    std::string field("\r\n");
+    field.append(name).append(":");
+    size_t b = req.find(field);
+    if (b == std::string::npos)
+      return std::string();
+    b += field.size();
+    while (b < req.size() && req[b] == ' ')
+      ++b;
+    return req.substr(b, req.find("\r\n", b) - b);
+  }
+
+  void Serve(SONOS::TcpSocket& sock, unsigned port)
+  {
+    std::string req;
+    char buf[4096];
+    size_t e;
+    while ((e = req.find("\r\n\r\n")) == std::string::npos)
+    {
+      size_t r = sock.ReceiveSome(buf, sizeof(buf));
+      if (r == 0)
+        return;
+      req.append(buf, r);
+    }
+    size_t length = (size_t)atoi(GetHeader(req, "CONTENT-LENGTH").c_str());
+    while (req.size() < e + 4 + length)
+    {
+      size_t r = sock.ReceiveSome(buf, sizeof(buf));
+      if (r == 0)
+        return;
+      req.append(buf, r);
+    }
+
+    std::string resp;
+    if (req.compare(0, 10, "SUBSCRIBE ") == 0)
+    {
+      std::string url = req.substr(10, req.find(' ', 10) - 10);
+      std::string sid = GetHeader(req, "SID");
+      if (sid.empty())
+      {
+        snprintf(buf, sizeof(buf), "uuid:RINCON_%u_sub%u", port, ++subscribes);
+        sid.assign(buf);
+        std::string callback = GetHeader(req, "Callback");
+        size_t p = callback.rfind(':');
+        SONOS::OS::CLockGuard lock(m_mutex);
+        if (p != std::string::npos)
+          m_callbackPort = (unsigned)atoi(callback.c_str() + p + 1);
+        if (url == "/MediaRenderer/AVTransport/Event")
+          m_sids[port] = sid;
+      }
+      resp.assign("HTTP/1.1 200 OK\r\nSID: ").append(sid).append("\r\nTIMEOUT: Second-3600\r\nContent-Length: 0\r\n\r\n");
+    }
+    else if (req.compare(0, 12, "UNSUBSCRIBE ") == 0)
+    {
+      ++unsubscribes;
+      resp.assign("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+    }
+    else if (req.compare(0, 5, "POST ") == 0 && req.find("#ListAvailableServices") != std::string::npos)
+    {
+      ++posts;
+      snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Type: text/xml; charset=\"utf-8\"\r\nContent-Length: %u\r\n\r\n", (unsigned)strlen(BODY_SERVICES));
+      resp.assign(buf).append(BODY_SERVICES);
+    }
+    else
+    {
+      ++posts;
+      resp.assign("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+    }
+    sock.SendData(resp.c_str(), resp.size());
+  }
+};
+
+/* counts the events funneled by the system */
+class Counter
+{
+public:
+  Counter() : total(0) { }
+  static void CBZoneEvent(void* handle, const std::string& group)
+  {
+    Counter* counter = static_cast<Counter*>(handle);
+    SONOS::OS::CLockGuard lock(counter->m_mutex);
+    ++counter->m_groups[group];
+    ++counter->total;
+  }
+  unsigned Groups()
+  {
+    SONOS::OS::CLockGuard lock(m_mutex);
+    return (unsigned)m_groups.size();
+  }
+  volatile unsigned total;
+private:
+  SONOS::OS::CMutex m_mutex;
+  std::map<std::string, unsigned> m_groups;
+};
+
+class Sender : public SONOS::OS::CThread
+{
+public:
+  Sender(PlayerFarm& farm, unsigned first, unsigned step, unsigned count)
+  : failed(0), m_farm(farm), m_first(first), m_step(step), m_count(count) { }
+  void* Process()
+  {
+    unsigned port = m_farm.GetCallbackPort();
+    for (unsigned n = 0; n < m_count; ++n)
+    {
+      for (unsigned i = m_first; i < ZONE_COUNT; i += m_step)
+      {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                "NOTIFY /notify HTTP/1.1\r\n"
+                "HOST: 127.0.0.1:%u\r\n"
+                "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+                "CONTENT-LENGTH: %u\r\n"
+                "NT: upnp:event\r\n"
+                "NTS: upnp:propchange\r\n"
+                "SID: %s\r\n"
+                "SEQ: %u\r\n"
+                "\r\n", port, (unsigned)strlen(BODY_AVT), m_farm.GetSID(BASE_PORT + i).c_str(), n + 1);
+        std::string req(buf);
+        req.append(BODY_AVT);
+        SONOS::TcpSocket sock;
+        if (!sock.Connect("127.0.0.1", port, 0) || !sock.SendData(req.c_str(), req.size()) ||
+                sock.ReceiveSome(buf, sizeof(buf)) == 0)
+          ++failed;
+        sock.Disconnect();
+      }
+    }
+    return NULL;
+  }
+  unsigned failed;
+private:
+  PlayerFarm& m_farm;
+  unsigned m_first;
+  unsigned m_step;
+  unsigned m_count;
+};
+
+static void CBSystem(void* handle)
+{
+  (void)handle;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned count = 50;
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  PlayerFarm farm;
+  if (!farm.Open(ZONE_COUNT))
+  {
+    fprintf(stderr, "could not open the simulated players\n");
+    return 1;
+  }
+
+  Counter counter;
+  SONOS::System* system = new SONOS::System(0, CBSystem);
+  system->SetZoneEventCB(&counter, Counter::CBZoneEvent);
+
+  // connect
+  int64_t start = SONOS::OS::gettime_ms();
+  unsigned connected = 0;
+  for (unsigned i = 0; i < ZONE_COUNT; ++i)
+  {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "RINCON_%u:1", BASE_PORT + i);
+    SONOS::ZonePtr zone(new SONOS::Zone(buf));
+    snprintf(buf, sizeof(buf), "Room %u", i + 1);
+    SONOS::ZonePlayerPtr zp(new SONOS::ZonePlayer(buf));
+    snprintf(buf, sizeof(buf), "RINCON_%u", BASE_PORT + i);
+    zp->SetAttribut(ZP_UUID, buf);
+    zp->SetAttribut(ZP_COORDINATOR, "true");
+    snprintf(buf, sizeof(buf), "http://127.0.0.1:%u/xml/device_description.xml", BASE_PORT + i);
+    zp->SetAttribut(ZP_LOCATION, buf);
+    zone->push_back(zp);
+    if (system->AddZone(zone))
+      ++connected;
+  }
+  int64_t elapsed = SONOS::OS::gettime_ms() - start;
+  while (farm.subscribes < 3 * ZONE_COUNT && SONOS::OS::gettime_ms() - start < 30000)
+    usleep(1000);
+  int64_t subscribed = SONOS::OS::gettime_ms() - start;
+  fprintf(stdout, "connect      %u/%u zones in %lld ms, %u subscriptions in %lld ms, %u requests to the players\n",
+          connected, ZONE_COUNT, (long long)elapsed, farm.subscribes, (long long)subscribed, farm.posts);
+
+  // delivery
+  unsigned senders = 8;
+  unsigned expected = count * ZONE_COUNT;
+  std::vector<Sender*> threads;
+  start = SONOS::OS::gettime_ms();
+  for (unsigned i = 0; i < senders; ++i)
+  {
+    threads.push_back(new Sender(farm, i, senders, count));
+    threads.back()->StartThread();
+  }
+  unsigned failed = 0;
+  for (unsigned i = 0; i < senders; ++i)
+  {
+    threads[i]->WaitThread(60000);
+    failed += threads[i]->failed;
+    delete threads[i];
+  }
+  while (counter.total < expected - failed && SONOS::OS::gettime_ms() - start < 60000)
+    usleep(1000);
+  elapsed = SONOS::OS::gettime_ms() - start;
+  fprintf(stdout, "delivery     %u senders, %u zones: %u/%u events from %u groups in %lld ms (%.0f evt/s), %u failed requests\n",
+          senders, ZONE_COUNT, counter.total, expected, counter.Groups(), (long long)elapsed,
+          elapsed ? 1000.0 * counter.total / elapsed : 0.0, failed);
+
+  // disconnect
+  start = SONOS::OS::gettime_ms();
+  SONOS::ConnectedPlayerList players = system->GetConnectedPlayers();
+  for (SONOS::ConnectedPlayerList::const_iterator it = players.begin(); it != players.end(); ++it)
+    system->RemoveZone(it->first);
+  players.clear();
+  delete system;
+  elapsed = SONOS::OS::gettime_ms() - start;
+  while (farm.unsubscribes < farm.subscribes && SONOS::OS::gettime_ms() - start < 10000)
+    usleep(1000);
+  fprintf(stdout, "disconnect   %u zones in %lld ms, %u/%u subscriptions revoked\n",
+          connected, (long long)elapsed, farm.unsubscribes, farm.subscribes);
+  farm.Close();
+  return (connected == ZONE_COUNT && counter.total >= expected - failed ? 0 : 1);
+}
@@ -0,0 +1,906 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#include "mockplayer.h"
+#include "../../noson/src/didlparser.h"
+#include "../../noson/src/didlpage.h"
+#include "../../noson/src/librarysearch.h"
+#include "../../noson/src/element.h"
+#include "../../noson/src/eventhandler.h"
+#include "../../noson/src/zonegrouptopology.h"
+#include "../../noson/src/contentdirectory.h"
+#include "../../noson/src/subscription.h"
+#include "../../noson/src/musicservices.h"
+#include "../../noson/src/smapimetadata.h"
+#include "../../noson/src/private/eventbroker.h"
+#include "../../noson/src/private/wsrequestbroker.h"
+#include "../../noson/src/private/soapreader.h"
+#include "../../noson/src/private/urlencoder.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <new>
+
+/*
+ * Microbenchmarks of the parsers, the event path and the HTTP path. The
+ * fixtures are synthesized from templates of the messages of a player, with
+ * generated values, so the runs are reproducible.
+ * Each benchmark is calibrated to run a sample for the minimum time, then the
+ * median of the samples is reported, with the count of heap allocations done
+ * by one operation. The results are written as JSON.
+ */
+
+#define BENCH_SAMPLES   5
+#define BENCH_MIN_TIME  100   // ms per sample
+
+///////////////////////////////////////////////////////////////////////////////
+//// Allocation counter
+
+#ifdef __WINDOWS__
+static volatile LONG g_allocs = 0;
+#define COUNT_ALLOC() InterlockedIncrement(&g_allocs)
+#else
+static volatile unsigned long g_allocs = 0;
+#define COUNT_ALLOC() __sync_fetch_and_add(&g_allocs, 1)
+#endif
+
+void* operator new(size_t size)
+{
+  COUNT_ALLOC();
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//// Fixtures
+
+#define DIDL_HEADER "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" xmlns:r=\"urn:schemas-rinconnetworks-com:metadata-1-0/\" xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">"
+#define DIDL_FOOTER "</DIDL-Lite>"
+
+/* a track of the library, as returned by Browse A:TRACKS */
+static const char* g_didlItem =
+  "<item id=\"S://nas/music/Artist%%20%u/Album%%20%u/%02u%%20Track%%20%u.flac\" parentID=\"A:TRACKS\" restricted=\"true\">"
+  "<res protocolInfo=\"x-file-cifs:*:audio/flac:*\">x-file-cifs://nas/music/Artist%%20%u/Album%%20%u/%02u%%20Track%%20%u.flac</res>"
+  "<upnp:albumArtURI>/getaa?u=x-file-cifs%%3a%%2f%%2fnas%%2fmusic%%2fArtist%%2520%u%%2fAlbum%%2520%u%%2f%02u%%2520Track%%2520%u.flac&amp;v=432</upnp:albumArtURI>"
+  "<dc:title>Track %u &amp; Friends</dc:title>"
+  "<upnp:class>object.item.audioItem.musicTrack</upnp:class>"
+  "<dc:creator>Artist %u</dc:creator>"
+  "<upnp:album>Album %u</upnp:album>"
+  "<upnp:originalTrackNumber>%u</upnp:originalTrackNumber>"
+  "</item>";
+
+static std::string MakeDIDL(unsigned count)
+{
+  std::string didl(DIDL_HEADER);
+  char buf[2048];
+  for (unsigned i = 0; i < count; ++i)
+  {
+    unsigned album = i / 10 + 1, artist = i / 40 + 1, number = i % 10 + 1;
+    snprintf(buf, sizeof(buf), g_didlItem, artist, album, number, i + 1, artist, album, number, i + 1,
+            artist, album, number, i + 1, i + 1, artist, album, number);
+    didl.append(buf);
+  }
+  didl.append(DIDL_FOOTER);
+  return didl;
+}
+
+static std::string XMLEscape(const std::string& str)
+{
+  std::string out;
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+  {
+    switch (*it)
+    {
+      case '&': out.append("&amp;"); break;
+      case '<': out.append("&lt;"); break;
+      case '>': out.append("&gt;"); break;
+      case '"': out.append("&quot;"); break;
+      default: out.push_back(*it);
+    }
+  }
+  return out;
+}
+
+/* the response of Browse */
+static std::string MakeBrowseResponse(unsigned count)
+{
+  char buf[256];
+  std::string xml("<?xml version=\"1.0\" encoding=\"utf-8\"?><s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\"><s:Body>"
+                  "<u:BrowseResponse xmlns:u=\"urn:schemas-upnp-org:service:ContentDirectory:1\"><Result>");
+  xml.append(XMLEscape(MakeDIDL(count)));
+  snprintf(buf, sizeof(buf), "</Result><NumberReturned>%u</NumberReturned><TotalMatches>%u</TotalMatches><UpdateID>412</UpdateID>", count, count);
+  xml.append(buf).append("</u:BrowseResponse></s:Body></s:Envelope>");
+  return xml;
+}
+
+/* a household of 'count' players, grouped by 'group' */
+static std::string MakeZoneGroupState(unsigned count, unsigned group)
+{
+  char buf[512];
+  std::string xml("<ZoneGroups>");
+  for (unsigned i = 0; i < count; i += group)
+  {
+    snprintf(buf, sizeof(buf), "<ZoneGroup Coordinator=\"RINCON_000E580000%02u01400\" ID=\"RINCON_000E580000%02u01400:%u\">", i, i, 100 + i);
+    xml.append(buf);
+    for (unsigned j = i; j < i + group && j < count; ++j)
+    {
+      snprintf(buf, sizeof(buf), "<ZoneGroupMember UUID=\"RINCON_000E580000%02u01400\" Location=\"http://192.168.1.%u:1400/xml/device_description.xml\" "
+              "ZoneName=\"Room %u\" Icon=\"x-rincon-roomicon:living\" Configuration=\"1\" SoftwareVersion=\"57.3-77280\" "
+              "MinCompatibleVersion=\"56.0-00000\" LegacyCompatibleVersion=\"36.0-00000\" BootSeq=\"42\" WirelessMode=\"0\"/>", j, 20 + j, j + 1);
+      xml.append(buf);
+    }
+    xml.append("</ZoneGroup>");
+  }
+  xml.append("</ZoneGroups>");
+  return xml;
+}
+
+/* the result of getMetadata from a music service */
+static std::string MakeSMAPIResult(unsigned count)
+{
+  char buf[1024];
+  snprintf(buf, sizeof(buf), "<getMetadataResult><index>0</index><count>%u</count><total>%u</total>", count, count * 10);
+  std::string xml(buf);
+  for (unsigned i = 0; i < count; ++i)
+  {
+    snprintf(buf, sizeof(buf), "<mediaMetadata><id>track:%u/tt%07u</id><itemType>track</itemType><title>Track %u</title>"
+            "<mimeType>audio/mp4</mimeType><trackMetadata><artistId>artist:%u</artistId><artist>Artist %u</artist>"
+            "<albumId>album:%u</albumId><album>Album %u</album><duration>241</duration>"
+            "<albumArtURI>https://images.example.com/album/%u/500x500.jpg</albumArtURI>"
+            "<canPlay>true</canPlay><canSkip>true</canSkip><canAddToFavorites>true</canAddToFavorites></trackMetadata></mediaMetadata>",
+            i, i, i + 1, i / 40, i / 40, i / 10, i / 10, i / 10);
+    xml.append(buf);
+  }
+  xml.append("</getMetadataResult>");
+  return xml;
+}
+
+static std::string MakeNotify(const char* body, unsigned seq)
+{
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+          "NOTIFY /notify HTTP/1.1\r\n"
+          "HOST: 127.0.0.1:1400\r\n"
+          "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+          "CONTENT-LENGTH: %u\r\n"
+          "NT: upnp:event\r\n"
+          "NTS: upnp:propchange\r\n"
+          "SID: uuid:RINCON_000E58000001400_sub0000000042\r\n"
+          "SEQ: %u\r\n"
+          "\r\n", (unsigned)strlen(body), seq);
+  return std::string(buf).append(body);
+}
+
+#define BODY_AVT  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/AVT/&quot; xmlns:r=&quot;urn:schemas-rinconnetworks-com:metadata-1-0/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;&lt;TransportState val=&quot;PLAYING&quot;/&gt;&lt;CurrentPlayMode val=&quot;NORMAL&quot;/&gt;&lt;CurrentCrossfadeMode val=&quot;0&quot;/&gt;&lt;NumberOfTracks val=&quot;12&quot;/&gt;&lt;CurrentTrack val=&quot;3&quot;/&gt;&lt;CurrentSection val=&quot;0&quot;/&gt;&lt;CurrentTrackURI val=&quot;x-file-cifs://nas/music/track03.flac&quot;/&gt;&lt;CurrentTrackDuration val=&quot;0:04:12&quot;/&gt;&lt;r:NextTrackURI val=&quot;x-file-cifs://nas/music/track04.flac&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;</LastChange></e:property></e:propertyset>"
+#define BODY_CDS  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><SystemUpdateID>412</SystemUpdateID></e:property><e:property><ContainerUpdateIDs>Q:0,87</ContainerUpdateIDs></e:property></e:propertyset>"
+
+/* reads a recorded request from memory */
+class MemorySocket : public SONOS::NetSocket
+{
+public:
+  MemorySocket(const std::string& data) : m_data(data), m_pos(0) { }
+  bool SendData(const char* buf, size_t size) { (void)buf; (void)size; return false; }
+  size_t ReceiveData(void* buf, size_t n)
+  {
+    size_t s = m_data.size() - m_pos;
+    if (s > n)
+      s = n;
+    memcpy(buf, m_data.c_str() + m_pos, s);
+    m_pos += s;
+    return s;
+  }
+private:
+  const std::string& m_data;
+  size_t m_pos;
+};
+
+/* counts the messages decoded by the broker */
+class Recorder : public SONOS::EventHandler::EventHandlerThread
+{
+public:
+  Recorder() : EventHandlerThread(0), count(0) { }
+  bool Start() { return true; }
+  void Stop() { }
+  bool IsRunning() { return true; }
+  unsigned CreateSubscription(SONOS::EventSubscriber *sub) { (void)sub; return 0; }
+  bool SubscribeForEvent(unsigned subid, SONOS::EVENT_t event) { (void)subid; (void)event; return false; }
+  void RevokeSubscription(unsigned subid) { (void)subid; }
+  void RevokeAllSubscriptions(SONOS::EventSubscriber *sub) { (void)sub; }
+  void DispatchEvent(const SONOS::EventMessage& msg) { count += (unsigned)msg.properties.size(); }
+  unsigned count;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//// Benchmarks
+
+class Benchmark
+{
+public:
+  Benchmark(const char* name) : m_name(name), m_bytes(0), m_failed(false) { }
+  virtual ~Benchmark() { }
+  const char* Name() const { return m_name; }
+  size_t Bytes() const { return m_bytes; }
+  bool Failed() const { return m_failed; }
+  virtual bool Setup() { return true; }
+  virtual void TearDown() { }
+  /* one operation */
+  virtual void Run() = 0;
+protected:
+  const char* m_name;
+  size_t m_bytes;   ///< bytes processed by an operation
+  bool m_failed;
+};
+
+class DIDLBench : public Benchmark
+{
+public:
+  DIDLBench(const char* name, unsigned count) : Benchmark(name), m_count(count) { }
+  bool Setup() { m_didl = MakeDIDL(m_count); m_bytes = m_didl.size(); return true; }
+  void Run()
+  {
+    SONOS::DIDLParser parser(m_didl.c_str(), m_count);
+    if (!parser.IsValid() || parser.GetItems().size() != m_count)
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  std::string m_didl;
+};
+
+/* the same document, parsed in one page */
+class DIDLPageBench : public Benchmark
+{
+public:
+  DIDLPageBench(const char* name, unsigned count) : Benchmark(name), m_count(count) { }
+  bool Setup() { m_didl = MakeDIDL(m_count); m_bytes = m_didl.size(); return true; }
+  void Run()
+  {
+    SONOS::DIDLPage page(m_didl.c_str());
+    if (!page.IsValid() || page.Count() != m_count || *page.GetValue(m_count - 1, "dc:title") == '\0')
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  std::string m_didl;
+};
+
+/* a thousand shared elements, allocated apart or with their counter */
+class SharedBench : public Benchmark
+{
+public:
+  SharedBench(const char* name, bool make) : Benchmark(name), m_make(make) { }
+  void Run()
+  {
+    SONOS::ElementList vars;
+    vars.reserve(1000);
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+      if (m_make)
+        vars.push_back(MAKE_SHARED<SONOS::Element>(m_key, m_key));
+      else
+        vars.push_back(SONOS::ElementPtr(new SONOS::Element(m_key, m_key)));
+    }
+    SONOS::ElementList copy(vars);
+    if (copy.size() != 1000 || copy[999].use_count() != 2)
+      m_failed = true;
+  }
+private:
+  bool m_make;
+  static const std::string m_key;
+};
+
+const std::string SharedBench::m_key("upnp:albumArtURI");
+
+/* a word of six letters, from three syllables */
+static std::string MakeWord(unsigned n)
+{
+  static const char* syllables[20] = { "ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "be", "do",
+                                       "fa", "gu", "ho", "ji", "pe", "qi", "wu", "xo", "ze", "ya" };
+  n %= 8000;
+  return std::string(syllables[n % 20]).append(syllables[(n / 20) % 20]).append(syllables[n / 400]);
+}
+
+/* a library of 'count' tracks, with titles and albums of two words */
+static std::string MakeLibraryDIDL(unsigned count)
+{
+  static const char* genres[8] = { "Rock", "Jazz", "Blues", "Classical", "Electronic", "Folk", "Pop", "Soul" };
+  std::string didl(DIDL_HEADER);
+  char buf[1024];
+  for (unsigned i = 0; i < count; ++i)
+  {
+    snprintf(buf, sizeof(buf),
+             "<item id=\"S://nas/music/%u.flac\" parentID=\"A:TRACKS\" restricted=\"true\">"
+             "<res protocolInfo=\"x-file-cifs:*:audio/flac:*\">x-file-cifs://nas/music/%u.flac</res>"
+             "<dc:title>%s %s</dc:title><upnp:class>object.item.audioItem.musicTrack</upnp:class>"
+             "<dc:creator>%s</dc:creator><upnp:album>%s %s</upnp:album><upnp:genre>%s</upnp:genre></item>",
+             i + 1, i + 1, MakeWord(i * 7).c_str(), MakeWord(i * 13).c_str(), MakeWord(i / 40 + 5000).c_str(),
+             MakeWord(i / 10 + 3000).c_str(), MakeWord(i / 10 + 6000).c_str(), genres[(i / 40) % 8]);
+    didl.append(buf);
+  }
+  didl.append(DIDL_FOOTER);
+  return didl;
+}
+
+class SearchBench : public Benchmark
+{
+public:
+  typedef enum { WORDS, PREFIX, SUBSTRING, TYPO } Mode;
+  SearchBench(const char* name, unsigned count, Mode mode) : Benchmark(name), m_count(count), m_mode(mode), m_search(NULL) { }
+  ~SearchBench() { TearDown(); }
+  bool Setup()
+  {
+    SONOS::DIDLPagePtr page(new SONOS::DIDLPage(MakeLibraryDIDL(m_count).c_str()));
+    m_search = new SONOS::LibrarySearch();
+    for (unsigned i = 0; i < page->Count(); ++i)
+      m_search->Add(SONOS::DIDLItem(page, i));
+    // a track in the middle of the library
+    unsigned n = m_count / 2;
+    std::string first = MakeWord(n * 7), second = MakeWord(n * 13);
+    switch (m_mode)
+    {
+      case WORDS: m_query = first + " " + second; break;
+      case PREFIX: m_query = first + " " + second.substr(0, 3); break;
+      case SUBSTRING: m_query = first.substr(1, 4); break;
+      case TYPO: m_query = first + " " + second.substr(0, 2) + second[3] + second[2] + second.substr(4); break;
+    }
+    return m_search->Size() == m_count;
+  }
+  void TearDown()
+  {
+    delete m_search;
+    m_search = NULL;
+  }
+  void Run()
+  {
+    SONOS::DigitalItemList items = (m_mode == SUBSTRING ? m_search->SearchSubstring(m_query) : m_search->Search(m_query));
+    if (items.empty())
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  Mode m_mode;
+  SONOS::LibrarySearch* m_search;
+  std::string m_query;
+};
+
+class NotifyBench : public Benchmark
+{
+public:
+  NotifyBench(const char* name) : Benchmark(name) { }
+  bool Setup()
+  {
+    m_requests.push_back(MakeNotify(BODY_AVT, 1));
+    m_requests.push_back(MakeNotify(BODY_CDS, 2));
+    for (std::vector<std::string>::const_iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+      m_bytes += it->size();
+    return true;
+  }
+  void Run()
+  {
+    for (std::vector<std::string>::const_iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+    {
+      MemorySocket sock(*it);
+      struct timeval timeout = { 0, 0 };
+      SONOS::WSRequestBroker rb(&sock, timeout);
+      std::string resp;
+      SONOS::EventBroker::HandleRequest(&m_recorder, rb, resp);
+    }
+    if (m_recorder.count == 0)
+      m_failed = true;
+  }
+private:
+  std::vector<std::string> m_requests;
+  Recorder m_recorder;
+};
+
+class SOAPBench : public Benchmark
+{
+public:
+  SOAPBench(const char* name, unsigned count) : Benchmark(name), m_count(count) { }
+  bool Setup() { m_xml = MakeBrowseResponse(m_count); m_bytes = m_xml.size(); return true; }
+  void Run()
+  {
+    SONOS::ElementList vars;
+    SONOS::SOAPReader reader(vars);
+    // the content is fed as received from the socket
+    for (size_t p = 0; p < m_xml.size(); p += 4096)
+      reader.Feed(m_xml.c_str() + p, std::min((size_t)4096, m_xml.size() - p));
+    if (!reader.Finish() || vars.empty() || vars.GetValue("Result").empty())
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  std::string m_xml;
+};
+
+class ZGSBench : public Benchmark
+{
+public:
+  ZGSBench(const char* name) : Benchmark(name), m_topology("127.0.0.1", 1400), m_flip(false) { }
+  bool Setup()
+  {
+    // the household is regrouped on each change
+    m_states[0] = MakeZoneGroupState(32, 1);
+    m_states[1] = MakeZoneGroupState(32, 4);
+    m_bytes = (m_states[0].size() + m_states[1].size()) / 2;
+    return true;
+  }
+  void Run()
+  {
+    m_flip = !m_flip;
+    if (!m_topology.SetZoneGroupState(m_states[m_flip ? 1 : 0]))
+      m_failed = true;
+  }
+private:
+  SONOS::ZoneGroupTopology m_topology;
+  std::string m_states[2];
+  bool m_flip;
+};
+
+class SMAPIBench : public Benchmark
+{
+public:
+  SMAPIBench(const char* name, unsigned count) : Benchmark(name), m_count(count) { }
+  bool Setup()
+  {
+    SONOS::ElementList vars;
+    vars.push_back(SONOS::ElementPtr(new SONOS::Element("Id", "204")));
+    vars.push_back(SONOS::ElementPtr(new SONOS::Element("Name", "Mock Music")));
+    m_service.reset(new SONOS::SMService("Linux UPnP/1.0 Sonos/26.99-12345", vars, "3"));
+    m_metadata.Reset(m_service, MakeSMAPIResult(m_count), "root");
+    return m_metadata.IsValid();
+  }
+  void Run()
+  {
+    if (m_metadata.GetItems().size() != m_count)
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  SONOS::SMServicePtr m_service;
+  SONOS::SMAPIMetadata m_metadata;
+};
+
+class XMLEncodedBench : public Benchmark
+{
+public:
+  XMLEncodedBench(const char* name) : Benchmark(name), m_element("CurrentURIMetaData") { }
+  bool Setup()
+  {
+    // the metadata of an item is sent as argument
+    m_element.assign(MakeDIDL(1));
+    m_bytes = m_element.size();
+    return true;
+  }
+  void Run()
+  {
+    if (m_element.XMLEncoded().size() <= m_bytes)
+      m_failed = true;
+  }
+private:
+  SONOS::Element m_element;
+};
+
+class URLEncodeBench : public Benchmark
+{
+public:
+  URLEncodeBench(const char* name) : Benchmark(name) { }
+  bool Setup()
+  {
+    m_ids.push_back("track:5/tt0000042");
+    m_ids.push_back("x-file-cifs://nas/music/Artist 12/Album 3/07 Track & Friends.flac");
+    m_ids.push_back("A:ALBUMARTIST/L'Orchestre Symphonique/Les Quatre Saisons (1725)");
+    for (std::vector<std::string>::const_iterator it = m_ids.begin(); it != m_ids.end(); ++it)
+      m_bytes += it->size();
+    return true;
+  }
+  void Run()
+  {
+    size_t len = 0;
+    for (std::vector<std::string>::const_iterator it = m_ids.begin(); it != m_ids.end(); ++it)
+      len += urlencode(*it).size();
+    if (len < m_bytes)
+      m_failed = true;
+  }
+private:
+  std::vector<std::string> m_ids;
+};
+
+/* Browse a page from the simulated player: request, transfer and decoding */
+class HTTPBrowseBench : public Benchmark
+{
+public:
+  HTTPBrowseBench(const char* name, unsigned count) : Benchmark(name), m_count(count), m_household(NULL), m_service(NULL) { }
+  ~HTTPBrowseBench() { TearDown(); }
+  bool Setup()
+  {
+    MockHousehold::Options options;
+    options.port = MOCK_BASE_PORT + 100;
+    options.tracks = m_count;
+    options.ssdp = false;
+    m_household = new MockHousehold(options);
+    if (!m_household->Start())
+      return false;
+    m_service = new SONOS::ContentDirectory(MOCK_ADDRESS, options.port);
+    return true;
+  }
+  void TearDown()
+  {
+    delete m_service;
+    m_service = NULL;
+    delete m_household;
+    m_household = NULL;
+  }
+  void Run()
+  {
+    SONOS::ElementList vars;
+    if (!m_service->Browse("A:TRACKS", 0, m_count, vars))
+      m_failed = true;
+    m_bytes = vars.GetValue("Result").size();
+  }
+private:
+  unsigned m_count;
+  MockHousehold* m_household;
+  SONOS::ContentDirectory* m_service;
+};
+
+/* list the whole library from a household with latency, chunk by chunk */
+class ContentListBench : public Benchmark
+{
+public:
+  ContentListBench(const char* name, unsigned count, unsigned prefetch, bool evented = false)
+  : Benchmark(name), m_count(count), m_prefetch(prefetch), m_evented(evented), m_household(NULL), m_events(NULL), m_service(NULL) { }
+  ~ContentListBench() { TearDown(); }
+  bool Setup()
+  {
+    MockHousehold::Options options;
+    options.port = MOCK_BASE_PORT + 101 + m_prefetch + (m_evented ? 10 : 0);
+    options.tracks = m_count;
+    options.latency = 5;
+    options.ssdp = false;
+    m_household = new MockHousehold(options);
+    if (!m_household->Start())
+      return false;
+    if (!m_evented)
+    {
+      m_service = new SONOS::ContentDirectory(MOCK_ADDRESS, options.port);
+      return true;
+    }
+    // with events the responses are cached by the service
+    m_events = new SONOS::EventHandler(options.port + 1000);
+    if (!m_events->Start())
+      return false;
+    m_subscription = SONOS::Subscription(MOCK_ADDRESS, options.port, SONOS::ContentDirectory::EventURL, m_events->GetPort(), 60);
+    m_service = new SONOS::ContentDirectory(MOCK_ADDRESS, options.port, *m_events, m_subscription);
+    return m_subscription.Start();
+  }
+  void TearDown()
+  {
+    delete m_service;
+    m_service = NULL;
+    m_subscription = SONOS::Subscription();
+    delete m_events;
+    m_events = NULL;
+    delete m_household;
+    m_household = NULL;
+  }
+  void Run()
+  {
+    SONOS::ContentList list(*m_service, "A:TRACKS", BROWSE_COUNT, true, m_prefetch);
+    unsigned n = 0;
+    for (SONOS::ContentList::iterator it = list.begin(); it != list.end(); ++it)
+      ++n;
+    if (list.failure() || n != m_count)
+      m_failed = true;
+  }
+private:
+  unsigned m_count;
+  unsigned m_prefetch;
+  bool m_evented;
+  MockHousehold* m_household;
+  SONOS::EventHandler* m_events;
+  SONOS::Subscription m_subscription;
+  SONOS::ContentDirectory* m_service;
+};
+
+/* a list view scrolling around hot spots of a large container, then back */
+class ContentBrowserBench : public Benchmark
+{
+public:
+  ContentBrowserBench(const char* name, unsigned count, size_t budget, unsigned prefetch, bool evented = false)
+  : Benchmark(name), m_count(count), m_budget(budget), m_prefetch(prefetch), m_evented(evented), m_household(NULL), m_events(NULL), m_service(NULL) { }
+  ~ContentBrowserBench() { TearDown(); }
+  bool Setup()
+  {
+    MockHousehold::Options options;
+    options.port = MOCK_BASE_PORT + 120 + m_prefetch + (m_budget > 0 ? 10 : 0) + (m_evented ? 20 : 0);
+    options.tracks = m_count;
+    options.latency = 5;
+    options.ssdp = false;
+    m_household = new MockHousehold(options);
+    if (!m_household->Start())
+      return false;
+    if (!m_evented)
+    {
+      m_service = new SONOS::ContentDirectory(MOCK_ADDRESS, options.port);
+      return true;
+    }
+    // with events the pages are checked against the generation of the content
+    m_events = new SONOS::EventHandler(options.port + 1000);
+    if (!m_events->Start())
+      return false;
+    m_subscription = SONOS::Subscription(MOCK_ADDRESS, options.port, SONOS::ContentDirectory::EventURL, m_events->GetPort(), 60);
+    m_service = new SONOS::ContentDirectory(MOCK_ADDRESS, options.port, *m_events, m_subscription);
+    return m_subscription.Start();
+  }
+  void TearDown()
+  {
+    delete m_service;
+    m_service = NULL;
+    m_subscription = SONOS::Subscription();
+    delete m_events;
+    m_events = NULL;
+    delete m_household;
+    m_household = NULL;
+  }
+  void Run()
+  {
+    static const unsigned window = 40;
+    // start cold, so the pages are kept by the browser only
+    m_service->ClearCache();
+    SONOS::ContentBrowser browser(*m_service, "A:TRACKS", BROWSE_COUNT, true, m_budget, m_prefetch);
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+      for (unsigned spot = 0; spot < 4; ++spot)
+      {
+        unsigned index = (m_count / 4) * spot + 1234 % (m_count / 4);
+        for (unsigned step = 0; step < 5; ++step)
+        {
+          if (!browser.Browse(index + step * window, window) || browser.count() != window)
+            m_failed = true;
+        }
+        // and scroll back up
+        for (unsigned step = 5; step > 0; --step)
+        {
+          if (!browser.Browse(index + (step - 1) * window, window) || browser.count() != window)
+            m_failed = true;
+        }
+      }
+    }
+  }
+private:
+  unsigned m_count;
+  size_t m_budget;
+  unsigned m_prefetch;
+  bool m_evented;
+  MockHousehold* m_household;
+  SONOS::EventHandler* m_events;
+  SONOS::Subscription m_subscription;
+  SONOS::ContentDirectory* m_service;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//// Runner
+
+struct Result
+{
+  std::string name;
+  unsigned iterations;    ///< per sample
+  double median;          ///< ns per operation
+  double min;
+  double max;
+  size_t bytes;
+  unsigned long allocs;
+  bool failed;
+};
+
+static int64_t nanotime()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static Result Measure(Benchmark& bench, unsigned samples, unsigned minTime)
+{
+  Result res;
+  res.name = bench.Name();
+  // calibrate the count of iterations, so a sample lasts the minimum time
+  unsigned n = 1;
+  for (;;)
+  {
+    int64_t start = nanotime();
+    for (unsigned i = 0; i < n; ++i)
+      bench.Run();
+    int64_t elapsed = nanotime() - start;
+    if (elapsed >= (int64_t)minTime * 1000000 || n >= (1u << 30))
+      break;
+    // aim above the minimum time
+    unsigned next = elapsed > 0 ? (unsigned)((double)n * minTime * 1200000.0 / elapsed) : n * 100;
+    n = (next > n * 100 ? n * 100 : next > n ? next : n + 1);
+  }
+  std::vector<double> times;
+  for (unsigned s = 0; s < samples; ++s)
+  {
+    int64_t start = nanotime();
+    for (unsigned i = 0; i < n; ++i)
+      bench.Run();
+    times.push_back((double)(nanotime() - start) / n);
+  }
+  std::sort(times.begin(), times.end());
+  // then count the allocations of one operation
+  unsigned long allocs = (unsigned long)g_allocs;
+  bench.Run();
+  res.allocs = (unsigned long)g_allocs - allocs;
+  res.iterations = n;
+  res.median = times[times.size() / 2];
+  res.min = times.front();
+  res.max = times.back();
+  res.bytes = bench.Bytes();
+  res.failed = bench.Failed();
+  return res;
+}
+
+static void WriteJSON(FILE* out, const std::vector<Result>& results, unsigned samples)
+{
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  fprintf(out, "{\n  \"library\": \"noson\",\n  \"version\": \"%s\",\n  \"date\": \"%s\",\n  \"samples\": %u,\n  \"results\": [\n",
+          LIBVERSION, date, samples);
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& r = results[i];
+    fprintf(out, "    { \"name\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.1f, \"ns_min\": %.1f, \"ns_max\": %.1f, "
+            "\"ops_per_sec\": %.1f, \"bytes_per_op\": %u, \"mb_per_sec\": %.2f, \"allocs_per_op\": %lu, \"failed\": %s }%s\n",
+            r.name.c_str(), r.iterations, r.median, r.min, r.max, r.median > 0 ? 1e9 / r.median : 0.0,
+            (unsigned)r.bytes, r.median > 0 ? r.bytes * 1e3 / r.median : 0.0, r.allocs, r.failed ? "true" : "false",
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+void usage(const char* cmd)
+{
+  fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --filter <text>            Run the benchmarks whose name contains the text\n"
+        "  --samples <count>          Samples per benchmark, default is %u\n"
+        "  --min-time <ms>            Minimum time of a sample, default is %u\n"
+        "  --json <file>              Write the results to the file, default is stdout\n"
+        "  --list                     List the benchmarks\n"
+        "  --help                     print this help\n"
+        "\n", cmd, BENCH_SAMPLES, BENCH_MIN_TIME
+        );
+}
+
+int main(int argc, char** argv)
+{
+  const char* filter = NULL;
+  const char* json = NULL;
+  unsigned samples = BENCH_SAMPLES;
+  unsigned minTime = BENCH_MIN_TIME;
+  bool list = false;
+
+  int i = 0;
+  while (++i < argc)
+  {
+    if (strcmp(argv[i], "--filter") == 0 && ++i < argc)
+      filter = argv[i];
+    else if (strcmp(argv[i], "--samples") == 0 && ++i < argc)
+      samples = atoi(argv[i]) > 0 ? atoi(argv[i]) : 1;
+    else if (strcmp(argv[i], "--min-time") == 0 && ++i < argc)
+      minTime = atoi(argv[i]);
+    else if (strcmp(argv[i], "--json") == 0 && ++i < argc)
+      json = argv[i];
+    else if (strcmp(argv[i], "--list") == 0)
+      list = true;
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Benchmark*> benchs;
+  benchs.push_back(new DIDLBench("didl.parse.1k", 1000));
+  benchs.push_back(new DIDLBench("didl.parse.10k", 10000));
+  benchs.push_back(new DIDLPageBench("didl.page.1k", 1000));
+  benchs.push_back(new DIDLPageBench("didl.page.10k", 10000));
+  benchs.push_back(new SearchBench("search.words.20k", 20000, SearchBench::WORDS));
+  benchs.push_back(new SearchBench("search.prefix.20k", 20000, SearchBench::PREFIX));
+  benchs.push_back(new SearchBench("search.substring.20k", 20000, SearchBench::SUBSTRING));
+  benchs.push_back(new SearchBench("search.typo.20k", 20000, SearchBench::TYPO));
+  benchs.push_back(new SharedBench("element.shared.new", false));
+  benchs.push_back(new SharedBench("element.shared.make", true));
+  benchs.push_back(new NotifyBench("event.notify.parse"));
+  benchs.push_back(new SOAPBench("soap.browse.decode.1k", 1000));
+  benchs.push_back(new ZGSBench("zgt.state.parse.32"));
+  benchs.push_back(new SMAPIBench("smapi.getitems.100", 100));
+  benchs.push_back(new XMLEncodedBench("element.xmlencoded"));
+  benchs.push_back(new URLEncodeBench("urlencode"));
+  benchs.push_back(new HTTPBrowseBench("http.browse.100", 100));
+  benchs.push_back(new HTTPBrowseBench("http.browse.1k", 1000));
+  benchs.push_back(new ContentListBench("http.list.5k", 5000, 0));
+  benchs.push_back(new ContentListBench("http.list.5k.prefetch", 5000, 4));
+  benchs.push_back(new ContentListBench("http.list.5k.cached", 5000, 0, true));
+  benchs.push_back(new ContentBrowserBench("http.browser.20k.nocache", 20000, 0, 0));
+  benchs.push_back(new ContentBrowserBench("http.browser.20k", 20000, BROWSE_BUDGET, 1));
+  benchs.push_back(new ContentBrowserBench("http.browser.20k.events", 20000, BROWSE_BUDGET, 1, true));
+
+  std::vector<Result> results;
+  int ret = 0;
+  for (std::vector<Benchmark*>::iterator it = benchs.begin(); it != benchs.end(); ++it)
+  {
+    Benchmark& bench = **it;
+    if (filter && !strstr(bench.Name(), filter))
+      continue;
+    if (list)
+    {
+      fprintf(stdout, "%s\n", bench.Name());
+      continue;
+    }
+    if (!bench.Setup())
+    {
+      fprintf(stderr, "%-24s setup failed\n", bench.Name());
+      bench.TearDown();
+      ret = 1;
+      continue;
+    }
+    Result res = Measure(bench, samples, minTime);
+    bench.TearDown();
+    fprintf(stderr, "%-24s %12.0f ns/op %10.1f MB/s %10lu allocs/op %10u iterations%s\n", res.name.c_str(), res.median,
+            res.median > 0 ? res.bytes * 1e3 / res.median : 0.0, res.allocs, res.iterations, res.failed ? " FAILED" : "");
+    if (res.failed)
+      ret = 1;
+    results.push_back(res);
+  }
+  for (std::vector<Benchmark*>::iterator it = benchs.begin(); it != benchs.end(); ++it)
+    delete *it;
+  if (list)
+    return 0;
+
+  FILE* out = stdout;
+  if (json && !(out = fopen(json, "w")))
+  {
+    fprintf(stderr, "cannot write %s\n", json);
+    return 1;
+  }
+  WriteJSON(out, results, samples);
+  if (out != stdout)
+    fclose(out);
+  return ret;
+}
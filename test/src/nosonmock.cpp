@@ -0,0 +1,147 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#include "mockplayer.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <cstdio>
+#include <string>
+
+/*
+ * Runs a simulated household on localhost. The commands of the script are
+ * read from the file, then from the standard input unless a duration is
+ * given. The players keep serving until the duration is elapsed, the command
+ * 'quit', or an interrupt.
+ */
+
+static volatile bool g_stop = false;
+
+static void sigHandler(int sig)
+{
+  (void)sig;
+  g_stop = true;
+}
+
+void usage(const char* cmd)
+{
+  fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --zones <count>            Count of players, default is 1\n"
+        "  --port <port>              Port of the first player, default is %u\n"
+        "  --latency <ms>             Delay of the responses\n"
+        "  --jitter <ms>              Random delay added to the responses\n"
+        "  --tracks <count>           Size of the music library, default is 1000\n"
+        "  --limit <count>            Most items returned by a browse\n"
+        "  --no-ssdp                  Don't answer the discovery\n"
+        "  --script <file>            Execute the commands of the file\n"
+        "  --duration <sec>           Stop serving after the duration\n"
+        "  --help                     print this help\n"
+        "\n"
+        "Commands:\n"
+        "  latency <ms> [<jitter ms>]\n"
+        "  tracks <count>\n"
+        "  play|pause|stop <zone>\n"
+        "  track <zone> <number>\n"
+        "  volume <zone> <value>\n"
+        "  sleep <ms>\n"
+        "  stats\n"
+        "  quit\n"
+        "A zone is numbered from 1, or 0 for all.\n"
+        "\n", cmd, MOCK_BASE_PORT
+        );
+}
+
+static bool runScript(MockHousehold& household, FILE* file)
+{
+  char line[256];
+  while (!g_stop && fgets(line, sizeof(line), file))
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (strcmp(line, "quit") == 0)
+      return false;
+    if (!household.Execute(line))
+      fprintf(stderr, "unknown command: %s\n", line);
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  MockHousehold::Options options;
+  const char* script = NULL;
+  unsigned duration = 0;
+
+  int i = 0;
+  while (++i < argc)
+  {
+    if (strcmp(argv[i], "--zones") == 0 && ++i < argc)
+      options.zones = atoi(argv[i]);
+    else if (strcmp(argv[i], "--port") == 0 && ++i < argc)
+      options.port = atoi(argv[i]);
+    else if (strcmp(argv[i], "--latency") == 0 && ++i < argc)
+      options.latency = atoi(argv[i]);
+    else if (strcmp(argv[i], "--jitter") == 0 && ++i < argc)
+      options.jitter = atoi(argv[i]);
+    else if (strcmp(argv[i], "--tracks") == 0 && ++i < argc)
+      options.tracks = atoi(argv[i]);
+    else if (strcmp(argv[i], "--limit") == 0 && ++i < argc)
+      options.limit = atoi(argv[i]);
+    else if (strcmp(argv[i], "--no-ssdp") == 0)
+      options.ssdp = false;
+    else if (strcmp(argv[i], "--script") == 0 && ++i < argc)
+      script = argv[i];
+    else if (strcmp(argv[i], "--duration") == 0 && ++i < argc)
+      duration = atoi(argv[i]);
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  signal(SIGINT, sigHandler);
+  signal(SIGTERM, sigHandler);
+  signal(SIGPIPE, SIG_IGN);
+
+  MockHousehold household(options);
+  if (!household.Start())
+    return 1;
+  for (unsigned z = 0; z < household.GetZoneCount(); ++z)
+    fprintf(stdout, "%s %s\n", household.GetUUID(z).c_str(), household.GetLocation(z).c_str());
+  fflush(stdout);
+
+  int64_t start = SONOS::OS::gettime_ms();
+  bool serve = true;
+  if (script)
+  {
+    FILE* file = fopen(script, "r");
+    if (!file)
+    {
+      fprintf(stderr, "cannot open script %s\n", script);
+      return 1;
+    }
+    serve = runScript(household, file);
+    fclose(file);
+  }
+  if (serve && !duration)
+    serve = runScript(household, stdin);
+  while (serve && !g_stop && (!duration || SONOS::OS::gettime_ms() - start < (int64_t)duration * 1000))
+    usleep(100000);
+
+  household.Stop();
+  household.Execute("stats");
+  return 0;
+}
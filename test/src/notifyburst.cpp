@@ -0,0 +1,357 @@
+#if (defined(_WIN32) || defined(_WIN64))
+#define __WINDOWS__
+#endif
+
+#ifdef __WINDOWS__
+#include <winsock2.h>
+#include <Windows.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#include "../../noson/src/eventhandler.h"
+#include "../../noson/src/private/eventbroker.h"
+#include "../../noson/src/private/wsrequestbroker.h"
+#include "../../noson/src/private/mpscqueue.h"
+#include "../../noson/src/private/socket.h"
+#include "../../noson/src/private/os/threads/thread.h"
+#include "../../noson/src/private/os/threads/event.h"
+#include "../../noson/src/private/os/threads/mutex.h"
+#include "../../noson/src/private/os/threads/timeout.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <list>
+
+/*
+ * Replays a recorded NOTIFY burst, as sent by the players of a household
+ * when the group changes.
+ * 1. Queue contention: the decoded messages are posted by many producers to
+ *    one subscriber, through the former locked list then the lock-free ring.
+ * 2. Delivery: the raw requests are sent concurrently to the event handler
+ *    listening on localhost, then delivered to many subscribers.
+ */
+
+#define BODY_RCS  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/RCS/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;&lt;Volume channel=&quot;Master&quot; val=&quot;23&quot;/&gt;&lt;Volume channel=&quot;LF&quot; val=&quot;100&quot;/&gt;&lt;Volume channel=&quot;RF&quot; val=&quot;100&quot;/&gt;&lt;Mute channel=&quot;Master&quot; val=&quot;0&quot;/&gt;&lt;Bass val=&quot;0&quot;/&gt;&lt;Treble val=&quot;0&quot;/&gt;&lt;Loudness channel=&quot;Master&quot; val=&quot;1&quot;/&gt;&lt;OutputFixed val=&quot;0&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;</LastChange></e:property></e:propertyset>"
+#define BODY_AVT  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/AVT/&quot; xmlns:r=&quot;urn:schemas-rinconnetworks-com:metadata-1-0/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;&lt;TransportState val=&quot;PLAYING&quot;/&gt;&lt;CurrentPlayMode val=&quot;NORMAL&quot;/&gt;&lt;CurrentCrossfadeMode val=&quot;0&quot;/&gt;&lt;NumberOfTracks val=&quot;12&quot;/&gt;&lt;CurrentTrack val=&quot;3&quot;/&gt;&lt;CurrentSection val=&quot;0&quot;/&gt;&lt;CurrentTrackURI val=&quot;x-file-cifs://nas/music/track03.flac&quot;/&gt;&lt;CurrentTrackDuration val=&quot;0:04:12&quot;/&gt;&lt;r:NextTrackURI val=&quot;x-file-cifs://nas/music/track04.flac&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;</LastChange></e:property></e:propertyset>"
+#define BODY_ZGT  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><ZoneGroupState>&lt;ZoneGroups&gt;&lt;ZoneGroup Coordinator=&quot;RINCON_000E58000001400&quot; ID=&quot;RINCON_000E58000001400:12&quot;&gt;&lt;ZoneGroupMember UUID=&quot;RINCON_000E58000001400&quot; Location=&quot;http://192.168.1.20:1400/xml/device_description.xml&quot; ZoneName=&quot;Living Room&quot;/&gt;&lt;/ZoneGroup&gt;&lt;/ZoneGroups&gt;</ZoneGroupState></e:property><e:property><ThirdPartyMediaServersX>0</ThirdPartyMediaServersX></e:property><e:property><AvailableSoftwareUpdate>&lt;UpdateItem/&gt;</AvailableSoftwareUpdate></e:property></e:propertyset>"
+#define BODY_CDS  "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><SystemUpdateID>412</SystemUpdateID></e:property><e:property><ContainerUpdateIDs>Q:0,87</ContainerUpdateIDs></e:property></e:propertyset>"
+
+static const char* g_bodies[] = { BODY_RCS, BODY_AVT, BODY_ZGT, BODY_CDS, BODY_RCS, BODY_AVT };
+static const unsigned g_burstSize = sizeof(g_bodies) / sizeof(g_bodies[0]);
+
+static std::string MakeNotify(unsigned i)
+{
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+          "NOTIFY /notify HTTP/1.1\r\n"
+          "HOST: 127.0.0.1\r\n"
+          "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+          "CONTENT-LENGTH: %u\r\n"
+          "NT: upnp:event\r\n"
+          "NTS: upnp:propchange\r\n"
+          "SID: uuid:RINCON_000E58000001400_sub%010u\r\n"
+          "SEQ: %u\r\n"
+          "\r\n", (unsigned)strlen(g_bodies[i]), i, i);
+  return std::string(buf).append(g_bodies[i]);
+}
+
+/* reads a recorded request from memory */
+class MemorySocket : public SONOS::NetSocket
+{
+public:
+  MemorySocket(const std::string& data) : m_data(data), m_pos(0) { }
+  bool SendData(const char* buf, size_t size) { (void)buf; (void)size; return false; }
+  size_t ReceiveData(void* buf, size_t n)
+  {
+    size_t s = m_data.size() - m_pos;
+    if (s > n)
+      s = n;
+    memcpy(buf, m_data.c_str() + m_pos, s);
+    m_pos += s;
+    return s;
+  }
+private:
+  const std::string& m_data;
+  size_t m_pos;
+};
+
+/* records the messages decoded by the broker */
+class Recorder : public SONOS::EventHandler::EventHandlerThread
+{
+public:
+  Recorder() : EventHandlerThread(0) { }
+  bool Start() { return true; }
+  void Stop() { }
+  bool IsRunning() { return true; }
+  unsigned CreateSubscription(SONOS::EventSubscriber *sub) { (void)sub; return 0; }
+  bool SubscribeForEvent(unsigned subid, SONOS::EVENT_t event) { (void)subid; (void)event; return false; }
+  void RevokeSubscription(unsigned subid) { (void)subid; }
+  void RevokeAllSubscriptions(SONOS::EventSubscriber *sub) { (void)sub; }
+  void DispatchEvent(const SONOS::EventMessage& msg) { messages.push_back(msg); }
+  std::vector<SONOS::EventMessage> messages;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//// Queue contention
+
+class Queue
+{
+public:
+  virtual ~Queue() { }
+  virtual void Post(const SONOS::EventMessage& msg) = 0;
+  virtual bool Start() = 0;
+  virtual void Stop() = 0;
+  unsigned received;
+  unsigned wakeups;
+};
+
+/* the former queue: locked list, signaled on each message */
+class LockedQueue : public Queue, private SONOS::OS::CThread
+{
+public:
+  LockedQueue() { received = wakeups = 0; }
+  void Post(const SONOS::EventMessage& msg)
+  {
+    SONOS::OS::CLockGuard lock(m_mutex);
+    m_queue.push_back(SONOS::EventMessagePtr(new SONOS::EventMessage(msg)));
+    m_event.Signal();
+  }
+  bool Start() { return StartThread(); }
+  void Stop() { StopThread(false); m_event.Signal(); StopThread(true); }
+private:
+  SONOS::OS::CMutex m_mutex;
+  SONOS::OS::CEvent m_event;
+  std::list<SONOS::EventMessagePtr> m_queue;
+  void* Process()
+  {
+    while (!IsStopped())
+    {
+      while (!m_queue.empty())
+      {
+        SONOS::OS::CLockGuard lock(m_mutex);
+        SONOS::EventMessagePtr msg = m_queue.front();
+        m_queue.pop_front();
+        lock.Unlock();
+        ++received;
+      }
+      m_event.Wait();
+      ++wakeups;
+    }
+    return NULL;
+  }
+};
+
+/* the lock-free ring: only the producer finding the consumer idle signals */
+class RingQueue : public Queue, private SONOS::OS::CThread
+{
+public:
+  RingQueue() : m_ring(128) { received = wakeups = 0; SONOS::mpsc::store(m_scheduled, 0); }
+  void Post(const SONOS::EventMessage& msg)
+  {
+    SONOS::EventMessagePtr ptr(new SONOS::EventMessage(msg));
+    while (!m_ring.Push(ptr))
+      usleep(100);
+    if (SONOS::mpsc::cas(m_scheduled, 0, 1))
+      m_event.Signal();
+  }
+  bool Start() { return StartThread(); }
+  void Stop() { StopThread(false); m_event.Signal(); StopThread(true); }
+private:
+  SONOS::MPSCQueue<SONOS::EventMessagePtr> m_ring;
+  SONOS::mpsc::sequence_t m_scheduled;
+  SONOS::OS::CEvent m_event;
+  void* Process()
+  {
+    SONOS::EventMessagePtr msg;
+    while (!IsStopped())
+    {
+      m_event.Wait();
+      ++wakeups;
+      for (;;)
+      {
+        while (m_ring.Pop(msg))
+          ++received;
+        SONOS::mpsc::exchange(m_scheduled, 0);
+        if (m_ring.Empty() || !SONOS::mpsc::cas(m_scheduled, 0, 1))
+          break;
+      }
+    }
+    return NULL;
+  }
+};
+
+class Producer : public SONOS::OS::CThread
+{
+public:
+  Producer(Queue& queue, const std::vector<SONOS::EventMessage>& burst, unsigned count)
+  : m_queue(queue), m_burst(burst), m_count(count) { }
+  void* Process()
+  {
+    for (unsigned n = 0; n < m_count; ++n)
+      for (std::vector<SONOS::EventMessage>::const_iterator it = m_burst.begin(); it != m_burst.end(); ++it)
+        m_queue.Post(*it);
+    return NULL;
+  }
+private:
+  Queue& m_queue;
+  const std::vector<SONOS::EventMessage>& m_burst;
+  unsigned m_count;
+};
+
+static void RunContention(const char* name, Queue& queue, const std::vector<SONOS::EventMessage>& burst,
+                          unsigned producers, unsigned count)
+{
+  unsigned total = producers * count * (unsigned)burst.size();
+  std::vector<Producer*> threads;
+  queue.Start();
+  int64_t start = SONOS::OS::gettime_ms();
+  for (unsigned i = 0; i < producers; ++i)
+  {
+    threads.push_back(new Producer(queue, burst, count));
+    threads.back()->StartThread();
+  }
+  for (unsigned i = 0; i < producers; ++i)
+  {
+    threads[i]->WaitThread(60000);
+    delete threads[i];
+  }
+  while (queue.received < total && SONOS::OS::gettime_ms() - start < 60000)
+    usleep(100);
+  int64_t elapsed = SONOS::OS::gettime_ms() - start;
+  queue.Stop();
+  fprintf(stdout, "%-12s %u producers: %u messages in %lld ms (%.0f msg/s), %u wakeups\n", name, producers,
+          queue.received, (long long)elapsed, elapsed ? 1000.0 * queue.received / elapsed : 0.0, queue.wakeups);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//// Delivery
+
+class Subscriber : public SONOS::EventSubscriber
+{
+public:
+  Subscriber() : count(0) { }
+  void HandleEventMessage(SONOS::EventMessagePtr msg)
+  {
+    if (msg->event == SONOS::EVENT_UPNP_PROPCHANGE)
+      ++count;
+  }
+  volatile unsigned count;
+};
+
+class Sender : public SONOS::OS::CThread
+{
+public:
+  Sender(unsigned port, unsigned count) : m_port(port), m_count(count), failed(0) { }
+  void* Process()
+  {
+    for (unsigned n = 0; n < m_count; ++n)
+    {
+      for (unsigned i = 0; i < g_burstSize; ++i)
+      {
+        SONOS::TcpSocket sock;
+        std::string req = MakeNotify(i);
+        char buf[64];
+        if (!sock.Connect("127.0.0.1", m_port, 0) || !sock.SendData(req.c_str(), req.size()) ||
+                sock.ReceiveSome(buf, sizeof(buf)) == 0)
+          ++failed;
+        sock.Disconnect();
+      }
+    }
+    return NULL;
+  }
+private:
+  unsigned m_port;
+  unsigned m_count;
+public:
+  unsigned failed;
+};
+
+static void RunDelivery(unsigned senders, unsigned subscribers, unsigned count)
+{
+  SONOS::EventHandler handler(3401);
+  std::vector<Subscriber*> subs;
+  for (unsigned i = 0; i < subscribers; ++i)
+  {
+    subs.push_back(new Subscriber());
+    unsigned id = handler.CreateSubscription(subs.back());
+    handler.SubscribeForEvent(id, SONOS::EVENT_UPNP_PROPCHANGE);
+  }
+  if (!handler.Start())
+    return;
+  while (handler.GetPort() == 0 || handler.GetAddress().empty())
+    usleep(1000);
+
+  unsigned expected = senders * count * g_burstSize * subscribers;
+  std::vector<Sender*> threads;
+  int64_t start = SONOS::OS::gettime_ms();
+  for (unsigned i = 0; i < senders; ++i)
+  {
+    threads.push_back(new Sender(handler.GetPort(), count));
+    threads.back()->StartThread();
+  }
+  unsigned failed = 0;
+  for (unsigned i = 0; i < senders; ++i)
+  {
+    threads[i]->WaitThread(60000);
+    failed += threads[i]->failed;
+    delete threads[i];
+  }
+  unsigned delivered = 0;
+  do
+  {
+    delivered = 0;
+    for (unsigned i = 0; i < subscribers; ++i)
+      delivered += subs[i]->count;
+  } while (delivered < expected - failed * subscribers && SONOS::OS::gettime_ms() - start < 60000 && usleep(1000) == 0);
+  int64_t elapsed = SONOS::OS::gettime_ms() - start;
+  fprintf(stdout, "delivery     %u senders x %u requests, %u subscribers: %u/%u messages in %lld ms (%.0f msg/s), %u failed requests\n",
+          senders, count * g_burstSize, subscribers, delivered, expected, (long long)elapsed,
+          elapsed ? 1000.0 * delivered / elapsed : 0.0, failed);
+  handler.Stop();
+  for (unsigned i = 0; i < subscribers; ++i)
+  {
+    handler.RevokeAllSubscriptions(subs[i]);
+    delete subs[i];
+  }
+}
+
+int main(int argc, char** argv)
+{
+  unsigned count = 2000;
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  // decode the recorded burst
+  Recorder recorder;
+  for (unsigned i = 0; i < g_burstSize; ++i)
+  {
+    std::string req = MakeNotify(i);
+    MemorySocket sock(req);
+    struct timeval timeout = { 0, 0 };
+    SONOS::WSRequestBroker rb(&sock, timeout);
+    std::string resp;
+    SONOS::EventBroker::HandleRequest(&recorder, rb, resp);
+  }
+  unsigned props = 0;
+  for (std::vector<SONOS::EventMessage>::const_iterator it = recorder.messages.begin(); it != recorder.messages.end(); ++it)
+    props += (unsigned)it->properties.size();
+  fprintf(stdout, "burst: %u requests, %u messages decoded, %u properties\n", g_burstSize, (unsigned)recorder.messages.size(), props);
+
+  unsigned producers[] = { 1, 4, 16 };
+  for (unsigned i = 0; i < sizeof(producers) / sizeof(producers[0]); ++i)
+  {
+    LockedQueue locked;
+    RunContention("locked list", locked, recorder.messages, producers[i], count);
+    RingQueue ring;
+    RunContention("mpsc ring", ring, recorder.messages, producers[i], count);
+  }
+
+  RunDelivery(8, 200, count / 100 > 0 ? count / 100 : 1);
+  return 0;
+}